@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#ifdef __SSE__
+#    include <xmmintrin.h>
+#endif
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include "srs/daemon/pulse.h"
+#include "srs/daemon/aec.h"
+
+#define DEFAULT_TAIL    64               /* default echo tail (msec) */
+#define DEFAULT_MARGIN  8                /* default alignment margin (msec) */
+#define STEP_SIZE       0.3              /* NLMS step size */
+#define POWER_MIN       (1000.0 * 1000.0)/* min. reference power to adapt */
+#define DTD_THRESHOLD   0.5              /* Geigel double-talk threshold */
+#define DTD_HOLD        30               /* double-talk hold time (msec) */
+#define PEAK_DECAY      0.9995           /* reference peak decay/sample */
+
+struct srs_aec_s {
+    srs_pulse_t      *p;                 /* playback (reference) context */
+    srs_aec_config_t  cfg;               /* configuration */
+    size_t            ntap;              /* filter length */
+    pa_usec_t         margin;            /* alignment margin */
+    float            *w;                 /* adaptive filter taps */
+    float            *x;                 /* mirrored reference history */
+    size_t            idx;               /* history position (newest) */
+    double            xpow;              /* reference power in history */
+    float             peak;              /* decaying reference peak */
+    uint32_t          hold;              /* remaining double-talk hold */
+    uint32_t          holdlen;           /* double-talk hold in samples */
+    int16_t          *ref;               /* reference block */
+    size_t            nref;              /* reference block size */
+};
+
+
+srs_aec_t *srs_aec_create(srs_pulse_t *p, srs_aec_config_t *cfg)
+{
+    srs_aec_t *aec;
+    size_t     ntap;
+
+    if (p == NULL || cfg == NULL || !cfg->rate) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ((aec = mrp_allocz(sizeof(*aec))) == NULL)
+        return NULL;
+
+    aec->p   = p;
+    aec->cfg = *cfg;
+
+    if (!aec->cfg.tail)
+        aec->cfg.tail = DEFAULT_TAIL;
+    if (!aec->cfg.margin)
+        aec->cfg.margin = DEFAULT_MARGIN;
+
+    ntap = (size_t)cfg->rate * aec->cfg.tail / 1000;
+    ntap = (ntap + 3) & ~(size_t)3;
+
+    aec->ntap    = ntap;
+    aec->margin  = aec->cfg.margin * PA_USEC_PER_MSEC;
+    aec->holdlen = cfg->rate * DTD_HOLD / 1000;
+    aec->w       = mrp_allocz(ntap * sizeof(aec->w[0]));
+    aec->x       = mrp_allocz(2 * ntap * sizeof(aec->x[0]));
+
+    if (aec->w == NULL || aec->x == NULL) {
+        srs_aec_destroy(aec);
+        return NULL;
+    }
+
+    mrp_log_info("echo canceller: %zu taps (%u msec tail, %u msec margin)",
+                 ntap, aec->cfg.tail, aec->cfg.margin);
+
+    return aec;
+}
+
+
+void srs_aec_destroy(srs_aec_t *aec)
+{
+    if (aec != NULL) {
+        mrp_free(aec->w);
+        mrp_free(aec->x);
+        mrp_free(aec->ref);
+        mrp_free(aec);
+    }
+}
+
+
+void srs_aec_reset(srs_aec_t *aec)
+{
+    if (aec != NULL) {
+        memset(aec->w, 0, aec->ntap * sizeof(aec->w[0]));
+        memset(aec->x, 0, 2 * aec->ntap * sizeof(aec->x[0]));
+        aec->idx  = 0;
+        aec->xpow = 0.0;
+        aec->peak = 0.0;
+        aec->hold = 0;
+    }
+}
+
+
+#ifdef __SSE__
+
+static inline float dot(const float *a, const float *b, size_t n)
+{
+    __m128 acc = _mm_setzero_ps();
+    float  sum[4];
+    size_t i;
+
+    for (i = 0; i < n; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                         _mm_loadu_ps(b + i)));
+
+    _mm_storeu_ps(sum, acc);
+
+    return sum[0] + sum[1] + sum[2] + sum[3];
+}
+
+
+static inline void axpy(float *y, float a, const float *x, size_t n)
+{
+    __m128 va = _mm_set1_ps(a);
+    size_t i;
+
+    for (i = 0; i < n; i += 4)
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                        _mm_mul_ps(va, _mm_loadu_ps(x + i))));
+}
+
+#else /* !__SSE__ */
+
+static inline float dot(const float *a, const float *b, size_t n)
+{
+    float  sum = 0.0;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+
+static inline void axpy(float *y, float a, const float *x, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        y[i] += a * x[i];
+}
+
+#endif /* !__SSE__ */
+
+
+int srs_aec_process(srs_aec_t *aec, const int16_t *in, int16_t *out,
+                    size_t nsample, pa_usec_t when)
+{
+    size_t  ntap, active, i;
+    float   xs, old, d, e, *win;
+    int32_t v;
+
+    if (aec == NULL || in == NULL || out == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (aec->nref < nsample) {
+        if (mrp_reallocz(aec->ref, aec->nref, nsample) == NULL) {
+            aec->nref = 0;
+            return -1;
+        }
+        aec->nref = nsample;
+    }
+
+    /*
+     * Fetch the reference slightly before the capture timestamp so the
+     * echo lands a few taps into the filter and alignment errors in
+     * either direction stay within its reach.
+     */
+    if (when > aec->margin)
+        when -= aec->margin;
+
+    active = srs_pulse_echo_reference(aec->p, when, aec->cfg.rate,
+                                      aec->ref, nsample);
+
+    if (!active && aec->xpow < POWER_MIN) {
+        if (out != in)
+            memmove(out, in, nsample * sizeof(out[0]));
+        return 0;
+    }
+
+    ntap = aec->ntap;
+
+    for (i = 0; i < nsample; i++) {
+        xs = aec->ref[i];
+
+        /* push the reference sample to the mirrored history */
+        aec->idx = aec->idx ? aec->idx - 1 : ntap - 1;
+        old = aec->x[aec->idx + ntap];
+        aec->x[aec->idx] = aec->x[aec->idx + ntap] = xs;
+        win = aec->x + aec->idx;
+
+        if (aec->idx == 0)
+            aec->xpow = dot(win, win, ntap);
+        else
+            aec->xpow += xs * xs - old * old;
+
+        if (aec->xpow < 0.0)
+            aec->xpow = 0.0;
+
+        aec->peak *= PEAK_DECAY;
+        if (fabsf(xs) > aec->peak)
+            aec->peak = fabsf(xs);
+
+        d = in[i];
+        e = d - dot(aec->w, win, ntap);
+
+        /* freeze adaptation while the near end is talking */
+        if (fabsf(d) > DTD_THRESHOLD * aec->peak)
+            aec->hold = aec->holdlen;
+
+        if (aec->hold > 0)
+            aec->hold--;
+        else if (aec->xpow > POWER_MIN)
+            axpy(aec->w, STEP_SIZE * e / (aec->xpow + POWER_MIN), win, ntap);
+
+        v = (int32_t)lrintf(e);
+
+        if (v > 32767)
+            v = 32767;
+        else if (v < -32768)
+            v = -32768;
+
+        out[i] = v;
+    }
+
+    return 1;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_AEC_H__
+#define __SRS_DAEMON_AEC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pulse/sample.h>
+
+#include "srs/daemon/context.h"
+
+/*
+ * acoustic echo cancellation against our own playback
+ */
+
+typedef struct srs_aec_s srs_aec_t;
+
+/** Echo canceller configuration. */
+typedef struct {
+    uint32_t rate;                       /* capture sample rate */
+    uint32_t tail;                       /* echo tail length (msec) */
+    uint32_t margin;                     /* alignment margin (msec) */
+} srs_aec_config_t;
+
+/** Create an echo canceller using the playback of p as reference. */
+srs_aec_t *srs_aec_create(srs_pulse_t *p, srs_aec_config_t *cfg);
+
+/** Destroy the given echo canceller. */
+void srs_aec_destroy(srs_aec_t *aec);
+
+/** Forget everything the canceller has adapted to. */
+void srs_aec_reset(srs_aec_t *aec);
+
+/**
+ * Remove echo from nsample 16-bit mono capture samples, the first of
+ * which was captured at the given time (on the pa_rtclock_now() time
+ * base). in and out may point to the same buffer. Returns 1 if echo was
+ * cancelled, 0 if there was no reference (out is a copy of in) or -1 on
+ * error.
+ */
+int srs_aec_process(srs_aec_t *aec, const int16_t *in, int16_t *out,
+                    size_t nsample, pa_usec_t when);
+
+#endif /* __SRS_DAEMON_AEC_H__ */
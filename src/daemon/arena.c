@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <murphy/common/mm.h>
+
+#include "srs/daemon/arena.h"
+
+#define ARENA_ALIGN    16                /* alignment of allocations */
+#define DEFAULT_BLOCK  4096              /* default block size */
+
+typedef struct block_s block_t;
+
+struct block_s {
+    block_t *next;                       /* next block */
+    size_t   size;                       /* usable size of this block */
+    size_t   used;                       /* amount used */
+    char    *data;                       /* aligned start of data */
+};
+
+struct srs_arena_s {
+    size_t   blksize;                    /* default block size */
+    block_t *blocks;                     /* all blocks */
+    block_t *cur;                        /* block we're allocating from */
+};
+
+
+srs_arena_t *srs_arena_create(size_t blksize)
+{
+    srs_arena_t *a;
+
+    if ((a = mrp_allocz(sizeof(*a))) == NULL)
+        return NULL;
+
+    a->blksize = blksize ? blksize : DEFAULT_BLOCK;
+
+    return a;
+}
+
+
+void srs_arena_destroy(srs_arena_t *a)
+{
+    block_t *b, *n;
+
+    if (a == NULL)
+        return;
+
+    for (b = a->blocks; b != NULL; b = n) {
+        n = b->next;
+        mrp_free(b);
+    }
+
+    mrp_free(a);
+}
+
+
+static block_t *add_block(srs_arena_t *a, block_t *after, size_t size)
+{
+    block_t *b;
+    size_t   hdr;
+
+    if (size < a->blksize)
+        size = a->blksize;
+
+    hdr = (sizeof(*b) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if ((b = mrp_alloc(hdr + size)) == NULL)
+        return NULL;
+
+    b->size = size;
+    b->used = 0;
+    b->data = (char *)b + hdr;
+
+    if (after != NULL) {
+        b->next     = after->next;
+        after->next = b;
+    }
+    else {
+        b->next   = a->blocks;
+        a->blocks = b;
+    }
+
+    return b;
+}
+
+
+void *srs_arena_alloc(srs_arena_t *a, size_t size)
+{
+    block_t *b;
+    void    *ptr;
+
+    if (a == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (size == 0)
+        size = ARENA_ALIGN;
+
+    /*
+     * Blocks after the current one are always unused (left over from
+     * before the last reset), so try them in order before growing.
+     */
+    for (b = a->cur; b != NULL; b = b->next) {
+        if (b != a->cur)
+            b->used = 0;
+
+        if (b->size - b->used >= size)
+            break;
+    }
+
+    if (b == NULL && (b = add_block(a, a->cur, size)) == NULL)
+        return NULL;
+
+    a->cur   = b;
+    ptr      = b->data + b->used;
+    b->used += size;
+
+    memset(ptr, 0, size);
+
+    return ptr;
+}
+
+
+void srs_arena_reset(srs_arena_t *a)
+{
+    if (a == NULL)
+        return;
+
+    a->cur = a->blocks;
+
+    if (a->cur != NULL)
+        a->cur->used = 0;
+}
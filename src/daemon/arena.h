@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_ARENA_H__
+#define __SRS_DAEMON_ARENA_H__
+
+#include <stddef.h>
+
+/*
+ * a simple bump allocator for short-lived, per-utterance allocations
+ *
+ * Memory handed out by an arena is never freed individually. Resetting
+ * the arena releases everything at once but keeps the underlying blocks
+ * around, so an arena that has seen its peak usage once does not touch
+ * the heap any more.
+ */
+
+typedef struct srs_arena_s srs_arena_t;
+
+/** Create an arena allocating from blocks of (at least) the given size. */
+srs_arena_t *srs_arena_create(size_t blksize);
+
+/** Destroy the given arena, freeing all memory allocated from it. */
+void srs_arena_destroy(srs_arena_t *a);
+
+/** Allocate size bytes of zeroed memory from the arena. */
+void *srs_arena_alloc(srs_arena_t *a, size_t size);
+
+/** Release all allocations from the arena, keeping its blocks. */
+void srs_arena_reset(srs_arena_t *a);
+
+/** Allocate memory for n objects of the given type from the arena. */
+#define srs_arena_alloc_array(a, type, n) \
+    ((type *)srs_arena_alloc((a), sizeof(type) * (n)))
+
+#endif /* __SRS_DAEMON_ARENA_H__ */
@@ -27,12 +27,20 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
 
 #include "srs/daemon/resctl.h"
 #include "srs/daemon/recognizer.h"
 #include "srs/daemon/client.h"
+#include "srs/daemon/cmdset.h"
+
+#define VOICE_RATE_MIN  0.1              /* slowest voice rate accepted */
+#define VOICE_RATE_MAX  10.0             /* fastest voice rate accepted */
+#define VOICE_PITCH_MIN 0.1              /* lowest voice pitch accepted */
+#define VOICE_PITCH_MAX 10.0             /* highest voice pitch accepted */
 
 typedef struct {
     mrp_list_hook_t  hook;               /* to list of voice requests */
@@ -79,95 +87,39 @@ void client_create_resources(srs_context_t *srs)
 }
 
 
-static void free_commands(srs_command_t *cmds, int ncmd)
+static int register_client(srs_client_t *c)
 {
-    srs_command_t *c;
-    int            i, j;
+    srs_context_t *srs = c->srs;
 
-    if (cmds != NULL) {
-        for (i = 0, c = cmds; i < ncmd; i++, c++) {
-            if (c->tokens != NULL) {
-                for (j = 0; j < c->ntoken; j++)
-                    mrp_free(c->tokens[j]);
-
-                mrp_free(c->tokens);
-            }
-        }
+    /* the first client registering an id keeps it */
+    if (client_lookup_by_id(srs, c->id) == NULL &&
+        !mrp_htbl_insert(srs->client_ids, c->id, c))
+        return -1;
 
-        mrp_free(cmds);
-    }
+    return 0;
 }
 
 
-static int parse_command(srs_command_t *cmd, char *command)
+static void unregister_client(srs_client_t *c)
 {
-    char **tokens, *p, *b, *e;
-    int    ntoken, len, osize, nsize, i;
-
-    tokens = NULL;
-    ntoken = 0;
-
-    p = command;
-
-    while (*p) {
-        b = p;
-        while (*b == ' ' || *b == '\t')
-            b++;
-
-        e = b;
-        while (*e != ' ' && *e != '\t' && *e != '\0')
-            e++;
-
-        len   = e - b;
-        osize = sizeof(*tokens) *  ntoken;
-        nsize = sizeof(*tokens) * (ntoken + 1);
-
-        if (mrp_reallocz(tokens, osize, nsize) == NULL)
-            goto fail;
-
-        tokens[ntoken] = mrp_datadup(b, len + 1);
-
-        if (tokens[ntoken] == NULL)
-            goto fail;
-
-        tokens[ntoken][len] = '\0';
-        ntoken++;
-
-        p = e;
-    }
-
-    cmd->tokens = tokens;
-    cmd->ntoken = ntoken;
-
-    return TRUE;
-
- fail:
-    for (i = 0; i < ntoken; i++)
-        mrp_free(tokens[i]);
-    mrp_free(tokens);
-
-    return FALSE;
-}
+    srs_context_t   *srs = c->srs;
+    srs_client_t    *o;
+    mrp_list_hook_t *p, *n;
 
+    if (mrp_htbl_lookup(srs->client_ids, c->id) != c)
+        return;
 
-static srs_command_t *parse_commands(char **commands, int ncommand)
-{
-    srs_command_t *cmds;
-    int            i;
+    mrp_htbl_remove(srs->client_ids, c->id, FALSE);
 
-    cmds = mrp_allocz_array(typeof(*cmds), ncommand);
+    /* let any other client with the same id take over the entry */
+    mrp_list_foreach(&srs->clients, p, n) {
+        o = mrp_list_entry(p, typeof(*o), hook);
 
-    if (cmds != NULL) {
-        for (i = 0; i < ncommand; i++)
-            if (!parse_command(cmds + i, commands[i]))
-                goto fail;
+        if (o != c && !strcmp(o->id, c->id)) {
+            mrp_htbl_insert(srs->client_ids, o->id, o);
+            break;
+        }
     }
-
-    return cmds;
-
- fail:
-    free_commands(cmds, ncommand);
-    return NULL;
 }
 
 
@@ -198,12 +150,15 @@ srs_client_t *client_create(srs_context_t *srs, srs_client_type_t type,
         return NULL;
     }
 
-    if (commands != NULL) {
-        c->commands = parse_commands(commands, ncommand);
-        c->ncommand = ncommand;
+    if (commands != NULL && ncommand > 0) {
+        if ((c->cmdset = srs_cmdset_get(commands, ncommand)) != NULL) {
+            c->commands = c->cmdset->commands;
+            c->ncommand = c->cmdset->ncommand;
+        }
     }
 
-    if ((c->commands == NULL && ncommand) || srs_srec_add_client(srs, c) != 0) {
+    if ((c->cmdset == NULL && ncommand) || register_client(c) < 0 ||
+        srs_srec_add_client(srs, c) != 0) {
         client_destroy(c);
         return NULL;
     }
@@ -218,6 +173,15 @@ srs_client_t *client_create(srs_context_t *srs, srs_client_type_t type,
 }
 
 
+static void cancel_voice_request(voice_req_t *req)
+{
+    srs_cancel_voice(req->c->srs, req->id, FALSE);
+
+    mrp_list_delete(&req->hook);
+    mrp_free(req);
+}
+
+
 static void purge_voice_requests(srs_client_t *c)
 {
     mrp_list_hook_t *p, *n;
@@ -225,7 +189,7 @@ static void purge_voice_requests(srs_client_t *c)
 
     mrp_list_foreach(&c->voices, p, n) {
         req = mrp_list_entry(p, typeof(*req), hook);
-        client_cancel_voice(c, req->id);
+        cancel_voice_request(req);
     }
 }
 
@@ -241,32 +205,291 @@ void client_destroy(srs_client_t *c)
         c->rset = NULL;
 
         mrp_list_delete(&c->hook);
+        unregister_client(c);
 
         mrp_free(c->name);
         mrp_free(c->appclass);
         mrp_free(c->id);
 
-        free_commands(c->commands, c->ncommand);
+        if (c->cmdset != NULL)
+            srs_cmdset_unref(c->cmdset);
+        else
+            srs_commands_free(c->commands, c->ncommand);
         purge_voice_requests(c);
     }
 }
 
 
-srs_client_t *client_lookup_by_id(srs_context_t *srs, const char *id)
+static int same_command(srs_command_t *a, srs_command_t *b)
 {
-    srs_client_t    *c;
-    mrp_list_hook_t *p, *n;
+    int i;
 
-    /* for now we just do a linear search... */
+    if (a->ntoken != b->ntoken)
+        return FALSE;
 
-    mrp_list_foreach(&srs->clients, p, n) {
-        c = mrp_list_entry(p, typeof(*c), hook);
+    for (i = 0; i < a->ntoken; i++)
+        if (strcmp(a->tokens[i], b->tokens[i]))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+static int unshare_commands(srs_client_t *c)
+{
+    srs_cmdset_t  *set = c->cmdset;
+    srs_command_t *cmds;
+    int            i, j;
+
+    /*
+     * Before changing its commands, give the client a private copy of
+     * its shared command set and re-register it with that one.
+     */
+
+    if (set == NULL)
+        return TRUE;
+
+    if ((cmds = mrp_allocz_array(srs_command_t, set->ncommand)) == NULL)
+        return FALSE;
+
+    for (i = 0; i < set->ncommand; i++) {
+        cmds[i].tokens = mrp_allocz_array(char *, set->commands[i].ntoken);
+
+        if (cmds[i].tokens == NULL)
+            goto nomem;
+
+        for (j = 0; j < set->commands[i].ntoken; j++) {
+            cmds[i].tokens[j] = mrp_strdup(set->commands[i].tokens[j]);
+
+            if (cmds[i].tokens[j] == NULL) {
+                cmds[i].ntoken = j;
+                goto nomem;
+            }
+        }
+
+        cmds[i].ntoken = j;
+    }
+
+    srs_srec_del_client(c->srs, c);
+
+    c->cmdset   = NULL;
+    c->commands = cmds;
+
+    if (srs_srec_add_client(c->srs, c) != 0) {
+        mrp_log_error("Failed to re-register client %s.", c->id);
+
+        c->cmdset   = set;
+        c->commands = set->commands;
+        srs_srec_add_client(c->srs, c);
+        srs_commands_free(cmds, c->ncommand);
+
+        return FALSE;
+    }
+
+    srs_cmdset_unref(set);
+
+    return TRUE;
+
+ nomem:
+    srs_commands_free(cmds, set->ncommand);
+    errno = ENOMEM;
+
+    return FALSE;
+}
+
+
+int client_add_commands(srs_client_t *c, char **commands, int ncommand)
+{
+    srs_command_t *cmds;
+    int           *indices, first, i;
+
+    /*
+     * New commands are always appended, so the indices of the existing
+     * ones (which is what clients get notified with) stay the same.
+     */
 
-        if (!strcmp(c->id, id))
-            return c;
+    if (ncommand <= 0)
+        return TRUE;
+
+    if (!unshare_commands(c))
+        return FALSE;
+
+    if ((cmds = srs_commands_parse(commands, ncommand)) == NULL)
+        return FALSE;
+
+    first   = c->ncommand;
+    indices = mrp_alloc_array(int, ncommand);
+
+    if (indices == NULL || !mrp_reallocz(c->commands, first, first + ncommand))
+        goto fail;
+
+    for (i = 0; i < ncommand; i++) {
+        c->commands[first + i] = cmds[i];
+        indices[i] = first + i;
     }
 
-    return NULL;
+    mrp_free(cmds);
+    cmds = NULL;
+    c->ncommand += ncommand;
+
+    if (srs_srec_add_commands(c->srs, c, indices, ncommand) != 0) {
+        mrp_log_error("Failed to add %d commands to client %s.", ncommand,
+                      c->id);
+
+        c->ncommand = first;
+        for (i = first; i < first + ncommand; i++)
+            srs_command_clear(c->commands + i);
+
+        goto fail;
+    }
+
+    mrp_free(indices);
+
+    mrp_log_info("added %d commands to client %s", ncommand, c->id);
+
+    return TRUE;
+
+ fail:
+    srs_commands_free(cmds, ncommand);
+    mrp_free(indices);
+
+    return FALSE;
+}
+
+
+int client_remove_commands(srs_client_t *c, char **commands, int ncommand)
+{
+    srs_command_t *cmds, *cmd;
+    int           *indices, i, j, k;
+
+    /*
+     * Removed commands leave an empty slot behind, again to keep the
+     * indices of the remaining commands intact. Trailing empty slots
+     * are trimmed, so replacing a whole command set does not grow it.
+     */
+
+    if (ncommand <= 0)
+        return TRUE;
+
+    if (!unshare_commands(c))
+        return FALSE;
+
+    if ((cmds = srs_commands_parse(commands, ncommand)) == NULL)
+        return FALSE;
+
+    if ((indices = mrp_alloc_array(int, ncommand)) == NULL) {
+        srs_commands_free(cmds, ncommand);
+        return FALSE;
+    }
+
+    for (i = 0; i < ncommand; i++) {
+        for (j = 0; j < c->ncommand; j++) {
+            cmd = c->commands + j;
+
+            if (cmd->tokens == NULL || !same_command(cmd, cmds + i))
+                continue;
+
+            for (k = 0; k < i; k++)
+                if (indices[k] == j)
+                    break;
+
+            if (k == i)
+                break;
+        }
+
+        if (j == c->ncommand) {
+            mrp_log_error("Client %s has no command '%s' to remove.", c->id,
+                          commands[i]);
+            srs_commands_free(cmds, ncommand);
+            mrp_free(indices);
+            errno = ENOENT;
+            return FALSE;
+        }
+
+        indices[i] = j;
+    }
+
+    srs_commands_free(cmds, ncommand);
+
+    srs_srec_del_commands(c->srs, c, indices, ncommand);
+
+    for (i = 0; i < ncommand; i++)
+        srs_command_clear(c->commands + indices[i]);
+
+    while (c->ncommand > 0 && c->commands[c->ncommand - 1].tokens == NULL)
+        c->ncommand--;
+
+    if (c->ncommand == 0) {
+        mrp_free(c->commands);
+        c->commands = NULL;
+    }
+
+    mrp_free(indices);
+
+    mrp_log_info("removed %d commands from client %s", ncommand, c->id);
+
+    return TRUE;
+}
+
+
+int client_set_commands(srs_client_t *c, char **commands, int ncommand)
+{
+    srs_cmdset_t  *oset  = c->cmdset, *set;
+    srs_command_t *ocmds = c->commands;
+    int            on    = c->ncommand;
+
+    /*
+     * Swap in the shared set for the new commands. Clients replacing
+     * their commands with the same ones (for instance all users of a
+     * reloaded grammar) end up sharing a single set again, which only
+     * gets parsed once.
+     */
+
+    if (ncommand > 0) {
+        if ((set = srs_cmdset_get(commands, ncommand)) == NULL)
+            return FALSE;
+
+        if (set == oset) {
+            srs_cmdset_unref(set);
+            return TRUE;
+        }
+    }
+    else
+        set = NULL;
+
+    srs_srec_del_client(c->srs, c);
+
+    c->cmdset   = set;
+    c->commands = set != NULL ? set->commands : NULL;
+    c->ncommand = set != NULL ? set->ncommand : 0;
+
+    if (srs_srec_add_client(c->srs, c) != 0) {
+        mrp_log_error("Failed to re-register client %s.", c->id);
+
+        c->cmdset   = oset;
+        c->commands = ocmds;
+        c->ncommand = on;
+        srs_srec_add_client(c->srs, c);
+        srs_cmdset_unref(set);
+
+        return FALSE;
+    }
+
+    if (oset != NULL)
+        srs_cmdset_unref(oset);
+    else
+        srs_commands_free(ocmds, on);
+
+    mrp_log_info("replaced commands of client %s (%d commands)", c->id,
+                 c->ncommand);
+
+    return TRUE;
+}
+
+
+srs_client_t *client_lookup_by_id(srs_context_t *srs, const char *id)
+{
+    return mrp_htbl_lookup(srs->client_ids, (void *)id);
 }
 
 
@@ -354,7 +577,7 @@ void client_notify_command(srs_client_t *c, int index,
     if (c->rset != NULL && !(c->granted & SRS_RESCTL_MASK_SREC))
         return;
 
-    if (0 <= index && index < c->ncommand) {
+    if (0 <= index && index < c->ncommand && c->commands[index].tokens) {
         c->ops.notify_command(c, index, ntoken, (char **)tokens,
                               start, end, audio);
     }
@@ -384,13 +607,27 @@ static void client_voice_event(srs_voice_event_t *event, void *notify_data)
 
 uint32_t client_render_voice(srs_client_t *c, const char *msg,
                              const char *voice, double rate, double pitch,
-                             int timeout, int notify_events)
+                             int timeout, int priority, int notify_events)
 {
     srs_context_t *srs    = c->srs;
     const char    *tags[] = { "media.role=speech", NULL };
     int            forced = SRS_VOICE_MASK_DONE;
     voice_req_t   *req;
 
+    if (rate == 0)
+        rate = 1;
+    if (pitch == 0)
+        pitch = 1;
+
+    /* written this way to reject NaNs, too */
+    if (!(rate >= VOICE_RATE_MIN && rate <= VOICE_RATE_MAX) ||
+        !(pitch >= VOICE_PITCH_MIN && pitch <= VOICE_PITCH_MAX)) {
+        mrp_log_error("Invalid voice rate (%f) or pitch (%f) requested.",
+                      rate, pitch);
+        errno = EINVAL;
+        return SRS_VOICE_INVALID;
+    }
+
     if ((req = mrp_allocz(sizeof(*req))) == NULL)
         return SRS_VOICE_INVALID;
 
@@ -398,13 +635,9 @@ uint32_t client_render_voice(srs_client_t *c, const char *msg,
     req->c             = c;
     req->notify_events = notify_events;
 
-    if (rate == 0)
-        rate = 1;
-    if (pitch == 0)
-        pitch = 1;
-
     req->id = srs_render_voice(srs, msg, (char **)tags, voice, rate, pitch,
-                               timeout, notify_events | forced,
+                               timeout, priority, c->id,
+                               notify_events | forced,
                                client_voice_event, req);
 
     if (req->id != SRS_VOICE_INVALID) {
@@ -422,7 +655,6 @@ uint32_t client_render_voice(srs_client_t *c, const char *msg,
 
 void client_cancel_voice(srs_client_t *c, uint32_t id)
 {
-    srs_context_t   *srs = c->srs;
     mrp_list_hook_t *p, *n;
     voice_req_t     *req;
 
@@ -430,11 +662,7 @@ void client_cancel_voice(srs_client_t *c, uint32_t id)
         req = mrp_list_entry(p, typeof(*req), hook);
 
         if (req->id == id) {
-            srs_cancel_voice(srs, id, FALSE);
-
-            mrp_list_delete(&req->hook);
-            mrp_free(req);
-
+            cancel_voice_request(req);
             return;
         }
     }
@@ -31,6 +31,7 @@
 #define __SRS_DAEMON_CLIENT_H__
 
 typedef struct srs_client_s srs_client_t;
+typedef struct srs_cmdset_s srs_cmdset_t;
 
 #include "srs/daemon/context.h"
 #include "srs/daemon/resctl.h"
@@ -96,6 +97,7 @@ struct srs_client_s {
     char                   *appclass;    /* client application class */
     srs_command_t          *commands;    /* client command set */
     int                     ncommand;    /* number of commands */
+    srs_cmdset_t           *cmdset;      /* shared set commands are from */
     char                   *id;          /* client id */
     srs_context_t          *srs;         /* context back pointer */
     srs_resset_t           *rset;        /* resource set */
@@ -119,6 +121,15 @@ srs_client_t *client_create(srs_context_t *srs, srs_client_type_t type,
 /** Destroy a client. */
 void client_destroy(srs_client_t *c);
 
+/** Add commands to the command set of a client. */
+int client_add_commands(srs_client_t *c, char **commands, int ncommand);
+
+/** Remove commands from the command set of a client. */
+int client_remove_commands(srs_client_t *c, char **commands, int ncommand);
+
+/** Replace the command set of a client, sharing it if possible. */
+int client_set_commands(srs_client_t *c, char **commands, int ncommand);
+
 /** Look up a client by its id. */
 srs_client_t *client_lookup_by_id(srs_context_t *srs, const char *id);
 
@@ -133,7 +144,7 @@ void client_notify_command(srs_client_t *c, int idx, int ntoken,
 /** Request synthesizing a message. */
 uint32_t client_render_voice(srs_client_t *c, const char *msg,
                              const char *voice, double rate, double pitch,
-                             int timeout, int notify_events);
+                             int timeout, int priority, int notify_events);
 
 /** Cancel/stop a synthesizing request. */
 void client_cancel_voice(srs_client_t *c, uint32_t id);
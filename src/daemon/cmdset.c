@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+
+#include "srs/daemon/cmdset.h"
+
+static MRP_LIST_HOOK(cmdsets);           /* shared command sets */
+
+
+static const char *scan_token(const char *p, const char **endp)
+{
+    const char *b, *e;
+
+    b = p;
+    while (*b == ' ' || *b == '\t')
+        b++;
+
+    e = b;
+    while (*e != ' ' && *e != '\t' && *e != '\0')
+        e++;
+
+    *endp = e;
+
+    return b;
+}
+
+
+void srs_command_clear(srs_command_t *cmd)
+{
+    int i;
+
+    if (cmd->tokens != NULL) {
+        for (i = 0; i < cmd->ntoken; i++)
+            mrp_free(cmd->tokens[i]);
+
+        mrp_free(cmd->tokens);
+    }
+
+    cmd->tokens = NULL;
+    cmd->ntoken = 0;
+}
+
+
+void srs_commands_free(srs_command_t *cmds, int ncommand)
+{
+    int i;
+
+    if (cmds != NULL) {
+        for (i = 0; i < ncommand; i++)
+            srs_command_clear(cmds + i);
+
+        mrp_free(cmds);
+    }
+}
+
+
+static int parse_command(srs_command_t *cmd, char *command)
+{
+    char       **tokens;
+    const char  *p, *b, *e;
+    int          ntoken, len, osize, nsize, i;
+
+    tokens = NULL;
+    ntoken = 0;
+
+    p = command;
+
+    while (*p) {
+        b = scan_token(p, &e);
+
+        len   = e - b;
+        osize = sizeof(*tokens) *  ntoken;
+        nsize = sizeof(*tokens) * (ntoken + 1);
+
+        if (mrp_reallocz(tokens, osize, nsize) == NULL)
+            goto fail;
+
+        tokens[ntoken] = mrp_datadup(b, len + 1);
+
+        if (tokens[ntoken] == NULL)
+            goto fail;
+
+        tokens[ntoken][len] = '\0';
+        ntoken++;
+
+        p = e;
+    }
+
+    cmd->tokens = tokens;
+    cmd->ntoken = ntoken;
+
+    return TRUE;
+
+ fail:
+    for (i = 0; i < ntoken; i++)
+        mrp_free(tokens[i]);
+    mrp_free(tokens);
+
+    return FALSE;
+}
+
+
+srs_command_t *srs_commands_parse(char **commands, int ncommand)
+{
+    srs_command_t *cmds;
+    int            i;
+
+    cmds = mrp_allocz_array(typeof(*cmds), ncommand);
+
+    if (cmds != NULL) {
+        for (i = 0; i < ncommand; i++)
+            if (!parse_command(cmds + i, commands[i]))
+                goto fail;
+    }
+
+    return cmds;
+
+ fail:
+    srs_commands_free(cmds, ncommand);
+    return NULL;
+}
+
+
+static uint32_t hash_commands(char **commands, int ncommand)
+{
+    uint32_t    h = 2166136261u;         /* 32-bit FNV-1a */
+    const char *p, *b, *e;
+    int         i;
+
+    /*
+     * Hash the tokens the commands would be parsed into, with a token
+     * and a command separator, so that commands differing only in the
+     * amount of whitespace between tokens end up in the same set.
+     */
+
+    for (i = 0; i < ncommand; i++) {
+        for (p = commands[i]; *p; p = e) {
+            for (b = scan_token(p, &e); b < e; b++) {
+                h ^= (uint8_t)*b;
+                h *= 16777619u;
+            }
+
+            h ^= ' ';
+            h *= 16777619u;
+        }
+
+        h ^= '\n';
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+static int same_command(srs_command_t *cmd, const char *command)
+{
+    const char *p, *b, *e;
+    int         i;
+
+    for (i = 0, p = command; *p; i++, p = e) {
+        b = scan_token(p, &e);
+
+        if (i >= cmd->ntoken || strncmp(cmd->tokens[i], b, e - b) ||
+            cmd->tokens[i][e - b] != '\0')
+            return FALSE;
+    }
+
+    return i == cmd->ntoken;
+}
+
+
+static srs_cmdset_t *find_cmdset(uint32_t hash, char **commands, int ncommand)
+{
+    srs_cmdset_t    *set;
+    mrp_list_hook_t *p, *n;
+    int              i;
+
+    mrp_list_foreach(&cmdsets, p, n) {
+        set = mrp_list_entry(p, typeof(*set), hook);
+
+        if (set->hash != hash || set->ncommand != ncommand)
+            continue;
+
+        for (i = 0; i < ncommand; i++)
+            if (!same_command(set->commands + i, commands[i]))
+                break;
+
+        if (i == ncommand)
+            return set;
+    }
+
+    return NULL;
+}
+
+
+srs_cmdset_t *srs_cmdset_get(char **commands, int ncommand)
+{
+    srs_cmdset_t *set;
+    uint32_t      hash;
+
+    hash = hash_commands(commands, ncommand);
+
+    if ((set = find_cmdset(hash, commands, ncommand)) != NULL) {
+        set->refcnt++;
+
+        mrp_debug("sharing command set %p (%d commands, %d users)", set,
+                  set->ncommand, set->refcnt);
+
+        return set;
+    }
+
+    if ((set = mrp_allocz(sizeof(*set))) == NULL)
+        return NULL;
+
+    mrp_list_init(&set->hook);
+    set->hash     = hash;
+    set->refcnt   = 1;
+    set->commands = srs_commands_parse(commands, ncommand);
+    set->ncommand = ncommand;
+
+    if (set->commands == NULL && ncommand > 0) {
+        mrp_free(set);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    mrp_list_append(&cmdsets, &set->hook);
+
+    mrp_debug("created command set %p (%d commands)", set, set->ncommand);
+
+    return set;
+}
+
+
+void srs_cmdset_unref(srs_cmdset_t *set)
+{
+    if (set == NULL || --set->refcnt > 0)
+        return;
+
+    mrp_debug("destroying command set %p (%d commands)", set, set->ncommand);
+
+    mrp_list_delete(&set->hook);
+    srs_commands_free(set->commands, set->ncommand);
+    mrp_free(set);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_CMDSET_H__
+#define __SRS_DAEMON_CMDSET_H__
+
+#include <stdint.h>
+
+#include <murphy/common/list.h>
+
+#include "srs/daemon/client.h"
+
+/*
+ * shared client command sets
+ *
+ * Clients registering the very same commands (for instance several
+ * browser tabs loading the same grammar) share a single parsed copy of
+ * them. Sets are looked up by a hash of their whitespace-normalized
+ * content and are reference counted by the clients using them.
+ */
+
+struct srs_cmdset_s {
+    mrp_list_hook_t  hook;               /* to list of command sets */
+    uint32_t         hash;               /* content hash */
+    int              refcnt;             /* number of users */
+    srs_command_t   *commands;           /* parsed commands */
+    int              ncommand;           /* number of commands */
+};
+
+/** Parse the given commands into tokens. */
+srs_command_t *srs_commands_parse(char **commands, int ncommand);
+
+/** Free the tokens of the given parsed command. */
+void srs_command_clear(srs_command_t *cmd);
+
+/** Free the given parsed commands. */
+void srs_commands_free(srs_command_t *cmds, int ncommand);
+
+/** Look up or create the shared set for the given commands. */
+srs_cmdset_t *srs_cmdset_get(char **commands, int ncommand);
+
+/** Drop a reference to the given shared set. */
+void srs_cmdset_unref(srs_cmdset_t *set);
+
+#endif /* __SRS_DAEMON_CMDSET_H__ */
@@ -58,6 +58,7 @@ struct srs_context_s {
     srs_pulse_t       *pulse;            /* audio stream interface */
     mrp_mainloop_t    *ml;               /* associated murphy mainloop */
     mrp_list_hook_t    clients;          /* connected clients */
+    mrp_htbl_t        *client_ids;       /* clients by id */
     mrp_list_hook_t    plugins;          /* loaded plugins */
     mrp_timer_t       *rtmr;             /* resource reconnect timer */
     srs_resctx_t      *rctx;             /* resource context */
@@ -68,6 +69,7 @@ struct srs_context_s {
     mrp_list_hook_t    disambiguators;   /* disambiguators */
     void              *default_disamb;   /* default disambiguator */
     void              *synthesizer;      /* syntehsizer state */
+    struct srs_workers_s *workers;       /* speech engine worker pool */
 
     /* files and directories */
     const char      *config_file;        /* configuration file */
@@ -28,6 +28,9 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include <murphy/common/macros.h>
 #include <murphy/common/mm.h>
@@ -43,6 +46,8 @@
 #include "srs/daemon/client.h"
 #include "srs/daemon/recognizer.h"
 #include "srs/daemon/pulse.h"
+#include "srs/daemon/worker.h"
+#include "srs/daemon/voice.h"
 
 static void cleanup_mainloop(srs_context_t *srs);
 static void resctl_state_change(srs_resctl_event_t *e, void *user_data);
@@ -52,7 +57,12 @@ static void cleanup_context(srs_context_t *srs)
     if (srs != NULL) {
         srs_resctl_disconnect(srs);
         srs_pulse_cleanup(srs->pulse);
+        srs_workers_destroy(srs);
         cleanup_mainloop(srs);
+        srs_token_cleanup();
+
+        if (srs->client_ids != NULL)
+            mrp_htbl_destroy(srs->client_ids, FALSE);
 
         /*
          * XXX TODO: should purge recognizers, disambiguators, synthesizers...
@@ -65,13 +75,26 @@ static void cleanup_context(srs_context_t *srs)
 
 static srs_context_t *create_context(void)
 {
-    srs_context_t *srs = mrp_allocz(sizeof(*srs));
+    srs_context_t     *srs = mrp_allocz(sizeof(*srs));
+    mrp_htbl_config_t  hcfg;
 
     if (srs != NULL) {
         mrp_list_init(&srs->clients);
         mrp_list_init(&srs->plugins);
         mrp_list_init(&srs->recognizers);
         mrp_list_init(&srs->disambiguators);
+
+        mrp_clear(&hcfg);
+        hcfg.nentry  = 64;
+        hcfg.comp    = mrp_string_comp;
+        hcfg.hash    = mrp_string_hash;
+        hcfg.free    = NULL;
+        hcfg.nbucket = hcfg.nentry;
+
+        if ((srs->client_ids = mrp_htbl_create(&hcfg)) == NULL) {
+            mrp_free(srs);
+            srs = NULL;
+        }
     }
 
     return srs;
@@ -145,6 +168,26 @@ static void create_mainloop(srs_context_t *srs)
 }
 
 
+static void create_workers(srs_context_t *srs)
+{
+    int n;
+
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    n = srs_config_get_int32(srs->settings, "daemon.workers",
+                             n < 1 ? 1 : (n > 4 ? 4 : n));
+
+    if (n <= 0) {
+        mrp_log_info("Worker pool disabled.");
+        return;
+    }
+
+    if (srs_workers_create(srs, n) < 0)
+        mrp_log_warning("Failed to create worker pool (%d: %s), running "
+                        "all backend work in the mainloop.", errno,
+                        strerror(errno));
+}
+
+
 static void run_mainloop(srs_context_t *srs)
 {
     if (srs->gl == NULL)
@@ -257,6 +300,7 @@ int main(int argc, char *argv[], char *env[])
         setup_logging(srs);
 
         create_mainloop(srs);
+        create_workers(srs);
         setup_signals(srs);
 
         if (!srs_configure_plugins(srs)) {
@@ -275,10 +319,22 @@ int main(int argc, char *argv[], char *env[])
 
         daemonize(srs);
 
+        /* threads do not survive forking, start workers only now */
+        if (srs_workers_start(srs) < 0) {
+            mrp_log_error("Failed to start worker threads.");
+            exit(1);
+        }
+
+        /* start hosts after forking, so that we can reap them */
+        if (srs_start_voice_hosts(srs) < 0)
+            mrp_log_error("Some synthesizer hosts failed to start.");
+
         run_mainloop(srs);
 
+        srs_stop_voice_hosts(srs);
         srs_stop_plugins(srs);
         srs_destroy_plugins(srs);
+        srs_cleanup_voice(srs);
 
         cleanup_context(srs);
 
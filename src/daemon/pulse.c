@@ -1,5 +1,7 @@
 #include <errno.h>
 
+#include <pulse/rtclock.h>
+
 #include <murphy/common/debug.h>
 #include <murphy/common/log.h>
 #include <murphy/common/mm.h>
@@ -11,6 +13,29 @@
 #define SPEECH "speech"
 #define TTS    "text-to-speech"
 
+#define ECHO_RATE    16000               /* echo reference sample rate */
+#define ECHO_SECONDS 2                   /* echo reference length */
+#define ECHO_LATENCY (300 * PA_USEC_PER_MSEC) /* fallback latency */
+
+/*
+ * echo reference
+ *
+ * A ring buffer of everything we have written to our playback streams,
+ * downmixed to mono, resampled to ECHO_RATE and indexed by the estimated
+ * time the audio leaves the speakers. Capture clients use this as the
+ * far-end reference for echo cancellation.
+ */
+
+typedef struct {
+    int16_t         *buf;                /* ring buffer */
+    size_t           size;               /* ring buffer size in samples */
+    int64_t          end;                /* absolute position of write end */
+    pa_usec_t        base;               /* time of absolute position 0 */
+    unsigned int     valid : 1;          /* whether base is set */
+    int16_t         *tmp;                /* resampling buffer */
+    size_t           ntmp;               /* resampling buffer size */
+} echo_ref_t;
+
 struct srs_pulse_s {
     pa_mainloop_api *pa;                 /* PA mainloop API */
     char            *name;               /* PA context name */
@@ -19,19 +44,26 @@ struct srs_pulse_s {
     mrp_list_hook_t  streams;            /* active streams */
     int              connected;          /* whether connection is up */
     pa_time_event   *reconn;             /* reconnect timer */
+    echo_ref_t       echo;               /* echo reference */
 };
 
 
 typedef struct {
     srs_pulse_t       *p;                /* our pulse_t context */
     pa_stream         *s;                /* associated PA stream */
-    void              *buf;              /* pre-generated sample buffer */
-    size_t             size;             /* buffer size */
+    void              *buf;              /* sample buffer */
+    size_t             size;             /* amount of samples in buffer */
+    size_t             alloc;            /* allocated buffer size */
     size_t             offs;             /* offset to next sample */
     uint32_t           msec;             /* length in milliseconds */
     int                rate;             /* sample rate */
     int                nchannel;         /* number of channels */
     uint32_t           nsample;          /* number of samples */
+    double             input;            /* estimated fraction appended */
+    srs_stream_release_t release;        /* sample buffer release callback */
+    void              *release_data;     /*     and its data */
+    srs_stream_capture_t capture;        /* audio capture callback */
+    void              *capture_data;     /*     and its data */
     uint32_t           id;               /* our stream id */
     int                event_mask;       /* mask of watched events */
     int                fired_mask;       /* mask of delivered events */
@@ -40,6 +72,11 @@ typedef struct {
     mrp_list_hook_t    hook;             /* hook to list of streams */
     mrp_refcnt_t       refcnt;           /* reference count */
     int                stopped : 1;      /* stopped marker */
+    int                open : 1;         /* more samples to be appended */
+    int                triggered : 1;    /* playback forced to start */
+    int                silent : 1;       /* rendered without playback */
+    pa_proplist       *props;            /* properties until connected */
+    double             volume;           /* playback volume (0 - 1.0) */
     pa_operation      *drain;            /* draining operation */
 } stream_t;
 
@@ -53,6 +90,11 @@ static void stream_drain_cb(pa_stream *ps, int success, void *user_data);
 
 static void stream_drain(stream_t *s);
 static void stream_notify(stream_t *s, srs_voice_event_type_t event);
+static void stream_stop(stream_t *s, int drain, int notify);
+static void stream_write(stream_t *s, size_t size);
+static void stream_volume(stream_t *s);
+
+static void echo_write(srs_pulse_t *p, stream_t *s, void *data, size_t size);
 
 
 srs_pulse_t *srs_pulse_setup(pa_mainloop_api *pa, const char *name)
@@ -63,11 +105,20 @@ srs_pulse_t *srs_pulse_setup(pa_mainloop_api *pa, const char *name)
         return NULL;
 
     mrp_list_init(&p->streams);
+    p->echo.size = ECHO_RATE * ECHO_SECONDS;
+    p->echo.buf  = mrp_allocz(p->echo.size * sizeof(p->echo.buf[0]));
+
+    if (p->echo.buf == NULL) {
+        mrp_free(p);
+        return NULL;
+    }
+
     p->pa   = pa;
     p->name = name ? mrp_strdup(name) : mrp_strdup("Winthorpe");
     p->pc   = pa_context_new(p->pa, p->name);
 
     if (p->pc == NULL) {
+        mrp_free(p->echo.buf);
         mrp_free(p);
 
         return NULL;
@@ -92,6 +143,8 @@ void srs_pulse_cleanup(srs_pulse_t *p)
         p->pc = NULL;
         mrp_free(p->name);
         p->name = NULL;
+        mrp_free(p->echo.buf);
+        mrp_free(p->echo.tmp);
         mrp_free(p);
     }
 }
@@ -109,10 +162,22 @@ static void stream_destroy(stream_t *s)
         pa_stream_disconnect(s->s);
         pa_stream_unref(s->s);
         s->s = NULL;
-        mrp_free(s->buf);
-        s->buf = NULL;
     }
 
+    if (s->capture != NULL) {
+        s->capture(s->p, NULL, s->rate, s->nchannel, 0, s->capture_data);
+        s->capture = NULL;
+    }
+
+    if (s->props != NULL)
+        pa_proplist_free(s->props);
+
+    if (s->release != NULL)
+        s->release(s->release_data);
+    else
+        mrp_free(s->buf);
+    s->buf = NULL;
+
     mrp_free(s);
 }
 
@@ -137,43 +202,18 @@ static inline void stream_unref(stream_t *s)
 }
 
 
-uint32_t srs_play_stream(srs_pulse_t *p, void *sample_buf, int sample_rate,
-                         int nchannel, uint32_t nsample, char **tags,
-                         int event_mask, srs_stream_cb_t cb,
-                         void *user_data)
+static int stream_connect(stream_t *s)
 {
-    char           **t;
-    stream_t        *s;
-    pa_sample_spec   ss;
-    pa_buffer_attr   ba;
-    pa_proplist     *props;
-    size_t           pamin, pabuf;
-    int              flags;
-
-    if ((s = mrp_allocz(sizeof(*s))) == NULL)
-        return 0;
-
-    mrp_list_init(&s->hook);
-    mrp_refcnt_init(&s->refcnt);
-
-    if (tags != NULL) {
-        if ((props = pa_proplist_new()) == NULL) {
-            mrp_free(s);
-            return 0;
-        }
-
-        pa_proplist_sets(props, PA_PROP_MEDIA_ROLE, SPEECH);
-
-        for (t = tags; *t; t++)
-            pa_proplist_setp(props, *t);
-    }
-    else
-        props = NULL;
+    srs_pulse_t    *p = s->p;
+    pa_sample_spec  ss;
+    pa_buffer_attr  ba;
+    size_t          pamin, pabuf;
+    int             flags;
 
     memset(&ss, 0, sizeof(ss));
     ss.format   = PA_SAMPLE_S16LE;
-    ss.rate     = sample_rate;
-    ss.channels = nchannel;
+    ss.rate     = s->rate;
+    ss.channels = s->nchannel;
 
     pamin  = pa_usec_to_bytes(100 * PA_USEC_PER_MSEC, &ss);
     pabuf  = pa_usec_to_bytes(300 * PA_USEC_PER_MSEC, &ss);
@@ -184,40 +224,291 @@ uint32_t srs_play_stream(srs_pulse_t *p, void *sample_buf, int sample_rate,
     ba.prebuf    = pabuf;
     ba.fragsize  = -1;
 
-    s->s = pa_stream_new_with_proplist(p->pc, TTS, &ss, NULL, props);
-    if (props != NULL)
-        pa_proplist_free(props);
-
-    if (s->s == NULL) {
-        mrp_free(s);
-        return 0;
+    s->s = pa_stream_new_with_proplist(p->pc, TTS, &ss, NULL, s->props);
+    if (s->props != NULL) {
+        pa_proplist_free(s->props);
+        s->props = NULL;
     }
 
+    if (s->s == NULL)
+        return -1;
+
+    pa_stream_set_state_callback(s->s, stream_state_cb, s);
+    pa_stream_set_write_callback(s->s, stream_write_cb, s);
+
+    flags = PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING |
+        PA_STREAM_AUTO_TIMING_UPDATE;
+    pa_stream_connect_playback(s->s, NULL, &ba, flags, NULL, NULL);
+
+    return 0;
+}
+
+
+static stream_t *stream_create(srs_pulse_t *p, int sample_rate, int nchannel,
+                               char **tags, int event_mask, srs_stream_cb_t cb,
+                               void *user_data)
+{
+    char     **t;
+    stream_t  *s;
+
+    if ((s = mrp_allocz(sizeof(*s))) == NULL)
+        return NULL;
+
+    mrp_list_init(&s->hook);
+    mrp_refcnt_init(&s->refcnt);
+
     s->p          = p;
-    s->buf        = sample_buf;
-    s->offs       = 0;
     s->rate       = sample_rate;
     s->nchannel   = nchannel;
-    s->nsample    = nsample;
-    s->size       = 2 * nsample * nchannel;
-    s->msec       = (1.0 * nsample) / sample_rate * 1000;
     s->cb         = cb;
     s->user_data  = user_data;
-    s->id         = p->strmid++;
     s->event_mask = event_mask;
+    s->input      = 1.0;
+    s->volume     = 1.0;
 
-    pa_stream_set_state_callback(s->s, stream_state_cb, s);
-    pa_stream_set_write_callback(s->s, stream_write_cb, s);
+    for (t = tags; t != NULL && *t; t++)
+        if (!strcmp(*t, SRS_STREAM_TAG_SILENT))
+            s->silent = TRUE;
 
-    flags = PA_STREAM_ADJUST_LATENCY;
-    pa_stream_connect_playback(s->s, NULL, &ba, flags, NULL, NULL);
+    if (!s->silent && tags != NULL) {
+        if ((s->props = pa_proplist_new()) == NULL) {
+            mrp_free(s);
+            return NULL;
+        }
+
+        pa_proplist_sets(s->props, PA_PROP_MEDIA_ROLE, SPEECH);
+
+        for (t = tags; *t; t++)
+            pa_proplist_setp(s->props, *t);
+    }
+
+    /* without a sample format we connect once we get one */
+    if (!s->silent && sample_rate > 0 && stream_connect(s) < 0) {
+        if (s->props != NULL)
+            pa_proplist_free(s->props);
+        mrp_free(s);
+        return NULL;
+    }
 
+    s->id = p->strmid++;
     mrp_list_append(&p->streams, &s->hook);
 
+    return s;
+}
+
+
+static stream_t *find_stream(srs_pulse_t *p, uint32_t id)
+{
+    mrp_list_hook_t *sp, *sn;
+    stream_t        *s;
+
+    mrp_list_foreach(&p->streams, sp, sn) {
+        s = mrp_list_entry(sp, typeof(*s), hook);
+
+        if (s->id == id)
+            return s;
+    }
+
+    errno = ENOENT;
+
+    return NULL;
+}
+
+
+uint32_t srs_play_stream(srs_pulse_t *p, void *sample_buf, int sample_rate,
+                         int nchannel, uint32_t nsample, char **tags,
+                         int event_mask, srs_stream_cb_t cb,
+                         void *user_data)
+{
+    stream_t *s;
+
+    s = stream_create(p, sample_rate, nchannel, tags, event_mask, cb,
+                      user_data);
+
+    if (s == NULL)
+        return 0;
+
+    s->buf     = sample_buf;
+    s->nsample = nsample;
+    s->size    = 2 * nsample * nchannel;
+    s->alloc   = s->size;
+    s->msec    = (1.0 * nsample) / sample_rate * 1000;
+
+    if (s->silent)
+        s->offs = s->size;
+
     return s->id;
 }
 
 
+uint32_t srs_play_buffer(srs_pulse_t *p, void *samples, int sample_rate,
+                         int nchannel, uint32_t nsample, char **tags,
+                         int event_mask, srs_stream_cb_t cb, void *user_data,
+                         srs_stream_release_t release, void *release_data)
+{
+    uint32_t  id;
+    stream_t *s;
+
+    id = srs_play_stream(p, samples, sample_rate, nchannel, nsample, tags,
+                         event_mask, cb, user_data);
+
+    if (id != 0 && (s = find_stream(p, id)) != NULL) {
+        s->release      = release;
+        s->release_data = release_data;
+    }
+
+    return id;
+}
+
+
+uint32_t srs_open_stream(srs_pulse_t *p, int sample_rate, int nchannel,
+                         char **tags, int event_mask, srs_stream_cb_t cb,
+                         void *user_data)
+{
+    stream_t *s;
+
+    s = stream_create(p, sample_rate, nchannel, tags, event_mask, cb,
+                      user_data);
+
+    if (s == NULL)
+        return 0;
+
+    s->open = TRUE;
+
+    return s->id;
+}
+
+
+int srs_append_stream(srs_pulse_t *p, uint32_t id, void *samples,
+                      uint32_t nsample)
+{
+    stream_t *s;
+    size_t    size, alloc, writable;
+
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
+
+    if (!s->open || s->stopped || s->nchannel == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size = 2 * nsample * s->nchannel;
+
+    if (s->size + size > s->alloc) {
+        alloc = s->alloc ? s->alloc : size;
+
+        while (alloc < s->size + size)
+            alloc *= 2;
+
+        if (mrp_realloc(s->buf, alloc) == NULL)
+            return -1;
+
+        s->alloc = alloc;
+    }
+
+    memcpy(s->buf + s->size, samples, size);
+    s->size    += size;
+    s->nsample += nsample;
+    s->msec     = (1.0 * s->nsample) / s->rate * 1000;
+
+    if (s->silent) {
+        s->offs = s->size;
+        return 0;
+    }
+
+    if (s->s == NULL)                    /* still connecting */
+        return 0;
+
+    /* the server is not going to ask again for what it has asked already */
+    if (pa_stream_get_state(s->s) == PA_STREAM_READY &&
+        (writable = pa_stream_writable_size(s->s)) != (size_t)-1)
+        stream_write(s, writable);
+
+    return 0;
+}
+
+
+int srs_format_stream(srs_pulse_t *p, uint32_t id, int sample_rate,
+                      int nchannel)
+{
+    stream_t *s;
+
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
+
+    if (!s->open || s->stopped || s->nchannel != 0 ||
+        sample_rate <= 0 || nchannel <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s->rate     = sample_rate;
+    s->nchannel = nchannel;
+
+    if (s->silent)
+        return 0;
+
+    return stream_connect(s);
+}
+
+
+int srs_estimate_stream(srs_pulse_t *p, uint32_t id, double input)
+{
+    stream_t *s;
+
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
+
+    if (input <= 0.0 || input > 1.0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s->input = input;
+
+    return 0;
+}
+
+
+int srs_close_stream(srs_pulse_t *p, uint32_t id)
+{
+    stream_t *s;
+
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
+
+    if (!s->open || s->stopped) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s->open = FALSE;
+
+    if (s->capture != NULL) {
+        s->capture(p, s->buf, s->rate, s->nchannel, s->nsample,
+                   s->capture_data);
+        s->capture = NULL;
+
+        if (s->silent) {
+            stream_stop(s, FALSE, TRUE);
+            return 0;
+        }
+    }
+
+    if (s->silent)
+        return 0;                        /* wait for the capture */
+
+    if (s->s == NULL)                    /* never got any audio */
+        stream_stop(s, FALSE, TRUE);
+    else if (s->offs == s->size &&
+             pa_stream_get_state(s->s) == PA_STREAM_READY)
+        stream_stop(s, TRUE, TRUE);
+
+    return 0;
+}
+
+
 static void stream_stop(stream_t *s, int drain, int notify)
 {
     if (s->stopped)
@@ -229,7 +520,7 @@ static void stream_stop(stream_t *s, int drain, int notify)
         s->event_mask = 0;
 
     if (!drain) {
-        stream_notify(s, s->offs >= s->size ?
+        stream_notify(s, !s->open && s->offs >= s->size ?
                       SRS_STREAM_EVENT_COMPLETED : SRS_STREAM_EVENT_ABORTED);
     }
     else
@@ -239,29 +530,81 @@ static void stream_stop(stream_t *s, int drain, int notify)
 }
 
 
+int srs_capture_stream(srs_pulse_t *p, uint32_t id, srs_stream_capture_t cb,
+                       void *user_data)
+{
+    stream_t *s;
+
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
+
+    if (s->capture != NULL || (s->open && s->stopped)) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (!s->open) {
+        cb(p, s->buf, s->rate, s->nchannel, s->nsample, user_data);
+
+        if (s->silent)
+            stream_stop(s, FALSE, TRUE);
+    }
+    else {
+        s->capture      = cb;
+        s->capture_data = user_data;
+    }
+
+    return 0;
+}
+
+
 int srs_stop_stream(srs_pulse_t *p, uint32_t id, int drain, int notify)
 {
-    mrp_list_hook_t *sp, *sn;
-    stream_t        *se, *s;
+    stream_t *s;
 
     mrp_debug("stopping stream #%u", id);
 
-    s = NULL;
-    mrp_list_foreach(&p->streams, sp, sn) {
-        se = mrp_list_entry(sp, typeof(*se), hook);
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
 
-        if (se->id == id) {
-            s = se;
-            break;
-        }
-    }
+    stream_stop(s, drain, notify);
+
+    return 0;
+}
+
+
+static void stream_volume(stream_t *s)
+{
+    srs_pulse_t  *p = s->p;
+    pa_cvolume    cv;
+    pa_operation *o;
+
+    pa_cvolume_set(&cv, s->nchannel, pa_sw_volume_from_linear(s->volume));
+
+    o = pa_context_set_sink_input_volume(p->pc, pa_stream_get_index(s->s),
+                                         &cv, NULL, NULL);
+    if (o != NULL)
+        pa_operation_unref(o);
+}
+
+
+int srs_set_stream_volume(srs_pulse_t *p, uint32_t id, double volume)
+{
+    stream_t *s;
+
+    if ((s = find_stream(p, id)) == NULL)
+        return -1;
 
-    if (s == NULL) {
-        errno = ENOENT;
+    if (s->stopped || volume < 0.0 || volume > 1.0) {
+        errno = EINVAL;
         return -1;
     }
 
-    stream_stop(s, drain, notify);
+    s->volume = volume;
+
+    /* not connected yet streams pick it up once ready */
+    if (s->s != NULL && pa_stream_get_state(s->s) == PA_STREAM_READY)
+        stream_volume(s);
 
     return 0;
 }
@@ -392,13 +735,17 @@ static void stream_notify(stream_t *s, srs_voice_event_type_t event)
         break;
 
     case SRS_STREAM_EVENT_PROGRESS:
-        e.data.progress.pcnt = ((1.0 * s->offs) / s->size) * 100;
-        e.data.progress.msec = ((1.0 * s->offs) / s->size) * s->msec;
-        break;
-
     case SRS_STREAM_EVENT_COMPLETED:
-        e.data.progress.pcnt = ((1.0 * s->offs) / s->size) * 100;
-        e.data.progress.msec = ((1.0 * s->offs) / s->size) * s->msec;
+        /* for open streams scale by the estimated fraction we have */
+        if (s->size > 0) {
+            e.data.progress.pcnt = ((1.0 * s->offs) / s->size) * 100 *
+                (s->open ? s->input : 1.0);
+            e.data.progress.msec = ((1.0 * s->offs) / s->size) * s->msec;
+        }
+        else {
+            e.data.progress.pcnt = 0;
+            e.data.progress.msec = 0;
+        }
         break;
 
     case SRS_STREAM_EVENT_ABORTED:
@@ -438,6 +785,8 @@ static void stream_state_cb(pa_stream *ps, void *user_data)
 
     case PA_STREAM_READY:
         mrp_debug("pulse: stream #%u ready", s->id);
+        if (s->volume != 1.0)
+            stream_volume(s);
         stream_notify(s, SRS_STREAM_EVENT_STARTED);
         break;
 
@@ -462,6 +811,11 @@ static void stream_state_cb(pa_stream *ps, void *user_data)
 
 static void stream_drain(stream_t *s)
 {
+    if (s->s == NULL) {
+        stream_notify(s, SRS_STREAM_EVENT_COMPLETED);
+        return;
+    }
+
     if (s->drain == NULL) {
         mrp_debug("pulse: stream #%u done, draining", s->id);
         stream_ref(s);
@@ -486,42 +840,228 @@ static void stream_drain_cb(pa_stream *ps, int success, void *user_data)
 }
 
 
+static void stream_write(stream_t *s, size_t size)
+{
+    pa_operation *o;
+
+    if (s->stopped)
+        return;
+
+    stream_ref(s);
+
+    if (s->offs + size > s->size)
+        size = s->size - s->offs;
+
+    if (size > 0) {
+        echo_write(s->p, s, s->buf + s->offs, size);
+
+        if (pa_stream_write(s->s, s->buf + s->offs, size, NULL, 0,
+                            PA_SEEK_RELATIVE) < 0) {
+            mrp_log_error("pulse: failed to write %zd bytes to stream #%u",
+                          size, s->id);
+            goto out;
+        }
+
+        s->offs += size;
+
+        /*
+         * Don't wait for a full prebuffer of a stream still being
+         * synthesized, start playing as soon as we have something.
+         */
+        if (s->open && !s->triggered) {
+            if ((o = pa_stream_trigger(s->s, NULL, NULL)) != NULL)
+                pa_operation_unref(o);
+            s->triggered = TRUE;
+        }
+    }
+
+    if (s->offs == s->size && !s->open)
+        stream_stop(s, TRUE, TRUE);
+
+ out:
+    stream_unref(s);
+}
+
+
 static void stream_write_cb(pa_stream *ps, size_t size, void *user_data)
 {
     stream_t *s = (stream_t *)user_data;
-    int       done;
 
     MRP_UNUSED(ps);
 
     stream_notify(s, SRS_STREAM_EVENT_PROGRESS);
 
-    if (s->offs == s->size) {
+    if (s->stopped) {
         pa_stream_set_write_callback(s->s, NULL, NULL);
         return;
     }
 
-    stream_ref(s);
+    stream_write(s, size);
+}
 
-    if (s->offs + size >= s->size) {
-        size = s->size - s->offs;
-        done = TRUE;
+
+static size_t resample(const int16_t *in, size_t nin, int nchannel,
+                       int16_t *out, size_t nout)
+{
+    double  step, pos, frac;
+    int32_t a, b;
+    size_t  i, j;
+    int     c;
+
+    /* downmix to mono and linearly interpolate to the output rate */
+    step = (nout > 1) ? (double)(nin - 1) / (double)(nout - 1) : 0.0;
+
+    for (i = 0, pos = 0.0; i < nout; i++, pos += step) {
+        j    = (size_t)pos;
+        frac = pos - j;
+
+        for (c = 0, a = b = 0; c < nchannel; c++) {
+            a += in[j * nchannel + c];
+            b += in[(j + 1 < nin ? j + 1 : j) * nchannel + c];
+        }
+
+        out[i] = (int16_t)(((1.0 - frac) * a + frac * b) / nchannel);
     }
-    else
-        done = FALSE;
 
-    if (pa_stream_write(s->s, s->buf + s->offs, size, NULL, 0,
-                        PA_SEEK_RELATIVE) < 0) {
-        mrp_log_error("pulse: failed to write %zd bytes to stream #%u",
-                      size, s->id);
-        goto out;
+    return nout;
+}
+
+
+static inline int64_t echo_position(echo_ref_t *e, pa_usec_t t)
+{
+    int64_t usec = (int64_t)t - (int64_t)e->base;
+
+    return usec * ECHO_RATE / (int64_t)PA_USEC_PER_SEC;
+}
+
+
+static void echo_write(srs_pulse_t *p, stream_t *s, void *data, size_t size)
+{
+    echo_ref_t *e = &p->echo;
+    pa_usec_t   latency, when;
+    int         negative;
+    size_t      nin, n, i;
+    int64_t     pos, end, zpos;
+    int32_t     v;
+
+    if (s->nchannel < 1 || s->rate <= 0)
+        return;
+
+    if (pa_stream_get_latency(s->s, &latency, &negative) < 0 || negative)
+        latency = ECHO_LATENCY;
+
+    when = pa_rtclock_now() + latency;
+    nin  = size / (sizeof(int16_t) * s->nchannel);
+    n    = (uint64_t)nin * ECHO_RATE / s->rate;
+
+    if (nin == 0 || n == 0)
+        return;
+
+    if (n > e->size)
+        n = e->size;
+
+    if (e->ntmp < n) {
+        if (mrp_reallocz(e->tmp, e->ntmp, n) == NULL) {
+            e->ntmp = 0;
+            return;
+        }
+        e->ntmp = n;
     }
-    else {
-        s->offs += size;
 
-        if (done)
-            stream_stop(s, TRUE, TRUE);
+    resample(data, nin, s->nchannel, e->tmp, n);
+
+    if (!e->valid || echo_position(e, when) > e->end + (int64_t)e->size) {
+        e->base  = when;
+        e->end   = 0;
+        e->valid = TRUE;
     }
 
- out:
-    stream_unref(s);
+    pos = echo_position(e, when);
+    end = pos + n;
+
+    /* clear anything stale between the old and the new write end */
+    if (end > e->end) {
+        zpos = end - (int64_t)e->size;
+
+        if (zpos < e->end)
+            zpos = e->end;
+
+        for (; zpos < end; zpos++)
+            if (zpos >= 0)
+                e->buf[zpos % e->size] = 0;
+
+        e->end = end;
+    }
+
+    /* mix in, so overlapping streams add up like they do in the sink */
+    for (i = 0; i < n; i++, pos++) {
+        if (pos < 0 || pos < e->end - (int64_t)e->size)
+            continue;
+
+        v = e->buf[pos % e->size] + e->tmp[i];
+
+        if (v > 32767)
+            v = 32767;
+        else if (v < -32768)
+            v = -32768;
+
+        e->buf[pos % e->size] = v;
+    }
+}
+
+
+size_t srs_pulse_echo_reference(srs_pulse_t *p, pa_usec_t when,
+                                uint32_t rate, int16_t *buf, size_t nsample)
+{
+    echo_ref_t *e;
+    int64_t     pos, first;
+    size_t      n, i, active;
+    int16_t    *dst;
+
+    if (p == NULL || buf == NULL || rate == 0) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    e = &p->echo;
+
+    memset(buf, 0, nsample * sizeof(buf[0]));
+
+    if (!e->valid)
+        return 0;
+
+    n = (uint64_t)nsample * ECHO_RATE / rate;
+
+    if (n == 0)
+        return 0;
+
+    if (rate != ECHO_RATE) {
+        if (e->ntmp < n) {
+            if (mrp_reallocz(e->tmp, e->ntmp, n) == NULL) {
+                e->ntmp = 0;
+                return 0;
+            }
+            e->ntmp = n;
+        }
+        dst = e->tmp;
+        memset(dst, 0, n * sizeof(dst[0]));
+    }
+    else
+        dst = buf;
+
+    pos    = echo_position(e, when);
+    first  = e->end - (int64_t)e->size;
+    active = 0;
+
+    for (i = 0; i < n; i++, pos++) {
+        if (pos >= 0 && pos >= first && pos < e->end) {
+            dst[i] = e->buf[pos % e->size];
+            active++;
+        }
+    }
+
+    if (active && dst != buf)
+        resample(dst, n, 1, buf, nsample);
+
+    return active;
 }
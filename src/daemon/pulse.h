@@ -66,11 +66,25 @@ typedef enum {
                                    SRS_STREAM_MASK_COMPLETED | \
                                    SRS_STREAM_MASK_ABORTED)
 
+/*
+ * Stream tag for rendering audio without playing it. A silent stream is
+ * kept around until its audio has been captured or it is stopped.
+ */
+#define SRS_STREAM_TAG_SILENT "srs.stream.silent=1"
+
 typedef srs_voice_event_t srs_stream_event_t;
 
 typedef void (*srs_stream_cb_t)(srs_pulse_t *p, srs_stream_event_t *event,
                                 void *user_data);
 
+/** Callback to release a sample buffer once it is not needed any more. */
+typedef void (*srs_stream_release_t)(void *release_data);
+
+/** Callback to pass on the complete audio of a stream. */
+typedef void (*srs_stream_capture_t)(srs_pulse_t *p, void *samples,
+                                     int sample_rate, int nchannel,
+                                     uint32_t nsample, void *user_data);
+
 /** Set up the PulseAudio interface. */
 srs_pulse_t *srs_pulse_setup(pa_mainloop_api *pa, const char *name);
 
@@ -83,9 +97,62 @@ uint32_t srs_play_stream(srs_pulse_t *p, void *sample_buf, int sample_rate,
                          int event_mask, srs_stream_cb_t cb,
                          void *user_data);
 
+/** Render a stream from a buffer released by the given callback. */
+uint32_t srs_play_buffer(srs_pulse_t *p, void *samples, int sample_rate,
+                         int nchannel, uint32_t nsample, char **tags,
+                         int event_mask, srs_stream_cb_t cb, void *user_data,
+                         srs_stream_release_t release, void *release_data);
+
+/**
+ * Open a stream for incremental playback. Samples are appended to it as
+ * they become available and playback starts with the first ones. Once
+ * closed, the stream completes after playing out all appended samples.
+ * If the sample format is not known yet, pass 0 for sample_rate and
+ * nchannel and set it with srs_format_stream before appending samples.
+ */
+uint32_t srs_open_stream(srs_pulse_t *p, int sample_rate, int nchannel,
+                         char **tags, int event_mask, srs_stream_cb_t cb,
+                         void *user_data);
+
+/** Append (a copy of) the given samples to an open stream. */
+int srs_append_stream(srs_pulse_t *p, uint32_t id, void *samples,
+                      uint32_t nsample);
+
+/** Set the sample format of a stream opened without one. */
+int srs_format_stream(srs_pulse_t *p, uint32_t id, int sample_rate,
+                      int nchannel);
+
+/** Estimate the fraction of the final stream appended so far (0 - 1.0). */
+int srs_estimate_stream(srs_pulse_t *p, uint32_t id, double input);
+
+/** Close an open stream, no more samples will be appended. */
+int srs_close_stream(srs_pulse_t *p, uint32_t id);
+
+/**
+ * Get the complete audio of a stream once all of it has been appended.
+ * cb is called exactly once, either with the audio as soon as the stream
+ * gets closed (right away, if it already is), or with NULL samples if
+ * the stream goes away before that. The samples are only valid during
+ * the callback.
+ */
+int srs_capture_stream(srs_pulse_t *p, uint32_t id, srs_stream_capture_t cb,
+                       void *user_data);
+
 /** Stop an ongoing stream. */
 int srs_stop_stream(srs_pulse_t *p, uint32_t id, int drain, int notify);
 
+/** Set the playback volume (0 - 1.0) of a stream, for instance to duck it. */
+int srs_set_stream_volume(srs_pulse_t *p, uint32_t id, double volume);
+
+/**
+ * Fetch the far-end reference for nsample mono samples at the given rate
+ * expected to leave the speakers starting at the given time (on the
+ * pa_rtclock_now() time base). Returns the number of reference samples
+ * found, 0 if nothing was played during the given period.
+ */
+size_t srs_pulse_echo_reference(srs_pulse_t *p, pa_usec_t when,
+                                uint32_t rate, int16_t *buf, size_t nsample);
+
 MRP_CDECL_END
 
 #endif /* __SRS_DAEMON_PULSE_H__ */
@@ -49,6 +49,7 @@ typedef struct {
     srs_srec_api_t     api;              /* backend API */
     void              *api_data;         /* opaque backend data */
     srs_srec_result_t *result;           /* result being processed, if any */
+    srs_arena_t       *arena;            /* per-utterance memory */
 } srs_srec_t;
 
 
@@ -109,8 +110,9 @@ int srs_register_srec(srs_context_t *srs, const char *name,
         srec->name     = mrp_strdup(name);
         srec->api      = *api;
         srec->api_data = api_data;
+        srec->arena    = srs_arena_create(0);
 
-        if (srec->name != NULL) {
+        if (srec->name != NULL && srec->arena != NULL) {
             mrp_list_append(&srs->recognizers, &srec->hook);
 
             if (srs->cached_srec == NULL)
@@ -127,6 +129,8 @@ int srs_register_srec(srs_context_t *srs, const char *name,
             return 0;
         }
 
+        srs_arena_destroy(srec->arena);
+        mrp_free(srec->name);
         mrp_free(srec);
     }
 
@@ -142,6 +146,7 @@ void srs_unregister_srec(srs_context_t *srs, const char *name)
 
     if (srec != NULL) {
         mrp_list_delete(&srec->hook);
+        srs_arena_destroy(srec->arena);
         mrp_free(srec->name);
         mrp_free(srec);
 
@@ -176,6 +181,15 @@ void srs_deactivate_srec(srs_context_t *srs, const char *name)
 }
 
 
+void srs_srec_speech_detected(srs_context_t *srs, const char *name)
+{
+    srs_srec_t *srec = find_srec(srs, name);
+
+    if (srec != NULL)
+        srs_barge_in_voice(srs, SRS_VOICE_BARGE_IN_SPEECH);
+}
+
+
 int srs_check_decoder(srs_context_t *srs, const char *name,
                       const char *decoder)
 {
@@ -224,52 +238,24 @@ static srs_srec_t *find_srec(srs_context_t *srs, const char *name)
 }
 
 
-static void free_match(srs_srec_match_t *m)
-{
-    mrp_free(m);
-}
-
-
 static void free_srec_result(srs_srec_result_t *res)
 {
-    srs_srec_match_t *m;
-    mrp_list_hook_t  *p, *n;
-    int               i;
-
-    switch (res->type) {
-    case SRS_SREC_RESULT_MATCH:
-        mrp_list_foreach(&res->result.matches, p, n) {
-            m = mrp_list_entry(p, typeof(*m), hook);
-            mrp_list_delete(&m->hook);
-            free_match(m);
-        }
-        break;
-
-    case SRS_SREC_RESULT_DICT:
-        break;
-
-    case SRS_SREC_RESULT_AMBIGUOUS:
-        break;
-
-    default:
-        break;
-    }
+    int i;
 
-    for (i = 0; i < res->ntoken; i++)
-        mrp_free(res->tokens[i]);
-    mrp_free(res->tokens);
+    /*
+     * The result itself, its matches and token arrays all live in the
+     * per-utterance arena and the tokens are interned, so apart from the
+     * sample buffer and the dictionary stack there is nothing to free.
+     */
 
-    mrp_free(res->start);
-    mrp_free(res->end);
     srs_unref_audiobuf(res->samplebuf);
 
     for (i = 0; i < res->ndict; i++)
         mrp_free(res->dicts[i]);
     mrp_free(res->dicts);
 
-
     mrp_list_delete(&res->hook);
-    mrp_free(res);
+    srs_arena_reset(res->arena);
 }
 
 
@@ -328,6 +314,9 @@ static void process_match_result(srs_srec_t *srec, srs_srec_result_t *res)
     srs_srec_match_t *match;
     int               i;
 
+    if (!mrp_list_empty(&res->result.matches))
+        srs_barge_in_voice(srec->srs, SRS_VOICE_BARGE_IN_COMMAND);
+
     mrp_list_foreach(&res->result.matches, p, n) {
         match = mrp_list_entry(p, typeof(*match), hook);
 
@@ -337,7 +326,7 @@ static void process_match_result(srs_srec_t *srec, srs_srec_result_t *res)
         }
 
         client_notify_command(match->client, match->index,
-                              res->ntoken, (const char **)res->tokens,
+                              res->ntoken, res->tokens,
                               res->start, res->end, res->samplebuf);
 
         while (res->ndict > 0)
@@ -505,11 +494,13 @@ static int srec_notify_cb(srs_srec_utterance_t *utt, void *notify_data)
 
     if (dis != NULL) {
         if (srec->result == NULL) {
-            res = srec->result = mrp_allocz(sizeof(*srec->result));
+            srs_arena_reset(srec->arena);
+            res = srec->result = srs_arena_alloc(srec->arena, sizeof(*res));
 
             if (res == NULL)
                 return SRS_SREC_FLUSH_ALL;
 
+            res->arena = srec->arena;
             mrp_list_init(&res->hook);
             mrp_list_init(&res->result.matches);
 
@@ -670,3 +661,30 @@ void srs_srec_del_client(srs_context_t *srs, srs_client_t *client)
    if (dis != NULL)
        dis->api.del_client(client, dis->api_data);
 }
+
+
+int srs_srec_add_commands(srs_context_t *srs, srs_client_t *client,
+                          int *indices, int nindex)
+{
+    srs_disamb_t *dis = find_disamb(srs, SRS_DEFAULT_DISAMBIGUATOR);
+
+    if (dis == NULL)
+        return -1;
+
+    if (dis->api.add_commands == NULL) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return dis->api.add_commands(client, indices, nindex, dis->api_data);
+}
+
+
+void srs_srec_del_commands(srs_context_t *srs, srs_client_t *client,
+                           int *indices, int nindex)
+{
+    srs_disamb_t *dis = find_disamb(srs, SRS_DEFAULT_DISAMBIGUATOR);
+
+    if (dis != NULL && dis->api.del_commands != NULL)
+        dis->api.del_commands(client, indices, nindex, dis->api_data);
+}
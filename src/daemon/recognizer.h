@@ -32,6 +32,8 @@
 
 #include "src/daemon/client.h"
 #include "src/daemon/audiobuf.h"
+#include "src/daemon/arena.h"
+#include "src/daemon/token.h"
 
 /*
  * speech recognition backend interface
@@ -73,10 +75,11 @@ typedef struct {
  * a single speech token
  */
 typedef struct {
-    const char *token;                     /* recognized tokens */
-    double      score;                     /* correctness probability */
-    uint32_t    start;                     /* start in audio buffer */
-    uint32_t    end;                       /* end in audio buffer */
+    const char     *token;                 /* recognized tokens */
+    srs_token_id_t  id;                    /* interned token id, if any */
+    double          score;                 /* correctness probability */
+    uint32_t        start;                 /* start in audio buffer */
+    uint32_t        end;                   /* end in audio buffer */
 } srs_srec_token_t;
 
 /*
@@ -116,6 +119,9 @@ int srs_activate_srec(srs_context_t *srs, const char *name);
 /** Deactivate the specified speech recognition backend. */
 void srs_deactivate_srec(srs_context_t *srs, const char *name);
 
+/** Notify the daemon that a backend has detected the onset of speech. */
+void srs_srec_speech_detected(srs_context_t *srs, const char *name);
+
 /** Check if a decoder (model/dictionary combination) exists for a backend. */
 int srs_check_decoder(srs_context_t *srs, const char *name,
                       const char *decoder);
@@ -164,7 +170,8 @@ struct srs_srec_result_s {
     mrp_list_hook_t          hook;       /* to list of results */
     srs_audiobuf_t          *samplebuf;  /* audio sample buffer */
     uint32_t                 sampleoffs; /* extra audio sample offset */
-    char                   **tokens;     /* matched tokens */
+    srs_arena_t             *arena;      /* per-utterance allocations */
+    const char             **tokens;     /* matched (interned) tokens */
     uint32_t                *start;      /* token start offset */
     uint32_t                *end;        /* token end offsets */
     int                      ntoken;     /* number of tokens */
@@ -192,6 +199,12 @@ typedef struct {
     int (*add_client)(srs_client_t *client, void *api_data);
     /** Unregister the commands of a client. */
     void (*del_client)(srs_client_t *client, void *api_data);
+    /** Register the given (newly added) commands of a client. */
+    int (*add_commands)(srs_client_t *client, int *indices, int nindex,
+                        void *api_data);
+    /** Unregister the given (about to be removed) commands of a client. */
+    void (*del_commands)(srs_client_t *client, int *indices, int nindex,
+                         void *api_data);
     /** Disambiguate an utterance with candidates. */
     int (*disambiguate)(srs_srec_utterance_t *utt, srs_srec_result_t **result,
                         void *api_data);
@@ -211,6 +224,14 @@ int srs_srec_add_client(srs_context_t *srs, srs_client_t *client);
 /** Unregister a client from speech recognition. */
 void srs_srec_del_client(srs_context_t *srs, srs_client_t *client);
 
+/** Register the given commands of a client for speech recognition. */
+int srs_srec_add_commands(srs_context_t *srs, srs_client_t *client,
+                          int *indices, int nindex);
+
+/** Unregister the given commands of a client from speech recognition. */
+void srs_srec_del_commands(srs_context_t *srs, srs_client_t *client,
+                           int *indices, int nindex);
+
 
 /** Macro to refer to the default disambiguator. */
 #define SRS_DEFAULT_DISAMBIGUATOR NULL
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include "srs/daemon/arena.h"
+#include "srs/daemon/token.h"
+
+#define INITIAL_SLOTS 1024               /* initial hash table size */
+#define STRING_BLOCK  16384              /* string storage block size */
+
+typedef struct {
+    uint32_t    hash;                    /* full hash of the token */
+    const char *str;                     /* interned string */
+    uint32_t    len;                     /* string length */
+} entry_t;
+
+static struct {
+    entry_t        *entries;             /* entries, indexed by id - 1 */
+    uint32_t        nentry;              /* number of entries */
+    uint32_t        nalloc;              /* allocated entries */
+    srs_token_id_t *slots;               /* open addressing hash table */
+    uint32_t        nslot;               /* number of slots, power of 2 */
+    srs_arena_t    *strings;             /* storage for the strings */
+} tokens;
+
+
+static inline uint32_t hash_token(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;            /* 32-bit FNV-1a */
+    size_t   i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+static srs_token_id_t *find_slot(const char *s, size_t len, uint32_t h)
+{
+    uint32_t        mask = tokens.nslot - 1;
+    uint32_t        i;
+    srs_token_id_t *slot;
+    entry_t        *e;
+
+    for (i = h & mask; ; i = (i + 1) & mask) {
+        slot = tokens.slots + i;
+
+        if (*slot == SRS_TOKEN_ID_NONE)
+            return slot;
+
+        e = tokens.entries + *slot - 1;
+
+        if (e->hash == h && e->len == len && !memcmp(e->str, s, len))
+            return slot;
+    }
+}
+
+
+static int grow_slots(void)
+{
+    srs_token_id_t *old, *slot;
+    uint32_t        nold, i;
+    entry_t        *e;
+
+    old  = tokens.slots;
+    nold = tokens.nslot;
+
+    tokens.nslot = nold ? 2 * nold : INITIAL_SLOTS;
+    tokens.slots = mrp_allocz(tokens.nslot * sizeof(tokens.slots[0]));
+
+    if (tokens.slots == NULL) {
+        tokens.slots = old;
+        tokens.nslot = nold;
+        return -1;
+    }
+
+    for (i = 0; i < nold; i++) {
+        if (old[i] == SRS_TOKEN_ID_NONE)
+            continue;
+
+        e     = tokens.entries + old[i] - 1;
+        slot  = find_slot(e->str, e->len, e->hash);
+        *slot = old[i];
+    }
+
+    mrp_free(old);
+
+    return 0;
+}
+
+
+static inline size_t token_length(const char *token, size_t len)
+{
+    return len == SRS_TOKEN_NUL ? strlen(token) : len;
+}
+
+
+srs_token_id_t srs_token_lookup(const char *token, size_t len)
+{
+    uint32_t        h;
+    srs_token_id_t *slot;
+
+    if (token == NULL || tokens.nslot == 0)
+        return SRS_TOKEN_ID_NONE;
+
+    len  = token_length(token, len);
+    h    = hash_token(token, len);
+    slot = find_slot(token, len, h);
+
+    return *slot;
+}
+
+
+srs_token_id_t srs_token_intern(const char *token, size_t len)
+{
+    uint32_t        h;
+    srs_token_id_t *slot;
+    entry_t        *e;
+    char           *str;
+
+    if (token == NULL) {
+        errno = EINVAL;
+        return SRS_TOKEN_ID_NONE;
+    }
+
+    len = token_length(token, len);
+    h   = hash_token(token, len);
+
+    /* keep the table at most half full */
+    if (2 * (tokens.nentry + 1) > tokens.nslot && grow_slots() < 0)
+        return SRS_TOKEN_ID_NONE;
+
+    slot = find_slot(token, len, h);
+
+    if (*slot != SRS_TOKEN_ID_NONE)
+        return *slot;
+
+    if (tokens.strings == NULL &&
+        (tokens.strings = srs_arena_create(STRING_BLOCK)) == NULL)
+        return SRS_TOKEN_ID_NONE;
+
+    if (tokens.nentry >= tokens.nalloc) {
+        if (mrp_reallocz(tokens.entries, tokens.nalloc,
+                         tokens.nalloc ? 2 * tokens.nalloc : INITIAL_SLOTS / 2)
+            == NULL)
+            return SRS_TOKEN_ID_NONE;
+
+        tokens.nalloc = tokens.nalloc ? 2 * tokens.nalloc : INITIAL_SLOTS / 2;
+    }
+
+    if ((str = srs_arena_alloc(tokens.strings, len + 1)) == NULL)
+        return SRS_TOKEN_ID_NONE;
+
+    memcpy(str, token, len);
+    str[len] = '\0';
+
+    e       = tokens.entries + tokens.nentry++;
+    e->hash = h;
+    e->str  = str;
+    e->len  = len;
+
+    *slot = tokens.nentry;
+
+    return *slot;
+}
+
+
+const char *srs_token_string(srs_token_id_t id)
+{
+    if (id == SRS_TOKEN_ID_NONE || id > tokens.nentry)
+        return NULL;
+
+    return tokens.entries[id - 1].str;
+}
+
+
+void srs_token_cleanup(void)
+{
+    mrp_log_info("Freeing %u interned tokens.", tokens.nentry);
+
+    srs_arena_destroy(tokens.strings);
+    mrp_free(tokens.entries);
+    mrp_free(tokens.slots);
+
+    memset(&tokens, 0, sizeof(tokens));
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_TOKEN_H__
+#define __SRS_DAEMON_TOKEN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * interned speech tokens
+ *
+ * Every distinct token string is stored once in a daemon-wide table and
+ * identified by a small integer id. Interned strings stay valid for the
+ * lifetime of the daemon, so they can be passed around and compared by
+ * id (or pointer) without ever being copied.
+ */
+
+/** Type of an interned token id. */
+typedef uint32_t srs_token_id_t;
+
+/** Id of no/invalid token. */
+#define SRS_TOKEN_ID_NONE ((srs_token_id_t)0)
+
+/** Length to pass for NUL-terminated tokens. */
+#define SRS_TOKEN_NUL ((size_t)-1)
+
+/** Intern the first len bytes of token, returning its id. */
+srs_token_id_t srs_token_intern(const char *token, size_t len);
+
+/** Look up the id of token without interning it. */
+srs_token_id_t srs_token_lookup(const char *token, size_t len);
+
+/** Get the interned string for the given token id. */
+const char *srs_token_string(srs_token_id_t id);
+
+/** Free all interned tokens. */
+void srs_token_cleanup(void);
+
+#endif /* __SRS_DAEMON_TOKEN_H__ */
@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#ifdef __SSE2__
+#    include <emmintrin.h>
+#endif
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include "srs/daemon/vad.h"
+
+#define FLOOR_RISE  0.002                /* noise floor upward tracking */
+#define SLOPE_MIN   1.0                  /* min. probability slope (dB) */
+
+struct srs_vad_s {
+    srs_vad_config_t cfg;                /* configuration */
+    size_t           frlen;              /* frame length in samples */
+    uint32_t         hangover;           /* hangover in frames */
+    int16_t         *carry;              /* partial frame from last call */
+    size_t           ncarry;             /* samples in partial frame */
+    double           floor;              /* noise floor estimate (dB) */
+    bool             floored;            /* whether floor is valid */
+    srs_vad_state_t  state;              /* current activity state */
+    uint32_t         hang;               /* remaining hangover frames */
+};
+
+
+srs_vad_t *srs_vad_create(srs_vad_config_t *cfg)
+{
+    srs_vad_t *vad;
+
+    if (cfg == NULL || !cfg->rate || !cfg->frame || cfg->onset < cfg->offset) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ((vad = mrp_allocz(sizeof(*vad))) == NULL)
+        return NULL;
+
+    vad->cfg      = *cfg;
+    vad->frlen    = (size_t)cfg->rate * cfg->frame / 1000;
+    vad->hangover = (cfg->hangover + cfg->frame - 1) / cfg->frame;
+    vad->carry    = mrp_allocz(vad->frlen * sizeof(vad->carry[0]));
+
+    if (vad->frlen == 0 || vad->carry == NULL) {
+        mrp_free(vad->carry);
+        mrp_free(vad);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    mrp_debug("created VAD: %zu samples/frame, %s levels %.1f/%.1f dB, "
+              "hangover %u frames", vad->frlen,
+              cfg->adaptive ? "relative" : "absolute", cfg->onset,
+              cfg->offset, vad->hangover);
+
+    return vad;
+}
+
+
+void srs_vad_destroy(srs_vad_t *vad)
+{
+    if (vad != NULL) {
+        mrp_free(vad->carry);
+        mrp_free(vad);
+    }
+}
+
+
+void srs_vad_reset(srs_vad_t *vad)
+{
+    if (vad != NULL) {
+        vad->ncarry = 0;
+        vad->state  = SRS_VAD_SILENCE;
+        vad->hang   = 0;
+    }
+}
+
+
+size_t srs_vad_frame_length(srs_vad_t *vad)
+{
+    return vad ? vad->frlen : 0;
+}
+
+
+double srs_vad_noise_floor(srs_vad_t *vad)
+{
+    return vad && vad->floored ? vad->floor : 0.0;
+}
+
+
+srs_vad_state_t srs_vad_state(srs_vad_t *vad)
+{
+    return vad ? vad->state : SRS_VAD_SILENCE;
+}
+
+
+static void process_frame(srs_vad_t *vad, const int16_t *samples,
+                          srs_vad_frame_t *frame)
+{
+    double level, on, off, mid, slope;
+
+    level = 10.0 * log10(srs_vad_energy(samples, vad->frlen) + 1.0);
+
+    if (vad->cfg.adaptive) {
+        if (!vad->floored || level < vad->floor) {
+            vad->floor   = level;
+            vad->floored = true;
+        }
+        else if (vad->state == SRS_VAD_SILENCE)
+            vad->floor += (level - vad->floor) * FLOOR_RISE;
+
+        on  = vad->floor + vad->cfg.onset;
+        off = vad->floor + vad->cfg.offset;
+    }
+    else {
+        on  = vad->cfg.onset;
+        off = vad->cfg.offset;
+    }
+
+    /*
+     * Hysteresis: speech starts above the onset level and lasts until
+     * the level has stayed below the offset level for the hangover.
+     */
+    if (vad->state == SRS_VAD_SILENCE) {
+        if (level >= on) {
+            vad->state = SRS_VAD_SPEECH;
+            vad->hang  = vad->hangover;
+        }
+    }
+    else {
+        if (level >= off)
+            vad->hang = vad->hangover;
+        else if (vad->hang > 0)
+            vad->hang--;
+        else
+            vad->state = SRS_VAD_SILENCE;
+    }
+
+    if (frame != NULL) {
+        mid   = (on + off) / 2.0;
+        slope = (on - off) / 4.0;
+
+        if (slope < SLOPE_MIN)
+            slope = SLOPE_MIN;
+
+        frame->state = vad->state;
+        frame->level = level;
+        frame->prob  = 1.0 / (1.0 + exp(-(level - mid) / slope));
+    }
+}
+
+
+int srs_vad_process(srs_vad_t *vad, const int16_t *samples, size_t nsample,
+                    srs_vad_frame_t *frames, int nframe)
+{
+    srs_vad_frame_t *f;
+    size_t frlen, n;
+    int cnt;
+
+    if (vad == NULL || (samples == NULL && nsample > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    frlen = vad->frlen;
+    cnt   = 0;
+
+    if (vad->ncarry > 0) {
+        n = frlen - vad->ncarry;
+
+        if (n > nsample)
+            n = nsample;
+
+        memcpy(vad->carry + vad->ncarry, samples, n * sizeof(samples[0]));
+        vad->ncarry += n;
+        samples     += n;
+        nsample     -= n;
+
+        if (vad->ncarry < frlen)
+            return 0;
+
+        f = (frames != NULL && cnt < nframe) ? frames + cnt : NULL;
+        process_frame(vad, vad->carry, f);
+        vad->ncarry = 0;
+        cnt++;
+    }
+
+    while (nsample >= frlen) {
+        f = (frames != NULL && cnt < nframe) ? frames + cnt : NULL;
+        process_frame(vad, samples, f);
+        samples += frlen;
+        nsample -= frlen;
+        cnt++;
+    }
+
+    if (nsample > 0) {
+        memcpy(vad->carry, samples, nsample * sizeof(samples[0]));
+        vad->ncarry = nsample;
+    }
+
+    return cnt;
+}
+
+
+#ifdef __SSE2__
+
+double srs_vad_energy(const int16_t *samples, size_t nsample)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i acc  = _mm_setzero_si128();
+    __m128i v, p;
+    int64_t sum[2];
+    int64_t e;
+    size_t  i;
+
+    /*
+     * The pairwise madd sums are non-negative and fit in 32 unsigned
+     * bits, so zero-extend them to 64 bits before accumulating.
+     */
+    for (i = 0; i + 8 <= nsample; i += 8) {
+        v   = _mm_loadu_si128((const __m128i *)(samples + i));
+        p   = _mm_madd_epi16(v, v);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, zero));
+    }
+
+    _mm_storeu_si128((__m128i *)sum, acc);
+    e = sum[0] + sum[1];
+
+    for (; i < nsample; i++)
+        e += (int32_t)samples[i] * (int32_t)samples[i];
+
+    return nsample ? (double)e / (double)nsample : 0.0;
+}
+
+
+uint32_t srs_vad_zero_crossings(const int16_t *samples, size_t nsample)
+{
+    __m128i  acc = _mm_setzero_si128();
+    __m128i  a, b, x;
+    int16_t  cnt[8];
+    uint32_t n;
+    size_t   i, j;
+
+    /*
+     * A sign change between neighbours shows up as a negative a ^ b,
+     * ie. as -1 after an arithmetic shift. Flush the 16-bit lane
+     * counters often enough that they can never overflow.
+     */
+    n = 0;
+    i = 0;
+
+    while (i + 9 <= nsample) {
+        for (j = 0; j < 4096 && i + 9 <= nsample; j++, i += 8) {
+            a   = _mm_loadu_si128((const __m128i *)(samples + i));
+            b   = _mm_loadu_si128((const __m128i *)(samples + i + 1));
+            x   = _mm_srai_epi16(_mm_xor_si128(a, b), 15);
+            acc = _mm_sub_epi16(acc, x);
+        }
+
+        _mm_storeu_si128((__m128i *)cnt, acc);
+        acc = _mm_setzero_si128();
+
+        for (j = 0; j < 8; j++)
+            n += (uint16_t)cnt[j];
+    }
+
+    for (; i + 1 < nsample; i++)
+        n += ((samples[i] ^ samples[i + 1]) < 0);
+
+    return n;
+}
+
+#else /* !__SSE2__ */
+
+double srs_vad_energy(const int16_t *samples, size_t nsample)
+{
+    int64_t e;
+    size_t  i;
+
+    for (i = 0, e = 0; i < nsample; i++)
+        e += (int32_t)samples[i] * (int32_t)samples[i];
+
+    return nsample ? (double)e / (double)nsample : 0.0;
+}
+
+
+uint32_t srs_vad_zero_crossings(const int16_t *samples, size_t nsample)
+{
+    uint32_t n;
+    size_t   i;
+
+    for (i = 0, n = 0; i + 1 < nsample; i++)
+        n += ((samples[i] ^ samples[i + 1]) < 0);
+
+    return n;
+}
+
+#endif /* !__SSE2__ */
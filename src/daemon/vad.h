@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_VAD_H__
+#define __SRS_DAEMON_VAD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * a frame-energy based voice activity detector
+ */
+
+typedef struct srs_vad_s srs_vad_t;
+
+/** Voice activity detector configuration. */
+typedef struct {
+    uint32_t rate;                       /* sample rate */
+    uint32_t frame;                      /* frame length (msec) */
+    double   onset;                      /* speech onset level (dB) */
+    double   offset;                     /* speech offset level (dB) */
+    uint32_t hangover;                   /* speech hangover (msec) */
+    bool     adaptive;                   /* levels relative to noise floor */
+} srs_vad_config_t;
+
+/** Voice activity states. */
+typedef enum {
+    SRS_VAD_SILENCE = 0,                 /* no voice activity */
+    SRS_VAD_SPEECH,                      /* voice activity (or hangover) */
+} srs_vad_state_t;
+
+/** Per-frame voice activity detection results. */
+typedef struct {
+    srs_vad_state_t state;               /* smoothed activity state */
+    double          level;               /* frame level (dB) */
+    double          prob;                /* speech probability (0.0 - 1.0) */
+} srs_vad_frame_t;
+
+/** Create a new voice activity detector. */
+srs_vad_t *srs_vad_create(srs_vad_config_t *cfg);
+
+/** Destroy the given voice activity detector. */
+void srs_vad_destroy(srs_vad_t *vad);
+
+/** Reset the activity state (but not the noise floor) of the detector. */
+void srs_vad_reset(srs_vad_t *vad);
+
+/** Return the frame length of the detector in samples. */
+size_t srs_vad_frame_length(srs_vad_t *vad);
+
+/** Return the current noise floor estimate (dB) of the detector. */
+double srs_vad_noise_floor(srs_vad_t *vad);
+
+/**
+ * Process the given 16-bit mono samples. Partial frames are carried
+ * over to the next call. Results for at most nframe frames are stored
+ * in frames (which can be NULL if only the state is of interest). Returns
+ * the number of frames completed or -1 on error.
+ */
+int srs_vad_process(srs_vad_t *vad, const int16_t *samples, size_t nsample,
+                    srs_vad_frame_t *frames, int nframe);
+
+/** Return the current smoothed activity state of the detector. */
+srs_vad_state_t srs_vad_state(srs_vad_t *vad);
+
+/** Calculate the mean square energy of the given samples. */
+double srs_vad_energy(const int16_t *samples, size_t nsample);
+
+/** Count the zero-crossings in the given samples. */
+uint32_t srs_vad_zero_crossings(const int16_t *samples, size_t nsample);
+
+#endif /* __SRS_DAEMON_VAD_H__ */
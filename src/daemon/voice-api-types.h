@@ -82,6 +82,15 @@ typedef enum {
 #define SRS_VOICE_QUEUE        -1        /* allow queuing indefinitely */
 #define SRS_VOICE_TIMEOUT(sec) (sec)     /* fail if can't start in time */
 
+/** Voice request priority classes. */
+typedef enum {
+    SRS_VOICE_PRIORITY_LOW,              /* whenever nothing else to say */
+    SRS_VOICE_PRIORITY_NORMAL,           /* ordinary prompts */
+    SRS_VOICE_PRIORITY_HIGH,             /* ahead of anything queued */
+    SRS_VOICE_PRIORITY_URGENT,           /* interrupt (or duck) others */
+    SRS_VOICE_PRIORITY_MAX
+} srs_voice_priority_t;
+
 
 /*
  * voice actors
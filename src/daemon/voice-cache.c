@@ -0,0 +1,693 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+#include <murphy/common/hashtbl.h>
+
+#include "srs/daemon/context.h"
+#include "srs/daemon/worker.h"
+#include "srs/daemon/voice-cache.h"
+
+#define FILE_MAGIC "SRSPCM1"             /* stored audio file magic */
+#define FILE_ALIGN 8                     /* alignment of stored samples */
+
+struct srs_voice_cache_s {
+    mrp_htbl_t      *entries;            /* cached audio by key */
+    mrp_list_hook_t  lru;                /* most recently used first */
+    mrp_list_hook_t  pinned;             /* pinned entries */
+    size_t           size;               /* current size */
+    size_t           max_size;           /* max. size */
+    size_t           pinned_size;        /* size of pinned entries */
+    char            *dir;                /* storage directory, if any */
+    srs_job_queue_t *jobs;               /* queue for storing entries */
+    mrp_list_hook_t  stores;             /* entries being stored */
+    uint64_t         hits;               /* cache hits */
+    uint64_t         misses;             /* cache misses */
+};
+
+typedef struct {
+    char             magic[8];           /* FILE_MAGIC */
+    uint32_t         rate;               /* sample rate */
+    uint32_t         nchannel;           /* number of channels */
+    uint32_t         nsample;            /* number of samples */
+    uint32_t         keylen;             /* length of key following us */
+} file_hdr_t;
+
+typedef struct {
+    mrp_list_hook_t    hook;             /* to entries being stored */
+    srs_voice_cache_t *cache;            /* cache we belong to */
+    srs_voice_pcm_t   *pcm;              /* audio to store (referenced) */
+    int                status;           /* 0, or errno of failure */
+    char               path[PATH_MAX];   /* file to store to */
+} store_t;
+
+typedef struct {
+    time_t             mtime;            /* last modification */
+    off_t              size;             /* file size */
+    char              *name;             /* file name */
+} stored_t;
+
+
+static void evict_entry(srs_voice_pcm_t *pcm);
+static void remove_file(srs_voice_cache_t *c, const char *key);
+
+
+static int cmp_stored(const void *a, const void *b)
+{
+    const stored_t *sa = a, *sb = b;
+
+    return sa->mtime < sb->mtime ? -1 : (sa->mtime > sb->mtime ? 1 : 0);
+}
+
+
+static void trim_dir(srs_voice_cache_t *c)
+{
+    DIR           *dp;
+    struct dirent *de;
+    struct stat    st;
+    stored_t      *files = NULL;
+    char           path[PATH_MAX];
+    const char    *ext;
+    size_t         total;
+    int            nfile, nremoved, i;
+
+    /*
+     * Only entries still in the cache keep their files while we run. Of
+     * the files left behind by earlier runs keep the most recent ones
+     * that fit our size limit, and forget about any partial writes.
+     */
+
+    if ((dp = opendir(c->dir)) == NULL)
+        return;
+
+    nfile = 0;
+    total = 0;
+
+    while ((de = readdir(dp)) != NULL) {
+        if ((ext = strrchr(de->d_name, '.')) == NULL)
+            continue;
+
+        if (snprintf(path, sizeof(path), "%s/%s", c->dir,
+                     de->d_name) >= (int)sizeof(path))
+            continue;
+
+        if (!strcmp(ext, ".tmp")) {
+            unlink(path);
+            continue;
+        }
+
+        if (strcmp(ext, ".pcm") || stat(path, &st) < 0 ||
+            !S_ISREG(st.st_mode))
+            continue;
+
+        if (!mrp_reallocz(files, nfile, nfile + 1))
+            break;
+
+        if ((files[nfile].name = mrp_strdup(de->d_name)) == NULL)
+            break;
+
+        files[nfile].mtime = st.st_mtime;
+        files[nfile].size  = st.st_size;
+        total += st.st_size;
+        nfile++;
+    }
+
+    closedir(dp);
+
+    if (nfile > 0)
+        qsort(files, nfile, sizeof(files[0]), cmp_stored);
+
+    for (i = nremoved = 0; i < nfile; i++) {
+        if (total > c->max_size) {
+            snprintf(path, sizeof(path), "%s/%s", c->dir, files[i].name);
+
+            if (unlink(path) == 0) {
+                total -= files[i].size;
+                nremoved++;
+            }
+        }
+
+        mrp_free(files[i].name);
+    }
+
+    mrp_free(files);
+
+    if (nremoved > 0)
+        mrp_log_info("Removed %d old voice cache files from %s.", nremoved,
+                     c->dir);
+}
+
+
+srs_voice_cache_t *srs_voice_cache_create(srs_context_t *srs,
+                                          size_t max_size, const char *dir)
+{
+    srs_voice_cache_t  *c;
+    mrp_htbl_config_t   hcfg;
+
+    if ((c = mrp_allocz(sizeof(*c))) == NULL)
+        return NULL;
+
+    mrp_list_init(&c->lru);
+    mrp_list_init(&c->pinned);
+    mrp_list_init(&c->stores);
+    c->max_size = max_size;
+
+    mrp_clear(&hcfg);
+    hcfg.nentry  = 64;
+    hcfg.comp    = mrp_string_comp;
+    hcfg.hash    = mrp_string_hash;
+    hcfg.free    = NULL;
+    hcfg.nbucket = hcfg.nentry;
+
+    if ((c->entries = mrp_htbl_create(&hcfg)) == NULL) {
+        mrp_free(c);
+        return NULL;
+    }
+
+    if (dir != NULL && *dir) {
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+            mrp_log_error("Failed to create voice cache directory '%s' "
+                          "(%d: %s).", dir, errno, strerror(errno));
+        else
+            c->dir = mrp_strdup(dir);
+    }
+
+    if (c->dir != NULL) {
+        trim_dir(c);
+
+        /* without a worker pool files are written in the main loop */
+        if (srs->workers != NULL)
+            c->jobs = srs_job_queue_create(srs, "voice-cache", 1);
+    }
+
+    mrp_log_info("Created voice cache of %zu kbytes%s%s.", max_size / 1024,
+                 c->dir ? ", stored in " : "", c->dir ? c->dir : "");
+
+    return c;
+}
+
+
+static void free_store(store_t *s)
+{
+    mrp_list_delete(&s->hook);
+    srs_voice_pcm_unref(s->pcm);
+    mrp_free(s);
+}
+
+
+void srs_voice_cache_destroy(srs_voice_cache_t *c)
+{
+    mrp_list_hook_t *p, *n;
+
+    if (c == NULL)
+        return;
+
+    mrp_log_info("Voice cache: %llu hits, %llu misses.",
+                 (unsigned long long)c->hits, (unsigned long long)c->misses);
+
+    /* this waits for any store in progress and drops the rest */
+    srs_job_queue_destroy(c->jobs);
+
+    mrp_list_foreach(&c->stores, p, n)
+        free_store(mrp_list_entry(p, store_t, hook));
+
+    mrp_list_foreach(&c->lru, p, n)
+        evict_entry(mrp_list_entry(p, srs_voice_pcm_t, hook));
+    mrp_list_foreach(&c->pinned, p, n)
+        evict_entry(mrp_list_entry(p, srs_voice_pcm_t, hook));
+
+    mrp_htbl_destroy(c->entries, FALSE);
+    mrp_free(c->dir);
+    mrp_free(c);
+}
+
+
+char *srs_voice_cache_key(const char *renderer, int actor, double rate,
+                          double pitch, const char *msg)
+{
+    char   *key, *d;
+    int     n;
+    size_t  len;
+
+    n = snprintf(NULL, 0, "%s/%d/%.2f/%.2f/", renderer, actor, rate, pitch);
+
+    if (n < 0)
+        return NULL;
+
+    len = (size_t)n + strlen(msg) + 1;
+
+    if ((key = mrp_alloc(len)) == NULL)
+        return NULL;
+
+    snprintf(key, len, "%s/%d/%.2f/%.2f/", renderer, actor, rate, pitch);
+
+    /* collapse and trim whitespace */
+    d = key + n;
+    while (*msg) {
+        if (isspace(*msg)) {
+            while (isspace(*msg))
+                msg++;
+
+            if (*msg && d > key + n)
+                *d++ = ' ';
+        }
+        else
+            *d++ = *msg++;
+    }
+    *d = '\0';
+
+    return key;
+}
+
+
+static void free_entry(srs_voice_pcm_t *pcm)
+{
+    if (pcm->map != NULL)
+        munmap(pcm->map, pcm->maplen);
+    else
+        mrp_free(pcm->samples);
+
+    mrp_free(pcm->key);
+    mrp_free(pcm);
+}
+
+
+void srs_voice_pcm_unref(srs_voice_pcm_t *pcm)
+{
+    if (pcm != NULL && --pcm->refcnt <= 0)
+        free_entry(pcm);
+}
+
+
+static void evict_entry(srs_voice_pcm_t *pcm)
+{
+    srs_voice_cache_t *c = pcm->cache;
+
+    mrp_debug("evicting '%s' from voice cache", pcm->key);
+
+    mrp_list_delete(&pcm->hook);
+    mrp_htbl_remove(c->entries, pcm->key, FALSE);
+    if (pcm->pinned)
+        c->pinned_size -= pcm->size;
+    else
+        c->size -= pcm->size;
+    pcm->cache = NULL;
+
+    srs_voice_pcm_unref(pcm);
+}
+
+
+static int make_room(srs_voice_cache_t *c, size_t size, int pinned)
+{
+    srs_voice_pcm_t *pcm;
+
+    if (pinned)
+        return 0;
+
+    if (size > c->max_size) {
+        errno = E2BIG;
+        return -1;
+    }
+
+    /* evicted entries lose their files, too, to keep within our limit */
+    while (c->size + size > c->max_size && !mrp_list_empty(&c->lru)) {
+        pcm = mrp_list_entry(c->lru.prev, srs_voice_pcm_t, hook);
+
+        remove_file(c, pcm->key);
+        evict_entry(pcm);
+    }
+
+    return 0;
+}
+
+
+static void link_entry(srs_voice_cache_t *c, srs_voice_pcm_t *pcm,
+                       int pinned)
+{
+    pcm->cache  = c;
+    pcm->refcnt = 1;                     /* the reference of the cache */
+
+    if (pinned) {
+        pcm->pinned     = TRUE;
+        c->pinned_size += pcm->size;
+        mrp_list_append(&c->pinned, &pcm->hook);
+    }
+    else {
+        c->size += pcm->size;
+        mrp_list_prepend(&c->lru, &pcm->hook);
+    }
+
+    mrp_htbl_insert(c->entries, pcm->key, pcm);
+}
+
+
+static void pin_entry(srs_voice_cache_t *c, srs_voice_pcm_t *pcm)
+{
+    if (pcm->pinned)
+        return;
+
+    mrp_list_delete(&pcm->hook);
+    mrp_list_append(&c->pinned, &pcm->hook);
+    c->size        -= pcm->size;
+    c->pinned_size += pcm->size;
+    pcm->pinned     = TRUE;
+}
+
+
+static char *file_path(srs_voice_cache_t *c, const char *key, char *buf,
+                       size_t size)
+{
+    uint64_t    h = 14695981039346656037ULL;
+    const char *p;
+
+    for (p = key; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ULL;
+    }
+
+    if (snprintf(buf, size, "%s/%016llx.pcm", c->dir,
+                 (unsigned long long)h) >= (int)size)
+        return NULL;
+
+    return buf;
+}
+
+
+static void remove_file(srs_voice_cache_t *c, const char *key)
+{
+    char path[PATH_MAX];
+
+    if (c->dir == NULL || file_path(c, key, path, sizeof(path)) == NULL)
+        return;
+
+    if (unlink(path) < 0 && errno != ENOENT)
+        mrp_log_error("Failed to remove voice cache file %s (%d: %s).",
+                      path, errno, strerror(errno));
+}
+
+
+static size_t samples_offset(uint32_t keylen)
+{
+    return (sizeof(file_hdr_t) + keylen + FILE_ALIGN - 1) & ~(FILE_ALIGN - 1);
+}
+
+
+static srs_voice_pcm_t *load_entry(srs_voice_cache_t *c, const char *key,
+                                   int pinned)
+{
+    srs_voice_pcm_t *pcm;
+    file_hdr_t      *hdr;
+    char             path[PATH_MAX];
+    struct stat      st;
+    void            *map;
+    size_t           offs, size;
+    int              fd;
+
+    if (c->dir == NULL || file_path(c, key, path, sizeof(path)) == NULL)
+        return NULL;
+
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return NULL;
+
+    map = MAP_FAILED;
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(*hdr))
+        goto invalid;
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED)
+        goto invalid;
+
+    hdr  = map;
+    offs = samples_offset(hdr->keylen);
+    size = 2 * (size_t)hdr->nsample * hdr->nchannel;
+
+    /* different keys may end up in the same file, check it is ours */
+    if (memcmp(hdr->magic, FILE_MAGIC, sizeof(hdr->magic)) ||
+        hdr->keylen != strlen(key) || hdr->nchannel == 0 ||
+        offs + size != (size_t)st.st_size ||
+        memcmp((char *)map + sizeof(*hdr), key, hdr->keylen))
+        goto invalid;
+
+    if (make_room(c, size, pinned) < 0 ||
+        (pcm = mrp_allocz(sizeof(*pcm))) == NULL)
+        goto invalid;
+
+    mrp_list_init(&pcm->hook);
+    pcm->key      = mrp_strdup(key);
+    pcm->samples  = (char *)map + offs;
+    pcm->rate     = hdr->rate;
+    pcm->nchannel = hdr->nchannel;
+    pcm->nsample  = hdr->nsample;
+    pcm->size     = size;
+    pcm->map      = map;
+    pcm->maplen   = st.st_size;
+
+    close(fd);
+
+    if (pcm->key == NULL) {
+        free_entry(pcm);
+        return NULL;
+    }
+
+    link_entry(c, pcm, pinned);
+
+    mrp_debug("loaded '%s' from voice cache file %s", key, path);
+
+    return pcm;
+
+ invalid:
+    if (map != MAP_FAILED)
+        munmap(map, st.st_size);
+    close(fd);
+
+    return NULL;
+}
+
+
+static int write_file(const char *path, srs_voice_pcm_t *pcm)
+{
+    file_hdr_t  hdr;
+    char        tmp[PATH_MAX + 8];
+    char        pad[FILE_ALIGN] = { 0, };
+    size_t      keylen, npad;
+    int         fd, ok;
+
+    /* called in a worker thread, only touch the immutable parts of pcm */
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+        return -1;
+
+    keylen = strlen(pcm->key);
+    npad   = samples_offset(keylen) - sizeof(hdr) - keylen;
+
+    mrp_clear(&hdr);
+    memcpy(hdr.magic, FILE_MAGIC, sizeof(hdr.magic));
+    hdr.rate     = pcm->rate;
+    hdr.nchannel = pcm->nchannel;
+    hdr.nsample  = pcm->nsample;
+    hdr.keylen   = keylen;
+
+    ok = (write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+          write(fd, pcm->key, keylen) == (ssize_t)keylen &&
+          write(fd, pad, npad) == (ssize_t)npad &&
+          write(fd, pcm->samples, pcm->size) == (ssize_t)pcm->size);
+
+    close(fd);
+
+    /* rename so that nobody ever maps in a partially written file */
+    if (ok && rename(tmp, path) == 0)
+        return 0;
+
+    ok = errno;
+    unlink(tmp);
+    errno = ok;
+
+    return -1;
+}
+
+
+static void store_job(void *data)
+{
+    store_t *s = (store_t *)data;
+
+    s->status = write_file(s->path, s->pcm) < 0 ? errno : 0;
+}
+
+
+static void store_done(uint32_t id, int status, void *data)
+{
+    store_t           *s = (store_t *)data;
+    srs_voice_cache_t *c = s->cache;
+
+    MRP_UNUSED(id);
+
+    if (status == 0 && s->status != 0)
+        mrp_log_error("Failed to store voice cache file %s (%d: %s).",
+                      s->path, s->status, strerror(s->status));
+
+    /* evicted (and not added again) while we were writing it */
+    if (status == 0 && s->status == 0 && s->pcm->cache == NULL &&
+        mrp_htbl_lookup(c->entries, s->pcm->key) == NULL)
+        unlink(s->path);
+
+    free_store(s);
+}
+
+
+static void store_entry(srs_voice_cache_t *c, srs_voice_pcm_t *pcm)
+{
+    store_t *s;
+    char     path[PATH_MAX];
+
+    if (c->dir == NULL || file_path(c, pcm->key, path, sizeof(path)) == NULL)
+        return;
+
+    if (c->jobs != NULL && (s = mrp_allocz(sizeof(*s))) != NULL) {
+        mrp_list_init(&s->hook);
+        s->cache = c;
+        s->pcm   = pcm;
+        strcpy(s->path, path);
+
+        /* keep the samples around until they are written */
+        pcm->refcnt++;
+        mrp_list_append(&c->stores, &s->hook);
+
+        if (srs_job_submit(c->jobs, store_job, store_done,
+                           s) != SRS_JOB_INVALID)
+            return;
+
+        free_store(s);
+    }
+
+    if (write_file(path, pcm) < 0)
+        mrp_log_error("Failed to store voice cache file %s (%d: %s).",
+                      path, errno, strerror(errno));
+}
+
+
+srs_voice_pcm_t *srs_voice_cache_lookup(srs_voice_cache_t *c,
+                                        const char *key)
+{
+    srs_voice_pcm_t *pcm;
+
+    if ((pcm = mrp_htbl_lookup(c->entries, (void *)key)) != NULL) {
+        if (!pcm->pinned) {
+            mrp_list_delete(&pcm->hook);
+            mrp_list_prepend(&c->lru, &pcm->hook);
+        }
+    }
+    else if ((pcm = load_entry(c, key, FALSE)) == NULL) {
+        c->misses++;
+        return NULL;
+    }
+
+    c->hits++;
+    pcm->refcnt++;
+
+    return pcm;
+}
+
+
+int srs_voice_cache_insert(srs_voice_cache_t *c, const char *key,
+                           void *samples, int rate, int nchannel,
+                           uint32_t nsample, int pinned)
+{
+    srs_voice_pcm_t *pcm;
+    size_t           size;
+
+    if ((pcm = mrp_htbl_lookup(c->entries, (void *)key)) != NULL) {
+        if (pinned)
+            pin_entry(c, pcm);
+        return 0;
+    }
+
+    size = 2 * (size_t)nsample * nchannel;
+
+    if (size == 0 || make_room(c, size, pinned) < 0)
+        return -1;
+
+    if ((pcm = mrp_allocz(sizeof(*pcm))) == NULL)
+        return -1;
+
+    mrp_list_init(&pcm->hook);
+    pcm->key      = mrp_strdup(key);
+    pcm->samples  = mrp_datadup(samples, size);
+    pcm->rate     = rate;
+    pcm->nchannel = nchannel;
+    pcm->nsample  = nsample;
+    pcm->size     = size;
+
+    if (pcm->key == NULL || pcm->samples == NULL) {
+        free_entry(pcm);
+        return -1;
+    }
+
+    link_entry(c, pcm, pinned);
+    store_entry(c, pcm);
+
+    mrp_debug("cached%s '%s' (%zu bytes, %zu/%zu bytes used)",
+              pinned ? " and pinned" : "", key, size, c->size, c->max_size);
+
+    return 0;
+}
+
+
+int srs_voice_cache_pin(srs_voice_cache_t *c, const char *key)
+{
+    srs_voice_pcm_t *pcm;
+
+    if ((pcm = mrp_htbl_lookup(c->entries, (void *)key)) != NULL)
+        pin_entry(c, pcm);
+    else if (load_entry(c, key, TRUE) == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_VOICE_CACHE_H__
+#define __SRS_DAEMON_VOICE_CACHE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <murphy/common/list.h>
+
+#include "srs/daemon/context.h"
+
+/*
+ * rendered voice cache
+ *
+ * An LRU cache of synthesized audio keyed by the backend, voice, rate,
+ * pitch and the whitespace-normalized text of a rendering. Cached audio
+ * is reference counted, so entries can be evicted while they are still
+ * being played. Optionally entries are also stored in a directory, from
+ * where they are mapped back in on demand, even after a restart. Pinned
+ * entries are never evicted and do not count against the size limit.
+ */
+
+typedef struct srs_voice_cache_s srs_voice_cache_t;
+
+typedef struct {
+    mrp_list_hook_t    hook;             /* to LRU list */
+    srs_voice_cache_t *cache;            /* cache, NULL once evicted */
+    char              *key;              /* cache key */
+    void              *samples;          /* audio samples */
+    int                rate;             /* sample rate */
+    int                nchannel;         /* number of channels */
+    uint32_t           nsample;          /* number of samples */
+    size_t             size;             /* size of samples in bytes */
+    int                refcnt;           /* reference count */
+    int                pinned;           /* never evicted */
+    void              *map;              /* mapped file, if any */
+    size_t             maplen;           /*     and its length */
+} srs_voice_pcm_t;
+
+/**
+ * Create a cache of max_size bytes, stored in dir if given. Files are
+ * written by the worker pool, if there is one. Files of evicted entries
+ * are removed, and at creation the oldest files are removed until the
+ * rest fit in max_size.
+ */
+srs_voice_cache_t *srs_voice_cache_create(srs_context_t *srs,
+                                          size_t max_size, const char *dir);
+
+/** Destroy the given cache. */
+void srs_voice_cache_destroy(srs_voice_cache_t *c);
+
+/** Construct the cache key for the given rendering. */
+char *srs_voice_cache_key(const char *renderer, int actor, double rate,
+                          double pitch, const char *msg);
+
+/** Look up (and take a reference to) cached audio. */
+srs_voice_pcm_t *srs_voice_cache_lookup(srs_voice_cache_t *c,
+                                        const char *key);
+
+/** Add (a copy of) the given audio to the cache, optionally pinned. */
+int srs_voice_cache_insert(srs_voice_cache_t *c, const char *key,
+                           void *samples, int rate, int nchannel,
+                           uint32_t nsample, int pinned);
+
+/** Pin already cached (or stored) audio in the cache. */
+int srs_voice_cache_pin(srs_voice_cache_t *c, const char *key);
+
+/** Drop a reference to cached audio. */
+void srs_voice_pcm_unref(srs_voice_pcm_t *pcm);
+
+#endif /* __SRS_DAEMON_VOICE_CACHE_H__ */
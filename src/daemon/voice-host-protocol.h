@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_VOICE_HOST_PROTOCOL_H__
+#define __SRS_DAEMON_VOICE_HOST_PROTOCOL_H__
+
+#include <stdint.h>
+
+/*
+ * synthesizer host protocol
+ *
+ * A synthesizer host is a helper process running a single voice engine
+ * on behalf of the daemon. It gets a SOCK_SEQPACKET socket to the daemon
+ * as file descriptor SRS_HOST_SOCKET and a shared memory buffer for the
+ * synthesized audio as SRS_HOST_BUFFER. The buffer is split into slots
+ * of SRS_HOST_SLOT_SIZE bytes. The host fills a free slot, tells the
+ * daemon about it with a chunk message and the daemon hands the slot
+ * back with an ack message once it has consumed the samples.
+ *
+ * After starting up the host sends a voice message for each voice it
+ * has, followed by a ready message. Then it renders one message at a
+ * time: for each render request it sends a format message, any number
+ * of chunk messages and finally a done message. A cancel request makes
+ * the host stop rendering as soon as possible.
+ */
+
+#define SRS_HOST_SOCKET    3             /* socket to the daemon */
+#define SRS_HOST_BUFFER    4             /* shared sample buffer */
+#define SRS_HOST_SLOT_SIZE (32 * 1024)   /* size of a buffer slot */
+#define SRS_HOST_NSLOT     8             /* number of buffer slots */
+#define SRS_HOST_MSG_MAX   (16 * 1024)   /* max. message size */
+
+typedef enum {
+    /* host to daemon */
+    SRS_HOST_MSG_VOICE = 1,              /* a voice actor */
+    SRS_HOST_MSG_READY,                  /* all voices announced */
+    SRS_HOST_MSG_FORMAT,                 /* sample format of a rendering */
+    SRS_HOST_MSG_CHUNK,                  /* a slot full of samples */
+    SRS_HOST_MSG_DONE,                   /* rendering done */
+    /* daemon to host */
+    SRS_HOST_MSG_RENDER,                 /* render a message */
+    SRS_HOST_MSG_CANCEL,                 /* cancel a rendering */
+    SRS_HOST_MSG_ACK,                    /* slot consumed */
+} srs_host_msg_type_t;
+
+typedef struct {
+    uint32_t type;                       /* message type */
+    uint32_t id;                         /* rendering or voice id */
+    union {
+        struct {                         /* voice, followed by the strings */
+            uint16_t gender;             /*   name, language, dialect and */
+            uint16_t age;                /*   description, '\0'-separated */
+        } voice;
+        struct {
+            uint32_t nvoice;             /* number of voices */
+        } ready;
+        struct {
+            int32_t  rate;               /* sample rate */
+            int32_t  nchannel;           /* number of channels */
+        } format;
+        struct {
+            uint32_t slot;               /* buffer slot */
+            uint32_t size;               /* amount of data in slot */
+            double   input;              /* fraction of message rendered */
+        } chunk;
+        struct {
+            int32_t  status;             /* 0 or an errno */
+        } done;
+        struct {                         /* render, followed by the text */
+            uint32_t actor;              /* voice id */
+            double   rate;               /* synthesis rate */
+            double   pitch;              /* synthesis pitch */
+        } render;
+        struct {
+            uint32_t slot;               /* consumed slot */
+        } ack;
+    } data;
+} srs_host_msg_t;
+
+/** Get the variable-sized payload following a message. */
+#define SRS_HOST_MSG_PAYLOAD(m) ((char *)((srs_host_msg_t *)(m) + 1))
+
+#endif /* __SRS_DAEMON_VOICE_HOST_PROTOCOL_H__ */
@@ -0,0 +1,853 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+#include <murphy/common/list.h>
+#include <murphy/common/mainloop.h>
+
+#include "srs/daemon/config.h"
+#include "srs/daemon/voice.h"
+#include "srs/daemon/pulse.h"
+#include "srs/daemon/voice-host.h"
+#include "srs/daemon/voice-host-protocol.h"
+
+#define RESPAWN_WINDOW 5                 /* hosts dying within this, */
+#define RESPAWN_MAX    3                 /* this many times are given up */
+
+typedef struct host_s   host_t;
+typedef struct render_s render_t;
+
+/*
+ * a synthesizer host process
+ */
+
+struct host_s {
+    srs_voice_host_t *pool;              /* pool we belong to */
+    int               idx;               /* host index within pool */
+    pid_t             pid;               /* host process */
+    int               fd;                /* socket to host */
+    mrp_io_watch_t   *iow;               /* I/O watch for socket */
+    void             *buf;               /* shared sample buffer */
+    int               ready;             /* whether host is up */
+    render_t         *active;            /* rendering in progress */
+    time_t            started;           /* time of last start */
+    int               nfail;             /* successive early exits */
+};
+
+
+/*
+ * a rendering
+ */
+
+struct render_s {
+    mrp_list_hook_t   hook;              /* to pending renderings */
+    uint32_t          id;                /* our stream id */
+    char            **segs;              /* message segments to render */
+    int               nseg;              /* number of segments */
+    int               seg;               /* segment being rendered */
+    size_t            total;             /* total length of segments */
+    size_t            done;              /* length of rendered segments */
+    uint32_t          actor;             /* voice to render with */
+    double            rate;              /* synthesis rate */
+    double            pitch;             /* synthesis pitch */
+    int               nchannel;          /* number of channels */
+    int               cancelled;         /* cancelled while rendering */
+};
+
+
+/*
+ * a pool of hosts
+ */
+
+struct srs_voice_host_s {
+    srs_context_t     *srs;              /* main context */
+    char              *engine;           /* engine (and backend) name */
+    char              *path;             /* host executable */
+    char             **argv;             /* host command line */
+    host_t            *hosts;            /* hosts */
+    int                nhost;            /* number of hosts */
+    host_t            *announcer;        /* host announcing voices */
+    srs_voice_actor_t *actors;           /* voices */
+    int                nactor;           /* number of voices */
+    int                registered;       /* whether registered as backend */
+    srs_voice_notify_t notify;           /* voice notification callback */
+    void              *notify_data;      /*     and its data */
+    mrp_list_hook_t    pending;          /* renderings waiting for a host */
+};
+
+
+static int start_host(host_t *h);
+static void dispatch_renders(srs_voice_host_t *pool);
+
+
+static void free_render(render_t *r)
+{
+    mrp_list_delete(&r->hook);
+    mrp_free(r->segs);
+    mrp_free(r);
+}
+
+
+static void abort_render(srs_voice_host_t *pool, render_t *r)
+{
+    srs_stop_stream(pool->srs->pulse, r->id, FALSE, TRUE);
+    free_render(r);
+}
+
+
+static void stream_event_cb(srs_pulse_t *p, srs_stream_event_t *event,
+                            void *user_data)
+{
+    srs_voice_host_t *pool = (srs_voice_host_t *)user_data;
+
+    MRP_UNUSED(p);
+
+    pool->notify(event, pool->notify_data);
+}
+
+
+static int send_msg(host_t *h, srs_host_msg_t *msg, size_t size)
+{
+    if (send(h->fd, msg, size, MSG_NOSIGNAL) != (ssize_t)size)
+        return -1;
+
+    return 0;
+}
+
+
+static const char *render_segment(render_t *r)
+{
+    return r->seg < r->nseg ? r->segs[r->seg] : "";
+}
+
+
+static int send_render(host_t *h, render_t *r)
+{
+    char            buf[SRS_HOST_MSG_MAX];
+    srs_host_msg_t *msg = (srs_host_msg_t *)buf;
+    const char     *seg = render_segment(r);
+    size_t          len = strlen(seg) + 1;
+
+    mrp_clear(msg);
+    msg->type              = SRS_HOST_MSG_RENDER;
+    msg->id                = r->id;
+    msg->data.render.actor = r->actor;
+    msg->data.render.rate  = r->rate;
+    msg->data.render.pitch = r->pitch;
+    memcpy(SRS_HOST_MSG_PAYLOAD(msg), seg, len);
+
+    return send_msg(h, msg, sizeof(*msg) + len);
+}
+
+
+static void dispatch_renders(srs_voice_host_t *pool)
+{
+    host_t   *h;
+    render_t *r;
+    int       i;
+
+    for (i = 0; i < pool->nhost && !mrp_list_empty(&pool->pending); i++) {
+        h = pool->hosts + i;
+
+        if (!h->ready || h->active != NULL)
+            continue;
+
+        r = mrp_list_entry(pool->pending.next, render_t, hook);
+        mrp_list_delete(&r->hook);
+
+        if (send_render(h, r) < 0) {
+            mrp_log_error("%s: failed to pass rendering #%u to host %d.",
+                          pool->engine, r->id, h->pid);
+            abort_render(pool, r);
+            continue;
+        }
+
+        mrp_debug("%s: rendering #%u on host %d", pool->engine, r->id,
+                  h->pid);
+
+        h->active = r;
+    }
+}
+
+
+static void add_voice(host_t *h, srs_host_msg_t *msg, size_t size)
+{
+    srs_voice_host_t  *pool = h->pool;
+    srs_voice_actor_t *a;
+    char              *str[4], *p, *end;
+    int                i;
+
+    /* all hosts have the same voices, just take them from the first one */
+    if (pool->registered || (pool->announcer && pool->announcer != h))
+        return;
+
+    pool->announcer = h;
+
+    p   = SRS_HOST_MSG_PAYLOAD(msg);
+    end = (char *)msg + size;
+
+    for (i = 0; i < (int)MRP_ARRAY_SIZE(str); i++) {
+        if (p >= end || memchr(p, '\0', end - p) == NULL) {
+            mrp_log_error("%s: invalid voice from host %d.", pool->engine,
+                          h->pid);
+            return;
+        }
+
+        str[i] = p;
+        p += strlen(p) + 1;
+    }
+
+    if (!mrp_reallocz(pool->actors, pool->nactor, pool->nactor + 1))
+        return;
+
+    a = pool->actors + pool->nactor;
+
+    a->id          = msg->id;
+    a->gender      = msg->data.voice.gender;
+    a->age         = msg->data.voice.age;
+    a->name        = mrp_strdup(str[0]);
+    a->lang        = mrp_strdup(str[1]);
+    a->dialect     = *str[2] ? mrp_strdup(str[2]) : NULL;
+    a->description = *str[3] ? mrp_strdup(str[3]) : NULL;
+
+    if (a->name == NULL || a->lang == NULL) {
+        mrp_free(a->name);
+        mrp_free(a->lang);
+        mrp_free(a->dialect);
+        mrp_free(a->description);
+        return;
+    }
+
+    pool->nactor++;
+}
+
+
+static void register_pool(srs_voice_host_t *pool);
+
+
+static void host_ready(host_t *h)
+{
+    srs_voice_host_t *pool = h->pool;
+
+    mrp_log_info("%s: synthesizer host %d is up.", pool->engine, h->pid);
+
+    h->ready = TRUE;
+
+    if (!pool->registered && pool->announcer == h)
+        register_pool(pool);
+
+    dispatch_renders(pool);
+}
+
+
+static void set_format(host_t *h, srs_host_msg_t *msg)
+{
+    srs_voice_host_t *pool = h->pool;
+    render_t         *r    = h->active;
+
+    if (r == NULL || r->id != msg->id || r->cancelled)
+        return;
+
+    /* hosts announce the format for every segment, take the first one */
+    if (r->nchannel > 0) {
+        if (r->nchannel == (int)msg->data.format.nchannel)
+            return;
+
+        mrp_log_error("%s: format of stream #%u changed mid-stream.",
+                      pool->engine, r->id);
+        r->cancelled = TRUE;
+        srs_stop_stream(pool->srs->pulse, r->id, FALSE, TRUE);
+        return;
+    }
+
+    r->nchannel = msg->data.format.nchannel;
+
+    if (srs_format_stream(pool->srs->pulse, r->id, msg->data.format.rate,
+                          msg->data.format.nchannel) < 0) {
+        mrp_log_error("%s: failed to set format of stream #%u.",
+                      pool->engine, r->id);
+        r->cancelled = TRUE;
+        srs_stop_stream(pool->srs->pulse, r->id, FALSE, TRUE);
+    }
+}
+
+
+static void take_chunk(host_t *h, srs_host_msg_t *msg)
+{
+    srs_voice_host_t *pool = h->pool;
+    render_t         *r    = h->active;
+    srs_host_msg_t    ack;
+    uint32_t          slot, size;
+    double            input;
+
+    slot = msg->data.chunk.slot;
+    size = msg->data.chunk.size;
+
+    /* always ack, or the host would wait for the slot forever */
+    if (slot >= SRS_HOST_NSLOT || size > SRS_HOST_SLOT_SIZE)
+        mrp_log_error("%s: invalid chunk from host %d.", pool->engine,
+                      h->pid);
+    else if (r != NULL && r->id == msg->id && !r->cancelled && r->nchannel > 0) {
+        if (srs_append_stream(pool->srs->pulse, r->id,
+                              (char *)h->buf + slot * SRS_HOST_SLOT_SIZE,
+                              size / (2 * r->nchannel)) < 0) {
+            r->cancelled = TRUE;
+            srs_stop_stream(pool->srs->pulse, r->id, FALSE, TRUE);
+        }
+        else {
+            input = msg->data.chunk.input;
+
+            if (r->total > 0)
+                input = (r->done + input * strlen(render_segment(r))) /
+                    r->total;
+
+            srs_estimate_stream(pool->srs->pulse, r->id, input);
+        }
+    }
+
+    mrp_clear(&ack);
+    ack.type          = SRS_HOST_MSG_ACK;
+    ack.id            = msg->id;
+    ack.data.ack.slot = slot;
+
+    send_msg(h, &ack, sizeof(ack));
+}
+
+
+static void render_done(host_t *h, srs_host_msg_t *msg)
+{
+    srs_voice_host_t *pool = h->pool;
+    render_t         *r    = h->active;
+
+    if (r == NULL || r->id != msg->id)
+        return;
+
+    /* pass on the next segment to the same host */
+    if (!r->cancelled && msg->data.done.status == 0 &&
+        r->seg + 1 < r->nseg) {
+        r->done += strlen(r->segs[r->seg]);
+        r->seg++;
+
+        if (send_render(h, r) == 0)
+            return;
+
+        mrp_log_error("%s: failed to pass rendering #%u to host %d.",
+                      pool->engine, r->id, h->pid);
+        h->active = NULL;
+        abort_render(pool, r);
+        dispatch_renders(pool);
+        return;
+    }
+
+    h->active = NULL;
+
+    if (!r->cancelled) {
+        if (msg->data.done.status == 0)
+            srs_close_stream(pool->srs->pulse, r->id);
+        else {
+            mrp_log_error("%s: host %d failed to render #%u (%d: %s).",
+                          pool->engine, h->pid, r->id, msg->data.done.status,
+                          strerror(msg->data.done.status));
+            srs_stop_stream(pool->srs->pulse, r->id, FALSE, TRUE);
+        }
+    }
+
+    free_render(r);
+    dispatch_renders(pool);
+}
+
+
+static void stop_host(host_t *h)
+{
+    int status;
+
+    mrp_del_io_watch(h->iow);
+    h->iow = NULL;
+
+    if (h->fd >= 0) {
+        close(h->fd);
+        h->fd = -1;
+    }
+
+    if (h->buf != NULL) {
+        munmap(h->buf, SRS_HOST_NSLOT * SRS_HOST_SLOT_SIZE);
+        h->buf = NULL;
+    }
+
+    if (h->pid > 0) {
+        if (waitpid(h->pid, &status, WNOHANG) != h->pid) {
+            kill(h->pid, SIGKILL);
+            waitpid(h->pid, &status, 0);
+        }
+
+        h->pid = 0;
+    }
+
+    h->ready = FALSE;
+}
+
+
+static void host_exited(host_t *h)
+{
+    srs_voice_host_t *pool = h->pool;
+    render_t         *r;
+    mrp_list_hook_t  *p, *n;
+    int               i;
+
+    mrp_log_error("%s: synthesizer host %d exited.", pool->engine, h->pid);
+
+    stop_host(h);
+
+    if ((r = h->active) != NULL) {
+        h->active = NULL;
+
+        if (r->cancelled)
+            free_render(r);
+        else
+            abort_render(pool, r);
+    }
+
+    if (pool->announcer == h && !pool->registered)
+        pool->announcer = NULL;
+
+    if (time(NULL) - h->started < RESPAWN_WINDOW)
+        h->nfail++;
+    else
+        h->nfail = 0;
+
+    if (h->nfail < RESPAWN_MAX && start_host(h) == 0)
+        return;
+
+    mrp_log_error("%s: giving up on synthesizer host #%d.", pool->engine,
+                  h->idx);
+
+    for (i = 0; i < pool->nhost; i++)
+        if (pool->hosts[i].pid > 0)
+            return;
+
+    /* no hosts left, nobody is going to render what is pending */
+    mrp_list_foreach(&pool->pending, p, n)
+        abort_render(pool, mrp_list_entry(p, render_t, hook));
+}
+
+
+static void host_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                    void *user_data)
+{
+    host_t         *h = (host_t *)user_data;
+    char            buf[SRS_HOST_MSG_MAX];
+    srs_host_msg_t *msg = (srs_host_msg_t *)buf;
+    ssize_t         n;
+
+    MRP_UNUSED(w);
+
+    if (events & MRP_IO_EVENT_IN) {
+        while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            if (n < (ssize_t)sizeof(*msg))
+                continue;
+
+            switch (msg->type) {
+            case SRS_HOST_MSG_VOICE:  add_voice(h, msg, n); break;
+            case SRS_HOST_MSG_READY:  host_ready(h);        break;
+            case SRS_HOST_MSG_FORMAT: set_format(h, msg);   break;
+            case SRS_HOST_MSG_CHUNK:  take_chunk(h, msg);   break;
+            case SRS_HOST_MSG_DONE:   render_done(h, msg);  break;
+            default:
+                mrp_log_error("%s: unknown message 0x%x from host %d.",
+                              h->pool->engine, msg->type, h->pid);
+            }
+        }
+
+        if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+            host_exited(h);
+            return;
+        }
+    }
+
+    if (events & (MRP_IO_EVENT_HUP | MRP_IO_EVENT_ERR))
+        host_exited(h);
+}
+
+
+static int open_buffer(host_t *h)
+{
+    char name[64];
+    int  fd;
+
+    snprintf(name, sizeof(name), "/srs-voice-host-%u-%s-%d",
+             (unsigned int)getpid(), h->pool->engine, h->idx);
+
+    if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+        return -1;
+
+    shm_unlink(name);
+
+    if (ftruncate(fd, SRS_HOST_NSLOT * SRS_HOST_SLOT_SIZE) < 0)
+        goto fail;
+
+    h->buf = mmap(NULL, SRS_HOST_NSLOT * SRS_HOST_SLOT_SIZE,
+                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (h->buf == MAP_FAILED) {
+        h->buf = NULL;
+        goto fail;
+    }
+
+    return fd;
+
+ fail:
+    close(fd);
+    return -1;
+}
+
+
+static int start_host(host_t *h)
+{
+    srs_voice_host_t *pool = h->pool;
+    mrp_io_event_t    events;
+    sigset_t          mask;
+    int               sv[2], buf, sock, fd;
+
+    sv[0] = sv[1] = -1;
+
+    if ((buf = open_buffer(h)) < 0 ||
+        socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+        goto fail;
+
+    h->started = time(NULL);
+
+    switch ((h->pid = fork())) {
+    case -1:
+        h->pid = 0;
+        goto fail;
+
+    case 0:
+        /* move our ends out of the way, then to where the host wants them */
+        sock = fcntl(sv[1], F_DUPFD, 16);
+        buf  = fcntl(buf, F_DUPFD, 16);
+
+        if (sock < 0 || buf < 0 ||
+            dup2(sock, SRS_HOST_SOCKET) < 0 || dup2(buf, SRS_HOST_BUFFER) < 0)
+            _exit(126);
+
+        for (fd = SRS_HOST_BUFFER + 1; fd < 1024; fd++)
+            close(fd);
+
+        /* we get our signals blocked for the mainloop, undo that */
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, NULL);
+
+        execv(pool->path, pool->argv);
+        _exit(127);
+
+    default:
+        break;
+    }
+
+    close(sv[1]);
+    close(buf);
+
+    h->fd  = sv[0];
+    events = MRP_IO_EVENT_IN | MRP_IO_EVENT_HUP | MRP_IO_EVENT_ERR;
+    h->iow = mrp_add_io_watch(pool->srs->ml, h->fd, events, host_cb, h);
+
+    if (h->iow == NULL) {
+        stop_host(h);
+        return -1;
+    }
+
+    mrp_debug("%s: started synthesizer host %d", pool->engine, h->pid);
+
+    return 0;
+
+ fail:
+    mrp_log_error("%s: failed to start synthesizer host (%d: %s).",
+                  pool->engine, errno, strerror(errno));
+
+    if (buf >= 0)
+        close(buf);
+    if (sv[0] >= 0) {
+        close(sv[0]);
+        close(sv[1]);
+    }
+    if (h->buf != NULL) {
+        munmap(h->buf, SRS_HOST_NSLOT * SRS_HOST_SLOT_SIZE);
+        h->buf = NULL;
+    }
+
+    return -1;
+}
+
+
+static uint32_t host_render(const char *msg, char **tags, int actor,
+                            double rate, double pitch, int notify_events,
+                            void *api_data)
+{
+    srs_voice_host_t *pool = (srs_voice_host_t *)api_data;
+    render_t         *r;
+    int               i;
+
+    for (i = 0; i < pool->nactor; i++)
+        if (pool->actors[i].id == (uint32_t)actor)
+            break;
+
+    if (i >= pool->nactor) {
+        errno = EINVAL;
+        return SRS_VOICE_INVALID;
+    }
+
+    if (sizeof(srs_host_msg_t) + strlen(msg) + 1 > SRS_HOST_MSG_MAX) {
+        mrp_log_error("%s: message too long for synthesizer host.",
+                      pool->engine);
+        errno = EMSGSIZE;
+        return SRS_VOICE_INVALID;
+    }
+
+    if ((r = mrp_allocz(sizeof(*r))) == NULL)
+        return SRS_VOICE_INVALID;
+
+    mrp_list_init(&r->hook);
+    r->actor = actor;
+    r->rate  = rate;
+    r->pitch = pitch;
+    r->nseg  = srs_segment_voice(msg, &r->segs);
+
+    if (r->nseg < 0) {
+        free_render(r);
+        return SRS_VOICE_INVALID;
+    }
+
+    for (i = 0; i < r->nseg; i++)
+        r->total += strlen(r->segs[i]);
+
+    /* the host tells us the sample format once it gets to it */
+    r->id = srs_open_stream(pool->srs->pulse, 0, 0, tags, notify_events,
+                            stream_event_cb, pool);
+
+    if (r->id == 0) {
+        free_render(r);
+        return SRS_VOICE_INVALID;
+    }
+
+    mrp_list_append(&pool->pending, &r->hook);
+    dispatch_renders(pool);
+
+    return r->id;
+}
+
+
+static void host_cancel(uint32_t id, void *api_data)
+{
+    srs_voice_host_t *pool = (srs_voice_host_t *)api_data;
+    mrp_list_hook_t  *p, *n;
+    render_t         *r;
+    srs_host_msg_t    msg;
+    host_t           *h;
+    int               i;
+
+    srs_stop_stream(pool->srs->pulse, id, FALSE, FALSE);
+
+    mrp_list_foreach(&pool->pending, p, n) {
+        r = mrp_list_entry(p, typeof(*r), hook);
+
+        if (r->id == id) {
+            free_render(r);
+            return;
+        }
+    }
+
+    for (i = 0; i < pool->nhost; i++) {
+        h = pool->hosts + i;
+        r = h->active;
+
+        if (r != NULL && r->id == id && !r->cancelled) {
+            r->cancelled = TRUE;
+
+            mrp_clear(&msg);
+            msg.type = SRS_HOST_MSG_CANCEL;
+            msg.id   = id;
+
+            send_msg(h, &msg, sizeof(msg));
+            return;
+        }
+    }
+}
+
+
+static void register_pool(srs_voice_host_t *pool)
+{
+    static srs_voice_api_t api = {
+        .render = host_render,
+        .cancel = host_cancel
+    };
+
+    if (srs_register_voice(pool->srs, pool->engine, &api, pool, pool->actors,
+                           pool->nactor, &pool->notify,
+                           &pool->notify_data) < 0) {
+        mrp_log_error("%s: failed to register voice backend.", pool->engine);
+        return;
+    }
+
+    pool->registered = TRUE;
+}
+
+
+srs_voice_host_t *srs_voice_host_create(srs_context_t *srs,
+                                        const char *engine,
+                                        const char *path, int nhost)
+{
+    srs_voice_host_t *pool;
+    srs_cfg_t        *cfg;
+    char              prefix[128];
+    int               ncfg, i, nstarted;
+
+    if (nhost <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if ((pool = mrp_allocz(sizeof(*pool))) == NULL)
+        return NULL;
+
+    mrp_list_init(&pool->pending);
+    pool->srs    = srs;
+    pool->engine = mrp_strdup(engine);
+    pool->path   = mrp_strdup(path);
+    pool->hosts  = mrp_allocz_array(host_t, nhost);
+
+    if (!pool->engine || !pool->path || !pool->hosts)
+        goto fail;
+
+    /* pass on the configuration of the engine on the command line */
+    snprintf(prefix, sizeof(prefix), "%s.", engine);
+    ncfg = srs_config_collect(srs->settings, prefix, &cfg);
+
+    if ((pool->argv = mrp_allocz_array(char *, ncfg + 2)) == NULL)
+        goto fail;
+
+    pool->argv[0] = mrp_strdup(path);
+
+    for (i = 0; i < ncfg; i++) {
+        pool->argv[i + 1] = mrp_allocz(strlen(cfg[i].key) +
+                                       strlen(cfg[i].value) + 2);
+
+        if (pool->argv[i + 1] == NULL)
+            break;
+
+        sprintf(pool->argv[i + 1], "%s=%s", cfg[i].key, cfg[i].value);
+    }
+
+    if (ncfg > 0)
+        srs_config_free(cfg);
+
+    if (pool->argv[0] == NULL || i < ncfg)
+        goto fail;
+
+    for (i = nstarted = 0; i < nhost; i++) {
+        pool->hosts[i].pool = pool;
+        pool->hosts[i].idx  = i;
+        pool->hosts[i].fd   = -1;
+        pool->nhost++;
+
+        if (start_host(pool->hosts + i) == 0)
+            nstarted++;
+    }
+
+    if (nstarted == 0)
+        goto fail;
+
+    mrp_log_info("%s: started %d synthesizer hosts.", engine, nstarted);
+
+    return pool;
+
+ fail:
+    srs_voice_host_destroy(pool);
+    return NULL;
+}
+
+
+void srs_voice_host_destroy(srs_voice_host_t *pool)
+{
+    mrp_list_hook_t *p, *n;
+    render_t        *r;
+    int              i;
+
+    if (pool == NULL)
+        return;
+
+    if (pool->registered)
+        srs_unregister_voice(pool->srs, pool->engine);
+
+    for (i = 0; i < pool->nhost; i++) {
+        stop_host(pool->hosts + i);
+
+        if ((r = pool->hosts[i].active) != NULL) {
+            srs_stop_stream(pool->srs->pulse, r->id, FALSE, FALSE);
+            free_render(r);
+        }
+    }
+
+    mrp_list_foreach(&pool->pending, p, n) {
+        r = mrp_list_entry(p, render_t, hook);
+        srs_stop_stream(pool->srs->pulse, r->id, FALSE, FALSE);
+        free_render(r);
+    }
+
+    for (i = 0; i < pool->nactor; i++) {
+        mrp_free(pool->actors[i].name);
+        mrp_free(pool->actors[i].lang);
+        mrp_free(pool->actors[i].dialect);
+        mrp_free(pool->actors[i].description);
+    }
+
+    for (i = 0; pool->argv != NULL && pool->argv[i] != NULL; i++)
+        mrp_free(pool->argv[i]);
+
+    mrp_free(pool->argv);
+    mrp_free(pool->actors);
+    mrp_free(pool->hosts);
+    mrp_free(pool->engine);
+    mrp_free(pool->path);
+    mrp_free(pool);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_VOICE_HOST_H__
+#define __SRS_DAEMON_VOICE_HOST_H__
+
+#include "srs/daemon/context.h"
+
+/*
+ * synthesizer host pool
+ *
+ * A pool of synthesizer host processes running the same voice engine.
+ * The pool registers itself as a voice backend named after the engine
+ * once the first host is up and dispatches renderings to idle hosts,
+ * so that engines which can only synthesize one message at a time, and
+ * only from a single thread, can render ahead (voice.synthesize-ahead)
+ * and prerender while another message is being synthesized. Messages
+ * are passed to a host a segment at a time (see srs_segment_voice).
+ * Crashed hosts are restarted and their ongoing rendering is aborted.
+ */
+
+typedef struct srs_voice_host_s srs_voice_host_t;
+
+/** Start a pool of nhost hosts for engine using the given executable. */
+srs_voice_host_t *srs_voice_host_create(srs_context_t *srs,
+                                        const char *engine,
+                                        const char *path, int nhost);
+
+/** Stop all hosts of the given pool. */
+void srs_voice_host_destroy(srs_voice_host_t *h);
+
+#endif /* __SRS_DAEMON_VOICE_HOST_H__ */
@@ -27,18 +27,57 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
 
 #include <murphy/common/macros.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/list.h>
+#include <murphy/common/hashtbl.h>
 
 #include "srs/daemon/context.h"
+#include "srs/daemon/config.h"
 #include "srs/daemon/voice.h"
+#include "srs/daemon/pulse.h"
+#include "srs/daemon/voice-cache.h"
+#include "srs/daemon/voice-host.h"
+
+#define CONFIG_BARGE_IN   "voice.barge-in"
+#define CONFIG_CACHE_SIZE "voice.cache.size"
+#define CONFIG_CACHE_DIR  "voice.cache.dir"
+#define CONFIG_PRERENDER  "voice.prerender."
+#define CONFIG_FEEDBACK   "feedback.tts."
+#define CONFIG_FB_VOICE   "feedback.voice"
+#define CONFIG_HOST       "voice.host."
+#define CONFIG_HOST_DIR   "voice.host-dir"
+#define CONFIG_PREEMPT    "voice.preempt"
+#define CONFIG_DUCKING    "voice.duck-volume"
+#define CONFIG_AHEAD      "voice.synthesize-ahead"
+
+#ifndef SRS_VOICE_HOST_DIR
+#    define SRS_VOICE_HOST_DIR "/usr/libexec/srs"
+#endif
+
+#define PRERENDER_DELAY   2000           /* start pre-rendering after this */
+#define AHEAD_MAX         8              /* max. requests to synthesize ahead */
+
+#define SEGMENT_CLAUSE  80               /* split at clauses beyond this */
+#define SEGMENT_MAX     240              /* split at spaces beyond this */
 
 typedef struct state_s state_t;
+typedef struct ahead_s ahead_t;
+
+#define NPRIORITY SRS_VOICE_PRIORITY_MAX
+
+typedef enum {
+    PREEMPT_CANCEL,                      /* abort preempted requests */
+    PREEMPT_DUCK,                        /* duck preempted requests */
+} preempt_t;
 
 /*
  * a speech synthesizer backend
@@ -86,19 +125,43 @@ typedef struct {
 } actor_t;
 
 
+/*
+ * owner (client) of queued rendering requests
+ *
+ * Queued requests are kept in per-owner FIFOs, one for each priority.
+ * Owners with requests of a given priority take turns in a ring, so a
+ * chatty client can't starve others of the same priority.
+ */
+
+typedef struct {
+    char               *id;              /* owner id */
+    mrp_list_hook_t     queue[NPRIORITY];/* queued requests by priority */
+    mrp_list_hook_t     turn[NPRIORITY]; /* to ring of owners by priority */
+    int                 nqueued;         /* number of queued requests */
+} owner_t;
+
+
 /*
  * ative and queued rendering requests
  */
 
 typedef struct {
     uint32_t            id;              /* request id */
+    int                 priority;        /* request priority */
+    owner_t            *owner;           /* owner, while queued */
+    uint64_t            queued;          /* time of queuing (msec) */
     renderer_t         *r;               /* rendering backend */
     uint32_t            vid;             /* backend id */
     int                 notify_mask;     /* notification event mask */
     srs_voice_notify_t  notify;          /* notification callback */
     void               *notify_data;     /* opaque notification data */
     mrp_timer_t        *timer;           /* request timeout timer */
-    mrp_list_hook_t     hook;            /* hook to list of requests */
+    mrp_list_hook_t     hook;            /* hook to owner queue */
+    int                 cached;          /* playing cached/ahead audio */
+    struct {                             /* last known rendering progress */
+        double          pcnt;            /* in percentages */
+        uint32_t        msec;            /* in milliseconds */
+    } progress;
 } request_t;
 
 
@@ -110,6 +173,7 @@ typedef struct {
     double              rate;            /* synthesis rate (1 = normal) */
     double              pitch;           /* synthesis pitch (1 = default) */
     int                 timeout;         /* timeout */
+    ahead_t            *ahead;           /* audio synthesized ahead */
 } queued_t;
 
 
@@ -118,18 +182,76 @@ typedef struct {
  */
 
 struct state_s {
+    srs_context_t   *srs;                /* main context */
     mrp_list_hook_t  synthesizers;       /* registered synthesizers */
     int              nsynthesizer;       /* number of synthesizers */
     mrp_list_hook_t  languages;          /* list of supported languages */
     uint32_t         nextid;             /* next voice id */
-    mrp_list_hook_t  requests;           /* request queue */
+    mrp_htbl_t      *requests;           /* queued requests by id */
+    mrp_htbl_t      *owners;             /* request owners by id */
+    mrp_list_hook_t  turns[NPRIORITY];   /* owners taking turns, by prio */
+    int              nqueued[NPRIORITY]; /* queued requests, by prio */
+    srs_voice_stats_t stats[NPRIORITY];  /* queuing statistics, by prio */
     request_t       *active;             /* active request */
+    request_t       *ducked;             /* request ducked by active one */
+    preempt_t        preempt;            /* preemption mode */
+    double           ducking;            /* ducked volume */
     request_t       *cancelling;         /* request being cancelled */
+    int              ahead;              /* requests to synthesize ahead */
+    srs_voice_barge_in_t barge_in;       /* barge-in mode */
+    srs_voice_cache_t *cache;            /* rendered audio cache */
+    mrp_list_hook_t  prerender;          /* prompts to pre-render */
+    uint32_t         prerendering;       /* prompt being pre-rendered */
+    mrp_timer_t     *prerender_timer;    /* timer to pre-render next */
+    srs_voice_host_t **hosts;            /* synthesizer host pools */
+    int              nhost;              /* number of host pools */
+};
+
+
+/*
+ * audio being captured for the cache
+ */
+
+typedef struct {
+    srs_voice_cache_t *cache;            /* cache to add to */
+    char              *key;              /* cache key */
+    state_t           *state;            /* state, if pre-rendering */
+} capture_t;
+
+
+/*
+ * audio of a queued request synthesized ahead of its turn
+ */
+
+struct ahead_s {
+    queued_t          *qr;               /* request, NULL once gone */
+    state_t           *state;            /* our state */
+    char              *key;              /* cache key, if caching */
+    uint32_t           vid;              /* silent stream, while rendering */
+    void              *samples;          /* audio, once rendered */
+    int                rate;             /* sample rate */
+    int                nchannel;         /* number of channels */
+    uint32_t           nsample;          /* number of samples */
 };
 
 
+/*
+ * a prompt to pre-render
+ */
+
+typedef struct {
+    mrp_list_hook_t  hook;               /* to list of prompts */
+    char            *voice;              /* voice to render with */
+    char            *msg;                /* message to render */
+    double           rate;               /* synthesis rate */
+    double           pitch;              /* synthesis pitch */
+} prompt_t;
+
+
 static request_t *find_request(state_t *state, uint32_t rid, uint32_t vid);
 static request_t *activate_next(state_t *state);
+static void schedule_prerender(state_t *state, int delay);
+static void load_prompts(state_t *state);
 
 
 static language_t *find_language(state_t *state, const char *lang, int create)
@@ -363,6 +485,22 @@ static void notify_request(request_t *req, srs_voice_event_t *event)
 }
 
 
+static void resume_ducked(state_t *state)
+{
+    request_t *req = state->ducked;
+
+    /* bring back any ducked request, then see what else is waiting */
+    if (req != NULL && state->active == NULL) {
+        mrp_log_info("Resuming ducked voice request #%u.", req->id);
+        srs_set_stream_volume(state->srs->pulse, req->vid, 1.0);
+        state->ducked = NULL;
+        state->active = req;
+    }
+
+    activate_next(state);
+}
+
+
 static void voice_notify_cb(srs_voice_event_t *event, void *notify_data)
 {
     renderer_t        *r     = (renderer_t *)notify_data;
@@ -382,21 +520,329 @@ static void voice_notify_cb(srs_voice_event_t *event, void *notify_data)
         req->timer = NULL;
     }
 
+    if (event->type == SRS_VOICE_EVENT_PROGRESS ||
+        event->type == SRS_VOICE_EVENT_COMPLETED) {
+        req->progress.pcnt = event->data.progress.pcnt;
+        req->progress.msec = event->data.progress.msec;
+    }
+
     notify_request(req, event);
 
     if (mask & SRS_VOICE_MASK_DONE) {
         mrp_del_timer(req->timer);
         req->timer = NULL;
-        if (state->cancelling != req) {
-            mrp_list_delete(&req->hook);
-            mrp_free(req);
-        }
+
+        /* requests being cancelled are taken care of by the canceller */
+        if (state->cancelling == req)
+            return;
+
+        if (state->ducked == req)
+            state->ducked = NULL;
 
         if (state->active == req) {
             state->active = NULL;
-            activate_next(state);
+            mrp_free(req);
+            resume_ducked(state);
+        }
+        else
+            mrp_free(req);
+    }
+}
+
+
+static srs_voice_barge_in_t barge_in_mode(srs_context_t *srs)
+{
+    const char *mode;
+
+    mode = srs_config_get_string(srs->settings, CONFIG_BARGE_IN, "off");
+
+    if (!strcmp(mode, "speech")) {
+        mrp_log_info("Voice barge-in enabled on speech onset.");
+        return SRS_VOICE_BARGE_IN_SPEECH;
+    }
+
+    if (!strcmp(mode, "command")) {
+        mrp_log_info("Voice barge-in enabled on command match.");
+        return SRS_VOICE_BARGE_IN_COMMAND;
+    }
+
+    if (strcmp(mode, "off"))
+        mrp_log_error("Invalid voice barge-in mode '%s', disabling.", mode);
+
+    return SRS_VOICE_BARGE_IN_OFF;
+}
+
+
+static srs_voice_cache_t *create_cache(srs_context_t *srs)
+{
+    const char *dir;
+    int         size;
+
+    size = srs_config_get_int32(srs->settings, CONFIG_CACHE_SIZE, 4096);
+    dir  = srs_config_get_string(srs->settings, CONFIG_CACHE_DIR, NULL);
+
+    if (size <= 0) {
+        mrp_log_info("Voice cache disabled.");
+        return NULL;
+    }
+
+    return srs_voice_cache_create(srs, (size_t)size * 1024, dir);
+}
+
+
+static int backend_mask(state_t *state, int notify_mask)
+{
+    /*
+     * With barge-in enabled we always track rendering progress so that
+     * we can tell the owner of an interrupted request how far it got.
+     */
+    if (state->barge_in != SRS_VOICE_BARGE_IN_OFF)
+        notify_mask |= SRS_VOICE_MASK_PROGRESS;
+
+    return notify_mask;
+}
+
+
+static preempt_t preempt_mode(srs_context_t *srs, double *ducking)
+{
+    const char *mode;
+    int         volume;
+
+    mode   = srs_config_get_string(srs->settings, CONFIG_PREEMPT, "cancel");
+    volume = srs_config_get_int32(srs->settings, CONFIG_DUCKING, 30);
+
+    *ducking = (volume < 0 ? 0 : (volume > 100 ? 100 : volume)) / 100.0;
+
+    if (!strcmp(mode, "duck")) {
+        mrp_log_info("Urgent voice requests duck others to %d%%.", volume);
+        return PREEMPT_DUCK;
+    }
+
+    if (strcmp(mode, "cancel"))
+        mrp_log_error("Invalid voice preemption mode '%s', cancelling.",
+                      mode);
+
+    return PREEMPT_CANCEL;
+}
+
+
+static uint32_t id_hash(const void *key)
+{
+    return (uint32_t)(ptrdiff_t)key;
+}
+
+
+static int id_comp(const void *key1, const void *key2)
+{
+    return (ptrdiff_t)key1 != (ptrdiff_t)key2;
+}
+
+
+static int create_queues(state_t *state)
+{
+    mrp_htbl_config_t hcfg;
+    int               i;
+
+    mrp_clear(&hcfg);
+    hcfg.nentry  = 64;
+    hcfg.comp    = id_comp;
+    hcfg.hash    = id_hash;
+    hcfg.nbucket = hcfg.nentry;
+
+    if ((state->requests = mrp_htbl_create(&hcfg)) == NULL)
+        return -1;
+
+    hcfg.nentry  = 16;
+    hcfg.comp    = mrp_string_comp;
+    hcfg.hash    = mrp_string_hash;
+    hcfg.nbucket = hcfg.nentry;
+
+    if ((state->owners = mrp_htbl_create(&hcfg)) == NULL) {
+        mrp_htbl_destroy(state->requests, FALSE);
+        return -1;
+    }
+
+    for (i = 0; i < NPRIORITY; i++)
+        mrp_list_init(&state->turns[i]);
+
+    return 0;
+}
+
+
+static uint64_t now_msec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+static owner_t *get_owner(state_t *state, const char *id)
+{
+    owner_t *o;
+    int      i;
+
+    if ((o = mrp_htbl_lookup(state->owners, (void *)id)) != NULL)
+        return o;
+
+    if ((o = mrp_allocz(sizeof(*o))) == NULL)
+        return NULL;
+
+    for (i = 0; i < NPRIORITY; i++) {
+        mrp_list_init(&o->queue[i]);
+        mrp_list_init(&o->turn[i]);
+    }
+
+    if ((o->id = mrp_strdup(id)) == NULL ||
+        !mrp_htbl_insert(state->owners, o->id, o)) {
+        mrp_free(o->id);
+        mrp_free(o);
+        return NULL;
+    }
+
+    return o;
+}
+
+
+static int queue_request(state_t *state, request_t *req, const char *owner)
+{
+    owner_t *o;
+    int      prio = req->priority;
+
+    if ((o = get_owner(state, owner ? owner : "")) == NULL)
+        return -1;
+
+    if (!mrp_htbl_insert(state->requests, (void *)(ptrdiff_t)req->id, req)) {
+        if (o->nqueued == 0) {
+            mrp_htbl_remove(state->owners, o->id, FALSE);
+            mrp_free(o->id);
+            mrp_free(o);
         }
+        return -1;
+    }
+
+    /* an owner with nothing queued yet at this priority joins the ring */
+    if (mrp_list_empty(&o->queue[prio]))
+        mrp_list_append(&state->turns[prio], &o->turn[prio]);
+
+    mrp_list_append(&o->queue[prio], &req->hook);
+    o->nqueued++;
+    state->nqueued[prio]++;
+
+    req->owner  = o;
+    req->queued = now_msec();
+
+    return 0;
+}
+
+
+static void unqueue_request(state_t *state, request_t *req)
+{
+    owner_t *o    = req->owner;
+    int      prio = req->priority;
+
+    if (o == NULL)
+        return;
+
+    mrp_htbl_remove(state->requests, (void *)(ptrdiff_t)req->id, FALSE);
+    mrp_list_delete(&req->hook);
+    req->owner = NULL;
+    state->nqueued[prio]--;
+
+    if (mrp_list_empty(&o->queue[prio]))
+        mrp_list_delete(&o->turn[prio]);
+
+    if (--o->nqueued == 0) {
+        mrp_htbl_remove(state->owners, o->id, FALSE);
+        mrp_free(o->id);
+        mrp_free(o);
+    }
+}
+
+
+static int top_priority(state_t *state)
+{
+    int prio;
+
+    for (prio = NPRIORITY - 1; prio >= 0; prio--)
+        if (state->nqueued[prio] > 0)
+            return prio;
+
+    return -1;
+}
+
+
+static request_t *dequeue_request(state_t *state)
+{
+    request_t *req;
+    owner_t   *o;
+    int        prio;
+    uint32_t   wait;
+
+    if ((prio = top_priority(state)) < 0)
+        return NULL;
+
+    /* serve the owner in turn, then send it to the end of the ring */
+    o   = mrp_list_entry(state->turns[prio].next, owner_t, turn[prio]);
+    req = mrp_list_entry(o->queue[prio].next, request_t, hook);
+
+    mrp_list_delete(&o->turn[prio]);
+    mrp_list_append(&state->turns[prio], &o->turn[prio]);
+
+    wait = (uint32_t)(now_msec() - req->queued);
+    unqueue_request(state, req);
+
+    state->stats[prio].nrequest++;
+    state->stats[prio].wait += wait;
+    if (wait > state->stats[prio].max)
+        state->stats[prio].max = wait;
+
+    mrp_debug("voice request #%u (priority %d) waited %u msec", req->id,
+              prio, wait);
+
+    return req;
+}
+
+
+static state_t *get_state(srs_context_t *srs)
+{
+    state_t *state = (state_t *)srs->synthesizer;
+
+    if (state != NULL)
+        return state;
+
+    srs->synthesizer = state = mrp_allocz(sizeof(*state));
+
+    if (state == NULL)
+        return NULL;
+
+    if (create_queues(state) < 0) {
+        mrp_free(state);
+        srs->synthesizer = NULL;
+        return NULL;
     }
+
+    mrp_list_init(&state->synthesizers);
+    mrp_list_init(&state->languages);
+    mrp_list_init(&state->prerender);
+    state->srs          = srs;
+    state->nextid       = 1;
+    state->barge_in     = barge_in_mode(srs);
+    state->preempt      = preempt_mode(srs, &state->ducking);
+    state->cache        = create_cache(srs);
+    state->prerendering = SRS_VOICE_INVALID;
+    state->ahead        = srs_config_get_int32(srs->settings, CONFIG_AHEAD, 2);
+
+    if (state->ahead < 0)
+        state->ahead = 0;
+    if (state->ahead > AHEAD_MAX)
+        state->ahead = AHEAD_MAX;
+
+    load_prompts(state);
+
+    return state;
 }
 
 
@@ -405,21 +851,12 @@ int srs_register_voice(srs_context_t *srs, const char *name,
                        srs_voice_actor_t *actors, int nactor,
                        srs_voice_notify_t *notify, void **notify_data)
 {
-    state_t           *state = (state_t *)srs->synthesizer;
+    state_t           *state = get_state(srs);
     renderer_t        *r;
     int                i;
 
-    if (state == NULL) {
-        srs->synthesizer = state = mrp_allocz(sizeof(*state));
-
-        if (state == NULL)
-            return -1;
-
-        mrp_list_init(&state->synthesizers);
-        mrp_list_init(&state->languages);
-        mrp_list_init(&state->requests);
-        state->nextid = 1;
-    }
+    if (state == NULL)
+        return -1;
 
     if (api == NULL || name == NULL || actors == NULL || nactor < 1) {
         errno = EINVAL;
@@ -481,6 +918,103 @@ void srs_unregister_voice(srs_context_t *srs, const char *name)
 }
 
 
+int srs_start_voice_hosts(srs_context_t *srs)
+{
+    state_t          *state = get_state(srs);
+    srs_cfg_t        *cfg;
+    srs_voice_host_t *h;
+    const char       *dir, *engine;
+    char              path[PATH_MAX];
+    int               ncfg, i, n, status;
+
+    if (state == NULL)
+        return -1;
+
+    dir    = srs_config_get_string(srs->settings, CONFIG_HOST_DIR,
+                                   SRS_VOICE_HOST_DIR);
+    ncfg   = srs_config_collect(srs->settings, CONFIG_HOST, &cfg);
+    status = 0;
+
+    for (i = 0; i < ncfg; i++) {
+        engine = cfg[i].key + sizeof(CONFIG_HOST) - 1;
+        n      = (int)strtol(cfg[i].value, NULL, 10);
+
+        if (n <= 0)
+            continue;
+
+        snprintf(path, sizeof(path), "%s/srs-%s-host", dir, engine);
+
+        if (!mrp_reallocz(state->hosts, state->nhost, state->nhost + 1)) {
+            status = -1;
+            break;
+        }
+
+        if ((h = srs_voice_host_create(srs, engine, path, n)) == NULL) {
+            mrp_log_error("Failed to start %d %s synthesizer hosts (%s).",
+                          n, engine, path);
+            status = -1;
+            continue;
+        }
+
+        state->hosts[state->nhost++] = h;
+    }
+
+    if (ncfg > 0)
+        srs_config_free(cfg);
+
+    return status;
+}
+
+
+void srs_stop_voice_hosts(srs_context_t *srs)
+{
+    state_t *state = (state_t *)srs->synthesizer;
+    int      i;
+
+    if (state == NULL)
+        return;
+
+    for (i = 0; i < state->nhost; i++)
+        srs_voice_host_destroy(state->hosts[i]);
+
+    mrp_free(state->hosts);
+    state->hosts = NULL;
+    state->nhost = 0;
+}
+
+
+void srs_cleanup_voice(srs_context_t *srs)
+{
+    static const char *names[NPRIORITY] = {
+        "low", "normal", "high", "urgent"
+    };
+    state_t           *state = (state_t *)srs->synthesizer;
+    srs_voice_stats_t  stats;
+    int                prio;
+
+    if (state == NULL)
+        return;
+
+    for (prio = 0; prio < NPRIORITY; prio++) {
+        if (srs_voice_stats(srs, prio, &stats) < 0 || !stats.nrequest)
+            continue;
+
+        mrp_log_info("Voice priority %s: %u requests, %llu msec average "
+                     "and %u msec max. wait, %u preempted.", names[prio],
+                     stats.nrequest,
+                     (unsigned long long)(stats.wait / stats.nrequest),
+                     stats.max, stats.npreempted);
+    }
+
+    mrp_del_timer(state->prerender_timer);
+    state->prerender_timer = NULL;
+
+    /* audio still being played is freed once its stream is gone */
+    srs_voice_cache_destroy(state->cache);
+    state->cache = NULL;
+}
+
+
 static renderer_t *find_renderer(state_t *state, const char *voice,
                                  uint32_t *actor)
 {
@@ -654,46 +1188,221 @@ static char **copy_tags(char **tags)
 }
 
 
-static void request_timer_cb(mrp_timer_t *t, void *user_data)
+static void ahead_capture_cb(srs_pulse_t *p, void *samples, int sample_rate,
+                             int nchannel, uint32_t nsample, void *user_data)
 {
-    queued_t          *qr  = (queued_t *)user_data;
-    request_t         *req = &qr->req;
-    srs_voice_event_t  event;
+    ahead_t  *a  = (ahead_t *)user_data;
+    queued_t *qr = a->qr;
 
-    MRP_UNUSED(t);
+    MRP_UNUSED(p);
 
-    mrp_log_info("Voice/TTS request #%u timed out.", qr->req.id);
+    a->vid = SRS_VOICE_INVALID;
 
-    mrp_del_timer(req->timer);
-    req->timer = NULL;
+    if (qr == NULL) {                    /* request gone meanwhile */
+        mrp_free(a->key);
+        mrp_free(a);
+        return;
+    }
 
-    mrp_clear(&event);
-    event.type = SRS_VOICE_EVENT_TIMEOUT;
-    event.id   = req->id;
+    /* without audio the request is rendered the usual way once active */
+    if (samples == NULL || nsample == 0) {
+        mrp_log_error("Failed to synthesize voice request #%u ahead.",
+                      qr->req.id);
+        return;
+    }
 
-    notify_request(req, &event);
+    a->samples = mrp_datadup(samples, 2 * (size_t)nsample * nchannel);
 
-    mrp_list_delete(&req->hook);
+    if (a->samples == NULL)
+        return;
 
-    mrp_free(qr->msg);
-    free_tags(qr->tags);
+    a->rate     = sample_rate;
+    a->nchannel = nchannel;
+    a->nsample  = nsample;
 
-    mrp_free(qr);
+    if (a->key != NULL)
+        srs_voice_cache_insert(a->state->cache, a->key, samples, sample_rate,
+                               nchannel, nsample, FALSE);
+
+    mrp_debug("voice request #%u synthesized ahead", qr->req.id);
 }
 
 
-static request_t *enqueue_request(state_t *state, const char *msg, char **tags,
-                                  renderer_t *r, uint32_t actor, double rate,
-                                  double pitch, int timeout, int notify_mask,
-                                  srs_voice_notify_t notify, void *notify_data)
+static void drop_ahead(state_t *state, queued_t *qr)
 {
-    queued_t *qr = NULL;
-
-    MRP_UNUSED(rate);
-    MRP_UNUSED(pitch);
-    MRP_UNUSED(timeout);
+    renderer_t *r = qr->req.r;
+    ahead_t    *a = qr->ahead;
 
-    qr = mrp_allocz(sizeof(*qr));
+    MRP_UNUSED(state);
+
+    if (a == NULL)
+        return;
+
+    qr->ahead = NULL;
+
+    /*
+     * Have the backend stop synthesizing a rendering in progress. This
+     * also stops its stream and the capture callback frees it.
+     */
+    if (a->vid != SRS_VOICE_INVALID) {
+        a->qr = NULL;
+        r->api.cancel(a->vid, r->api_data);
+    }
+    else {
+        mrp_free(a->samples);
+        mrp_free(a->key);
+        mrp_free(a);
+    }
+}
+
+
+static int peek_queue(state_t *state, queued_t **reqs, int max)
+{
+    mrp_list_hook_t *op, *on, *rp, *rn;
+    owner_t         *o;
+    int              prio, round, found, i, n;
+
+    /* list queued requests in the order dequeue_request would take them */
+    n = 0;
+    for (prio = NPRIORITY - 1; prio >= 0 && n < max; prio--) {
+        for (round = 0, found = TRUE; found && n < max; round++) {
+            found = FALSE;
+
+            mrp_list_foreach(&state->turns[prio], op, on) {
+                o = mrp_list_entry(op, owner_t, turn[prio]);
+                i = 0;
+
+                mrp_list_foreach(&o->queue[prio], rp, rn) {
+                    if (i++ == round) {
+                        reqs[n++] = (queued_t *)mrp_list_entry(rp, request_t,
+                                                               hook);
+                        found = TRUE;
+                        break;
+                    }
+                }
+
+                if (n >= max)
+                    break;
+            }
+        }
+    }
+
+    return n;
+}
+
+
+static int start_ahead(state_t *state, queued_t *qr)
+{
+    static char *tags[] = { SRS_STREAM_TAG_SILENT, NULL };
+
+    renderer_t      *r = qr->req.r;
+    srs_voice_pcm_t *pcm;
+    ahead_t         *a;
+
+    if ((a = mrp_allocz(sizeof(*a))) == NULL)
+        return -1;
+
+    a->qr    = qr;
+    a->state = state;
+
+    /* cached audio is played right away anyway, see render_message */
+    if (state->cache != NULL) {
+        a->key = srs_voice_cache_key(r->name, qr->actor, qr->rate, qr->pitch,
+                                     qr->msg);
+
+        if (a->key != NULL &&
+            (pcm = srs_voice_cache_lookup(state->cache, a->key)) != NULL) {
+            srs_voice_pcm_unref(pcm);
+            goto fail;
+        }
+    }
+
+    a->vid = r->api.render(qr->msg, tags, qr->actor, qr->rate, qr->pitch, 0,
+                           r->api_data);
+
+    if (a->vid == SRS_VOICE_INVALID)
+        goto fail;
+
+    qr->ahead = a;
+
+    if (srs_capture_stream(state->srs->pulse, a->vid, ahead_capture_cb,
+                           a) < 0) {
+        qr->ahead = NULL;
+        r->api.cancel(a->vid, r->api_data);
+        goto fail;
+    }
+
+    mrp_debug("synthesizing voice request #%u ahead", qr->req.id);
+
+    return 0;
+
+ fail:
+    mrp_free(a->key);
+    mrp_free(a);
+    return -1;
+}
+
+
+static void synthesize_ahead(state_t *state)
+{
+    queued_t *reqs[AHEAD_MAX];
+    int       n, i;
+
+    /*
+     * While a request is playing, synthesize the ones next in line into
+     * silent streams and hold on to their audio, so that they can start
+     * playing as soon as it is their turn.
+     */
+
+    if (state->active == NULL && state->ducked == NULL)
+        return;
+
+    n = peek_queue(state, reqs, state->ahead);
+
+    for (i = 0; i < n; i++)
+        if (reqs[i]->ahead == NULL)
+            start_ahead(state, reqs[i]);
+}
+
+
+static void request_timer_cb(mrp_timer_t *t, void *user_data)
+{
+    queued_t          *qr  = (queued_t *)user_data;
+    request_t         *req = &qr->req;
+    srs_voice_event_t  event;
+
+    MRP_UNUSED(t);
+
+    mrp_log_info("Voice/TTS request #%u timed out.", qr->req.id);
+
+    mrp_del_timer(req->timer);
+    req->timer = NULL;
+
+    mrp_clear(&event);
+    event.type = SRS_VOICE_EVENT_TIMEOUT;
+    event.id   = req->id;
+
+    notify_request(req, &event);
+
+    unqueue_request(req->r->state, req);
+    drop_ahead(req->r->state, qr);
+
+    mrp_free(qr->msg);
+    free_tags(qr->tags);
+
+    mrp_free(qr);
+}
+
+
+static request_t *enqueue_request(state_t *state, const char *msg, char **tags,
+                                  renderer_t *r, uint32_t actor, double rate,
+                                  double pitch, int timeout, int priority,
+                                  const char *owner, int notify_mask,
+                                  srs_voice_notify_t notify, void *notify_data)
+{
+    queued_t *qr = NULL;
+
+    qr = mrp_allocz(sizeof(*qr));
 
     if (qr == NULL)
         return NULL;
@@ -701,6 +1410,7 @@ static request_t *enqueue_request(state_t *state, const char *msg, char **tags,
     mrp_list_init(&qr->req.hook);
 
     qr->req.id          = state->nextid++;
+    qr->req.priority    = priority;
     qr->req.r           = r;
     qr->req.vid         = SRS_VOICE_INVALID;
     qr->req.notify_mask = notify_mask;
@@ -710,11 +1420,12 @@ static request_t *enqueue_request(state_t *state, const char *msg, char **tags,
     qr->msg     = mrp_strdup(msg);
     qr->tags    = copy_tags(tags);
     qr->actor   = actor;
+    qr->rate    = rate;
+    qr->pitch   = pitch;
     qr->timeout = timeout;
 
-    if (qr->msg != NULL && (qr->tags != NULL || tags == NULL)) {
-        mrp_list_append(&state->requests, &qr->req.hook);
-
+    if (qr->msg != NULL && (qr->tags != NULL || tags == NULL) &&
+        queue_request(state, &qr->req, owner) == 0) {
         if (timeout > 0)
             qr->req.timer = mrp_add_timer(r->srs->ml, timeout,
                                           request_timer_cb, qr);
@@ -731,65 +1442,275 @@ static request_t *enqueue_request(state_t *state, const char *msg, char **tags,
 }
 
 
-static request_t *activate_next(state_t *state)
+static void cache_stream_cb(srs_pulse_t *p, srs_stream_event_t *event,
+                            void *user_data)
 {
-    queued_t        *qr;
-    renderer_t      *r;
-    mrp_list_hook_t *p, *n;
+    MRP_UNUSED(p);
 
-    if (state->active != NULL)
-        return NULL;
+    voice_notify_cb(event, user_data);
+}
 
-    qr = NULL;
-    mrp_list_foreach(&state->requests, p, n) {
-        mrp_list_delete(p);
-        qr = mrp_list_entry(p, typeof(*qr), req.hook);
-        break;
-    }
 
-    if (qr == NULL)
-        return NULL;
+static void cache_release_cb(void *release_data)
+{
+    srs_voice_pcm_unref((srs_voice_pcm_t *)release_data);
+}
 
-    mrp_del_timer(qr->req.timer);
-    qr->req.timer = NULL;
 
-    r = qr->req.r;
-    qr->req.vid = r->api.render(qr->msg, qr->tags, qr->actor, qr->rate,
-                                qr->pitch, qr->req.notify_mask, r->api_data);
+static void cache_capture_cb(srs_pulse_t *p, void *samples, int sample_rate,
+                             int nchannel, uint32_t nsample, void *user_data)
+{
+    capture_t *c = (capture_t *)user_data;
 
-    mrp_free(qr->msg);
-    qr->msg = NULL;
-    free_tags(qr->tags);
-    qr->tags = NULL;
+    MRP_UNUSED(p);
 
-    if (qr->req.vid == SRS_VOICE_INVALID) {
-        if (qr->req.notify != NULL &&
-            (qr->req.notify_mask & 1 << SRS_VOICE_EVENT_ABORTED)) {
-            srs_voice_event_t e;
+    if (samples != NULL)
+        srs_voice_cache_insert(c->cache, c->key, samples, sample_rate,
+                               nchannel, nsample, c->state != NULL);
 
-            mrp_clear(&e);
-            e.type = SRS_VOICE_EVENT_ABORTED;
-            e.id   = qr->req.id;
+    if (c->state != NULL) {
+        if (samples == NULL)
+            mrp_log_error("Failed to pre-render voice prompt '%s'.", c->key);
 
-            voice_notify_cb(&e, qr->req.notify_data);
+        c->state->prerendering = SRS_VOICE_INVALID;
+        schedule_prerender(c->state, 0);
+    }
+
+    mrp_free(c->key);
+    mrp_free(c);
+}
 
-            free(qr);
+
+static uint32_t render_message(state_t *state, request_t *req, const char *msg,
+                               char **tags, uint32_t actor, double rate,
+                               double pitch, int notify_mask)
+{
+    renderer_t      *r     = req->r;
+    srs_pulse_t     *pulse = r->srs->pulse;
+    srs_voice_pcm_t *pcm;
+    capture_t       *c;
+    char            *key;
+    uint32_t         vid;
+
+    notify_mask = backend_mask(state, notify_mask);
+
+    if (state->cache == NULL ||
+        (key = srs_voice_cache_key(r->name, actor, rate, pitch, msg)) == NULL)
+        return r->api.render(msg, tags, actor, rate, pitch, notify_mask,
+                             r->api_data);
+
+    /*
+     * Play cached audio directly, bypassing the backend. Otherwise have
+     * the backend render the message and grab the result from its stream
+     * for the cache once it is complete.
+     */
+
+    if ((pcm = srs_voice_cache_lookup(state->cache, key)) != NULL) {
+        mrp_free(key);
+
+        vid = srs_play_buffer(pulse, pcm->samples, pcm->rate, pcm->nchannel,
+                              pcm->nsample, tags, notify_mask, cache_stream_cb,
+                              r, cache_release_cb, pcm);
+
+        if (vid == 0) {
+            srs_voice_pcm_unref(pcm);
+            return SRS_VOICE_INVALID;
         }
 
-        return NULL;
+        req->cached = TRUE;
+
+        return vid;
+    }
+
+    vid = r->api.render(msg, tags, actor, rate, pitch, notify_mask,
+                        r->api_data);
+
+    if (vid == SRS_VOICE_INVALID || (c = mrp_allocz(sizeof(*c))) == NULL) {
+        mrp_free(key);
+        return vid;
+    }
+
+    c->cache = state->cache;
+    c->key   = key;
+
+    if (srs_capture_stream(pulse, vid, cache_capture_cb, c) < 0) {
+        mrp_free(c->key);
+        mrp_free(c);
+    }
+
+    return vid;
+}
+
+
+static void ahead_release_cb(void *release_data)
+{
+    mrp_free(release_data);
+}
+
+
+static uint32_t play_ahead(state_t *state, queued_t *qr)
+{
+    request_t *req = &qr->req;
+    ahead_t   *a   = qr->ahead;
+    uint32_t   vid;
+
+    if (a == NULL || a->samples == NULL)
+        return SRS_VOICE_INVALID;
+
+    vid = srs_play_buffer(state->srs->pulse, a->samples, a->rate,
+                          a->nchannel, a->nsample, qr->tags,
+                          backend_mask(state, req->notify_mask),
+                          cache_stream_cb, req->r, ahead_release_cb,
+                          a->samples);
+
+    if (vid == 0)
+        return SRS_VOICE_INVALID;
+
+    a->samples  = NULL;                  /* owned by the stream now */
+    req->cached = TRUE;
+
+    return vid;
+}
+
+
+static void cancel_request(state_t *state, request_t *req, int notify)
+{
+    renderer_t        *r = req->r;
+    srs_voice_event_t  event;
+
+    mrp_del_timer(req->timer);
+    req->timer = NULL;
+    state->cancelling = req;
+
+    if (req->vid != SRS_VOICE_INVALID) {
+        if (req->cached)
+            srs_stop_stream(state->srs->pulse, req->vid, FALSE, FALSE);
+        else
+            r->api.cancel(req->vid, r->api_data);
+    }
+
+    if (notify) {
+        mrp_clear(&event);
+        event.type = SRS_VOICE_EVENT_ABORTED;
+        event.id   = req->id;
+        event.data.progress.pcnt = req->progress.pcnt;
+        event.data.progress.msec = req->progress.msec;
+
+        notify_request(req, &event);
+    }
+
+    if (req->owner != NULL) {
+        unqueue_request(state, req);
+        drop_ahead(state, (queued_t *)req);
+        mrp_free(((queued_t *)req)->msg);
+        free_tags(((queued_t *)req)->tags);
+    }
+
+    if (state->active == req)
+        state->active = NULL;
+    if (state->ducked == req)
+        state->ducked = NULL;
+
+    state->cancelling = NULL;
+    mrp_free(req);
+}
+
+
+static int preempt_active(state_t *state)
+{
+    request_t *req = state->active;
+
+    state->stats[req->priority].npreempted++;
+
+    /*
+     * Duck the active request if we can, letting it play on quietly
+     * under the preempting one. Otherwise abort it.
+     */
+
+    if (state->preempt == PREEMPT_DUCK && state->ducked == NULL &&
+        srs_set_stream_volume(state->srs->pulse, req->vid,
+                              state->ducking) == 0) {
+        mrp_log_info("Ducking voice request #%u.", req->id);
+        state->ducked = req;
+        state->active = NULL;
     }
     else {
-        state->active = &qr->req;
+        mrp_log_info("Preempting voice request #%u.", req->id);
+        cancel_request(state, req, TRUE);
+    }
 
-        return &qr->req;
+    return 0;
+}
+
+
+static int preempts(state_t *state, int priority)
+{
+    return state->active != NULL &&
+        priority == SRS_VOICE_PRIORITY_URGENT &&
+        priority > state->active->priority;
+}
+
+
+static request_t *activate_next(state_t *state)
+{
+    queued_t          *qr;
+    request_t         *req;
+    srs_voice_event_t  e;
+
+    if (state->active != NULL) {
+        if (!preempts(state, top_priority(state)))
+            return NULL;
+
+        preempt_active(state);
+    }
+
+    while ((req = dequeue_request(state)) != NULL) {
+        qr = (queued_t *)req;
+
+        mrp_del_timer(req->timer);
+        req->timer = NULL;
+
+        /* play audio synthesized ahead, if we have it all by now */
+        req->vid = play_ahead(state, qr);
+        drop_ahead(state, qr);
+
+        if (req->vid == SRS_VOICE_INVALID)
+            req->vid = render_message(state, req, qr->msg, qr->tags,
+                                      qr->actor, qr->rate, qr->pitch,
+                                      req->notify_mask);
+
+        mrp_free(qr->msg);
+        qr->msg = NULL;
+        free_tags(qr->tags);
+        qr->tags = NULL;
+
+        if (req->vid != SRS_VOICE_INVALID) {
+            state->active = req;
+            synthesize_ahead(state);
+
+            return req;
+        }
+
+        mrp_clear(&e);
+        e.type = SRS_VOICE_EVENT_ABORTED;
+        e.id   = req->id;
+
+        notify_request(req, &e);
+        mrp_free(qr);
     }
+
+    if (state->ducked == NULL)
+        schedule_prerender(state, 0);
+
+    return NULL;
 }
 
 
 request_t *render_request(state_t *state, const char *msg, char **tags,
                           renderer_t *r, uint32_t actor, double rate,
-                          double pitch, int timeout, int notify_mask,
-                          srs_voice_notify_t notify, void *notify_data)
+                          double pitch, int timeout, int priority,
+                          int notify_mask, srs_voice_notify_t notify,
+                          void *notify_data)
 {
     request_t *req = NULL;
 
@@ -801,10 +1722,11 @@ request_t *render_request(state_t *state, const char *msg, char **tags,
         return NULL;
 
     mrp_list_init(&req->hook);
-    req->id  = state->nextid++;
-    req->r   = r;
-    req->vid = r->api.render(msg, tags, actor, rate, pitch,
-                             notify_mask, r->api_data);
+    req->id       = state->nextid++;
+    req->priority = priority;
+    req->r        = r;
+    req->vid      = render_message(state, req, msg, tags, actor, rate, pitch,
+                                   notify_mask);
 
     if (req->vid == SRS_VOICE_INVALID) {
         mrp_free(req);
@@ -816,6 +1738,7 @@ request_t *render_request(state_t *state, const char *msg, char **tags,
     req->notify_data = notify_data;
 
     state->active = req;
+    state->stats[priority].nrequest++;
 
     return req;
 }
@@ -823,7 +1746,8 @@ request_t *render_request(state_t *state, const char *msg, char **tags,
 
 uint32_t srs_render_voice(srs_context_t *srs, const char *msg,
                           char **tags, const char *voice, double rate,
-                          double pitch, int timeout, int notify_mask,
+                          double pitch, int timeout, int priority,
+                          const char *owner, int notify_mask,
                           srs_voice_notify_t notify, void *user_data)
 {
     state_t    *state = (state_t *)srs->synthesizer;
@@ -837,6 +1761,12 @@ uint32_t srs_render_voice(srs_context_t *srs, const char *msg,
         return SRS_VOICE_INVALID;
     }
 
+    if (priority < 0 || priority >= NPRIORITY) {
+        errno = EINVAL;
+
+        return SRS_VOICE_INVALID;
+    }
+
     r = find_renderer(state, voice, &actid);
 
     if (r == NULL) {
@@ -845,17 +1775,30 @@ uint32_t srs_render_voice(srs_context_t *srs, const char *msg,
         return SRS_VOICE_INVALID;
     }
 
-    if (state->active == NULL)
+    if (preempts(state, priority))
+        preempt_active(state);
+
+    /* anything more urgent already waiting goes first */
+    if (state->active == NULL && top_priority(state) < priority)
         req = render_request(state, msg, tags, r, actid, rate, pitch, timeout,
-                             notify_mask, notify, user_data);
+                             priority, notify_mask, notify, user_data);
     else {
         if (timeout == SRS_VOICE_IMMEDIATE) {
             errno = EBUSY;
             req   = NULL;
         }
-        else
+        else {
             req = enqueue_request(state, msg, tags, r, actid, rate, pitch,
-                                  timeout, notify_mask, notify, user_data);
+                                  timeout, priority, owner, notify_mask,
+                                  notify, user_data);
+
+            if (req != NULL) {
+                if (state->active == NULL)
+                    activate_next(state);
+                else
+                    synthesize_ahead(state);
+            }
+        }
     }
 
     if (req != NULL)
@@ -867,8 +1810,7 @@ uint32_t srs_render_voice(srs_context_t *srs, const char *msg,
 
 static request_t *find_request(state_t *state, uint32_t rid, uint32_t vid)
 {
-    mrp_list_hook_t *p, *n;
-    request_t       *req;
+    request_t *req;
 
     if (state == NULL) {
         errno = ENOSYS;
@@ -881,14 +1823,20 @@ static request_t *find_request(state_t *state, uint32_t rid, uint32_t vid)
             return req;
     }
 
-    mrp_list_foreach(&state->requests, p, n) {
-        req = mrp_list_entry(p, typeof(*req), hook);
-
+    if ((req = state->ducked) != NULL) {
         if ((rid == SRS_VOICE_INVALID || req->id == rid) &&
             (vid == SRS_VOICE_INVALID || req->vid == vid))
             return req;
     }
 
+    /* queued requests are not rendering yet, so only look up by id */
+    if (rid != SRS_VOICE_INVALID && vid == SRS_VOICE_INVALID) {
+        req = mrp_htbl_lookup(state->requests, (void *)(ptrdiff_t)rid);
+
+        if (req != NULL)
+            return req;
+    }
+
     errno = EINVAL;
 
  error:
@@ -898,31 +1846,281 @@ static request_t *find_request(state_t *state, uint32_t rid, uint32_t vid)
 
 void srs_cancel_voice(srs_context_t *srs, uint32_t rid, int notify)
 {
-    state_t    *state = (state_t *)srs->synthesizer;
-    request_t  *req   = find_request(state, rid, -1);
-    renderer_t *voice = req ? req->r : NULL;
-
-    MRP_UNUSED(notify);
+    state_t   *state = (state_t *)srs->synthesizer;
+    request_t *req   = find_request(state, rid, -1);
+    int        next;
 
     if (req == NULL)
         return;
 
-    mrp_del_timer(req->timer);
-    req->timer = NULL;
-    state->cancelling = req;
+    next = (state->active == req);
 
-    voice->api.cancel(req->vid, voice->api_data);
+    cancel_request(state, req, notify);
 
-    mrp_list_delete(&req->hook);
-    mrp_free(req);
+    if (next)
+        resume_ducked(state);
+}
 
-    if (state->active == req) {
-        state->active = NULL;
-        activate_next(state);
+
+int srs_voice_stats(srs_context_t *srs, int priority,
+                    srs_voice_stats_t *stats)
+{
+    state_t *state = (state_t *)srs->synthesizer;
+
+    if (priority < 0 || priority >= NPRIORITY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (state == NULL)
+        mrp_clear(stats);
+    else
+        *stats = state->stats[priority];
+
+    return 0;
+}
+
+
+static void free_prompt(prompt_t *p)
+{
+    mrp_list_delete(&p->hook);
+    mrp_free(p->voice);
+    mrp_free(p->msg);
+    mrp_free(p);
+}
+
+
+static int prerender_prompt(state_t *state, prompt_t *p)
+{
+    static char *tags[] = { SRS_STREAM_TAG_SILENT, NULL };
+
+    renderer_t *r;
+    capture_t  *c;
+    uint32_t    actor, vid;
+    char       *key;
+
+    if ((r = find_renderer(state, p->voice, &actor)) == NULL) {
+        mrp_log_error("Can't pre-render prompt '%s', no voice '%s'.",
+                      p->msg, p->voice);
+        return -1;
+    }
+
+    key = srs_voice_cache_key(r->name, actor, p->rate, p->pitch, p->msg);
+
+    if (key == NULL)
+        return -1;
+
+    if (srs_voice_cache_pin(state->cache, key) == 0) {
+        mrp_debug("voice prompt '%s' already cached", key);
+        mrp_free(key);
+        return -1;
+    }
+
+    if ((c = mrp_allocz(sizeof(*c))) == NULL) {
+        mrp_free(key);
+        return -1;
+    }
+
+    c->cache = state->cache;
+    c->key   = key;
+    c->state = state;
+
+    vid = r->api.render(p->msg, tags, actor, p->rate, p->pitch, 0,
+                        r->api_data);
+
+    if (vid == SRS_VOICE_INVALID) {
+        mrp_log_error("Failed to pre-render voice prompt '%s'.", key);
+        goto fail;
+    }
+
+    mrp_debug("pre-rendering voice prompt '%s'", key);
+
+    /* the capture callback resets this, possibly right away */
+    state->prerendering = vid;
+
+    if (srs_capture_stream(state->srs->pulse, vid, cache_capture_cb, c) < 0) {
+        state->prerendering = SRS_VOICE_INVALID;
+        srs_stop_stream(state->srs->pulse, vid, FALSE, FALSE);
+        goto fail;
+    }
+
+    return 0;
+
+ fail:
+    mrp_free(c->key);
+    mrp_free(c);
+    return -1;
+}
+
+
+static void prerender_timer_cb(mrp_timer_t *t, void *user_data)
+{
+    state_t         *state = (state_t *)user_data;
+    mrp_list_hook_t *p, *n;
+    prompt_t        *pr;
+
+    MRP_UNUSED(t);
+
+    mrp_del_timer(state->prerender_timer);
+    state->prerender_timer = NULL;
+
+    /*
+     * Pre-render one prompt at a time, only while there is nothing else
+     * to render. Anything rendered in between will kick us again once
+     * done.
+     */
+
+    mrp_list_foreach(&state->prerender, p, n) {
+        if (state->active != NULL || state->ducked != NULL ||
+            state->prerendering != SRS_VOICE_INVALID)
+            return;
+
+        pr = mrp_list_entry(p, typeof(*pr), hook);
+        mrp_list_delete(&pr->hook);
+
+        if (prerender_prompt(state, pr) == 0) {
+            free_prompt(pr);
+            return;
+        }
+
+        free_prompt(pr);
     }
 }
 
 
+static void schedule_prerender(state_t *state, int delay)
+{
+    if (state->prerender_timer != NULL || mrp_list_empty(&state->prerender))
+        return;
+
+    state->prerender_timer = mrp_add_timer(state->srs->ml, delay,
+                                           prerender_timer_cb, state);
+}
+
+
+static int add_prompt(state_t *state, const char *voice, const char *msg,
+                      double rate, double pitch)
+{
+    prompt_t *p;
+
+    if (state->cache == NULL) {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    if ((p = mrp_allocz(sizeof(*p))) == NULL)
+        return -1;
+
+    mrp_list_init(&p->hook);
+    p->voice = mrp_strdup(voice);
+    p->msg   = mrp_strdup(msg);
+    p->rate  = rate > 0 ? rate : 1;
+    p->pitch = pitch > 0 ? pitch : 1;
+
+    if (p->voice == NULL || p->msg == NULL) {
+        free_prompt(p);
+        return -1;
+    }
+
+    mrp_list_append(&state->prerender, &p->hook);
+
+    return 0;
+}
+
+
+static void load_prompts(state_t *state)
+{
+    srs_context_t *srs = state->srs;
+    srs_cfg_t     *cfg;
+    const char    *voice;
+    char          *msg, buf[256];
+    int            n, i, len;
+
+    if (state->cache == NULL)
+        return;
+
+    /* feedback.tts.* prompts in the feedback voice */
+    voice = srs_config_get_string(srs->settings, CONFIG_FB_VOICE, "english");
+    n     = srs_config_collect(srs->settings, CONFIG_FEEDBACK, &cfg);
+
+    for (i = 0; i < n; i++)
+        add_prompt(state, voice, cfg[i].value, 1, 1);
+
+    if (n > 0)
+        srs_config_free(cfg);
+
+    /* voice.prerender.* prompts of the form <voice>:<message> */
+    n = srs_config_collect(srs->settings, CONFIG_PRERENDER, &cfg);
+
+    for (i = 0; i < n; i++) {
+        if ((msg = strchr(cfg[i].value, ':')) == NULL ||
+            (len = msg - cfg[i].value) >= (int)sizeof(buf)) {
+            mrp_log_error("Invalid voice prompt '%s' for %s.", cfg[i].value,
+                          cfg[i].key);
+            continue;
+        }
+
+        snprintf(buf, sizeof(buf), "%.*s", len, cfg[i].value);
+        add_prompt(state, buf, msg + 1, 1, 1);
+    }
+
+    if (n > 0)
+        srs_config_free(cfg);
+
+    schedule_prerender(state, PRERENDER_DELAY);
+}
+
+
+int srs_prerender_voice(srs_context_t *srs, const char *msg,
+                        const char *voice, double rate, double pitch)
+{
+    state_t *state = (state_t *)srs->synthesizer;
+
+    if (state == NULL) {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    if (add_prompt(state, voice, msg, rate, pitch) < 0)
+        return -1;
+
+    schedule_prerender(state, 0);
+
+    return 0;
+}
+
+
+int srs_barge_in_voice(srs_context_t *srs, srs_voice_barge_in_t trigger)
+{
+    state_t   *state = (state_t *)srs->synthesizer;
+    request_t *req;
+
+    if (state == NULL || (req = state->active) == NULL)
+        return FALSE;
+
+    switch (state->barge_in) {
+    case SRS_VOICE_BARGE_IN_SPEECH:      /* any trigger will do */
+        break;
+    case SRS_VOICE_BARGE_IN_COMMAND:
+        if (trigger != SRS_VOICE_BARGE_IN_COMMAND)
+            return FALSE;
+        break;
+    default:
+        return FALSE;
+    }
+
+    mrp_log_info("Barge-in, interrupting voice request #%u at %u msec.",
+                 req->id, req->progress.msec);
+
+    if (state->ducked != NULL)
+        cancel_request(state, state->ducked, TRUE);
+
+    srs_cancel_voice(srs, req->id, TRUE);
+
+    return TRUE;
+}
+
+
 int srs_query_voices(srs_context_t *srs, const char *language,
                      srs_voice_actor_t **actorsp)
 {
@@ -1006,3 +2204,150 @@ void srs_free_queried_voices(srs_voice_actor_t *actors)
         mrp_free(actors);
     }
 }
+
+
+static int abbreviation(const char *msg, const char *dot)
+{
+    static const char *abbrevs[] = {
+        "mr", "mrs", "ms", "dr", "prof", "st", "jr", "sr", "vs", "etc",
+        "eg", "ie", "no", "nr", "ave", "rd", NULL
+    };
+    const char  *w, **a;
+    int          len;
+
+    for (w = dot; w > msg && isalpha(w[-1]); w--)
+        ;
+
+    if ((len = dot - w) == 1)            /* an initial */
+        return TRUE;
+
+    for (a = abbrevs; *a != NULL; a++)
+        if ((int)strlen(*a) == len && !strncasecmp(*a, w, len))
+            return TRUE;
+
+    return FALSE;
+}
+
+
+static const char *sentence_end(const char *msg, const char *p)
+{
+    const char *e, *n;
+
+    /* include any closing quotes or brackets, then require a space */
+    for (e = p + 1; *e == '"' || *e == '\'' || *e == ')' || *e == ']'; e++)
+        ;
+
+    if (*e != '\0' && !isspace(*e))
+        return NULL;
+
+    if (*p == '.') {
+        for (n = e; isspace(*n); n++)
+            ;
+
+        if (islower(*n) || abbreviation(msg, p))
+            return NULL;
+    }
+
+    return e;
+}
+
+
+int srs_segment_voice(const char *msg, char ***segsp)
+{
+    struct {
+        int  offs;
+        int  len;
+    }           *seg = NULL;
+    const char  *b, *p, *e, *space;
+    char       **segs, *t;
+    int          nseg, size, i;
+
+    nseg = 0;
+    size = 0;
+    b    = msg;
+
+    while (*b != '\0') {
+        while (isspace(*b))
+            b++;
+
+        if (*b == '\0')
+            break;
+
+        e     = NULL;
+        space = NULL;
+
+        for (p = b; *p != '\0' && e == NULL; p++) {
+            switch (*p) {
+            case '.':
+            case '!':
+            case '?':
+                e = sentence_end(msg, p);
+                break;
+
+            case ',':
+            case ';':
+            case ':':
+                if (p - b >= SEGMENT_CLAUSE && isspace(p[1]))
+                    e = p + 1;
+                break;
+
+            case '\n':
+                if (p[1] == '\n')       /* paragraph break */
+                    e = p;
+                break;
+
+            default:
+                if (isspace(*p))
+                    space = p;
+                else if (p - b >= SEGMENT_MAX && space != NULL)
+                    e = space;
+            }
+        }
+
+        if (e == NULL)
+            e = p;
+
+        if (!mrp_reallocz(seg, nseg, nseg + 1)) {
+            mrp_free(seg);
+            return -1;
+        }
+
+        for (p = e; p > b && isspace(p[-1]); p--)
+            ;
+
+        seg[nseg].offs = b - msg;
+        seg[nseg].len  = p - b;
+        size += seg[nseg].len + 1;
+        nseg++;
+
+        b = e;
+    }
+
+    if (nseg == 0) {
+        *segsp = NULL;
+        return 0;
+    }
+
+    /* pack the segment table and the segments into a single allocation */
+    segs = mrp_alloc(nseg * sizeof(segs[0]) + size);
+
+    if (segs == NULL) {
+        mrp_free(seg);
+        return -1;
+    }
+
+    t = (char *)(segs + nseg);
+
+    for (i = 0; i < nseg; i++) {
+        segs[i] = t;
+        memcpy(t, msg + seg[i].offs, seg[i].len);
+        t[seg[i].len] = '\0';
+        t += seg[i].len + 1;
+    }
+
+    mrp_free(seg);
+
+    *segsp = segs;
+
+    return nseg;
+}
@@ -37,14 +37,35 @@
  * speech synthesizer backend interface
  */
 
+/** Barge-in modes/triggers. */
+typedef enum {
+    SRS_VOICE_BARGE_IN_OFF = 0,          /* never interrupt voice output */
+    SRS_VOICE_BARGE_IN_SPEECH,           /* interrupt on speech onset */
+    SRS_VOICE_BARGE_IN_COMMAND,          /* interrupt on a command match */
+} srs_voice_barge_in_t;
+
 /** Voice rendering notification callback type. */
 typedef void (*srs_voice_notify_t)(srs_voice_event_t *event, void *notify_data);
 
+/*
+ * queuing statistics of a request priority class
+ */
+typedef struct {
+    uint32_t nrequest;                   /* requests started */
+    uint64_t wait;                       /* total time spent queued (msec) */
+    uint32_t max;                        /* longest time spent queued */
+    uint32_t npreempted;                 /* requests preempted */
+} srs_voice_stats_t;
+
 /*
  * API to voice backend
  */
 typedef struct {
-    /** Render the given message. */
+    /**
+     * Render the given message. Backends should not block here for the
+     * whole synthesis but open a playback stream (srs_open_stream), return
+     * its id and keep appending audio to it as it gets synthesized.
+     */
     uint32_t (*render)(const char *msg, char **tags, int actor, double rate,
                        double pitch, int notify_events, void *api_data);
     /** Cancel the given rendering, notify cancellation if asked for. */
@@ -61,15 +82,52 @@ int srs_register_voice(srs_context_t *srs, const char *name,
 void srs_unregister_voice(srs_context_t *srs, const char *name);
 
 
-/** Render the given message using the given parameters. */
+/** Start the configured out-of-process synthesizer hosts. */
+int srs_start_voice_hosts(srs_context_t *srs);
+
+/** Stop all synthesizer hosts. */
+void srs_stop_voice_hosts(srs_context_t *srs);
+
+/** Clean up the voice rendering infrastructure at shutdown. */
+void srs_cleanup_voice(srs_context_t *srs);
+
+/**
+ * Render the given message using the given parameters. Requests are
+ * queued by priority, taking turns between owners of the same priority.
+ * Urgent requests preempt (abort or duck) active requests of lower
+ * priority.
+ */
 uint32_t srs_render_voice(srs_context_t *srs, const char *msg,
                           char **tags, const char *voice, double rate,
-                          double pitch, int timeout, int notify_events,
+                          double pitch, int timeout, int priority,
+                          const char *owner, int notify_events,
                           srs_voice_notify_t notify, void *user_data);
 
 /** Cancel the given voice rendering. */
 void srs_cancel_voice(srs_context_t *srs, uint32_t id, int notify);
 
+/** Get the queuing statistics of the given request priority. */
+int srs_voice_stats(srs_context_t *srs, int priority,
+                    srs_voice_stats_t *stats);
+
+/**
+ * Render the given message in the background, while there is nothing
+ * else to render, and keep the result pinned in the voice cache.
+ */
+int srs_prerender_voice(srs_context_t *srs, const char *msg,
+                        const char *voice, double rate, double pitch);
+
+/** Interrupt the active voice rendering if barge-in allows for trigger. */
+int srs_barge_in_voice(srs_context_t *srs, srs_voice_barge_in_t trigger);
+
+/**
+ * Split a message to segments at sentence (and for long sentences at
+ * clause) boundaries, for backends to synthesize and start playing one
+ * segment at a time. Returns the number of segments, the segment table
+ * and the segments themselves are freed with a single mrp_free.
+ */
+int srs_segment_voice(const char *msg, char ***segs);
+
 /** Query languages. */
 int srs_query_voices(srs_context_t *srs, const char *language,
                      srs_voice_actor_t **actors);
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+#include <murphy/common/list.h>
+#include <murphy/common/mainloop.h>
+
+#include "srs/daemon/worker.h"
+
+typedef struct {
+    mrp_list_hook_t  hook;               /* to pending or done jobs */
+    srs_job_queue_t *q;                  /* queue we were submitted to */
+    uint32_t         id;                 /* job id */
+    srs_job_run_t    run;                /* job function */
+    srs_job_done_t   done;               /* completion callback */
+    void            *data;               /* opaque job data */
+    int              status;             /* 0, or ECANCELED */
+    int              post;               /* intermediate result of a job */
+} job_t;
+
+struct srs_job_queue_s {
+    mrp_list_hook_t  hook;               /* to list of queues */
+    srs_workers_t   *w;                  /* worker pool */
+    char            *name;               /* queue name */
+    uint32_t         max_active;         /* max. concurrently running jobs */
+    srs_job_stats_t  stats;              /* queue statistics */
+};
+
+struct srs_workers_s {
+    srs_context_t   *srs;                /* context back pointer */
+    pthread_t       *threads;            /* worker threads */
+    int              nthread;            /* number of threads */
+    int              nrunning;           /* number of threads started */
+    pthread_mutex_t  lock;               /* protects everything below */
+    pthread_cond_t   wakeup;             /* signalled for new jobs */
+    pthread_cond_t   finished;           /* signalled for finished jobs */
+    mrp_list_hook_t  pending;            /* jobs waiting, in order */
+    mrp_list_hook_t  done;               /* jobs to report, in order */
+    mrp_list_hook_t  queues;             /* job queues */
+    uint32_t         next_id;            /* next job id */
+    int              stop;               /* whether stopping */
+    int              efd;                /* eventfd for done jobs */
+    mrp_io_watch_t  *iow;                /*     and its I/O watch */
+};
+
+
+static void notify_done(srs_workers_t *w)
+{
+    uint64_t one = 1;
+
+    /* called with the lock held */
+
+    if (write(w->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        mrp_log_error("Failed to signal finished jobs (%d: %s).", errno,
+                      strerror(errno));
+}
+
+
+static job_t *next_job(srs_workers_t *w)
+{
+    mrp_list_hook_t *p, *n;
+    job_t           *job;
+
+    /* pick the first job whose queue is not at its limit */
+
+    mrp_list_foreach(&w->pending, p, n) {
+        job = mrp_list_entry(p, typeof(*job), hook);
+
+        if (job->q->stats.active < job->q->max_active) {
+            mrp_list_delete(&job->hook);
+            job->q->stats.pending--;
+            job->q->stats.active++;
+
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void *worker_thread(void *data)
+{
+    srs_workers_t *w = (srs_workers_t *)data;
+    job_t         *job;
+
+    pthread_mutex_lock(&w->lock);
+
+    while (!w->stop) {
+        if ((job = next_job(w)) == NULL) {
+            pthread_cond_wait(&w->wakeup, &w->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&w->lock);
+        job->run(job->data);
+        pthread_mutex_lock(&w->lock);
+
+        job->q->stats.active--;
+        job->q->stats.completed++;
+
+        mrp_list_append(&w->done, &job->hook);
+        notify_done(w);
+
+        /* a job held back by the limit of this queue might run now */
+        pthread_cond_signal(&w->wakeup);
+        pthread_cond_broadcast(&w->finished);
+    }
+
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+
+static void done_cb(mrp_io_watch_t *iow, int fd, mrp_io_event_t events,
+                    void *user_data)
+{
+    srs_workers_t *w = (srs_workers_t *)user_data;
+    uint64_t       cnt;
+    job_t         *job;
+
+    MRP_UNUSED(iow);
+    MRP_UNUSED(events);
+
+    if (read(fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+        mrp_log_error("Failed to read finished job count (%d: %s).", errno,
+                      strerror(errno));
+
+    /* report one job at a time, callbacks are free to submit new ones */
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+
+        if (mrp_list_empty(&w->done)) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+
+        job = mrp_list_entry(w->done.next, typeof(*job), hook);
+        mrp_list_delete(&job->hook);
+
+        pthread_mutex_unlock(&w->lock);
+
+        if (job->done != NULL)
+            job->done(job->id, job->status, job->data);
+
+        mrp_free(job);
+    }
+}
+
+
+static void move_jobs(mrp_list_hook_t *jobs, srs_job_queue_t *q,
+                      mrp_list_hook_t *to)
+{
+    mrp_list_hook_t *p, *n;
+    job_t           *job;
+
+    mrp_list_foreach(jobs, p, n) {
+        job = mrp_list_entry(p, typeof(*job), hook);
+
+        if (job->q == q) {
+            mrp_list_delete(&job->hook);
+            mrp_list_append(to, &job->hook);
+        }
+    }
+}
+
+
+static void free_jobs(mrp_list_hook_t *jobs)
+{
+    mrp_list_hook_t *p, *n;
+    job_t           *job;
+
+    mrp_list_foreach(jobs, p, n) {
+        job = mrp_list_entry(p, typeof(*job), hook);
+
+        mrp_list_delete(&job->hook);
+
+        /* posted results need to be freed by their owner */
+        if (job->post)
+            job->done(SRS_JOB_INVALID, ECANCELED, job->data);
+
+        mrp_free(job);
+    }
+}
+
+
+int srs_workers_create(srs_context_t *srs, int nthread)
+{
+    srs_workers_t *w;
+
+    if (nthread <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((w = mrp_allocz(sizeof(*w))) == NULL)
+        return -1;
+
+    w->srs     = srs;
+    w->next_id = 1;
+    w->efd     = -1;
+    mrp_list_init(&w->pending);
+    mrp_list_init(&w->done);
+    mrp_list_init(&w->queues);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wakeup, NULL);
+    pthread_cond_init(&w->finished, NULL);
+
+    srs->workers = w;
+
+    w->efd     = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    w->threads = mrp_allocz_array(pthread_t, nthread);
+
+    if (w->efd < 0 || w->threads == NULL)
+        goto fail;
+
+    w->iow = mrp_add_io_watch(srs->ml, w->efd, MRP_IO_EVENT_IN, done_cb, w);
+
+    if (w->iow == NULL)
+        goto fail;
+
+    w->nthread = nthread;
+
+    mrp_log_info("Created worker pool with %d threads.", w->nthread);
+
+    return 0;
+
+ fail:
+    mrp_log_error("Failed to create worker pool (%d: %s).", errno,
+                  strerror(errno));
+    srs_workers_destroy(srs);
+
+    return -1;
+}
+
+
+void srs_workers_destroy(srs_context_t *srs)
+{
+    srs_workers_t   *w = srs->workers;
+    mrp_list_hook_t *p, *n;
+    srs_job_queue_t *q;
+    int              i;
+
+    if (w == NULL)
+        return;
+
+    pthread_mutex_lock(&w->lock);
+    w->stop = TRUE;
+    pthread_cond_broadcast(&w->wakeup);
+    pthread_mutex_unlock(&w->lock);
+
+    for (i = 0; i < w->nrunning; i++)
+        pthread_join(w->threads[i], NULL);
+
+    mrp_del_io_watch(w->iow);
+
+    if (w->efd >= 0)
+        close(w->efd);
+
+    free_jobs(&w->pending);
+    free_jobs(&w->done);
+
+    mrp_list_foreach(&w->queues, p, n) {
+        q = mrp_list_entry(p, typeof(*q), hook);
+        mrp_log_warning("Destroying leftover job queue '%s'.", q->name);
+        mrp_list_delete(&q->hook);
+        mrp_free(q->name);
+        mrp_free(q);
+    }
+
+    pthread_cond_destroy(&w->finished);
+    pthread_cond_destroy(&w->wakeup);
+    pthread_mutex_destroy(&w->lock);
+
+    mrp_free(w->threads);
+    mrp_free(w);
+
+    srs->workers = NULL;
+}
+
+
+int srs_workers_start(srs_context_t *srs)
+{
+    srs_workers_t *w   = srs->workers;
+    int            err = 0;
+
+    if (w == NULL || w->nrunning > 0)
+        return 0;
+
+    /* jobs submitted so far are picked up once the threads are running */
+    while (w->nrunning < w->nthread) {
+        err = pthread_create(w->threads + w->nrunning, NULL, worker_thread,
+                             w);
+
+        if (err != 0) {
+            mrp_log_error("Failed to start worker thread (%d: %s).", err,
+                          strerror(err));
+            break;
+        }
+
+        w->nrunning++;
+    }
+
+    if (w->nrunning == 0) {
+        errno = err;
+        return -1;
+    }
+
+    mrp_log_info("Started %d worker threads.", w->nrunning);
+
+    return 0;
+}
+
+
+srs_job_queue_t *srs_job_queue_create(srs_context_t *srs, const char *name,
+                                      int max_active)
+{
+    srs_workers_t   *w = srs->workers;
+    srs_job_queue_t *q;
+
+    if (w == NULL) {
+        errno = ENOSYS;
+        return NULL;
+    }
+
+    if ((q = mrp_allocz(sizeof(*q))) == NULL)
+        return NULL;
+
+    mrp_list_init(&q->hook);
+    q->w          = w;
+    q->name       = mrp_strdup(name ? name : "<unnamed>");
+    q->max_active = max_active > 0 ? max_active : w->nthread;
+
+    if (q->name == NULL) {
+        mrp_free(q);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&w->lock);
+    mrp_list_append(&w->queues, &q->hook);
+    pthread_mutex_unlock(&w->lock);
+
+    mrp_log_info("Created job queue '%s' (max. %u active jobs).", q->name,
+                 q->max_active);
+
+    return q;
+}
+
+
+void srs_job_queue_destroy(srs_job_queue_t *q)
+{
+    srs_workers_t   *w;
+    mrp_list_hook_t  dropped;
+    srs_job_stats_t  stats;
+
+    if (q == NULL)
+        return;
+
+    w = q->w;
+
+    srs_job_queue_stats(q, &stats);
+
+    mrp_log_info("Job queue '%s': %llu submitted, %llu completed, "
+                 "%llu cancelled, peak backlog %u.", q->name,
+                 (unsigned long long)stats.submitted,
+                 (unsigned long long)stats.completed,
+                 (unsigned long long)stats.cancelled, stats.peak);
+
+    /*
+     * Drop all pending jobs, wait for the running ones to finish, then
+     * drop them as well without reporting anything. The owner of the
+     * queue is going away and is not interested in completions.
+     */
+
+    mrp_list_init(&dropped);
+
+    pthread_mutex_lock(&w->lock);
+
+    move_jobs(&w->pending, q, &dropped);
+
+    while (q->stats.active > 0)
+        pthread_cond_wait(&w->finished, &w->lock);
+
+    move_jobs(&w->done, q, &dropped);
+    mrp_list_delete(&q->hook);
+
+    pthread_mutex_unlock(&w->lock);
+
+    free_jobs(&dropped);
+
+    mrp_debug("destroyed job queue '%s'", q->name);
+
+    mrp_free(q->name);
+    mrp_free(q);
+}
+
+
+uint32_t srs_job_submit(srs_job_queue_t *q, srs_job_run_t run,
+                        srs_job_done_t done, void *job_data)
+{
+    srs_workers_t *w = q->w;
+    job_t         *job;
+    uint32_t       id;
+
+    if (run == NULL) {
+        errno = EINVAL;
+        return SRS_JOB_INVALID;
+    }
+
+    if ((job = mrp_allocz(sizeof(*job))) == NULL)
+        return SRS_JOB_INVALID;
+
+    mrp_list_init(&job->hook);
+    job->q    = q;
+    job->run  = run;
+    job->done = done;
+    job->data = job_data;
+
+    pthread_mutex_lock(&w->lock);
+
+    if ((id = w->next_id++) == SRS_JOB_INVALID)
+        id = w->next_id++;
+    job->id = id;
+
+    mrp_list_append(&w->pending, &job->hook);
+
+    q->stats.submitted++;
+    if (++q->stats.pending > q->stats.peak)
+        q->stats.peak = q->stats.pending;
+
+    pthread_cond_signal(&w->wakeup);
+    pthread_mutex_unlock(&w->lock);
+
+    return id;
+}
+
+
+int srs_job_post(srs_job_queue_t *q, srs_job_done_t cb, void *data)
+{
+    srs_workers_t *w = q->w;
+    job_t         *job;
+
+    if (cb == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((job = mrp_allocz(sizeof(*job))) == NULL)
+        return -1;
+
+    mrp_list_init(&job->hook);
+    job->q    = q;
+    job->id   = SRS_JOB_INVALID;
+    job->done = cb;
+    job->data = data;
+    job->post = TRUE;
+
+    /* the job itself gets to the done list after this, keeping the order */
+
+    pthread_mutex_lock(&w->lock);
+    mrp_list_append(&w->done, &job->hook);
+    notify_done(w);
+    pthread_mutex_unlock(&w->lock);
+
+    return 0;
+}
+
+
+int srs_job_cancel(srs_job_queue_t *q, uint32_t id)
+{
+    srs_workers_t   *w = q->w;
+    mrp_list_hook_t *p, *n;
+    job_t           *job;
+
+    pthread_mutex_lock(&w->lock);
+
+    mrp_list_foreach(&w->pending, p, n) {
+        job = mrp_list_entry(p, typeof(*job), hook);
+
+        if (job->q == q && job->id == id) {
+            mrp_list_delete(&job->hook);
+            job->status = ECANCELED;
+
+            q->stats.pending--;
+            q->stats.cancelled++;
+
+            mrp_list_append(&w->done, &job->hook);
+            notify_done(w);
+
+            pthread_mutex_unlock(&w->lock);
+
+            return 0;
+        }
+    }
+
+    pthread_mutex_unlock(&w->lock);
+
+    /* not pending (any more), it is either running or done */
+    errno = ENOENT;
+
+    return -1;
+}
+
+
+void srs_job_queue_stats(srs_job_queue_t *q, srs_job_stats_t *stats)
+{
+    pthread_mutex_lock(&q->w->lock);
+    *stats = q->stats;
+    pthread_mutex_unlock(&q->w->lock);
+}
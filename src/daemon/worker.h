@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2012 - 2013, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Intel Corporation nor the names of its contributors
+ *     may be used to endorse or promote products derived from this software
+ *     without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SRS_DAEMON_WORKER_H__
+#define __SRS_DAEMON_WORKER_H__
+
+#include <stdint.h>
+
+#include "srs/daemon/context.h"
+
+/*
+ * speech engine worker pool
+ *
+ * A daemon-wide pool of worker threads for offloading heavy backend
+ * work (decoding, synthesis, etc.) from the main loop. Jobs are
+ * submitted to per-plugin queues, each with its own limit on the
+ * number of jobs running concurrently. The run callback of a job is
+ * called in a worker thread, its completion callback back in the main
+ * loop, always in the order the jobs finish.
+ */
+
+/** Invalid job id. */
+#define SRS_JOB_INVALID ((uint32_t)0)
+
+/** Worker pool type. */
+typedef struct srs_workers_s srs_workers_t;
+
+/** Job queue type. */
+typedef struct srs_job_queue_s srs_job_queue_t;
+
+/** Job function, called in a worker thread. */
+typedef void (*srs_job_run_t)(void *job_data);
+
+/** Job completion callback, called in the main loop. */
+typedef void (*srs_job_done_t)(uint32_t id, int status, void *job_data);
+
+/** Job queue statistics. */
+typedef struct {
+    uint32_t pending;                    /* jobs waiting for a worker */
+    uint32_t active;                     /* jobs being run */
+    uint32_t peak;                       /* max. jobs ever waiting */
+    uint64_t submitted;                  /* jobs submitted */
+    uint64_t completed;                  /* jobs run to completion */
+    uint64_t cancelled;                  /* jobs cancelled */
+} srs_job_stats_t;
+
+/**
+ * Create the worker pool with the given number of threads. Job queues
+ * can be created and jobs submitted right away, but the threads are
+ * only started by srs_workers_start, so that they survive daemonizing.
+ */
+int srs_workers_create(srs_context_t *srs, int nthread);
+
+/** Start the threads of the worker pool. */
+int srs_workers_start(srs_context_t *srs);
+
+/** Stop and destroy the worker pool. */
+void srs_workers_destroy(srs_context_t *srs);
+
+/** Create a job queue running at most max_active jobs at a time. */
+srs_job_queue_t *srs_job_queue_create(srs_context_t *srs, const char *name,
+                                      int max_active);
+
+/** Destroy a job queue, dropping any pending or unreported jobs. */
+void srs_job_queue_destroy(srs_job_queue_t *q);
+
+/** Submit a job, returning its id. */
+uint32_t srs_job_submit(srs_job_queue_t *q, srs_job_run_t run,
+                        srs_job_done_t done, void *job_data);
+
+/**
+ * Pass intermediate results from a running job to the main loop. cb
+ * is called there with data before the completion of the job, or with
+ * ECANCELED from srs_job_queue_destroy if the queue goes away first.
+ */
+int srs_job_post(srs_job_queue_t *q, srs_job_done_t cb, void *data);
+
+/** Cancel a pending job, its completion is reported with ECANCELED. */
+int srs_job_cancel(srs_job_queue_t *q, uint32_t id);
+
+/** Get the statistics of a job queue. */
+void srs_job_queue_stats(srs_job_queue_t *q, srs_job_stats_t *stats);
+
+#endif /* __SRS_DAEMON_WORKER_H__ */
@@ -2,12 +2,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
 #include <errno.h>
 
 #include <pulse/pulseaudio.h>
 #include <pulse/mainloop.h>
 #include <pulse/introspect.h>
 
+#include <murphy/common/macros.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/log.h>
 
@@ -15,6 +17,9 @@
 #include "dbusif.h"
 #include "clients.h"
 
+#define VAD_FRAME     20       /* VAD frame length in msecs */
+#define VAD_MAX_FRAME 32       /* max. VAD frames processed in one go */
+
 typedef struct {
     mrp_list_hook_t link;
     context_t *ctx;
@@ -70,6 +75,7 @@ int pulseif_create(context_t *ctx, pa_mainloop_api *pa)
     pulseif->rate = 16000;
     pulseif->limit.upper = 1500;
     pulseif->limit.lower = 100;
+    pulseif->limit.hangover = 100;
 
     mrp_list_init(&pulseif->cards);
     mrp_list_init(&pulseif->pending_ops);
@@ -261,6 +267,8 @@ static void remove_card(card_t *card)
             pa_stream_set_write_callback(stream, NULL, NULL);
         }
 
+        srs_vad_destroy(card->input.vad);
+
         mrp_list_delete(&card->link);
         mrp_free((void *)card->name);
         mrp_free((void *)card->btaddr);
@@ -411,6 +419,7 @@ static int input_stream_create(card_t *card)
     pa_sample_spec spec;
     pa_buffer_attr battr;
     pa_proplist *pl;
+    srs_vad_config_t vcfg;
     size_t minsiz, bufsiz, extra, size;
 
     if (!card || !(device = card->device) || !(ctx = device->ctx) ||
@@ -420,6 +429,23 @@ static int input_stream_create(card_t *card)
     if (card->input.stream)
         return 0;
 
+    if (!card->input.vad) {
+        vcfg.rate     = pulseif->rate;
+        vcfg.frame    = VAD_FRAME;
+        vcfg.onset    = 20.0 * log10(pulseif->limit.upper);
+        vcfg.offset   = 20.0 * log10(pulseif->limit.lower);
+        vcfg.hangover = pulseif->limit.hangover;
+        vcfg.adaptive = false;
+
+        if (!(card->input.vad = srs_vad_create(&vcfg))) {
+            mrp_log_error("bluetooth client: failed to create voice "
+                          "activity detector for card %s", card->btaddr);
+            return -1;
+        }
+    }
+    else
+        srs_vad_reset(card->input.vad);
+
     memset(&spec, 0, sizeof(spec));
     spec.format = PA_SAMPLE_S16LE;
     spec.rate = pulseif->rate;
@@ -617,9 +643,9 @@ static void read_callback(pa_stream *stream, size_t bytes, void *userdata)
     pulseif_t *pulseif;
     const void *data;
     size_t size;
-    size_t n, i;
-    double sample;
-    double m;
+    size_t n, i, len, max;
+    int cnt, j;
+    srs_vad_frame_t frames[VAD_MAX_FRAME + 1];
     int16_t *s;
 
     MRP_UNUSED(bytes);
@@ -638,26 +664,28 @@ static void read_callback(pa_stream *stream, size_t bytes, void *userdata)
         if (card->input.state == ST_BEGIN || card->input.state == ST_CLING) {
             n = size / sizeof(int16_t);
             s = (int16_t *)data;
-            m = 0.0;
-
-            for (i = 0;   i < n;   i++) {
-                sample = (double)s[i];
-                m += sample > 0.0 ? sample : -sample;
-            }
+            max = VAD_MAX_FRAME * srs_vad_frame_length(card->input.vad);
 
-            m /= (double)n;
+            for (i = 0;  i < n && card->input.state != ST_READY;  i += len) {
+                len = (n - i > max) ? max : n - i;
+                cnt = srs_vad_process(card->input.vad, s + i, len,
+                                      frames, MRP_ARRAY_SIZE(frames));
 
-            if (card->input.state == ST_BEGIN) {
-                if (m > pulseif->limit.upper)
-                    card->input.state = ST_CLING;
-            }
-            else {
-                if (m < pulseif->limit.lower) {
-                    printf("*** cling ends\n");
-                    card->input.state = ST_READY;
-
-                    if (device->audio.buf && device->audio.end > 0)
-                        pulseif_add_output_stream_to_card(card);
+                for (j = 0;  j < cnt;  j++) {
+                    if (card->input.state == ST_BEGIN) {
+                        if (frames[j].state == SRS_VAD_SPEECH)
+                            card->input.state = ST_CLING;
+                    }
+                    else {
+                        if (frames[j].state == SRS_VAD_SILENCE) {
+                            printf("*** cling ends\n");
+                            card->input.state = ST_READY;
+
+                            if (device->audio.buf && device->audio.end > 0)
+                                pulseif_add_output_stream_to_card(card);
+                            break;
+                        }
+                    }
                 }
             }
         }
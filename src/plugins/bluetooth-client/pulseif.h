@@ -5,6 +5,8 @@
 #include <pulse/mainloop.h>
 #include <pulse/subscribe.h>
 
+#include "srs/daemon/vad.h"
+
 #include "bluetooth-plugin.h"
 
 struct pulseif_s {
@@ -18,6 +20,7 @@ struct pulseif_s {
     struct {
         double upper;
         double lower;
+        uint32_t hangover;
     } limit;
 };
 
@@ -39,6 +42,7 @@ struct card_s {
     } source;
     struct {
         pa_stream *stream;
+        srs_vad_t *vad;
         enum {
             ST_BEGIN = 0,
             ST_CLING,
@@ -52,6 +52,10 @@
 static int register_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *msg, void *user_data);
 static int unregister_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *msg,
                           void *user_data);
+static int add_commands_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *msg,
+                            void *user_data);
+static int remove_commands_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *msg,
+                               void *user_data);
 static int focus_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *msg, void *user_data);
 static int render_voice_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *msg,
                             void *user_data);
@@ -70,6 +74,7 @@ static int voice_notify(srs_client_t *c, srs_voice_event_t *event);
 #define reply_register   simple_reply
 #define reply_unregister simple_reply
 #define reply_focus      simple_reply
+#define reply_commands   simple_reply
 #define reply_cancel     simple_reply
 
 typedef struct {
@@ -110,6 +115,20 @@ static int dbusif_setup(dbusif_t *bus)
             goto fail;
         }
 
+        method = SRS_CLIENT_ADD_COMMANDS;
+        cb     = add_commands_req;
+        if (!mrp_dbus_export_method(bus->dbus, path, iface, method, cb, bus)) {
+            mrp_log_error("Failed to register D-BUS '%s' method.", method);
+            goto fail;
+        }
+
+        method = SRS_CLIENT_REMOVE_COMMANDS;
+        cb     = remove_commands_req;
+        if (!mrp_dbus_export_method(bus->dbus, path, iface, method, cb, bus)) {
+            mrp_log_error("Failed to register D-BUS '%s' method.", method);
+            goto fail;
+        }
+
         method = SRS_CLIENT_REQUEST_FOCUS;
         cb     = focus_req;
         if (!mrp_dbus_export_method(bus->dbus, path, iface, method, cb, bus)) {
@@ -179,6 +198,14 @@ static void dbusif_cleanup(dbusif_t *bus)
         cb     = unregister_req;
         mrp_dbus_remove_method(bus->dbus, path, iface, method, cb, bus);
 
+        method = SRS_CLIENT_ADD_COMMANDS;
+        cb     = add_commands_req;
+        mrp_dbus_remove_method(bus->dbus, path, iface, method, cb, bus);
+
+        method = SRS_CLIENT_REMOVE_COMMANDS;
+        cb     = remove_commands_req;
+        mrp_dbus_remove_method(bus->dbus, path, iface, method, cb, bus);
+
         method = SRS_CLIENT_REQUEST_FOCUS;
         cb     = focus_req;
         mrp_dbus_remove_method(bus->dbus, path, iface, method, cb, bus);
@@ -440,6 +467,89 @@ static int unregister_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *req,
 }
 
 
+static int parse_commands(mrp_dbus_msg_t *req, const char **id,
+                          char ***commands, int *ncommand, const char **errmsg)
+{
+    void   *cmds;
+    size_t  ncmd;
+
+    *id = mrp_dbus_msg_sender(req);
+
+    if (*id == NULL) {
+        *errmsg = "failed to determine client id";
+        return EINVAL;
+    }
+
+    if (mrp_dbus_msg_read_array(req, MRP_DBUS_TYPE_STRING, &cmds, &ncmd)) {
+        *commands = cmds;
+        *ncommand = (int)ncmd;
+
+        return 0;
+    }
+
+    *errmsg = "malformed command request";
+    return EINVAL;
+}
+
+
+static int update_commands(mrp_dbus_t *dbus, mrp_dbus_msg_t *req,
+                           void *user_data, int add)
+{
+    dbusif_t      *bus = (dbusif_t *)user_data;
+    srs_context_t *srs = bus->self->srs;
+    const char    *id, *errmsg;
+    char         **cmds;
+    int            ncmd, err, success;
+    srs_client_t  *c;
+
+    ncmd = 0;
+    err  = parse_commands(req, &id, &cmds, &ncmd, &errmsg);
+
+    if (err) {
+        reply_commands(dbus, req, err, errmsg);
+
+        return TRUE;
+    }
+
+    mrp_debug("got %s commands request from %s", add ? "add" : "remove", id);
+
+    c = client_lookup_by_id(srs, id);
+
+    if (c == NULL) {
+        reply_commands(dbus, req, 1, "you don't exist, go away");
+
+        return TRUE;
+    }
+
+    if (add)
+        success = client_add_commands(c, cmds, ncmd);
+    else
+        success = client_remove_commands(c, cmds, ncmd);
+
+    if (success)
+        reply_commands(dbus, req, 0, NULL);
+    else
+        reply_commands(dbus, req, 1, add ? "failed to add commands" :
+                       "failed to remove commands");
+
+    return TRUE;
+}
+
+
+static int add_commands_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *req,
+                            void *user_data)
+{
+    return update_commands(dbus, req, user_data, TRUE);
+}
+
+
+static int remove_commands_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *req,
+                               void *user_data)
+{
+    return update_commands(dbus, req, user_data, FALSE);
+}
+
+
 static int parse_focus(mrp_dbus_msg_t *req, const char **id, int *focus,
                        const char **errmsg)
 {
@@ -605,11 +715,12 @@ static int voice_notify(srs_client_t *c, srs_voice_event_t *event)
 static int parse_render_voice(mrp_dbus_msg_t *req, const char **id,
                               const char **msg, const char **voice,
                               double *rate, double *pitch, int *timeout,
-                              int *notify_events, const char **errmsg)
+                              int *priority, int *notify_events,
+                              const char **errmsg)
 {
     char    **events, *e;
     size_t    i, nevent;
-    int32_t   to;
+    int32_t   to, prio;
 
     *id = mrp_dbus_msg_sender(req);
 
@@ -631,7 +742,24 @@ static int parse_render_voice(mrp_dbus_msg_t *req, const char **id,
         return EINVAL;
     }
 
+    /* priority is optional, for compatibility with older clients */
+    prio = SRS_VOICE_PRIORITY_NORMAL;
+
+    if (mrp_dbus_msg_arg_type(req, NULL) == MRP_DBUS_TYPE_INT32 &&
+        !mrp_dbus_msg_read_basic(req, MRP_DBUS_TYPE_INT32, &prio)) {
+        *errmsg = "malformed voice render message";
+
+        return EINVAL;
+    }
+
+    if (prio < SRS_VOICE_PRIORITY_LOW || prio >= SRS_VOICE_PRIORITY_MAX) {
+        *errmsg = "invalid priority";
+
+        return EINVAL;
+    }
+
     *timeout       = to;
+    *priority      = prio;
     *notify_events = 0;
 
     for (i = 0; i < nevent; i++) {
@@ -665,12 +793,12 @@ static int render_voice_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *req,
     srs_context_t *srs = bus->self->srs;
     const char    *id, *msg, *voice, *errmsg = NULL;
     double         rate, pitch;
-    int            timeout, events, err;
+    int            timeout, prio, events, err;
     uint32_t       reqid;
     srs_client_t  *c;
 
     err = parse_render_voice(req, &id, &msg, &voice, &rate, &pitch, &timeout,
-                             &events, &errmsg);
+                             &prio, &events, &errmsg);
 
     if (err != 0) {
         reply_error(dbus, req, err, errmsg);
@@ -686,7 +814,8 @@ static int render_voice_req(mrp_dbus_t *dbus, mrp_dbus_msg_t *req,
         return TRUE;
     }
 
-    reqid = client_render_voice(c, msg, voice, rate, pitch, timeout, events);
+    reqid = client_render_voice(c, msg, voice, rate, pitch, timeout, prio,
+                                events);
 
     if (reqid != SRS_VOICE_INVALID)
         reply_render(dbus, req, reqid);
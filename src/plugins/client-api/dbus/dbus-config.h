@@ -36,6 +36,8 @@
 
 #define SRS_CLIENT_REGISTER        "Register"
 #define SRS_CLIENT_UNREGISTER      "Unregister"
+#define SRS_CLIENT_ADD_COMMANDS    "AddCommands"
+#define SRS_CLIENT_REMOVE_COMMANDS "RemoveCommands"
 
 #define SRS_CLIENT_NOTIFY_COMMAND  "VoiceCommand"
 #define SRS_CLIENT_REQUEST_FOCUS   "RequestFocus"
@@ -83,6 +83,10 @@ typedef union {
     struct {
         uint32_t id;
     } voice_ccl;
+    struct {
+        char   **commands;
+        size_t   ncommand;
+    } commands;
 } request_data_t;
 
 typedef struct {
@@ -96,6 +100,7 @@ typedef struct {
 
 
 static void status_reply(srs_t *srs, srs_rpl_status_t *rpl);
+static void update_commands(srs_t *srs, request_t *req);
 static void rendervoice_reply(srs_t *srs, srs_rpl_voice_t *rpl);
 static void queryvoices_reply(srs_t *srs, srs_rpl_voiceqry_t *rpl);
 static void focus_event(srs_t *srs, srs_evt_focus_t *evt);
@@ -183,6 +188,10 @@ static int queue_request(srs_t *srs, srs_msg_t *req, request_data_t *data)
     r->type  = req->any_req.type;
     r->reqno = req->any_req.reqno = srs->reqno++;
 
+    /* prioritized voice requests are voice requests all the same */
+    if (r->type == SRS_REQUEST_RENDERVOICEPRIO)
+        r->type = SRS_REQUEST_RENDERVOICE;
+
     if (data != NULL)
         r->data = *data;
 
@@ -213,9 +222,46 @@ static request_t *find_request(srs_t *srs, uint32_t reqno)
 }
 
 
+static void free_strings(char **strings, size_t n)
+{
+    size_t i;
+
+    if (strings != NULL) {
+        for (i = 0; i < n; i++)
+            mrp_free(strings[i]);
+
+        mrp_free(strings);
+    }
+}
+
+
+static char **copy_strings(char **strings, size_t n)
+{
+    char   **copy;
+    size_t   i;
+
+    if ((copy = mrp_allocz_array(char *, n)) == NULL)
+        return NULL;
+
+    for (i = 0; i < n; i++) {
+        if ((copy[i] = mrp_strdup(strings[i])) == NULL) {
+            free_strings(copy, n);
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+
 static void purge_request(request_t *r)
 {
     mrp_list_delete(&r->hook);
+
+    if (r->type == SRS_REQUEST_ADDCOMMANDS ||
+        r->type == SRS_REQUEST_DELCOMMANDS)
+        free_strings(r->data.commands.commands, r->data.commands.ncommand);
+
     mrp_free(r);
 }
 
@@ -542,8 +588,59 @@ int srs_request_focus(srs_t *srs, srs_voice_focus_t focus)
 }
 
 
+static int queue_commands(srs_t *srs, uint32_t type, char **commands,
+                          size_t ncommand)
+{
+    srs_req_commands_t req;
+    request_data_t     data;
+
+    if (check_connection(srs) < 0)
+        return -1;
+
+    if (ncommand == 0)
+        return 0;
+
+    /*
+     * Keep a copy of the commands with the request. Our own copy of the
+     * command set (which we register with on reconnect) is only updated
+     * once the server has accepted the change.
+     */
+
+    memset(&data, 0, sizeof(data));
+    data.commands.commands = copy_strings(commands, ncommand);
+    data.commands.ncommand = ncommand;
+
+    if (data.commands.commands == NULL)
+        return -1;
+
+    req.type     = type;
+    req.commands = commands;
+    req.ncommand = ncommand;
+
+    if (queue_request(srs, (srs_msg_t *)&req, &data) < 0) {
+        free_strings(data.commands.commands, ncommand);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int srs_add_commands(srs_t *srs, char **commands, size_t ncommand)
+{
+    return queue_commands(srs, SRS_REQUEST_ADDCOMMANDS, commands, ncommand);
+}
+
+
+int srs_remove_commands(srs_t *srs, char **commands, size_t ncommand)
+{
+    return queue_commands(srs, SRS_REQUEST_DELCOMMANDS, commands, ncommand);
+}
+
+
 uint32_t srs_render_voice(srs_t *srs, const char *msg, const char *voice,
-                          double rate, double pitch, int timeout, int events,
+                          double rate, double pitch, int timeout,
+                          int priority, int events,
                           srs_render_notify_t cb, void *cb_data)
 {
     srs_req_voice_t req;
@@ -552,13 +649,19 @@ uint32_t srs_render_voice(srs_t *srs, const char *msg, const char *voice,
     if (check_connection(srs) < 0)
         return -1;
 
-    req.type    = SRS_REQUEST_RENDERVOICE;
-    req.msg     = (char *)msg;
-    req.voice   = (char *)voice;
-    req.rate    = rate;
-    req.pitch   = pitch;
-    req.timeout = timeout;
-    req.events  = events;
+    /* only use the newer request type if we really need to */
+    if (priority == SRS_VOICE_PRIORITY_NORMAL)
+        req.type = SRS_REQUEST_RENDERVOICE;
+    else
+        req.type = SRS_REQUEST_RENDERVOICEPRIO;
+
+    req.msg      = (char *)msg;
+    req.voice    = (char *)voice;
+    req.rate     = rate;
+    req.pitch    = pitch;
+    req.timeout  = timeout;
+    req.events   = events;
+    req.priority = priority;
 
     memset(&data, 0, sizeof(data));
     data.voice_req.cvid    = srs->cvid++;
@@ -662,6 +765,16 @@ static void status_reply(srs_t *srs, srs_rpl_status_t *rpl)
                   status == 0 ? "succeeded" : "failed");
         break;
 
+    case SRS_REQUEST_ADDCOMMANDS:
+    case SRS_REQUEST_DELCOMMANDS:
+        mrp_debug("Command %s request %s on server.",
+                  req->type == SRS_REQUEST_ADDCOMMANDS ? "add" : "remove",
+                  status == 0 ? "succeeded" : "failed");
+
+        if (status == 0)
+            update_commands(srs, req);
+        break;
+
     default:
         mrp_log_warning("Dequeued request with invalid type 0x%x.", req->type);
     }
@@ -670,6 +783,37 @@ static void status_reply(srs_t *srs, srs_rpl_status_t *rpl)
 }
 
 
+static void update_commands(srs_t *srs, request_t *req)
+{
+    char   **cmds = req->data.commands.commands;
+    size_t   ncmd = req->data.commands.ncommand;
+    size_t   i, j;
+
+    if (req->type == SRS_REQUEST_ADDCOMMANDS) {
+        if (!mrp_reallocz(srs->commands, srs->ncommand, srs->ncommand + ncmd)) {
+            mrp_log_error("Failed to update local command set.");
+            return;
+        }
+
+        for (i = 0; i < ncmd; i++) {
+            srs->commands[srs->ncommand++] = cmds[i];
+            cmds[i] = NULL;
+        }
+    }
+    else {
+        for (i = 0; i < ncmd; i++) {
+            for (j = 0; j < srs->ncommand; j++) {
+                if (!strcmp(srs->commands[j], cmds[i])) {
+                    mrp_free(srs->commands[j]);
+                    srs->commands[j] = srs->commands[--srs->ncommand];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
 static void rendervoice_reply(srs_t *srs, srs_rpl_voice_t *rpl)
 {
     request_t         *req = find_request(srs, rpl->reqno);
@@ -83,13 +83,23 @@ int srs_connect(srs_t *srs, const char *server, int reconnect);
 /** Close connection to the server if there is one. */
 void srs_disconnect(srs_t *srs);
 
+/** Add the given commands to the command set of the client. */
+int srs_add_commands(srs_t *srs, char **commands, size_t ncommand);
+
+/** Remove the given commands from the command set of the client. */
+int srs_remove_commands(srs_t *srs, char **commands, size_t ncommand);
+
 /** Request the given type of focus. */
 int srs_request_focus(srs_t *srs, srs_voice_focus_t focus);
 
-/** Request rendering the given message, subscribing for the given events. */
+/**
+ * Request rendering the given message with the given priority (one of
+ * SRS_VOICE_PRIORITY_*), subscribing for the given events.
+ */
 uint32_t srs_render_voice(srs_t *srs, const char *msg, const char *voice,
                           double rate, double pitch, int timeout,
-                          int events, srs_render_notify_t cb, void *cb_data);
+                          int priority, int events, srs_render_notify_t cb,
+                          void *cb_data);
 
 /** Cancel an ongoing voice render request. */
 int srs_cancel_voice(srs_t *srs, uint32_t id);
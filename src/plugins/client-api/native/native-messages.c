@@ -53,6 +53,9 @@ mrp_typemap_t *register_message_types(void)
         MRP_TYPEMAP(SRS_EVENT_FOCUS        , MRP_INVALID_TYPE),
         MRP_TYPEMAP(SRS_EVENT_COMMAND      , MRP_INVALID_TYPE),
         MRP_TYPEMAP(SRS_EVENT_VOICE        , MRP_INVALID_TYPE),
+        MRP_TYPEMAP(SRS_REQUEST_ADDCOMMANDS, MRP_INVALID_TYPE),
+        MRP_TYPEMAP(SRS_REQUEST_DELCOMMANDS, MRP_INVALID_TYPE),
+        MRP_TYPEMAP(SRS_REQUEST_RENDERVOICEPRIO, MRP_INVALID_TYPE),
         MRP_TYPEMAP_END
     };
 
@@ -69,6 +72,20 @@ mrp_typemap_t *register_message_types(void)
                     MRP_UINT32(srs_req_unregister_t, type  , DEFAULT),
                     MRP_UINT32(srs_req_unregister_t, reqno , DEFAULT));
 
+    MRP_NATIVE_TYPE(addcmd_req, srs_req_addcmd_t,
+                    MRP_UINT32(srs_req_addcmd_t, type    , DEFAULT),
+                    MRP_UINT32(srs_req_addcmd_t, reqno   , DEFAULT),
+                    MRP_ARRAY (srs_req_addcmd_t, commands, DEFAULT, SIZED,
+                               char *, ncommand),
+                    MRP_UINT32(srs_req_addcmd_t, ncommand, DEFAULT));
+
+    MRP_NATIVE_TYPE(delcmd_req, srs_req_delcmd_t,
+                    MRP_UINT32(srs_req_delcmd_t, type    , DEFAULT),
+                    MRP_UINT32(srs_req_delcmd_t, reqno   , DEFAULT),
+                    MRP_ARRAY (srs_req_delcmd_t, commands, DEFAULT, SIZED,
+                               char *, ncommand),
+                    MRP_UINT32(srs_req_delcmd_t, ncommand, DEFAULT));
+
     MRP_NATIVE_TYPE(status_rpl, srs_rpl_status_t,
                     MRP_UINT32(srs_rpl_status_t, type  , DEFAULT),
                     MRP_UINT32(srs_rpl_status_t, reqno , DEFAULT),
@@ -94,6 +111,18 @@ mrp_typemap_t *register_message_types(void)
                     MRP_UINT32(srs_req_voice_t, timeout , DEFAULT),
                     MRP_UINT32(srs_req_voice_t, events  , DEFAULT));
 
+    /* a separate type for prioritized requests keeps the above intact */
+    MRP_NATIVE_TYPE(voiceprio_req, srs_req_voice_t,
+                    MRP_UINT32(srs_req_voice_t, type    , DEFAULT),
+                    MRP_UINT32(srs_req_voice_t, reqno   , DEFAULT),
+                    MRP_STRING(srs_req_voice_t, msg     , DEFAULT),
+                    MRP_STRING(srs_req_voice_t, voice   , DEFAULT),
+                    MRP_DOUBLE(srs_req_voice_t, rate    , DEFAULT),
+                    MRP_DOUBLE(srs_req_voice_t, pitch   , DEFAULT),
+                    MRP_UINT32(srs_req_voice_t, timeout , DEFAULT),
+                    MRP_UINT32(srs_req_voice_t, events  , DEFAULT),
+                    MRP_UINT32(srs_req_voice_t, priority, DEFAULT));
+
     MRP_NATIVE_TYPE(voice_rpl, srs_rpl_voice_t,
                     MRP_UINT32(srs_rpl_voice_t, type , DEFAULT),
                     MRP_UINT32(srs_rpl_voice_t, reqno, DEFAULT),
@@ -156,6 +185,9 @@ mrp_typemap_t *register_message_types(void)
         { SRS_EVENT_FOCUS        , &focus_evt    },
         { SRS_EVENT_COMMAND      , &command_evt  },
         { SRS_EVENT_VOICE        , &voice_evt    },
+        { SRS_REQUEST_ADDCOMMANDS, &addcmd_req   },
+        { SRS_REQUEST_DELCOMMANDS, &delcmd_req   },
+        { SRS_REQUEST_RENDERVOICEPRIO, &voiceprio_req },
         { MRP_INVALID_TYPE       , NULL          },
     }, *t;
     mrp_typemap_t *m;
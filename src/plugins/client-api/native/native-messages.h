@@ -60,6 +60,11 @@ typedef enum {
     SRS_EVENT_COMMAND,
     SRS_EVENT_VOICE,
 
+    /* later additions, appended to keep existing ids on the wire intact */
+    SRS_REQUEST_ADDCOMMANDS,
+    SRS_REQUEST_DELCOMMANDS,
+    SRS_REQUEST_RENDERVOICEPRIO,
+
     SRS_MSG_MAX
 } srs_msg_type_t;
 
@@ -88,6 +93,21 @@ typedef struct {
 } srs_req_unregister_t;
 
 
+/*
+ * command addition or removal request
+ */
+
+typedef struct {
+    uint32_t   type;                     /* SRS_REQUEST_{ADD,DEL}COMMANDS */
+    uint32_t   reqno;                    /* request number */
+    char     **commands;                 /* speech commands */
+    uint32_t   ncommand;                 /* number of speech commands */
+} srs_req_commands_t;
+
+typedef srs_req_commands_t srs_req_addcmd_t;
+typedef srs_req_commands_t srs_req_delcmd_t;
+
+
 /*
  * error codes
  */
@@ -136,7 +156,7 @@ typedef struct {
  */
 
 typedef struct {
-    uint32_t  type;                      /* SRS_REQUEST_VOICERENDER */
+    uint32_t  type;                      /* SRS_REQUEST_RENDERVOICE{,PRIO} */
     uint32_t  reqno;                     /* request number */
     char     *msg;                       /* message to render */
     char     *voice;                     /* voice to use */
@@ -144,6 +164,7 @@ typedef struct {
     double    pitch;                     /* voice pitch (0 or 1 = default) */
     uint32_t  timeout;                   /* message timeout */
     uint32_t  events;                    /* mask of events to notify about */
+    uint32_t  priority;                  /* priority, only for *PRIO */
 } srs_req_voice_t;
 
 
@@ -238,6 +259,7 @@ typedef union {
     srs_rpl_any_t          any_rpl;
     srs_req_register_t     reg_req;
     srs_req_unregister_t   bye_req;
+    srs_req_commands_t     cmd_req;
     srs_rpl_status_t       status_rpl;
     srs_req_focus_t        focus_req;
     srs_evt_focus_t        focus_evt;
@@ -87,6 +87,7 @@ static int reply_status(client_t *c, uint32_t reqno, int status,
 #define reply_register   reply_status
 #define reply_unregister reply_status
 #define reply_focus      reply_status
+#define reply_commands   reply_status
 static int reply_render(client_t *c, uint32_t reqno, uint32_t id);
 static int reply_voiceqry(client_t *c, uint32_t reqno,
                           srs_voice_actor_t *actors, int nactor);
@@ -184,7 +185,7 @@ static void request_focus(client_t *c, srs_req_focus_t *req)
 }
 
 
-static void request_voice(client_t *c, srs_req_voice_t *req)
+static void request_voice(client_t *c, srs_req_voice_t *req, int prio)
 {
     const char *msg     = req->msg;
     const char *voice   = req->voice;
@@ -196,7 +197,8 @@ static void request_voice(client_t *c, srs_req_voice_t *req)
 
     mrp_debug("received voice render request from native client #%d", c->id);
 
-    reqid = client_render_voice(c->c, msg, voice, rate, pitch, timeout, events);
+    reqid = client_render_voice(c->c, msg, voice, rate, pitch, timeout, prio,
+                                events);
 
     if (reqid != SRS_VOICE_INVALID)
         reply_render(c, req->reqno, reqid);
@@ -214,6 +216,35 @@ static void cancel_voice(client_t *c, srs_ccl_voice_t *req)
 }
 
 
+static void add_commands(client_t *c, srs_req_commands_t *req)
+{
+    char **cmds = req->commands;
+    int    ncmd = req->ncommand;
+
+    mrp_debug("received add commands request from native client #%d", c->id);
+
+    if (client_add_commands(c->c, cmds, ncmd))
+        reply_commands(c, req->reqno, SRS_STATUS_OK, "OK");
+    else
+        reply_commands(c, req->reqno, SRS_STATUS_FAILED, "failed");
+}
+
+
+static void del_commands(client_t *c, srs_req_commands_t *req)
+{
+    char **cmds = req->commands;
+    int    ncmd = req->ncommand;
+
+    mrp_debug("received remove commands request from native client #%d",
+              c->id);
+
+    if (client_remove_commands(c->c, cmds, ncmd))
+        reply_commands(c, req->reqno, SRS_STATUS_OK, "OK");
+    else
+        reply_commands(c, req->reqno, SRS_STATUS_FAILED, "failed");
+}
+
+
 static void query_voices(client_t *c, srs_req_voiceqry_t *req)
 {
     srs_voice_actor_t  *actors = NULL;
@@ -398,7 +429,11 @@ static void recv_evt(mrp_transport_t *t, void *data, uint32_t type_id,
         break;
 
     case SRS_REQUEST_RENDERVOICE:
-        request_voice(c, &req->voice_req);
+        request_voice(c, &req->voice_req, SRS_VOICE_PRIORITY_NORMAL);
+        break;
+
+    case SRS_REQUEST_RENDERVOICEPRIO:
+        request_voice(c, &req->voice_req, req->voice_req.priority);
         break;
 
     case SRS_REQUEST_CANCELVOICE:
@@ -409,6 +444,14 @@ static void recv_evt(mrp_transport_t *t, void *data, uint32_t type_id,
         query_voices(c, &req->voice_qry);
         break;
 
+    case SRS_REQUEST_ADDCOMMANDS:
+        add_commands(c, &req->cmd_req);
+        break;
+
+    case SRS_REQUEST_DELCOMMANDS:
+        del_commands(c, &req->cmd_req);
+        break;
+
     default:
         break;
     }
@@ -709,6 +709,7 @@ static void request_tts(client_t *c, int ntoken, char **tokens)
     const char *voice   = "english";
     int         timeout = SRS_VOICE_QUEUE;
     int         events  = FALSE;
+    int         priority = SRS_VOICE_PRIORITY_NORMAL;
     char        msg[1024], *t, *e, *p;
     int         i, o, n;
     size_t      l;
@@ -731,6 +732,14 @@ static void request_tts(client_t *c, int ntoken, char **tokens)
             else if (!strncmp(t + 1, "voice:", o=6)) {
                 voice = t + 1 + o;
             }
+            else if (!strncmp(t + 1, "priority:", o=9)) {
+                priority = strtol(t + 1 + o, &e, 10);
+                if (*e != '\0' || priority < SRS_VOICE_PRIORITY_LOW ||
+                    priority >= SRS_VOICE_PRIORITY_MAX) {
+                    print(c, "Invalid priority: %s.", t + 1 + o);
+                    return;
+                }
+            }
         }
         else {
             n = snprintf(p, l, "%s%s", sep, t);
@@ -747,7 +756,7 @@ static void request_tts(client_t *c, int ntoken, char **tokens)
 
     print(c, "Requesting TTS for message: '%s'.", msg);
 
-    c->vreq = srs_render_voice(c->srs, msg, voice, 0, 0, timeout,
+    c->vreq = srs_render_voice(c->srs, msg, voice, 0, 0, timeout, priority,
                                events ? SRS_VOICE_MASK_ALL:SRS_VOICE_MASK_NONE,
                                render_notify, NULL);
 }
@@ -804,6 +813,7 @@ static void execute_user_command(client_t *c, int narg, char **args)
             print(c, "  render tts '<msg>' \\        - request TTS of <msg>");
             print(c, "    [-voice:<voice>] \\");
             print(c, "    [-timeout:<timeout>]\\");
+            print(c, "    [-priority:<0-3>]\\");
             print(c, "    [-events]");
             print(c, "  cancel tts '<id>'            - cancel given TTS "
                   "request");
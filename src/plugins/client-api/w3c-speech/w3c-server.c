@@ -29,12 +29,17 @@
 
 #include <errno.h>
 #include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/inotify.h>
 
 #include <murphy/common/macros.h>
 #include <murphy/common/debug.h>
 #include <murphy/common/log.h>
 #include <murphy/common/mm.h>
 #include <murphy/common/mainloop.h>
+#include <murphy/common/hashtbl.h>
 #include <murphy/common/transport.h>
 #include <murphy/common/json.h>
 
@@ -74,6 +79,11 @@ typedef struct {
     mrp_transport_t *lt;                 /* transport we listen on */
     mrp_list_hook_t  clients;            /* connected clients */
     int              next_id;            /* next client id */
+    mrp_list_hook_t  grammars;           /* loaded grammars, shared */
+    mrp_htbl_t      *gtbl;               /* loaded grammars by URI */
+    int              ifd;                /* inotify fd for grammar_dir */
+    mrp_io_watch_t  *iw;                 /*     and its I/O watch */
+    mrp_deferred_t  *reload;             /* deferred grammar (re)loading */
 } w3c_server_t;
 
 
@@ -142,6 +152,24 @@ struct w3c_client_s {
 };
 
 
+/*
+ * commands read from a grammar, or added dynamically
+ *
+ * Grammars are loaded once per server and shared by all recognizers
+ * using the same grammar URI. Loaded grammars are kept around even if
+ * unused, and reloaded whenever their file changes.
+ */
+
+typedef struct {
+    mrp_list_hook_t   hook;              /* to list of loaded grammars */
+    int               refcnt;            /* number of recognizers using us */
+    bool              stale;             /* needs to be (re)loaded */
+    char             *src;               /* grammar URI, or NULL */
+    char            **commands;          /* commands */
+    int               ncommand;          /* number of commands */
+} w3c_grammar_t;
+
+
 /*
  * a W3C recognizer instance
  */
@@ -158,7 +186,7 @@ typedef struct {
     int        max_alt;                  /* max. alternatives to deliver */
     char      *service;                  /* recognizer service URI */
     bool       shared;                   /* whether use shared focus */
-    char     **commands;                 /* commands from grammars */
+    char     **commands;                 /* commands (of grammars, dynamic) */
     int        ncommand;                 /* number of commands */
 } w3c_rec_attr_t;
 
@@ -172,6 +200,9 @@ typedef struct {
     srs_client_t    *srsc;               /* associated backend client */
     int              request;            /* W3C client request */
     int              backend;            /* W3C backend state */
+    w3c_grammar_t  **gcache;             /* commands of loaded grammars */
+    int              ngcache;            /* number of loaded grammars */
+    w3c_grammar_t    dynamic;            /* dynamically added commands */
 } w3c_recognizer_t;
 
 
@@ -270,6 +301,8 @@ typedef int (*request_handler_t)(w3c_client_t *c, int reqno, mrp_json_t *req);
 static int create_synthesizer(w3c_client_t *c);
 static void destroy_synthesizer(w3c_synthesizer_t *syn);
 static void destroy_recognizer(w3c_recognizer_t *rec);
+static void free_grammar(w3c_grammar_t *g);
+static void put_grammar(w3c_grammar_t *g);
 static w3c_utterance_t *lookup_utterance(w3c_client_t *c, int id, uint32_t vid);
 static void destroy_utterance(w3c_utterance_t *utt);
 
@@ -1024,7 +1057,8 @@ static int activate_utterance(w3c_utterance_t *utt)
 
     if (!utt->syn->paused) {
         utt->vid = client_render_voice(utt->syn->srsc, msg, voice, rate, pitch,
-                                       timeout, events);
+                                       timeout, SRS_VOICE_PRIORITY_NORMAL,
+                                       events);
 
         if (utt->vid == SRS_VOICE_INVALID) {
             errno = EINVAL;
@@ -1382,6 +1416,11 @@ static void destroy_recognizer(w3c_recognizer_t *rec)
         mrp_free(rec->attr.grammars[i]);
     mrp_free(rec->attr.grammars);
 
+    for (i = 0; i < rec->ngcache; i++)
+        put_grammar(rec->gcache[i]);
+    mrp_free(rec->gcache);
+    free_grammar(&rec->dynamic);
+    mrp_free(rec->attr.commands);
 
     mrp_free(rec);
 }
@@ -1414,7 +1453,6 @@ static int check_recognizer_attr(void *obj, w3c_attrdef_t *def, void *val,
     switch (def->mask) {
     case W3C_ATTR_NAME:
     case W3C_ATTR_APPCLASS:
-    case W3C_ATTR_GRAMMARS:
     case W3C_ATTR_LANG:
         if (rec->srsc == NULL)
             return 0;
@@ -1423,6 +1461,7 @@ static int check_recognizer_attr(void *obj, w3c_attrdef_t *def, void *val,
         *errs = W3C_BUSY;
         return -EBUSY;
 
+    case W3C_ATTR_GRAMMARS:   return 0; /* updated in place, if needed */
     case W3C_ATTR_EVENTS:     return 0;
     case W3C_ATTR_CONTINUOUS: return 0;
     case W3C_ATTR_INTERIM:    return 0;
@@ -1601,56 +1640,478 @@ static FILE *open_grammar(w3c_server_t *s, const char *URI)
 }
 
 
-int read_grammars(w3c_recognizer_t *rec, const char **errs)
+static void free_grammar(w3c_grammar_t *g)
 {
-    char **cmds, *cmd, buf[4096];
-    int    n, i;
+    int i;
+
+    for (i = 0; i < g->ncommand; i++)
+        mrp_free(g->commands[i]);
+    mrp_free(g->commands);
+    mrp_free(g->src);
+
+    g->src      = NULL;
+    g->commands = NULL;
+    g->ncommand = 0;
+}
+
+
+static int read_grammar(w3c_server_t *s, const char *src, w3c_grammar_t *g,
+                        const char **errs)
+{
+    char  *cmd, buf[4096];
     FILE  *fp;
 
-    cmds = NULL;
-    n    = 0;
+    fp = open_grammar(s, src);
+
+    if (fp == NULL) {
+        *errs = W3C_BADGRAMMAR;
+        return -1;
+    }
+
+    while (fgets(buf, sizeof(buf), fp) != NULL) {
+        cmd = strip_whitespace(buf);
 
-    for (i = 0; i < rec->attr.ngrammar; i++) {
-        fp = open_grammar(rec->c->s, rec->attr.grammars[i]);
+        if (!*cmd)
+            continue;
 
-        if (fp == NULL) {
-            *errs = W3C_BADGRAMMAR;
-            goto fail;
-        }
+        if (mrp_reallocz(g->commands, g->ncommand, g->ncommand + 1) == NULL ||
+            (g->commands[g->ncommand] = mrp_strdup(cmd)) == NULL)
+            goto nomem;
+
+        mrp_debug("command #%d: '%s'", g->ncommand, cmd);
+
+        g->ncommand++;
+    }
+
+    fclose(fp);
+
+    return 0;
+
+ nomem:
+    fclose(fp);
+    free_grammar(g);
+    *errs = W3C_NOMEM;
+    errno = ENOMEM;
+
+    return -1;
+}
+
+
+static w3c_grammar_t *add_grammar(w3c_server_t *s, const char *src)
+{
+    w3c_grammar_t *g;
+
+    if ((g = mrp_allocz(sizeof(*g))) == NULL)
+        return NULL;
 
-        while (fgets(buf, sizeof(buf), fp) != NULL) {
-            cmd = strip_whitespace(buf);
+    mrp_list_init(&g->hook);
+    g->stale = true;
 
-            if (!*cmd)
+    if ((g->src = mrp_strdup(src)) == NULL ||
+        !mrp_htbl_insert(s->gtbl, g->src, g)) {
+        mrp_free(g->src);
+        mrp_free(g);
+        return NULL;
+    }
+
+    mrp_list_append(&s->grammars, &g->hook);
+
+    return g;
+}
+
+
+static void drop_grammar(w3c_server_t *s, w3c_grammar_t *g)
+{
+    mrp_debug("W3C: dropping grammar '%s'", g->src);
+
+    mrp_htbl_remove(s->gtbl, g->src, FALSE);
+    mrp_list_delete(&g->hook);
+    free_grammar(g);
+    mrp_free(g);
+}
+
+
+static bool uses_grammar(w3c_recognizer_t *rec, w3c_grammar_t *g)
+{
+    int i;
+
+    for (i = 0; i < rec->ngcache; i++)
+        if (rec->gcache[i] == g)
+            return true;
+
+    return false;
+}
+
+
+static int collect_commands(w3c_recognizer_t *rec, const char **errs);
+
+static void update_recognizers(w3c_server_t *s, w3c_grammar_t *g)
+{
+    mrp_list_hook_t  *cp, *cn, *rp, *rn;
+    w3c_client_t     *c;
+    w3c_recognizer_t *rec;
+    const char       *errs;
+
+    /*
+     * Swap the full new command set in for every user of the grammar.
+     * Recognizers with the same grammars keep sharing a single set.
+     */
+
+    mrp_list_foreach(&s->clients, cp, cn) {
+        c = mrp_list_entry(cp, typeof(*c), hook);
+
+        mrp_list_foreach(&c->recognizers, rp, rn) {
+            rec = mrp_list_entry(rp, typeof(*rec), hook);
+
+            if (!uses_grammar(rec, g))
                 continue;
 
-            if (mrp_reallocz(cmds, n, n + 1) == NULL ||
-                (cmds[n] = mrp_strdup(cmd))  == NULL) {
-                *errs = W3C_NOMEM;
-                goto fail;
+            if (collect_commands(rec, &errs) < 0 ||
+                (rec->srsc != NULL &&
+                 !client_set_commands(rec->srsc, rec->attr.commands,
+                                      rec->attr.ncommand)))
+                mrp_log_error("W3C: failed to update recognizer #%d.%d "
+                              "with grammar '%s'.", c->id, rec->id, g->src);
+        }
+    }
+}
+
+
+static int load_grammar(w3c_server_t *s, w3c_grammar_t *g, const char **errs)
+{
+    w3c_grammar_t   old;
+    char          **commands;
+    int             ncommand;
+
+    memset(&old, 0, sizeof(old));
+
+    if (read_grammar(s, g->src, &old, errs) < 0)
+        return -1;
+
+    /* swap in the new commands, leaving the old ones in old */
+    commands     = g->commands;
+    ncommand     = g->ncommand;
+    g->commands  = old.commands;
+    g->ncommand  = old.ncommand;
+    old.commands = commands;
+    old.ncommand = ncommand;
+    g->stale     = false;
+
+    mrp_log_info("W3C: loaded grammar '%s' (%d commands).", g->src,
+                 g->ncommand);
+
+    if (g->refcnt > 0)
+        update_recognizers(s, g);
+
+    free_grammar(&old);
+
+    return 0;
+}
+
+
+static w3c_grammar_t *get_grammar(w3c_server_t *s, const char *src,
+                                  const char **errs)
+{
+    w3c_grammar_t *g;
+
+    if ((g = mrp_htbl_lookup(s->gtbl, (void *)src)) == NULL) {
+        if ((g = add_grammar(s, src)) == NULL) {
+            *errs = W3C_NOMEM;
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+    else
+        mrp_debug("W3C: found grammar '%s' in cache", src);
+
+    if (g->stale && load_grammar(s, g, errs) < 0) {
+        if (g->refcnt == 0)
+            drop_grammar(s, g);
+        return NULL;
+    }
+
+    g->refcnt++;
+
+    return g;
+}
+
+
+static void put_grammar(w3c_grammar_t *g)
+{
+    /* unused grammars stay cached until dropped by reloading */
+    if (g != NULL)
+        g->refcnt--;
+}
+
+
+static void reload_cb(mrp_deferred_t *d, void *user_data)
+{
+    w3c_server_t    *s = (w3c_server_t *)user_data;
+    mrp_list_hook_t *p, *n;
+    w3c_grammar_t   *g;
+    const char      *errs;
+
+    /* (re)load one stale grammar per mainloop iteration */
+
+    mrp_list_foreach(&s->grammars, p, n) {
+        g = mrp_list_entry(p, typeof(*g), hook);
+
+        if (!g->stale)
+            continue;
+
+        if (load_grammar(s, g, &errs) < 0) {
+            if (g->refcnt == 0)
+                drop_grammar(s, g);
+            else {
+                mrp_log_warning("W3C: failed to reload grammar '%s', "
+                                "keeping old commands.", g->src);
+                g->stale = false;
             }
+        }
+
+        return;
+    }
+
+    mrp_disable_deferred(d);
+}
+
+
+static void invalidate_grammar(w3c_server_t *s, const char *name)
+{
+    char           src[PATH_MAX];
+    w3c_grammar_t *g;
+
+    /* ignore hidden files and editor backups */
+    if (name[0] == '.' || name[strlen(name) - 1] == '~')
+        return;
+
+    snprintf(src, sizeof(src), "%s%s", W3C_URI, name);
+
+    if ((g = mrp_htbl_lookup(s->gtbl, src)) == NULL)
+        g = add_grammar(s, src);
+
+    if (g != NULL) {
+        mrp_debug("W3C: grammar '%s' needs (re)loading", src);
+        g->stale = true;
+        mrp_enable_deferred(s->reload);
+    }
+}
+
+
+static void grammar_dir_cb(mrp_io_watch_t *w, int fd, mrp_io_event_t events,
+                           void *user_data)
+{
+    w3c_server_t         *s = (w3c_server_t *)user_data;
+    char                  buf[4096]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct inotify_event *e;
+    ssize_t               n;
+    char                 *p;
 
-            mrp_debug("command #%d: '%s'", n, cmd);
+    MRP_UNUSED(w);
 
-            n++;
+    if (!(events & MRP_IO_EVENT_IN))
+        return;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (p = buf; p < buf + n; p += sizeof(*e) + e->len) {
+            e = (struct inotify_event *)p;
+
+            if (e->len > 0 && *e->name)
+                invalidate_grammar(s, e->name);
         }
+    }
+}
+
+
+static int grammar_watch_create(w3c_server_t *s)
+{
+    srs_context_t *srs = s->self->srs;
+    uint32_t       mask;
+    DIR           *dir;
+    struct dirent *de;
+
+    s->reload = mrp_add_deferred(srs->ml, reload_cb, s);
 
-        fclose(fp);
+    if (s->reload == NULL)
+        return -1;
+
+    mrp_disable_deferred(s->reload);
+
+    mask   = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+    s->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (s->ifd < 0 || inotify_add_watch(s->ifd, s->grammar_dir, mask) < 0) {
+        mrp_log_warning("W3C: can't watch grammar directory '%s' (%d: %s), "
+                        "grammar changes will not be noticed.",
+                        s->grammar_dir, errno, strerror(errno));
     }
+    else {
+        s->iw = mrp_add_io_watch(srs->ml, s->ifd, MRP_IO_EVENT_IN,
+                                 grammar_dir_cb, s);
 
-    for (i = 0; i < rec->attr.ncommand; i++)
-        mrp_free(rec->attr.commands[i]);
-    mrp_free(rec->attr.commands);
+        if (s->iw == NULL)
+            return -1;
+    }
+
+    /* preload all grammars in the background */
+    if ((dir = opendir(s->grammar_dir)) != NULL) {
+        while ((de = readdir(dir)) != NULL)
+            if (de->d_type == DT_REG || de->d_type == DT_LNK ||
+                de->d_type == DT_UNKNOWN)
+                invalidate_grammar(s, de->d_name);
 
+        closedir(dir);
+    }
+
+    return 0;
+}
+
+
+static void grammar_watch_destroy(w3c_server_t *s)
+{
+    mrp_list_hook_t *p, *n;
+
+    mrp_del_io_watch(s->iw);
+    s->iw = NULL;
+
+    if (s->ifd >= 0) {
+        close(s->ifd);
+        s->ifd = -1;
+    }
+
+    mrp_del_deferred(s->reload);
+    s->reload = NULL;
+
+    mrp_list_foreach(&s->grammars, p, n)
+        drop_grammar(s, mrp_list_entry(p, w3c_grammar_t, hook));
+}
+
+
+static int collect_commands(w3c_recognizer_t *rec, const char **errs)
+{
+    w3c_grammar_t  *g;
+    char          **cmds;
+    int             n, i, j;
+
+    /*
+     * The collected array refers to, but does not own the commands. If
+     * we fail, drop the old array too, as our caller might be about to
+     * free the grammar commands it refers to.
+     */
+
+    n = rec->dynamic.ncommand;
+    for (i = 0; i < rec->ngcache; i++)
+        n += rec->gcache[i]->ncommand;
+
+    if ((cmds = mrp_allocz_array(char *, n + 1)) == NULL) {
+        mrp_free(rec->attr.commands);
+        rec->attr.commands = NULL;
+        rec->attr.ncommand = 0;
+        *errs = W3C_NOMEM;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    n = 0;
+    for (i = 0; i <= rec->ngcache; i++) {
+        g = i < rec->ngcache ? rec->gcache[i] : &rec->dynamic;
+
+        for (j = 0; j < g->ncommand; j++)
+            cmds[n++] = g->commands[j];
+    }
+
+    mrp_free(rec->attr.commands);
     rec->attr.commands = cmds;
     rec->attr.ncommand = n;
 
+    return 0;
+}
+
+
+int read_grammars(w3c_recognizer_t *rec, const char **errs)
+{
+    w3c_grammar_t **grams, **ogcache;
+    int            *fresh, *used, ngram, ongcache, status, i, k;
+    const char     *e;
+
+    /*
+     * Only look up the grammars we are not using yet and keep the rest.
+     * If we already have a backend client, swap in the new command set
+     * for it, going back to the old grammars if that fails.
+     */
+
+    ngram = rec->attr.ngrammar;
+    grams = mrp_allocz_array(w3c_grammar_t *, ngram + 1);
+    fresh = mrp_allocz_array(int, ngram + 1);
+    used  = mrp_allocz_array(int, rec->ngcache + 1);
+
+    if (grams == NULL || fresh == NULL || used == NULL) {
+        *errs = W3C_NOMEM;
+        errno = ENOMEM;
+        goto fail;
+    }
+
+    for (i = 0; i < ngram; i++) {
+        for (k = 0; k < rec->ngcache; k++)
+            if (!used[k] && !strcmp(rec->gcache[k]->src, rec->attr.grammars[i]))
+                break;
+
+        if (k < rec->ngcache) {
+            grams[i] = rec->gcache[k];
+            used[k]  = TRUE;
+        }
+        else {
+            grams[i] = get_grammar(rec->c->s, rec->attr.grammars[i], errs);
+
+            if (grams[i] == NULL)
+                goto fail;
+
+            fresh[i] = TRUE;
+        }
+    }
+
+    ogcache      = rec->gcache;
+    ongcache     = rec->ngcache;
+    rec->gcache  = grams;
+    rec->ngcache = ngram;
+
+    status = collect_commands(rec, errs);
+
+    if (status == 0 && rec->srsc != NULL &&
+        !client_set_commands(rec->srsc, rec->attr.commands,
+                             rec->attr.ncommand)) {
+        *errs  = W3C_BADGRAMMAR;
+        errno  = EINVAL;
+        status = -1;
+    }
+
+    if (status < 0) {
+        rec->gcache  = ogcache;
+        rec->ngcache = ongcache;
+        collect_commands(rec, &e);
+        goto fail;
+    }
+
+    for (k = 0; k < ongcache; k++)
+        if (!used[k])
+            put_grammar(ogcache[k]);
+
+    mrp_free(ogcache);
+    mrp_free(fresh);
+    mrp_free(used);
+
     return 0;
 
  fail:
-    for (i = 0; i < n; i++)
-        mrp_free(cmds[i]);
-    mrp_free(cmds);
+    if (grams != NULL && fresh != NULL)
+        for (i = 0; i < ngram; i++)
+            if (fresh[i])
+                put_grammar(grams[i]);
+
+    mrp_free(grams);
+    mrp_free(fresh);
+    mrp_free(used);
 
     return -1;
 }
@@ -1945,6 +2406,152 @@ static int w3c_abort_recognizer(w3c_client_t *c, int reqno, mrp_json_t *req)
 }
 
 
+static int add_dynamic_commands(w3c_recognizer_t *rec, char **cmds, int n,
+                                const char **errs)
+{
+    w3c_grammar_t *g = &rec->dynamic;
+    int            i;
+
+    if (rec->srsc != NULL && !client_add_commands(rec->srsc, cmds, n)) {
+        *errs = W3C_FAILED;
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!mrp_reallocz(g->commands, g->ncommand, g->ncommand + n))
+        goto nomem;
+
+    for (i = 0; i < n; i++) {
+        if ((g->commands[g->ncommand + i] = mrp_strdup(cmds[i])) == NULL) {
+            while (--i >= 0) {
+                mrp_free(g->commands[g->ncommand + i]);
+                g->commands[g->ncommand + i] = NULL;
+            }
+            goto nomem;
+        }
+    }
+
+    g->ncommand += n;
+
+    return collect_commands(rec, errs);
+
+ nomem:
+    if (rec->srsc != NULL)
+        client_remove_commands(rec->srsc, cmds, n);
+
+    *errs = W3C_NOMEM;
+    errno = ENOMEM;
+
+    return -1;
+}
+
+
+static int remove_dynamic_commands(w3c_recognizer_t *rec, char **cmds, int n,
+                                   const char **errs)
+{
+    w3c_grammar_t *g = &rec->dynamic;
+    bool           gone[g->ncommand + 1];
+    int            i, j;
+
+    /* only dynamically added commands can be removed */
+
+    memset(gone, 0, sizeof(gone));
+
+    for (i = 0; i < n; i++) {
+        for (j = 0; j < g->ncommand; j++)
+            if (!gone[j] && !strcmp(g->commands[j], cmds[i]))
+                break;
+
+        if (j == g->ncommand) {
+            *errs = W3C_FAILED;
+            errno = ENOENT;
+            return -1;
+        }
+
+        gone[j] = true;
+    }
+
+    if (rec->srsc != NULL && !client_remove_commands(rec->srsc, cmds, n)) {
+        *errs = W3C_FAILED;
+        return -1;
+    }
+
+    for (i = j = 0; i < g->ncommand; i++) {
+        if (gone[i])
+            mrp_free(g->commands[i]);
+        else
+            g->commands[j++] = g->commands[i];
+    }
+
+    g->ncommand = j;
+
+    return collect_commands(rec, errs);
+}
+
+
+static int update_commands(w3c_client_t *c, int reqno, mrp_json_t *req,
+                           bool add)
+{
+    w3c_recognizer_t  *rec;
+    mrp_json_t        *arr;
+    const char        *cmd, *errs;
+    char             **cmds;
+    int                id, n, i, status;
+
+    if (check_id(c, req, &id) < 0)
+        return -1;
+
+    if ((rec = check_recognizer(c, req, id)) == NULL)
+        return -1;
+
+    if ((arr = mrp_json_get(req, "args")) == NULL ||
+        mrp_json_get_type(arr) != MRP_JSON_ARRAY)
+        return malformed_request(c->t, req, "missing or invalid commands");
+
+    n = mrp_json_array_length(arr);
+
+    if ((cmds = mrp_allocz_array(char *, n + 1)) == NULL)
+        return reply_error(c->t, reqno, ENOMEM, W3C_NOMEM, req,
+                           "failed to allocate commands");
+
+    for (i = 0; i < n; i++) {
+        if (!mrp_json_array_get_item(arr, i, MRP_JSON_STRING, &cmd)) {
+            mrp_free(cmds);
+            return malformed_request(c->t, req, "invalid command #%d", i);
+        }
+
+        cmds[i] = (char *)cmd;
+    }
+
+    errs = NULL;
+
+    if (add)
+        status = add_dynamic_commands(rec, cmds, n, &errs);
+    else
+        status = remove_dynamic_commands(rec, cmds, n, &errs);
+
+    mrp_free(cmds);
+
+    if (status < 0)
+        return reply_error(c->t, reqno, errno, errs, req,
+                           "failed to %s commands", add ? "add" : "remove");
+
+    return reply_status(c->t, reqno, 0);
+}
+
+
+static int w3c_add_commands(w3c_client_t *c, int reqno, mrp_json_t *req)
+{
+    return update_commands(c, reqno, req, true);
+}
+
+
+static int w3c_remove_commands(w3c_client_t *c, int reqno, mrp_json_t *req)
+{
+    return update_commands(c, reqno, req, false);
+}
+
+
 static int w3c_create_utterance(w3c_client_t *c, int reqno, mrp_json_t *req)
 {
     w3c_synthesizer_t *syn = c->syn;
@@ -2219,6 +2826,8 @@ static request_handler_t get_handler(w3c_client_t *c, mrp_json_t *req,
         { "invoke"   , "method" , "start"     , w3c_start_recognizer  },
         { "invoke"   , "method" , "stop"      , w3c_stop_recognizer   },
         { "invoke"   , "method" , "abort"     , w3c_abort_recognizer  },
+        { "invoke"   , "method" , "add-commands"   , w3c_add_commands    },
+        { "invoke"   , "method" , "remove-commands", w3c_remove_commands },
         { "invoke"   , "method" , "speak"     , w3c_speak_utterance   },
         { "invoke"   , "method" , "cancel"    , w3c_cancel_utterance  },
         { "invoke"   , "method" , "pause"     , w3c_pause_utterance   },
@@ -2373,7 +2982,8 @@ static void transport_destroy(w3c_server_t *s)
 
 static int w3c_create(srs_plugin_t *plugin)
 {
-    w3c_server_t *s;
+    w3c_server_t      *s;
+    mrp_htbl_config_t  hcfg;
 
     mrp_debug("creating W3C Speech API plugin");
 
@@ -2382,8 +2992,22 @@ static int w3c_create(srs_plugin_t *plugin)
     if (s == NULL)
         return FALSE;
 
+    mrp_clear(&hcfg);
+    hcfg.nentry  = 32;
+    hcfg.comp    = mrp_string_comp;
+    hcfg.hash    = mrp_string_hash;
+    hcfg.free    = NULL;
+    hcfg.nbucket = hcfg.nentry;
+
+    if ((s->gtbl = mrp_htbl_create(&hcfg)) == NULL) {
+        mrp_free(s);
+        return FALSE;
+    }
+
     mrp_list_init(&s->clients);
+    mrp_list_init(&s->grammars);
     s->self = plugin;
+    s->ifd  = -1;
 
     plugin->plugin_data = s;
 
@@ -2418,7 +3042,7 @@ static int w3c_start(srs_plugin_t *plugin)
 {
     w3c_server_t *s = (w3c_server_t *)plugin->plugin_data;
 
-    if (transport_create(s) < 0)
+    if (transport_create(s) < 0 || grammar_watch_create(s) < 0)
         return FALSE;
     else
         return TRUE;
@@ -2436,6 +3060,8 @@ static void w3c_destroy(srs_plugin_t *plugin)
     w3c_server_t *s = (w3c_server_t *)plugin->plugin_data;
 
     transport_destroy(s);
+    grammar_watch_destroy(s);
+    mrp_htbl_destroy(s->gtbl, FALSE);
     mrp_free(s);
 }
 
@@ -231,7 +231,8 @@ static void tts_request_cb(GDBusConnection *c, const gchar *sender,
     mrp_log_info("WRT media client: relaying TTS request '%s' in '%s' from %s.",
                  msg, voice, sender);
 
-    id = client_render_voice(wrtc->c, msg, voice, 0, 0, timeout, events);
+    id = client_render_voice(wrtc->c, msg, voice, 0, 0, timeout,
+                             SRS_VOICE_PRIORITY_NORMAL, events);
 
     g_dbus_method_invocation_return_value(inv, g_variant_new("(u)", id));
 }
@@ -0,0 +1,448 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+
+#include "dfa.h"
+
+#define HASH_MIN 64                      /* smallest state hash table */
+
+typedef struct {
+    dfa_t    *dfa;                       /* automaton being compiled */
+    uint32_t  sstate;                    /* allocated states */
+    uint32_t  sedge;                     /* allocated edges */
+    uint32_t  sword;                     /* allocated words */
+    uint32_t  saccept;                   /* allocated accepts */
+} compiler_t;
+
+
+static uint32_t hash_state(dfa_state_t *s, dfa_edge_t *e)
+{
+    uint32_t h = 2166136261U, i;
+
+#define MIX(v) do { h ^= (uint32_t)(v); h *= 16777619U; } while (0)
+
+    MIX(s->nedge);
+    MIX(s->final);
+    MIX(s->any);
+    MIX(s->dict);
+    MIX(s->op);
+    MIX((uintptr_t)s->name);
+
+    for (i = 0; i < s->nedge; i++) {
+        MIX(e[i].id);
+        MIX(e[i].target);
+    }
+
+#undef MIX
+
+    return h;
+}
+
+
+static int equal_state(dfa_t *dfa, uint32_t idx, dfa_state_t *s,
+                       dfa_edge_t *e)
+{
+    dfa_state_t *o = dfa->states + idx;
+    dfa_edge_t  *oe;
+    uint32_t     i;
+
+    if (o->nedge != s->nedge || o->final != s->final ||
+        o->any != s->any || o->dict != s->dict ||
+        o->op != s->op || o->name != s->name)
+        return FALSE;
+
+    oe = dfa->edges + o->edge;
+    for (i = 0; i < s->nedge; i++)
+        if (oe[i].id != e[i].id || oe[i].target != e[i].target)
+            return FALSE;
+
+    return TRUE;
+}
+
+
+static uint32_t *hash_slot(dfa_t *dfa, uint32_t h, dfa_state_t *s,
+                           dfa_edge_t *e)
+{
+    uint32_t mask = dfa->hsize - 1, i, idx;
+
+    for (i = h & mask; (idx = dfa->hash[i]) != 0; i = (i + 1) & mask)
+        if (s != NULL && equal_state(dfa, idx, s, e))
+            break;
+
+    return dfa->hash + i;
+}
+
+
+static int rehash(dfa_t *dfa, uint32_t size)
+{
+    dfa_state_t *s;
+    uint32_t     i;
+
+    mrp_free(dfa->hash);
+
+    if ((dfa->hash = mrp_allocz_array(uint32_t, size)) == NULL)
+        return -1;
+
+    dfa->hsize = size;
+
+    /* the start state (0) is never merged, so it is never hashed */
+    for (i = 1; i < dfa->nstate; i++) {
+        s = dfa->states + i;
+        *hash_slot(dfa, hash_state(s, dfa->edges + s->edge), NULL, NULL) = i;
+    }
+
+    return 0;
+}
+
+
+static int cmp_nodes(const void *a, const void *b)
+{
+    srs_token_id_t ia = (*(node_t **)a)->data.token.id;
+    srs_token_id_t ib = (*(node_t **)b)->data.token.id;
+
+    return (ia > ib) - (ia < ib);
+}
+
+
+static node_t **sorted_tokens(node_t *node)
+{
+    node_t   **nodes;
+    uint32_t   i, n;
+
+    if ((nodes = mrp_alloc_array(node_t *, node->ntoken)) == NULL)
+        return NULL;
+
+    for (i = n = 0; i < node->size; i++)
+        if (node->tokens[i] != NULL)
+            nodes[n++] = node->tokens[i];
+
+    if (node->size > TRIE_SORTED_MAX)
+        qsort(nodes, n, sizeof(nodes[0]), cmp_nodes);
+
+    return nodes;
+}
+
+
+static uint32_t add_state(compiler_t *cc, dfa_state_t *s, dfa_edge_t *e,
+                          int start)
+{
+    dfa_t    *dfa = cc->dfa;
+    uint32_t *slot, h, idx, i, rank;
+
+    h = hash_state(s, e);
+
+    if (!start) {
+        slot = hash_slot(dfa, h, s, e);
+
+        if (*slot != 0)
+            return *slot;
+    }
+
+    while (dfa->nedge + s->nedge > cc->sedge) {
+        if (!mrp_reallocz(dfa->edges, cc->sedge, 2 * cc->sedge))
+            return DFA_NONE;
+        cc->sedge *= 2;
+    }
+
+    if (dfa->nstate == cc->sstate) {
+        if (!mrp_reallocz(dfa->states, cc->sstate, 2 * cc->sstate))
+            return DFA_NONE;
+        cc->sstate *= 2;
+    }
+
+    /*
+     * Accepted sequences are ranked in the order: the one ending here,
+     * then those through each token edge by token id, then those through
+     * the wildcard and finally those through the dictionary operation.
+     */
+
+    rank = s->final;
+
+    for (i = 0; i < s->nedge; i++) {
+        e[i].rank = rank;
+        rank += dfa->states[e[i].target].nword;
+    }
+
+    s->any_rank = rank;
+    if (s->any != DFA_NONE)
+        rank += dfa->states[s->any].nword;
+
+    s->dict_rank = rank;
+    if (s->dict != DFA_NONE)
+        rank += dfa->states[s->dict].nword;
+
+    s->nword = rank;
+    s->edge  = dfa->nedge;
+
+    if (s->nedge > 0)
+        memcpy(dfa->edges + dfa->nedge, e, s->nedge * sizeof(e[0]));
+    dfa->nedge += s->nedge;
+
+    if (start) {
+        dfa->states[0] = *s;
+        return 0;
+    }
+
+    idx = dfa->nstate++;
+    dfa->states[idx] = *s;
+
+    if (2 * dfa->nstate > dfa->hsize) {
+        if (rehash(dfa, 2 * dfa->hsize) < 0)
+            return DFA_NONE;
+    }
+    else
+        *hash_slot(dfa, h, NULL, NULL) = idx;
+
+    return idx;
+}
+
+
+static uint32_t compile_node(compiler_t *cc, node_t *node, int start)
+{
+    dfa_state_t   s;
+    dfa_edge_t   *e = NULL;
+    node_t      **tokens = NULL, *c;
+    uint32_t      idx = DFA_NONE, i;
+
+    /*
+     * Compile children first, so that by the time we get to a node all
+     * the states it could be merged with already exist.
+     */
+
+    memset(&s, 0, sizeof(s));
+    s.final = (node->clients != NULL);
+    s.any   = DFA_NONE;
+    s.dict  = DFA_NONE;
+
+    if (node->ntoken > 0) {
+        e      = mrp_alloc_array(dfa_edge_t, node->ntoken);
+        tokens = sorted_tokens(node);
+
+        if (e == NULL || tokens == NULL)
+            goto out;
+
+        for (i = 0; i < node->ntoken; i++) {
+            e[i].id     = tokens[i]->data.token.id;
+            e[i].target = compile_node(cc, tokens[i], FALSE);
+
+            if (e[i].target == DFA_NONE)
+                goto out;
+        }
+
+        s.nedge = node->ntoken;
+    }
+
+    if (node->any != NULL)
+        if ((s.any = compile_node(cc, node->any, FALSE)) == DFA_NONE)
+            goto out;
+
+    if ((c = node->dict) != NULL) {
+        if ((s.dict = compile_node(cc, c, FALSE)) == DFA_NONE)
+            goto out;
+
+        s.op   = c->data.dict.op;
+        s.name = srs_token_string(srs_token_intern(c->data.dict.dict,
+                                                   SRS_TOKEN_NUL));
+    }
+
+    idx = add_state(cc, &s, e, start);
+
+ out:
+    mrp_free(e);
+    mrp_free(tokens);
+
+    return idx;
+}
+
+
+static int collect_words(compiler_t *cc, node_t *node)
+{
+    dfa_t     *dfa = cc->dfa;
+    dfa_word_t *w;
+    node_t   **tokens, *c;
+    uint32_t   i;
+
+    /* walk the tree in rank order, see add_state */
+
+    if (node->clients != NULL) {
+        if (dfa->nword == cc->sword) {
+            if (!mrp_reallocz(dfa->words, cc->sword, 2 * cc->sword))
+                return -1;
+            cc->sword *= 2;
+        }
+
+        w = dfa->words + dfa->nword++;
+        w->accept = dfa->naccept;
+
+        for (c = node->clients; c != NULL; c = c->next) {
+            if (dfa->naccept == cc->saccept) {
+                if (!mrp_reallocz(dfa->accepts, cc->saccept, 2 * cc->saccept))
+                    return -1;
+                cc->saccept *= 2;
+            }
+
+            dfa->accepts[dfa->naccept].client = c->data.client.client;
+            dfa->accepts[dfa->naccept].shared = c->data.client.shared;
+            dfa->accepts[dfa->naccept].index  = c->data.client.index;
+            dfa->naccept++;
+            w->naccept++;
+        }
+    }
+
+    if (node->ntoken > 0) {
+        if ((tokens = sorted_tokens(node)) == NULL)
+            return -1;
+
+        for (i = 0; i < node->ntoken; i++) {
+            if (collect_words(cc, tokens[i]) < 0) {
+                mrp_free(tokens);
+                return -1;
+            }
+        }
+
+        mrp_free(tokens);
+    }
+
+    if (node->any != NULL && collect_words(cc, node->any) < 0)
+        return -1;
+
+    if (node->dict != NULL && collect_words(cc, node->dict) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+dfa_t *dfa_compile(trie_t *trie, uint32_t gen)
+{
+    compiler_t cc;
+    dfa_t     *dfa;
+
+    if ((dfa = mrp_allocz(sizeof(*dfa))) == NULL)
+        return NULL;
+
+    cc.dfa     = dfa;
+    cc.sstate  = 64;
+    cc.sedge   = 64;
+    cc.sword   = 64;
+    cc.saccept = 64;
+
+    dfa->gen     = gen;
+    dfa->nstate  = 1;                    /* reserve 0 for the start state */
+    dfa->states  = mrp_allocz_array(dfa_state_t, cc.sstate);
+    dfa->edges   = mrp_allocz_array(dfa_edge_t, cc.sedge);
+    dfa->words   = mrp_allocz_array(dfa_word_t, cc.sword);
+    dfa->accepts = mrp_allocz_array(dfa_accept_t, cc.saccept);
+
+    if (dfa->states == NULL || dfa->edges == NULL ||
+        dfa->words == NULL || dfa->accepts == NULL ||
+        rehash(dfa, HASH_MIN) < 0 ||
+        compile_node(&cc, trie->root, TRUE) == DFA_NONE ||
+        collect_words(&cc, trie->root) < 0) {
+        dfa_free(dfa);
+        return NULL;
+    }
+
+    /* the merge table is only needed while compiling */
+    mrp_free(dfa->hash);
+    dfa->hash  = NULL;
+    dfa->hsize = 0;
+
+    mrp_log_info("Compiled %zu command tree nodes into %u states, %u edges "
+                 "for %u commands.", trie->nnode, dfa->nstate, dfa->nedge,
+                 dfa->naccept);
+
+    return dfa;
+}
+
+
+void dfa_free(dfa_t *dfa)
+{
+    if (dfa == NULL)
+        return;
+
+    mrp_free(dfa->states);
+    mrp_free(dfa->edges);
+    mrp_free(dfa->words);
+    mrp_free(dfa->accepts);
+    mrp_free(dfa->hash);
+    mrp_free(dfa);
+}
+
+
+uint32_t dfa_next(dfa_t *dfa, uint32_t state, srs_token_id_t id,
+                  uint32_t *rank, int *wild)
+{
+    dfa_state_t *s = dfa->states + state;
+    dfa_edge_t  *e = dfa->edges + s->edge;
+    uint32_t     lo, hi, mid;
+
+    lo = 0;
+    hi = s->nedge;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+
+        if (e[mid].id < id)
+            lo = mid + 1;
+        else if (e[mid].id > id)
+            hi = mid;
+        else {
+            *rank += e[mid].rank;
+            *wild  = FALSE;
+            return e[mid].target;
+        }
+    }
+
+    if (s->any == DFA_NONE)
+        return DFA_NONE;
+
+    *rank += s->any_rank;
+    *wild  = TRUE;
+
+    return s->any;
+}
+
+
+uint32_t dfa_dict(dfa_t *dfa, uint32_t state, uint32_t *rank)
+{
+    dfa_state_t *s = dfa->states + state;
+
+    if (s->dict == DFA_NONE)
+        return DFA_NONE;
+
+    *rank += s->dict_rank;
+
+    return s->dict;
+}
+
+
+dfa_accept_t *dfa_accepts(dfa_t *dfa, uint32_t state, uint32_t rank,
+                          uint32_t *naccept)
+{
+    dfa_word_t *w;
+
+    if (!dfa->states[state].final || rank >= dfa->nword) {
+        *naccept = 0;
+        return NULL;
+    }
+
+    w = dfa->words + rank;
+    *naccept = w->naccept;
+
+    return dfa->accepts + w->accept;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
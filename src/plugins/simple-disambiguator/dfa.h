@@ -0,0 +1,89 @@
+#ifndef __SRS_SIMPLE_DISAMBIGUATOR_DFA_H__
+#define __SRS_SIMPLE_DISAMBIGUATOR_DFA_H__
+
+#include "trie.h"
+
+#define DFA_NONE ((uint32_t)-1)          /* no transition */
+
+/*
+ * a minimized, table-driven command automaton
+ *
+ * Compiled from the command tree by merging all states that accept the
+ * same token sequences, regardless of which clients the commands belong
+ * to. Which commands a sequence stands for is recovered from its rank
+ * among all accepted sequences: every transition carries the number of
+ * sequences it skips over, and the sum along the path indexes a table
+ * of client commands. Wildcard and dictionary operations are explicit
+ * transitions.
+ */
+
+typedef struct {
+    srs_token_id_t  id;                  /* token */
+    uint32_t        target;              /* target state */
+    uint32_t        rank;                /* sequences skipped by this edge */
+} dfa_edge_t;
+
+typedef struct {
+    uint32_t        edge;                /* first token edge */
+    uint32_t        nedge;               /* number of token edges */
+    uint32_t        final;               /* whether a command ends here */
+    uint32_t        nword;               /* sequences accepted from here */
+    uint32_t        any;                 /* wildcard target */
+    uint32_t        any_rank;            /*     sequences it skips over */
+    uint32_t        dict;                /* dictionary operation target */
+    uint32_t        dict_rank;           /*     sequences it skips over */
+    srs_dict_op_t   op;                  /* dictionary operation */
+    const char     *name;                /* dictionary name (interned) */
+} dfa_state_t;
+
+typedef struct {
+    srs_client_t   *client;              /* client, or */
+    shared_t       *shared;              /* shared command set */
+    int             index;               /* command index */
+} dfa_accept_t;
+
+typedef struct {
+    uint32_t        accept;              /* first command */
+    uint32_t        naccept;             /* number of commands */
+} dfa_word_t;
+
+typedef struct {
+    dfa_state_t    *states;              /* states, 0 is the start state */
+    uint32_t        nstate;
+    dfa_edge_t     *edges;               /* token edges of all states */
+    uint32_t        nedge;
+    dfa_word_t     *words;               /* commands by sequence rank */
+    uint32_t        nword;
+    dfa_accept_t   *accepts;             /* client commands */
+    uint32_t        naccept;
+    uint32_t       *hash;                /* state hash table for merging */
+    uint32_t        hsize;
+    uint32_t        gen;                 /* compilation generation */
+} dfa_t;
+
+/** Compile the given command tree into a minimized automaton. */
+dfa_t *dfa_compile(trie_t *trie, uint32_t gen);
+
+/** Free the given automaton. */
+void dfa_free(dfa_t *dfa);
+
+/** Follow the transition for token id (or a wildcard) from state. */
+uint32_t dfa_next(dfa_t *dfa, uint32_t state, srs_token_id_t id,
+                  uint32_t *rank, int *wild);
+
+/** Follow the dictionary operation transition from state. */
+uint32_t dfa_dict(dfa_t *dfa, uint32_t state, uint32_t *rank);
+
+/** Get the client commands accepted at state for the given rank. */
+dfa_accept_t *dfa_accepts(dfa_t *dfa, uint32_t state, uint32_t rank,
+                          uint32_t *naccept);
+
+#endif /* __SRS_SIMPLE_DISAMBIGUATOR_DFA_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
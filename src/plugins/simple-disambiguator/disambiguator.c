@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 
@@ -10,41 +11,21 @@
 #include "srs/daemon/client.h"
 #include "srs/daemon/recognizer.h"
 
+#include "trie.h"
+#include "dfa.h"
+
 #define DISAMB_NAME     "simple-disambiguator"
 #define DISAMB_INFO     "A test disambiguator."
 #define DISAMB_AUTHORS  "Krisztian Litkey <kli@iki.fi>"
 #define DISAMB_VERSION  "0.0.1"
 
 #define MAX_DICT  256                    /* max. dictionary name length */
-#define MAX_DEPTH 256                    /* max. token tree depth */
-
-
-typedef enum {
-    NODE_TYPE_UNKNOWN = 0,
-    NODE_TYPE_NONE    = 0,
-    NODE_TYPE_TOKEN,                     /* a command token node */
-    NODE_TYPE_DICTIONARY,                /* dictionary operation node */
-    NODE_TYPE_CLIENT,                    /* a client/command node */
-} node_type_t;
-
-typedef union {
-    char *token;                         /* for NODE_TYPE_TOKEN */
-    struct {                             /* for NODE_TYPE_CLIENT */
-        srs_client_t *client;            /*     client */
-        int           index;             /*     command index */
-    } client;
-    struct {                             /* for NODE_TYPE_DICTIONARY */
-        srs_dict_op_t  op;               /*     operation */
-        char          *dict;             /*     dictionary to switch or push */
-    } dict;
-} node_data_t;
+#define BEAM_WIDTH 8                     /* default beam width */
+#define WILDCARD_QUALITY 0.95            /* quality of a wildcard token match */
+#define FUZZ_QUALITY 0.6                 /* quality of a single token edit */
+#define MAX_FUZZ 3                       /* max. allowed token edits */
+#define CONFIG_FUZZ "disambiguator.max-fuzz"
 
-typedef struct {
-    mrp_list_hook_t hook;                /* hook to parent node */
-    node_type_t     type;                /* node type */
-    node_data_t     data;                /* type-specific node data */
-    mrp_list_hook_t children;            /* child nodes */
-} node_t;
 
 typedef enum {
     MATCH_NONE = 0,                      /* no match */
@@ -52,24 +33,66 @@ typedef enum {
     MATCH_PREFIX,                        /* token prefix match */
 } match_t;
 
+typedef enum {
+    CAND_ACTIVE = 0,                     /* still consuming tokens */
+    CAND_MATCH,                          /* consumed all, reached clients */
+    CAND_DICT,                           /* reached a dictionary operation */
+    CAND_FAILED,                         /* fell off the tree or pruned */
+} cand_state_t;
+
 typedef struct {
-    mrp_list_hook_t       hook;          /* to list of candidates */
     srs_srec_candidate_t *src;           /* candidate from the backend */
+    cand_state_t          state;         /* search state */
     int                   tknidx;        /* token index */
     int                   nchange;       /* number changes to get a match */
-    node_t               *nodes;         /* path through the tree */
-    int                   nnode;         /* path length so far */
+    node_t               *node;          /* current node in the tree */
+    uint32_t              dstate;        /* current automaton state */
+    uint32_t              rank;          /* automaton sequence rank */
+    double                quality;       /* path match quality */
+    double                score;         /* combined score */
 } candidate_t;
 
+typedef struct {
+    uint32_t              gen;           /* command set generation */
+    int                   compiled;      /* whether in the automaton */
+    node_t               *node;          /* node to continue from */
+    uint32_t              dstate;        /* or state to continue from */
+    uint32_t              rank;          /* and sequence rank so far */
+} continuation_t;
+
+typedef struct {
+    char                 *name;          /* client name */
+    int                   fuzz;          /* max. allowed edits */
+} fuzz_limit_t;
+
 typedef struct {
     srs_plugin_t    *plugin;             /* that's us */
-    node_t          *root;               /* command token tree */
-    mrp_list_hook_t  candidates;         /* recognition candidates */
-    candidate_t     *active;             /* candidate being processed */
+    trie_t          *trie;               /* command token tree */
+    int              beam;               /* beam width */
+    int              compile;            /* use a compiled automaton */
+    dfa_t           *dfa;                /* compiled automaton, if any */
+    uint32_t         gen;                /* command set generation */
+    int              fuzz;               /* default max. allowed edits */
+    fuzz_limit_t    *limits;             /* per-client max. allowed edits */
+    int              nlimit;
+    int              maxfuzz;            /* largest of all limits */
+    mrp_list_hook_t  shared;             /* registered shared sets */
 } disamb_t;
 
+typedef struct {
+    disamb_t             *dis;           /* disambiguator */
+    srs_srec_candidate_t *src;           /* candidate being matched */
+    srs_token_id_t       *tokens;        /* its token ids */
+    int                   ntoken;        /*     and their number */
+    int                 **rows;          /* edit distance rows by depth */
+    int                   nrow;
+    candidate_t          *best;          /* best match found so far */
+} fuzzy_t;
+
 
 static void disamb_del_client(srs_client_t *client, void *api_data);
+static void disamb_del_commands(srs_client_t *client, int *indices, int nindex,
+                                void *api_data);
 
 static srs_dict_op_t parse_dictionary(const char *tkn, char *dict, size_t size)
 {
@@ -113,565 +136,1057 @@ static srs_dict_op_t parse_dictionary(const char *tkn, char *dict, size_t size)
 }
 
 
-static node_t *get_token_node(node_t *prnt, const char *token, int insert)
+static node_t *get_dictionary_node(disamb_t *dis, node_t *prnt,
+                                   const char *token, int insert)
 {
-    mrp_list_hook_t *p, *n;
-    node_t          *node, *any;
-    int              cnt;
+    srs_dict_op_t op = SRS_DICT_OP_UNKNOWN;
+    char          dict[MAX_DICT];
 
-    cnt = 0;
-    any = NULL;
-    mrp_list_foreach(&prnt->children, p, n) {
-        node = mrp_list_entry(p, typeof(*node), hook);
+    if (token != NULL) {
+        op = parse_dictionary(token, dict, sizeof(dict));
 
-        if (node->type != NODE_TYPE_TOKEN) {
+        if (op == SRS_DICT_OP_UNKNOWN) {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+    else {
+        if (insert) {
             errno = EINVAL;
             return NULL;
         }
+    }
 
-        if (!strcmp(node->data.token, token))
-            return node;
+    return trie_dict_node(dis->trie, prnt, op, token ? dict : NULL, insert);
+}
 
-        if (!strcmp(node->data.token, SRS_TOKEN_WILDCARD))
-            any = node;
 
-        cnt++;
-    }
+static node_t *command_node(disamb_t *dis, srs_client_t *client,
+                            shared_t *shared, int index, int insert)
+{
+    srs_command_t   *cmd = client->commands + index;
+    char            *tkn;
+    srs_token_id_t   id;
+    int              i;
+    node_t          *prnt, *node;
 
-    /*
-     * wildcard node matches all tokens but only for pure lookups
-     */
+    prnt = dis->trie->root;
+    for (i = 0; i < cmd->ntoken; i++) {
+        tkn = cmd->tokens[i];
+
+        if (tkn[0] != '_') {
+            if (insert)
+                id = srs_token_intern(tkn, SRS_TOKEN_NUL);
+            else
+                id = srs_token_lookup(tkn, SRS_TOKEN_NUL);
+
+            if (id == SRS_TOKEN_ID_NONE)
+                return NULL;
 
-    if (!insert) {
-        if (any != NULL)
-            return any;
+            node = trie_token_node(dis->trie, prnt, id, insert);
+
+            if (node == NULL) {
+                if (insert && errno == EINVAL)
+                    mrp_log_error("Command #%d of client %s would introduce "
+                                  "ambiguity.", index, client->id);
+
+                return NULL;
+            }
+
+            prnt = node;
+        }
         else {
-            errno = ENOENT;
-            return NULL;
+            node = get_dictionary_node(dis, prnt, tkn, insert);
+
+            if (node == NULL) {
+                if (!insert)
+                    return NULL;
+
+                switch (errno) {
+                case ECHILD:
+                    mrp_log_error("Command #%d of client %s has dictionary "
+                                  "operation following a nonregular token.",
+                                  index, client->id);
+                    break;
+                case EILSEQ:
+                    mrp_log_error("Command #%d of client %s would introduce "
+                                  "ambiguous dictionary operations.",
+                                  index, client->id);
+                    break;
+                }
+                return NULL;
+            }
+
+            prnt = node;
         }
     }
 
+    if (shared != NULL)
+        return trie_shared_node(dis->trie, prnt, shared, index, insert);
+    else
+        return trie_client_node(dis->trie, prnt, client, index, insert);
+}
+
+
+static int register_command(disamb_t *dis, srs_client_t *client,
+                            shared_t *shared, int index)
+{
+    /* skip the empty slots left behind by removed commands */
+    if (client->commands[index].tokens == NULL)
+        return 0;
+
+    if (command_node(dis, client, shared, index, TRUE) == NULL)
+        return -1;
+
+    mrp_debug("added client command %s/#%d", client->id, index);
+
+    return 0;
+}
+
+
+static void unregister_command(disamb_t *dis, srs_client_t *client,
+                               shared_t *shared, int index)
+{
+    node_t *node;
+
+    if (client->commands[index].tokens == NULL)
+        return;
+
+    if ((node = command_node(dis, client, shared, index, FALSE)) == NULL)
+        return;
+
+    mrp_debug("deleting client command node %s/#%d", client->id, index);
+
+    trie_remove_node(dis->trie, node);
+}
+
+
+static shared_t *find_shared(disamb_t *dis, srs_cmdset_t *set)
+{
+    mrp_list_hook_t *p, *n;
+    shared_t        *shared;
+
+    mrp_list_foreach(&dis->shared, p, n) {
+        shared = mrp_list_entry(p, typeof(*shared), hook);
+
+        if (shared->set == set)
+            return shared;
+    }
+
+    return NULL;
+}
+
+
+static int add_shared(disamb_t *dis, srs_client_t *client)
+{
+    shared_t *shared;
+    int       i;
+
     /*
-     * a wildcard node must be the only child of its parent
+     * Register the commands of a shared set only for its first client.
+     * Any further client just joins the set, which leaves the tree (and
+     * any automaton compiled from it) intact.
      */
 
-    if (any != NULL || (cnt > 0 && !strcmp(token, SRS_TOKEN_WILDCARD))) {
-        mrp_log_error("Wildcard/non-wildcard token conflict.");
-        errno = EILSEQ;
-        return NULL;
-    }
+    if ((shared = find_shared(dis, client->cmdset)) == NULL) {
+        if ((shared = mrp_allocz(sizeof(*shared))) == NULL)
+            return -1;
 
-    node = mrp_allocz(sizeof(*node));
+        mrp_list_init(&shared->hook);
+        shared->set = client->cmdset;
 
-    if (node == NULL)
-        return NULL;
+        dis->gen++;
 
-    mrp_list_init(&node->hook);
-    mrp_list_init(&node->children);
+        for (i = 0; i < client->ncommand; i++) {
+            mrp_debug("registering shared command %s/#%d", client->id, i);
+            if (register_command(dis, client, shared, i) != 0) {
+                while (--i >= 0)
+                    unregister_command(dis, client, shared, i);
+                mrp_free(shared);
+                return -1;
+            }
+        }
 
-    node->type = NODE_TYPE_TOKEN;
-    node->data.token = mrp_strdup(token);
+        mrp_list_append(&dis->shared, &shared->hook);
+    }
 
-    if (node->data.token == NULL) {
-        mrp_free(node);
-        return NULL;
+    if (!mrp_reallocz(shared->clients, shared->nclient, shared->nclient + 1)) {
+        if (shared->nclient == 0) {
+            for (i = 0; i < client->ncommand; i++)
+                unregister_command(dis, client, shared, i);
+            mrp_list_delete(&shared->hook);
+            mrp_free(shared);
+        }
+        return -1;
     }
 
-    mrp_list_append(&prnt->children, &node->hook);
+    shared->clients[shared->nclient++] = client;
 
-    mrp_debug("added token node %s", token);
+    mrp_debug("client %s shares command set %p with %d other clients",
+              client->id, shared->set, shared->nclient - 1);
 
-    return node;
+    return 0;
 }
 
 
-static node_t *get_dictionary_node(node_t *prnt, const char *token, int insert)
+static void del_shared(disamb_t *dis, srs_client_t *client)
 {
-    srs_dict_op_t    op = SRS_DICT_OP_UNKNOWN;
-    char             dict[MAX_DICT];
-    mrp_list_hook_t *p, *n;
-    node_t          *node;
+    shared_t *shared;
+    int       i;
 
-    if (token != NULL) {
-        op = parse_dictionary(token, dict, sizeof(dict));
+    if ((shared = find_shared(dis, client->cmdset)) == NULL)
+        return;
 
-        if (op == SRS_DICT_OP_UNKNOWN) {
-            errno = EINVAL;
-            return NULL;
+    for (i = 0; i < shared->nclient; i++) {
+        if (shared->clients[i] == client) {
+            shared->clients[i] = shared->clients[--shared->nclient];
+            break;
         }
     }
-    else {
-        if (insert) {
-            errno = EINVAL;
-            return NULL;
+
+    if (shared->nclient > 0)
+        return;
+
+    dis->gen++;
+
+    for (i = 0; i < client->ncommand; i++) {
+        mrp_debug("unregistering shared command %s/#%d", client->id, i);
+        unregister_command(dis, client, shared, i);
+    }
+
+    mrp_list_delete(&shared->hook);
+    mrp_free(shared->clients);
+    mrp_free(shared);
+}
+
+
+static int disamb_add_client(srs_client_t *client, void *api_data)
+{
+    disamb_t *dis = (disamb_t *)api_data;
+    int       i;
+
+    if (client->cmdset != NULL)
+        return add_shared(dis, client);
+
+    dis->gen++;
+
+    for (i = 0; i < client->ncommand; i++) {
+        mrp_debug("registering client command %s/#%d", client->id, i);
+        if (register_command(dis, client, NULL, i) != 0) {
+            disamb_del_client(client, api_data);
+            return -1;
         }
     }
 
-    if (prnt->type != NODE_TYPE_TOKEN) {
-        errno = ECHILD;
-        return NULL;
+    return 0;
+}
+
+
+static void disamb_del_client(srs_client_t *client, void *api_data)
+{
+    disamb_t *dis = (disamb_t *)api_data;
+    int       i;
+
+    if (client->cmdset != NULL) {
+        del_shared(dis, client);
+        return;
     }
 
-    mrp_list_foreach(&prnt->children, p, n) {
-        node = mrp_list_entry(p, typeof(*node), hook);
+    dis->gen++;
 
-        if (!insert && token == NULL)
-            if (node->type == NODE_TYPE_DICTIONARY)
-                return node;
+    for (i = 0; i < client->ncommand; i++) {
+        mrp_debug("unregistering client command %s/#%d", client->id, i);
+        unregister_command(dis, client, NULL, i);
+    }
+}
 
-        if (node->type != NODE_TYPE_DICTIONARY || node->data.dict.op != op ||
-            strcmp(dict, node->data.dict.dict) != 0) {
-            errno = EILSEQ;
-            return NULL;
+
+static int disamb_add_commands(srs_client_t *client, int *indices, int nindex,
+                               void *api_data)
+{
+    disamb_t *dis = (disamb_t *)api_data;
+    int       i;
+
+    dis->gen++;
+
+    for (i = 0; i < nindex; i++) {
+        mrp_debug("registering client command %s/#%d", client->id,
+                  indices[i]);
+        if (register_command(dis, client, NULL, indices[i]) != 0) {
+            disamb_del_commands(client, indices, i + 1, api_data);
+            return -1;
         }
     }
 
-    if (!insert) {
-        errno = ENOENT;
-        return NULL;
+    return 0;
+}
+
+
+static void disamb_del_commands(srs_client_t *client, int *indices, int nindex,
+                                void *api_data)
+{
+    disamb_t *dis = (disamb_t *)api_data;
+    int       i;
+
+    dis->gen++;
+
+    for (i = 0; i < nindex; i++) {
+        mrp_debug("unregistering client command %s/#%d", client->id,
+                  indices[i]);
+        unregister_command(dis, client, NULL, indices[i]);
     }
+}
 
-    node = mrp_allocz(sizeof(*node));
 
-    if (node == NULL)
-        return NULL;
+static srs_token_id_t token_id(srs_srec_token_t *t)
+{
+    if (t->id == SRS_TOKEN_ID_NONE)
+        t->id = srs_token_intern(t->token, SRS_TOKEN_NUL);
 
-    mrp_list_init(&node->hook);
-    mrp_list_init(&node->children);
-    node->type = NODE_TYPE_DICTIONARY;
-    node->data.dict.op = op;
-    node->data.dict.dict = mrp_strdup(dict);
+    return t->id;
+}
 
-    if (node->data.dict.dict == NULL) {
-        mrp_free(node);
-        return NULL;
+
+static int append_tokens(srs_srec_result_t *res, srs_srec_candidate_t *src,
+                         int first, int last)
+{
+    const char **tokens;
+    uint32_t    *start, *end, offs;
+    int          ntoken, i, j;
+
+    /*
+     * The arrays are reallocated from the per-utterance arena. The old
+     * ones are simply abandoned and go away when the arena is reset.
+     */
+    ntoken = res->ntoken + (last - first + 1);
+    tokens = srs_arena_alloc_array(res->arena, const char *, ntoken);
+    start  = srs_arena_alloc_array(res->arena, uint32_t, ntoken);
+    end    = srs_arena_alloc_array(res->arena, uint32_t, ntoken);
+
+    if (tokens == NULL || start == NULL || end == NULL)
+        return -1;
+
+    if (res->ntoken > 0) {
+        memcpy(tokens, res->tokens, res->ntoken * sizeof(tokens[0]));
+        memcpy(start , res->start , res->ntoken * sizeof(start[0]));
+        memcpy(end   , res->end   , res->ntoken * sizeof(end[0]));
     }
 
-    mrp_list_append(&prnt->children, &node->hook);
+    offs = res->sampleoffs;
+
+    for (i = res->ntoken, j = first; j <= last; i++, j++) {
+        if ((tokens[i] = srs_token_string(token_id(src->tokens + j))) == NULL)
+            return -1;
+
+        start[i] = offs + src->tokens[j].start;
+        end[i]   = offs + src->tokens[j].end;
+    }
 
-    mrp_debug("added dictionary node %s", token);
+    res->tokens = tokens;
+    res->start  = start;
+    res->end    = end;
+    res->ntoken = ntoken;
 
-    return node;
+    return 0;
 }
 
 
-static node_t *get_client_node(node_t *prnt, srs_client_t *client, int index)
+static node_t *client_parent(node_t *node, node_t **dict)
 {
-    mrp_list_hook_t *p, *n;
-    node_t          *node;
+    /*
+     * Find the node holding the client nodes for a candidate that has
+     * consumed all of its tokens. A wildcard also matches 0 tokens so
+     * we follow immediate wildcard children further down the tree. If
+     * we run into a dictionary node instead, pass that back to the
+     * caller.
+     */
+
+    *dict = NULL;
 
-    mrp_list_foreach(&prnt->children, p, n) {
-        node = mrp_list_entry(p, typeof(*node), hook);
+    while (node != NULL) {
+        if (node->clients != NULL)
+            return node;
 
-        if (node->type != NODE_TYPE_CLIENT)
+        if (node->dict != NULL) {
+            *dict = node->dict;
             return NULL;
+        }
 
-        if (node->data.client.client == client &&
-            node->data.client.index  == index)
-            return node;
+        node = node->any;
     }
 
     return NULL;
 }
 
 
-static int register_command(disamb_t *dis, srs_client_t *client, int index)
+static void consume_wildcard(candidate_t *c)
 {
-    srs_command_t   *cmd = client->commands + index;
-    char            *tkn;
-    int              i;
-    node_t          *prnt, *node;
+    /*
+     * A wildcard swallows the rest of the tokens. Penalize each token
+     * slightly so that a more specific command wins over a catch-all
+     * one with an equally good backend score.
+     */
 
-    prnt = dis->root;
-    for (i = 0; i < cmd->ntoken; i++) {
-        tkn = cmd->tokens[i];
+    while (c->tknidx < (int)c->src->ntoken) {
+        c->quality *= WILDCARD_QUALITY;
+        c->tknidx++;
+    }
+}
 
-        if (tkn[0] != '_') {
-            node = get_token_node(prnt, tkn, TRUE);
 
-            if (node == NULL) {
-                if (errno == EINVAL)
-                    mrp_log_error("Command #%d of client %s would introduce "
-                                  "ambiguity.", index, client->id);
+static void advance_tree(disamb_t *dis, candidate_t *c)
+{
+    srs_srec_candidate_t *src = c->src;
+    node_t               *node, *dict;
+    srs_token_id_t        tkn;
 
-                return -1;
-            }
+    if (c->tknidx >= (int)src->ntoken) {
+        node = client_parent(c->node, &dict);
 
-            prnt = node;
+        if (node != NULL) {
+            c->node  = node;
+            c->state = CAND_MATCH;
         }
-        else {
-            node = get_dictionary_node(prnt, tkn, TRUE);
+        else if (dict != NULL) {
+            c->node  = dict;
+            c->state = CAND_DICT;
+        }
+        else
+            c->state = CAND_FAILED;
 
-            if (node == NULL) {
-                switch (errno) {
-                case ECHILD:
-                    mrp_log_error("Command #%d of client %s has dictionary "
-                                  "operation following a nonregular token.",
-                                  index, client->id);
-                    break;
-                case EILSEQ:
-                    mrp_log_error("Command #%d of client %s would introduce "
-                                  "ambiguous dictionary operations.",
-                                  index, client->id);
-                    break;
-                }
-                return -1;
+        return;
+    }
+
+    tkn  = token_id(src->tokens + c->tknidx);
+    node = trie_token_node(dis->trie, c->node, tkn, FALSE);
+
+    if (node == NULL) {
+        node = get_dictionary_node(dis, c->node, NULL, FALSE);
+
+        if (node != NULL) {
+            c->node  = node;
+            c->state = CAND_DICT;
+        }
+        else
+            c->state = CAND_FAILED;
+
+        return;
+    }
+
+    if (node->data.token.id == dis->trie->wildcard)
+        consume_wildcard(c);
+    else
+        c->tknidx++;
+
+    c->node  = node;
+    c->score = src->score * c->quality;
+}
+
+
+static void advance_dfa(disamb_t *dis, candidate_t *c)
+{
+    srs_srec_candidate_t *src = c->src;
+    dfa_t                *dfa = dis->dfa;
+    dfa_state_t          *s;
+    uint32_t              next;
+    int                   wild;
+
+    /*
+     * Same as advance_tree, but with table lookups. Notably, a candidate
+     * reaching a dictionary operation stays in the state the operation
+     * leaves from, since that is where its operation and name are.
+     */
+
+    if (c->tknidx >= (int)src->ntoken) {
+        for (;;) {
+            s = dfa->states + c->dstate;
+
+            if (s->final)
+                c->state = CAND_MATCH;
+            else if (s->dict != DFA_NONE)
+                c->state = CAND_DICT;
+            else if (s->any != DFA_NONE) {
+                c->rank  += s->any_rank;
+                c->dstate = s->any;
+                continue;
             }
+            else
+                c->state = CAND_FAILED;
 
-            prnt = node;
+            return;
         }
     }
 
-    node = mrp_allocz(sizeof(*node));
+    next = dfa_next(dfa, c->dstate, token_id(src->tokens + c->tknidx),
+                    &c->rank, &wild);
 
-    if (node == NULL)
-        return -1;
+    if (next == DFA_NONE) {
+        if (dfa->states[c->dstate].dict != DFA_NONE)
+            c->state = CAND_DICT;
+        else
+            c->state = CAND_FAILED;
 
-    mrp_list_init(&node->hook);
-    mrp_list_init(&node->children);
-    node->type = NODE_TYPE_CLIENT;
-    node->data.client.client = client;
-    node->data.client.index  = index;
+        return;
+    }
 
-    mrp_list_append(&prnt->children, &node->hook);
+    if (wild)
+        consume_wildcard(c);
+    else
+        c->tknidx++;
 
-    mrp_debug("added client command %s/#%d", client->id, index);
+    c->dstate = next;
+    c->score  = src->score * c->quality;
+}
+
+
+static void advance_candidate(disamb_t *dis, candidate_t *c)
+{
+    if (dis->dfa != NULL)
+        advance_dfa(dis, c);
+    else
+        advance_tree(dis, c);
+}
+
+
+static int cmp_candidates(const void *a, const void *b)
+{
+    const candidate_t *ca = *(const candidate_t **)a;
+    const candidate_t *cb = *(const candidate_t **)b;
+
+    if (ca->score > cb->score)
+        return -1;
+    if (ca->score < cb->score)
+        return +1;
 
     return 0;
 }
 
 
-static void unregister_command(disamb_t *dis, srs_client_t *client, int index)
+static candidate_t *beam_search(disamb_t *dis, srs_srec_utterance_t *utt,
+                                continuation_t *cont, srs_arena_t *arena)
 {
-    srs_command_t *cmd = client->commands + index;
-    const char    *tkn;
-    node_t        *stack[MAX_DEPTH], *prnt, *node;
-    int            i;
+    candidate_t  *cands, **beam, *c, *best;
+    int           ncand, nactive, i;
 
-    prnt = dis->root;
-    for (i = 0; i < cmd->ntoken && i < (int)MRP_ARRAY_SIZE(stack); i++) {
-        tkn = cmd->tokens[i];
+    ncand = (int)utt->ncand;
+    cands = srs_arena_alloc_array(arena, candidate_t, ncand);
+    beam  = srs_arena_alloc_array(arena, candidate_t *, ncand);
 
-        if (tkn[0] != '_')
-            node = get_token_node(prnt, tkn, FALSE);
-        else
-            node = get_dictionary_node(prnt, tkn, FALSE);
+    if (cands == NULL || beam == NULL)
+        return NULL;
 
-        if (node == NULL)
-            return;
+    for (i = 0; i < ncand; i++) {
+        c = cands + i;
+
+        c->src     = utt->cands[i];
+        c->node    = cont->node;
+        c->dstate  = cont->dstate;
+        c->rank    = cont->rank;
+        c->quality = 1.0;
 
-        stack[i] = prnt = node;
+        if (c->src != NULL)
+            c->score = c->src->score;
+        else
+            c->state = CAND_FAILED;
     }
 
-    if (i == cmd->ntoken) {
-        node = get_client_node(prnt, client, index);
+    /*
+     * Walk all candidates through the tree token by token in lockstep.
+     * Match quality never increases along a path so the score of an
+     * active candidate is an upper bound for any result it can reach.
+     * After each step we keep only the best active candidates and drop
+     * the rest.
+     */
 
-        if (node != NULL) {
-            mrp_list_delete(&node->hook);
-            mrp_free(node);
+    do {
+        nactive = 0;
+
+        for (i = 0; i < ncand; i++) {
+            c = cands + i;
+
+            if (c->state != CAND_ACTIVE)
+                continue;
+
+            advance_candidate(dis, c);
 
-            mrp_debug("deleted client command node %s/#%d",
-                      node->data.client.client->id, node->data.client.index);
+            if (c->state == CAND_ACTIVE)
+                beam[nactive++] = c;
         }
+
+        if (nactive > dis->beam) {
+            qsort(beam, nactive, sizeof(beam[0]), cmp_candidates);
+
+            for (i = dis->beam; i < nactive; i++) {
+                mrp_debug("pruning candidate %d (score %.4f)",
+                          (int)(beam[i] - cands), beam[i]->score);
+                beam[i]->state = CAND_FAILED;
+            }
+        }
+    } while (nactive > 0);
+
+    best = NULL;
+
+    for (i = 0; i < ncand; i++) {
+        c = cands + i;
+
+        if (c->state == CAND_FAILED)
+            continue;
+
+        mrp_debug("candidate %d: %s, score %.4f (backend %.4f, quality %.4f)",
+                  i, c->state == CAND_MATCH ? "match" : "dictionary",
+                  c->score, c->src->score, c->quality);
+
+        if (best == NULL || c->score > best->score)
+            best = c;
     }
 
-    i--;
+    return best;
+}
 
-    while (i >= 0) {
-        node = stack[i];
 
-        if (mrp_list_empty(&node->children)) {
-            mrp_list_delete(&node->hook);
+static int client_fuzz(disamb_t *dis, srs_client_t *client)
+{
+    int i;
 
-            switch (node->type) {
-            case NODE_TYPE_TOKEN:
-                mrp_debug("deleting token node '%s'", node->data.token);
-                mrp_free(node->data.token);
-                break;
+    if (client->name != NULL)
+        for (i = 0; i < dis->nlimit; i++)
+            if (!strcmp(dis->limits[i].name, client->name))
+                return dis->limits[i].fuzz;
 
-            case NODE_TYPE_DICTIONARY:
-                mrp_debug("deleting dictionary node 0x%x(%s)",
-                          node->data.dict.op, node->data.dict.dict);
-                mrp_free(node->data.dict.dict);
-                break;
+    return dis->fuzz;
+}
 
-            case NODE_TYPE_CLIENT: /* really should not happen */
-                mrp_log_error("Unexpected client node %s/#%d !",
-                              node->data.client.client->id,
-                              node->data.client.index);
-                break;
-            default:
-                break;
-            }
 
-            mrp_free(node);
+static int node_fuzz(disamb_t *dis, node_t *node)
+{
+    shared_t *shared;
+    node_t   *c;
+    int       fuzz, max, i;
+
+    max = -1;
+    for (c = node->clients; c != NULL; c = c->next) {
+        if ((shared = c->data.client.shared) == NULL) {
+            if ((fuzz = client_fuzz(dis, c->data.client.client)) > max)
+                max = fuzz;
+        }
+        else {
+            for (i = 0; i < shared->nclient; i++)
+                if ((fuzz = client_fuzz(dis, shared->clients[i])) > max)
+                    max = fuzz;
         }
-
-        i--;
     }
+
+    return max;
 }
 
 
-static void free_all_nodes(node_t *root)
+static void fuzzy_leaf(fuzzy_t *f, node_t *node, int depth, int cost,
+                       double quality)
 {
-    mrp_list_hook_t  nodes, *np, *nn, *cp, *cn;
-    node_t          *node;
-    int              change;
+    candidate_t *b = f->best;
+    double       score;
+    int          i;
 
-    mrp_list_init(&nodes);
+    /*
+     * Require at least one token to actually match, otherwise any short
+     * enough utterance would match any short command (or any utterance
+     * a command consisting of a single token and a wildcard).
+     */
 
-    mrp_list_delete(&root->hook);
-    mrp_list_append(&nodes, &root->hook);
-    change = TRUE;
+    if (node == NULL || node->clients == NULL || cost >= depth)
+        return;
 
-    /* collapse all nodes in the tree to a single list of nodes */
-    while (change) {
-        change = FALSE;
+    if (cost > node_fuzz(f->dis, node))
+        return;
 
-        mrp_list_foreach(&nodes, np, nn) {
-            node = mrp_list_entry(np, typeof(*node), hook);
+    score = f->src->score * quality;
+    for (i = 0; i < cost; i++)
+        score *= FUZZ_QUALITY;
 
-            mrp_list_foreach(&node->children, cp, cn) {
-                mrp_list_delete(cp);
-                mrp_list_append(&nodes, cp);
-                change = TRUE;
-            }
+    if (b->state == CAND_MATCH && score <= b->score)
+        return;
+
+    b->src     = f->src;
+    b->state   = CAND_MATCH;
+    b->tknidx  = f->ntoken;
+    b->nchange = cost;
+    b->node    = node;
+    b->dstate  = DFA_NONE;
+    b->quality = quality;
+    b->score   = score;
+}
+
+
+static void fuzzy_walk(fuzzy_t *f, node_t *node, int depth)
+{
+    int     *row = f->rows[depth], *r, n = f->ntoken, k = f->dis->maxfuzz;
+    node_t  *child, *dict;
+    double   quality;
+    int      i, j, min, cost;
+
+    /*
+     * row[j] is the number of edits needed to turn the first j tokens
+     * of the candidate into the token path leading to node. Commands
+     * ending here cost row[n]. A wildcard can swallow any remaining
+     * tokens, so it costs the best row[j] plus the usual penalty for
+     * each swallowed token.
+     */
+
+    fuzzy_leaf(f, node, depth, row[n], 1.0);
+
+    if (node->any != NULL) {
+        child   = client_parent(node->any, &dict);
+        quality = 1.0;
+
+        for (j = n; j >= 0; j--) {
+            fuzzy_leaf(f, child, depth, row[j], quality);
+            quality *= WILDCARD_QUALITY;
         }
     }
 
-    /* now free all nodes */
-    mrp_list_foreach(&nodes, np, nn) {
-        node = mrp_list_entry(np, typeof(*node), hook);
+    if (depth + 1 >= f->nrow)
+        return;
 
-        mrp_list_delete(&node->hook);
+    r = f->rows[depth + 1];
 
-        switch (node->type) {
-        case NODE_TYPE_TOKEN:
-            mrp_debug("freeing token node '%s'", node->data.token);
-            mrp_free(node->data.token);
-            break;
+    for (i = 0; i < (int)node->size; i++) {
+        if ((child = node->tokens[i]) == NULL)
+            continue;
 
-        case NODE_TYPE_DICTIONARY:
-            mrp_debug("freeing dictionary node '%s'", node->data.dict.dict);
-            break;
+        r[0] = min = row[0] + 1;
 
-        default:
-            break;
+        for (j = 1; j <= n; j++) {
+            cost = row[j - 1] + (f->tokens[j - 1] != child->data.token.id);
+
+            if (row[j] + 1 < cost)
+                cost = row[j] + 1;
+            if (r[j - 1] + 1 < cost)
+                cost = r[j - 1] + 1;
+
+            r[j] = cost;
+
+            if (cost < min)
+                min = cost;
         }
 
-        mrp_free(node);
+        /* no path through child can get back under the limit */
+        if (min <= k)
+            fuzzy_walk(f, child, depth + 1);
     }
 }
 
 
-static int disamb_add_client(srs_client_t *client, void *api_data)
+static int cmp_sources(const void *a, const void *b)
 {
-    disamb_t *dis = (disamb_t *)api_data;
-    int       i;
+    const srs_srec_candidate_t *ca = *(const srs_srec_candidate_t **)a;
+    const srs_srec_candidate_t *cb = *(const srs_srec_candidate_t **)b;
 
-    for (i = 0; i < client->ncommand; i++) {
-        mrp_debug("registering client command %s/#%d", client->id, i);
-        if (register_command(dis, client, i) != 0) {
-            disamb_del_client(client, api_data);
-            return -1;
-        }
-    }
+    if (ca->score > cb->score)
+        return -1;
+    if (ca->score < cb->score)
+        return +1;
 
     return 0;
 }
 
 
-static void disamb_del_client(srs_client_t *client, void *api_data)
+static candidate_t *fuzzy_search(disamb_t *dis, srs_srec_utterance_t *utt,
+                                 continuation_t *cont, srs_arena_t *arena)
 {
-    disamb_t *dis = (disamb_t *)api_data;
-    int       i;
+    srs_srec_candidate_t **srcs;
+    candidate_t           *best;
+    fuzzy_t                f;
+    int                    nsrc, i, j;
 
-    for (i = 0; i < client->ncommand; i++) {
-        mrp_debug("unregistering client command %s/#%d", client->id, i);
-        unregister_command(dis, client, i);
+    /*
+     * Walk the command tree once per candidate, carrying a row of the
+     * token edit distance matrix along and pruning every branch whose
+     * row has no entry within the largest allowed fuzz. With a small
+     * limit this only visits the first few levels of the tree outside
+     * the paths close to the candidate. Dictionary operations are only
+     * matched exactly, by the beam search.
+     */
+
+    srcs = srs_arena_alloc_array(arena, srs_srec_candidate_t *, utt->ncand);
+    best = srs_arena_alloc(arena, sizeof(*best));
+
+    if (srcs == NULL || best == NULL)
+        return NULL;
+
+    memset(best, 0, sizeof(*best));
+    best->state = CAND_FAILED;
+
+    for (i = nsrc = 0; i < (int)utt->ncand; i++)
+        if (utt->cands[i] != NULL)
+            srcs[nsrc++] = utt->cands[i];
+
+    qsort(srcs, nsrc, sizeof(srcs[0]), cmp_sources);
+
+    if (nsrc > dis->beam)
+        nsrc = dis->beam;
+
+    f.dis  = dis;
+    f.best = best;
+
+    for (i = 0; i < nsrc; i++) {
+        f.src    = srcs[i];
+        f.ntoken = (int)f.src->ntoken;
+        f.nrow   = f.ntoken + dis->maxfuzz + 1;
+        f.tokens = srs_arena_alloc_array(arena, srs_token_id_t, f.ntoken + 1);
+        f.rows   = srs_arena_alloc_array(arena, int *, f.nrow);
+
+        if (f.tokens == NULL || f.rows == NULL)
+            return NULL;
+
+        for (j = 0; j < f.nrow; j++)
+            if ((f.rows[j] = srs_arena_alloc_array(arena, int,
+                                                   f.ntoken + 1)) == NULL)
+                return NULL;
+
+        for (j = 0; j < f.ntoken; j++) {
+            f.tokens[j]  = token_id(f.src->tokens + j);
+            f.rows[0][j] = j;
+        }
+        f.rows[0][f.ntoken] = f.ntoken;
+
+        fuzzy_walk(&f, cont->node, 0);
     }
+
+    if (best->state != CAND_MATCH)
+        return NULL;
+
+    mrp_debug("fuzzy match: score %.4f (backend %.4f, quality %.4f), "
+              "%d edits", best->score, best->src->score, best->quality,
+              best->nchange);
+
+    return best;
 }
 
 
-static int disambiguate(srs_srec_utterance_t *utt, srs_srec_result_t **result,
-                        void *api_data)
+static int update_dfa(disamb_t *dis)
 {
-    disamb_t             *dis = (disamb_t *)api_data;
-    srs_srec_candidate_t *src;
-    srs_srec_result_t    *res;
-    srs_srec_match_t     *m;
-    const char           *tkn;
-    mrp_list_hook_t      *p, *n;
-    node_t               *node, *child, *prnt;
-    int                   i, j, end, match;
-    uint32_t              offs;
+    /*
+     * Recompile lazily, on the first utterance after the set of
+     * registered commands has changed.
+     */
 
-    mrp_debug("should disambiguate utterance %p", utt);
+    if (!dis->compile || (dis->dfa != NULL && dis->dfa->gen == dis->gen))
+        return 0;
+
+    dfa_free(dis->dfa);
+    dis->dfa = dfa_compile(dis->trie, dis->gen);
 
-    /* XXX handling multiple candidates currently not implemented */
-    if (utt->ncand > 1) {
-        mrp_log_warning("Handling multiple candidates not implemented.");
-        mrp_log_warning("Ignoring all but first candidate.");
+    if (dis->dfa == NULL) {
+        mrp_log_error("Failed to compile commands, using the command tree.");
+        return -1;
     }
 
-    src = utt->cands[0];
-    res = *result;
+    return 0;
+}
 
-    if (res != NULL) {
-        if (res->type == SRS_SREC_RESULT_DICT)
-            node = res->result.dict.state;
-        else
-            node = dis->root;
-    }
-    else {
-        mrp_log_error("Expected result buffer not found.");
+
+static int add_match(srs_srec_result_t *res, candidate_t *c,
+                     srs_client_t *client, int index)
+{
+    srs_srec_match_t *m;
+
+    m = srs_arena_alloc(res->arena, sizeof(*m));
+
+    if (m == NULL)
         return -1;
+
+    mrp_list_init(&m->hook);
+    m->client = client;
+    m->index  = index;
+    m->score  = c->score;
+    m->fuzz   = c->nchange;
+    m->tokens = NULL;
+
+    mrp_list_append(&res->result.matches, &m->hook);
+
+    mrp_log_info("Found matching command %s/#%d (score %.4f, fuzz %d).",
+                 m->client->id, m->index, m->score, m->fuzz);
+
+    return 0;
+}
+
+
+static int add_matches(disamb_t *dis, srs_srec_result_t *res, candidate_t *c,
+                       srs_client_t *client, shared_t *shared, int index)
+{
+    int i;
+
+    /* a command of a shared set matches for every client sharing it */
+
+    if (shared == NULL) {
+        if (client_fuzz(dis, client) < c->nchange)
+            return 0;
+
+        return add_match(res, c, client, index);
     }
 
-    if (utt->ncand == 0 || src == NULL)
-        goto unrecognized;
+    for (i = 0; i < shared->nclient; i++) {
+        client = shared->clients[i];
 
-    for (i = 0, match = TRUE; i < (int)src->ntoken && match; i++) {
-        tkn = src->tokens[i].token;
+        if (client_fuzz(dis, client) < c->nchange)
+            continue;
 
-        prnt = node;
-        node = get_token_node(prnt, tkn, FALSE);
+        if (add_match(res, c, client, index) < 0)
+            return -1;
+    }
 
-        if (node == NULL)
-            node = get_token_node(prnt, SRS_TOKEN_WILDCARD, FALSE);
+    return 0;
+}
 
-        if (node == NULL) {
-            node = get_dictionary_node(prnt, NULL, FALSE);
 
-            if (node != NULL) {
-                mrp_debug("found dictionary node %s", node->data.dict.dict);
+static int dict_result(disamb_t *dis, srs_srec_result_t *res, candidate_t *c)
+{
+    srs_srec_candidate_t *src = c->src;
+    continuation_t       *cont;
+    dfa_state_t          *s;
+    node_t               *node;
 
-                res->type = SRS_SREC_RESULT_DICT;
-                res->result.dict.op     = node->data.dict.op;
-                res->result.dict.dict   = node->data.dict.dict;
-                res->result.dict.state  = node;
-                res->result.dict.rescan = (int)src->tokens[i].start;
+    if ((cont = srs_arena_alloc(res->arena, sizeof(*cont))) == NULL)
+        return -1;
 
-                return 0;
-            }
-            else
-                match = FALSE;
-        }
-        else {
-            mrp_debug("found matching node for %s", tkn);
+    res->type = SRS_SREC_RESULT_DICT;
+    res->result.dict.state = cont;
 
-            if (strcmp(node->data.token, SRS_TOKEN_WILDCARD))
-                end = i;
-            else
-                end = (int)src->ntoken - 1;
+    cont->gen = dis->gen;
 
-            for (j = i; j <= end; j++) {
-                if (mrp_reallocz(res->tokens, res->ntoken, res->ntoken + 1)) {
-                    tkn = src->tokens[j].token;
-                    res->tokens[res->ntoken] = mrp_strdup(tkn);
+    if (dis->dfa != NULL) {
+        s = dis->dfa->states + c->dstate;
 
-                    if (res->tokens[res->ntoken] == NULL)
-                        return -1;
-                    else
-                        res->ntoken++;
-                }
+        cont->compiled = TRUE;
+        cont->rank     = c->rank;
+        cont->dstate = dfa_dict(dis->dfa, c->dstate, &cont->rank);
 
-                offs = res->sampleoffs;
-                if (mrp_reallocz(res->start, res->ntoken, res->ntoken + 1))
-                    res->start[res->ntoken-1] = offs + src->tokens[j].start;
-                else
-                    return -1;
+        mrp_debug("found dictionary transition %s", s->name);
 
-                if (mrp_reallocz(res->end, res->ntoken, res->ntoken + 1))
-                    res->end[res->ntoken-1] = offs + src->tokens[j].end;
-                else
-                    return -1;
-            }
+        res->result.dict.op   = s->op;
+        res->result.dict.dict = (char *)s->name;
+    }
+    else {
+        node = c->node;
 
-            i = end;
-        }
+        mrp_debug("found dictionary node %s", node->data.dict.dict);
+
+        cont->node = node;
+
+        res->result.dict.op   = node->data.dict.op;
+        res->result.dict.dict = node->data.dict.dict;
     }
 
-    if (match && i == (int)src->ntoken) {
-        res->type = SRS_SREC_RESULT_MATCH;
-        mrp_list_init(&res->result.matches);
-
-    search_clients:
-        mrp_list_foreach(&node->children, p, n) {
-            child = mrp_list_entry(p, typeof(*child), hook);
-
-            /*
-             * Notes:
-             *   This is a kludge to get wildcard match also 0 tokens.
-             *
-             *   If we don't find an immediate client node, see if we can
-             *   get to a client node by traversing the tree further but
-             *   without consume any tokens (which we do not have). This
-             *   can be accomplished in two ways:
-             *     1) via an immediate wildcard node followed by a client
-             *     2) via a dictionary and a wildcard node followed by a
-             *        client
-             */
-            if (child->type != NODE_TYPE_CLIENT) {
-                prnt = NULL;
-
-                if (child->type == NODE_TYPE_TOKEN) {
-                    if (!strcmp(child->data.token, SRS_TOKEN_WILDCARD))
-                        prnt = child;
-                }
-                else if (child->type == NODE_TYPE_DICTIONARY) {
-                    mrp_debug("found dictionary node %s",
-                              child->data.dict.dict);
+    if (c->tknidx < (int)src->ntoken)
+        res->result.dict.rescan = (int)src->tokens[c->tknidx].start;
+    else if (c->tknidx > 0)
+        res->result.dict.rescan = (int)src->tokens[c->tknidx - 1].end;
+    else
+        res->result.dict.rescan = 0;
 
-                    res->type = SRS_SREC_RESULT_DICT;
-                    res->result.dict.op     = child->data.dict.op;
-                    res->result.dict.dict   = child->data.dict.dict;
-                    res->result.dict.state  = child;
-                    res->result.dict.rescan = (int)src->tokens[i-1].end;
+    return 0;
+}
 
-                    return 0;
-                }
 
-                if (prnt != NULL) {
-                    node = prnt;
-                    goto search_clients;
-                }
+static int match_result(disamb_t *dis, srs_srec_result_t *res, candidate_t *c)
+{
+    dfa_accept_t *a;
+    node_t       *node;
+    uint32_t      n, j;
+    int           i;
 
-                mrp_log_error("Unexpected non-client node type 0x%x.",
-                              node->type);
-                res->type = SRS_SREC_RESULT_UNRECOGNIZED;
-                continue;
-            }
+    res->type = SRS_SREC_RESULT_MATCH;
+    mrp_list_init(&res->result.matches);
 
-            m = mrp_allocz(sizeof(*m));
+    /* fuzzy matches are only found in the tree */
+    if (dis->dfa != NULL && c->dstate != DFA_NONE) {
+        a = dfa_accepts(dis->dfa, c->dstate, c->rank, &n);
 
-            if (m == NULL)
+        for (j = 0; j < n; j++)
+            if (add_matches(dis, res, c, a[j].client, a[j].shared,
+                            a[j].index) < 0)
                 return -1;
+    }
+    else {
+        for (node = c->node->clients; node != NULL; node = node->next)
+            if (add_matches(dis, res, c, node->data.client.client,
+                            node->data.client.shared,
+                            node->data.client.index) < 0)
+                return -1;
+    }
 
-            mrp_list_init(&m->hook);
-            m->client = child->data.client.client;
-            m->index  = child->data.client.index;
-            m->score  = src->score;
-            m->fuzz   = 0;
-            m->tokens = NULL;
+    for (i = 0; i < res->ntoken; i++)
+        mrp_log_info("    actual token #%d: '%s'", i, res->tokens[i]);
 
-            mrp_list_append(&res->result.matches, &m->hook);
+    return 0;
+}
 
-            mrp_log_info("Found matching command %s/#%d.",
-                         m->client->id, m->index);
 
-            for (j = 0; j < res->ntoken; j++) {
-                mrp_log_info("    actual token #%d: '%s'", j,
-                             res->tokens[j]);
-            }
+static int disambiguate(srs_srec_utterance_t *utt, srs_srec_result_t **result,
+                        void *api_data)
+{
+    disamb_t             *dis = (disamb_t *)api_data;
+    srs_srec_result_t    *res;
+    candidate_t          *best;
+    continuation_t        start, *cont;
+
+    mrp_debug("should disambiguate utterance %p", utt);
+
+    res = *result;
+
+    if (res == NULL) {
+        mrp_log_error("Expected result buffer not found.");
+        return -1;
+    }
+
+    update_dfa(dis);
+
+    if (res->type == SRS_SREC_RESULT_DICT) {
+        cont = res->result.dict.state;
+
+        /*
+         * Continuing after a dictionary operation is only possible if
+         * the tree or automaton we stopped in is still the same one.
+         */
+
+        if (cont->gen != dis->gen || cont->compiled != (dis->dfa != NULL)) {
+            mrp_log_warning("Commands changed during dictionary switch.");
+            goto unrecognized;
         }
     }
+    else {
+        cont = &start;
 
-    if (!match) {
-    unrecognized:
-        res->type = SRS_SREC_RESULT_UNRECOGNIZED;
+        start.gen      = dis->gen;
+        start.compiled = (dis->dfa != NULL);
+        start.node     = dis->trie->root;
+        start.dstate   = 0;
+        start.rank     = 0;
     }
 
+    if (utt->ncand == 0)
+        goto unrecognized;
+
+    best = beam_search(dis, utt, cont, res->arena);
+
+    if (best == NULL && dis->maxfuzz > 0 && cont->node != NULL)
+        best = fuzzy_search(dis, utt, cont, res->arena);
+
+    if (best == NULL)
+        goto unrecognized;
+
+    if (best->tknidx > 0)
+        if (append_tokens(res, best->src, 0, best->tknidx - 1) < 0)
+            return -1;
+
+    if (best->state == CAND_DICT)
+        return dict_result(dis, res, best);
+    else
+        return match_result(dis, res, best);
+
+ unrecognized:
+    res->type = SRS_SREC_RESULT_UNRECOGNIZED;
+
     return 0;
 }
 
@@ -681,6 +1196,8 @@ static int create_disamb(srs_plugin_t *plugin)
     srs_disamb_api_t api = {
     add_client:   disamb_add_client,
     del_client:   disamb_del_client,
+    add_commands: disamb_add_commands,
+    del_commands: disamb_del_commands,
     disambiguate: disambiguate,
     };
 
@@ -692,39 +1209,106 @@ static int create_disamb(srs_plugin_t *plugin)
     dis = mrp_allocz(sizeof(*dis));
 
     if (dis != NULL) {
-        mrp_list_init(&dis->candidates);
         dis->plugin = plugin;
-        dis->root   = mrp_allocz(sizeof(*dis->root));
-
-        if (dis->root != NULL) {
-            mrp_list_init(&dis->root->hook);
-            mrp_list_init(&dis->root->children);
-            dis->root->type = NODE_TYPE_TOKEN;
+        dis->beam   = BEAM_WIDTH;
+        dis->trie   = trie_create();
+        mrp_list_init(&dis->shared);
 
+        if (dis->trie != NULL) {
             if (srs_register_disambiguator(srs, DISAMB_NAME, &api, dis) == 0) {
                 plugin->plugin_data = dis;
                 return TRUE;
             }
             else
-                mrp_free(dis->root);
+                trie_destroy(dis->trie);
         }
-        else
-            mrp_free(dis);
+
+        mrp_free(dis);
     }
 
     return FALSE;
 }
 
 
+static int clamp_fuzz(int fuzz)
+{
+    if (fuzz < 0)
+        return 0;
+    if (fuzz > MAX_FUZZ)
+        return MAX_FUZZ;
+
+    return fuzz;
+}
+
+
+static int config_limits(disamb_t *dis, srs_cfg_t *settings)
+{
+    srs_cfg_t    *cfg;
+    fuzz_limit_t *l;
+    size_t        plen = sizeof(CONFIG_FUZZ ".") - 1;
+    int           n, i;
+
+    /* disambiguator.max-fuzz.<client-name> overrides the default */
+
+    n = srs_config_collect(settings, CONFIG_FUZZ ".", &cfg);
+
+    if (n <= 0)
+        return 0;
+
+    if ((dis->limits = mrp_allocz_array(fuzz_limit_t, n)) == NULL) {
+        srs_config_free(cfg);
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        l = dis->limits + dis->nlimit;
+
+        if (!cfg[i].key[plen])
+            continue;
+
+        if ((l->name = mrp_strdup(cfg[i].key + plen)) == NULL) {
+            srs_config_free(cfg);
+            return -1;
+        }
+
+        l->fuzz = clamp_fuzz((int)strtol(cfg[i].value, NULL, 10));
+
+        if (l->fuzz > dis->maxfuzz)
+            dis->maxfuzz = l->fuzz;
+
+        mrp_debug("max. fuzz for client %s: %d", l->name, l->fuzz);
+
+        dis->nlimit++;
+    }
+
+    srs_config_free(cfg);
+
+    return 0;
+}
+
+
 static int config_disamb(srs_plugin_t *plugin, srs_cfg_t *settings)
 {
+    disamb_t  *dis = (disamb_t *)plugin->plugin_data;
     srs_cfg_t *cfg;
     int        n, i;
 
-    MRP_UNUSED(plugin);
-
     mrp_debug("configuring disambiguator");
 
+    dis->beam = srs_config_get_int32(settings, "disambiguator.beam-width",
+                                     BEAM_WIDTH);
+    dis->compile = srs_config_get_bool(settings, "disambiguator.compile",
+                                       FALSE);
+
+    if (dis->beam < 1)
+        dis->beam = 1;
+
+    dis->fuzz    = clamp_fuzz(srs_config_get_int32(settings, CONFIG_FUZZ, 0));
+    dis->maxfuzz = dis->fuzz;
+
+    if (config_limits(dis, settings) < 0)
+        return FALSE;
+
     n = srs_config_collect(settings, "disambiguator.", &cfg);
 
     mrp_debug("found %d configuration keys%s", n, n ? ":" : "");
@@ -761,12 +1345,19 @@ static void destroy_disamb(srs_plugin_t *plugin)
 {
     srs_context_t *srs = plugin->srs;
     disamb_t      *dis = (disamb_t *)plugin->plugin_data;
+    int            i;
 
     mrp_debug("destroying disambiguator plugin");
 
     if (dis != NULL) {
         srs_unregister_disambiguator(srs, DISAMB_NAME);
-        free_all_nodes(dis->root);
+        dfa_free(dis->dfa);
+        trie_destroy(dis->trie);
+
+        for (i = 0; i < dis->nlimit; i++)
+            mrp_free(dis->limits[i].name);
+        mrp_free(dis->limits);
+
         mrp_free(dis);
     }
 }
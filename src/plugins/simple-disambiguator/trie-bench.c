@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+
+#include "trie.h"
+#include "dfa.h"
+
+/*
+ * Command tree micro-benchmark.
+ *
+ * Registers a synthetic command set with a wide first-level fan-out,
+ * then times registration, lookup of every command (both in the tree
+ * and in the compiled automaton) and removal of all commands.
+ * Usage: trie-bench [commands [lookup-rounds]]
+ */
+
+#define DEFAULT_COMMANDS 10000
+#define DEFAULT_ROUNDS   100
+#define NVERB            2000            /* distinct first tokens */
+#define NWORD            500             /* distinct later tokens */
+#define MAX_TOKENS       6               /* max. tokens per command */
+
+typedef struct {
+    int            ntoken;
+    srs_token_id_t tokens[MAX_TOKENS];
+} command_t;
+
+
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *state = x;
+}
+
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+static void generate(command_t *cmds, int ncmd)
+{
+    uint32_t  seed = 0x5eed1234;
+    char      tkn[32];
+    command_t *c;
+    int        i, j;
+
+    for (i = 0; i < ncmd; i++) {
+        c = cmds + i;
+        c->ntoken = 2 + next_random(&seed) % (MAX_TOKENS - 1);
+
+        snprintf(tkn, sizeof(tkn), "verb%u", next_random(&seed) % NVERB);
+        c->tokens[0] = srs_token_intern(tkn, SRS_TOKEN_NUL);
+
+        for (j = 1; j < c->ntoken; j++) {
+            snprintf(tkn, sizeof(tkn), "word%u", next_random(&seed) % NWORD);
+            c->tokens[j] = srs_token_intern(tkn, SRS_TOKEN_NUL);
+        }
+    }
+}
+
+
+static int dfa_walk(dfa_t *dfa, command_t *c, int index)
+{
+    dfa_accept_t *a;
+    uint32_t      state = 0, rank = 0, n, i;
+    int           j, wild;
+
+    for (j = 0; j < c->ntoken && state != DFA_NONE; j++)
+        state = dfa_next(dfa, state, c->tokens[j], &rank, &wild);
+
+    if (state == DFA_NONE || (a = dfa_accepts(dfa, state, rank, &n)) == NULL)
+        return FALSE;
+
+    for (i = 0; i < n; i++)
+        if (a[i].index == index)
+            return TRUE;
+
+    return FALSE;
+}
+
+
+static node_t *walk(trie_t *trie, command_t *c, int insert)
+{
+    node_t *node = trie->root;
+    int     i;
+
+    for (i = 0; i < c->ntoken && node != NULL; i++)
+        node = trie_token_node(trie, node, c->tokens[i], insert);
+
+    return node;
+}
+
+
+int main(int argc, char *argv[])
+{
+    srs_client_t  client;
+    trie_t       *trie;
+    dfa_t        *dfa;
+    command_t    *cmds;
+    node_t       *node;
+    size_t        nleft;
+    int           ncmd, nround, nadded, nfound, ndfa, i, r;
+    double        t0, t1, tadd, tfind, tcomp, tdfa, tdel;
+
+    ncmd   = argc > 1 ? atoi(argv[1]) : DEFAULT_COMMANDS;
+    nround = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+
+    if (ncmd <= 0 || nround <= 0) {
+        fprintf(stderr, "usage: %s [commands [lookup-rounds]]\n", argv[0]);
+        exit(1);
+    }
+
+    memset(&client, 0, sizeof(client));
+    client.id = "bench";
+
+    cmds = mrp_allocz_array(command_t, ncmd);
+    trie = trie_create();
+
+    if (cmds == NULL || trie == NULL) {
+        fprintf(stderr, "failed to allocate benchmark data\n");
+        exit(1);
+    }
+
+    generate(cmds, ncmd);
+
+    /* register */
+    t0 = now();
+    for (i = nadded = 0; i < ncmd; i++) {
+        if ((node = walk(trie, cmds + i, TRUE)) != NULL &&
+            trie_client_node(trie, node, &client, i, TRUE) != NULL)
+            nadded++;
+    }
+    t1 = now();
+    tadd = t1 - t0;
+
+    /* look up every command nround times */
+    for (r = nfound = 0; r < nround; r++) {
+        for (i = 0; i < ncmd; i++) {
+            if ((node = walk(trie, cmds + i, FALSE)) != NULL &&
+                node->clients != NULL)
+                nfound++;
+        }
+    }
+    t0 = now();
+    tfind = t0 - t1;
+
+    /* compile, then do the same lookups in the automaton */
+    if ((dfa = dfa_compile(trie, 1)) == NULL) {
+        fprintf(stderr, "failed to compile command automaton\n");
+        exit(1);
+    }
+    t1 = now();
+    tcomp = t1 - t0;
+
+    for (r = ndfa = 0; r < nround; r++) {
+        for (i = 0; i < ncmd; i++) {
+            if (dfa_walk(dfa, cmds + i, i))
+                ndfa++;
+        }
+    }
+    t0 = now();
+    tdfa = t0 - t1;
+
+    printf("%d commands, %d registered, %zu nodes, %d root children\n",
+           ncmd, nadded, trie->nnode, (int)trie->root->ntoken);
+    printf("automaton: %u states, %u edges, %u commands\n", dfa->nstate,
+           dfa->nedge, dfa->naccept);
+
+    /* unregister */
+    t0 = now();
+    for (i = 0; i < ncmd; i++) {
+        if ((node = walk(trie, cmds + i, FALSE)) != NULL &&
+            (node = trie_client_node(trie, node, &client, i, FALSE)) != NULL)
+            trie_remove_node(trie, node);
+    }
+    tdel  = now() - t0;
+    nleft = trie->nnode;
+
+    printf("register: %8.1f ns/command\n", 1e9 * tadd / ncmd);
+    printf("lookup:   %8.1f ns/command (%d found)\n",
+           1e9 * tfind / ((double)ncmd * nround), nfound);
+    printf("compile:  %8.1f ns/command\n", 1e9 * tcomp / ncmd);
+    printf("dfa:      %8.1f ns/command (%d found)\n",
+           1e9 * tdfa / ((double)ncmd * nround), ndfa);
+    printf("remove:   %8.1f ns/command, %zu nodes left\n",
+           1e9 * tdel / ncmd, nleft);
+
+    dfa_free(dfa);
+    trie_destroy(trie);
+    mrp_free(cmds);
+    srs_token_cleanup();
+
+    return (nfound == nadded * nround && ndfa == nfound && nleft == 1) ? 0 : 1;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,476 @@
+#include <string.h>
+#include <errno.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+#include <murphy/common/debug.h>
+
+#include "trie.h"
+
+#define TRIE_BLKSIZE (64 * 1024)         /* node arena block size */
+#define TABLE_MIN    32                  /* smallest child hash table */
+
+static node_t *alloc_node(trie_t *trie, node_t *prnt, node_type_t type)
+{
+    node_t *node;
+
+    if ((node = trie->free) != NULL) {
+        trie->free = node->next;
+        memset(node, 0, sizeof(*node));
+    }
+    else if ((node = srs_arena_alloc(trie->arena, sizeof(*node))) == NULL)
+        return NULL;
+
+    node->type   = type;
+    node->parent = prnt;
+    trie->nnode++;
+
+    return node;
+}
+
+
+static void free_node(trie_t *trie, node_t *node)
+{
+    if (node->type == NODE_TYPE_DICTIONARY)
+        mrp_free(node->data.dict.dict);
+
+    mrp_free(node->tokens);
+
+    node->type = NODE_TYPE_NONE;
+    node->next = trie->free;
+    trie->free = node;
+    trie->nnode--;
+}
+
+
+trie_t *trie_create(void)
+{
+    trie_t *trie;
+
+    if ((trie = mrp_allocz(sizeof(*trie))) == NULL)
+        return NULL;
+
+    trie->arena    = srs_arena_create(TRIE_BLKSIZE);
+    trie->wildcard = srs_token_intern(SRS_TOKEN_WILDCARD, SRS_TOKEN_NUL);
+
+    if (trie->arena == NULL || trie->wildcard == SRS_TOKEN_ID_NONE)
+        goto fail;
+
+    if ((trie->root = alloc_node(trie, NULL, NODE_TYPE_TOKEN)) == NULL)
+        goto fail;
+
+    return trie;
+
+ fail:
+    srs_arena_destroy(trie->arena);
+    mrp_free(trie);
+
+    return NULL;
+}
+
+
+static void free_children(node_t *node)
+{
+    node_t   *c;
+    uint32_t  i;
+
+    /* nodes live in the arena, only free what they own on the heap */
+
+    for (i = 0; i < node->size; i++)
+        if ((c = node->tokens[i]) != NULL)
+            free_children(c);
+
+    if (node->any != NULL)
+        free_children(node->any);
+
+    if (node->dict != NULL)
+        free_children(node->dict);
+
+    if (node->type == NODE_TYPE_DICTIONARY)
+        mrp_free(node->data.dict.dict);
+
+    mrp_free(node->tokens);
+}
+
+
+void trie_destroy(trie_t *trie)
+{
+    if (trie == NULL)
+        return;
+
+    free_children(trie->root);
+    srs_arena_destroy(trie->arena);
+    mrp_free(trie);
+}
+
+
+static inline uint32_t hash_slot(srs_token_id_t id, uint32_t size)
+{
+    /* Fibonacci hashing, token ids are small consecutive integers */
+    return (uint32_t)(id * 2654435769U) >> (32 - __builtin_ctz(size));
+}
+
+
+static node_t **lookup_slot(node_t *prnt, srs_token_id_t id)
+{
+    node_t   **tbl = prnt->tokens;
+    uint32_t   mask, i;
+
+    if (prnt->size <= TRIE_SORTED_MAX) {
+        for (i = 0; i < prnt->ntoken; i++) {
+            if (tbl[i]->data.token.id >= id)
+                return tbl[i]->data.token.id == id ? tbl + i : NULL;
+        }
+
+        return NULL;
+    }
+
+    mask = prnt->size - 1;
+
+    for (i = hash_slot(id, prnt->size); tbl[i] != NULL; i = (i + 1) & mask)
+        if (tbl[i]->data.token.id == id)
+            return tbl + i;
+
+    return NULL;
+}
+
+
+static void hash_insert(node_t **tbl, uint32_t size, node_t *node)
+{
+    uint32_t mask = size - 1, i;
+
+    for (i = hash_slot(node->data.token.id, size); tbl[i]; i = (i + 1) & mask)
+        ;
+
+    tbl[i] = node;
+}
+
+
+static int resize_children(node_t *prnt, uint32_t size)
+{
+    node_t   **old = prnt->tokens, **tbl;
+    uint32_t   osize = prnt->size, i, j, n;
+
+    if ((tbl = mrp_allocz(size * sizeof(tbl[0]))) == NULL)
+        return -1;
+
+    if (size <= TRIE_SORTED_MAX) {
+        /* collect the hashed children back into a sorted array */
+        for (i = n = 0; i < osize; i++) {
+            if (old[i] == NULL)
+                continue;
+
+            for (j = n++; j > 0; j--) {
+                if (tbl[j-1]->data.token.id < old[i]->data.token.id)
+                    break;
+                tbl[j] = tbl[j-1];
+            }
+
+            tbl[j] = old[i];
+        }
+    }
+    else {
+        for (i = 0; i < osize; i++)
+            if (old[i] != NULL)
+                hash_insert(tbl, size, old[i]);
+    }
+
+    mrp_free(old);
+    prnt->tokens = tbl;
+    prnt->size   = size;
+
+    return 0;
+}
+
+
+static int add_token_child(node_t *prnt, node_t *node)
+{
+    node_t   **tbl;
+    uint32_t   i;
+
+    if (prnt->ntoken + 1 > prnt->size / 2 && prnt->size > TRIE_SORTED_MAX) {
+        if (resize_children(prnt, 2 * prnt->size) < 0)
+            return -1;
+    }
+    else if (prnt->ntoken == prnt->size) {
+        if (prnt->size == 0) {
+            if ((prnt->tokens = mrp_allocz_array(node_t *, 2)) == NULL)
+                return -1;
+            prnt->size = 2;
+        }
+        else if (prnt->size < TRIE_SORTED_MAX) {
+            if (!mrp_reallocz(prnt->tokens, prnt->size, 2 * prnt->size))
+                return -1;
+            prnt->size *= 2;
+        }
+        else if (resize_children(prnt, TABLE_MIN) < 0)
+            return -1;
+    }
+
+    if (prnt->size > TRIE_SORTED_MAX)
+        hash_insert(prnt->tokens, prnt->size, node);
+    else {
+        tbl = prnt->tokens;
+
+        for (i = prnt->ntoken; i > 0; i--) {
+            if (tbl[i-1]->data.token.id < node->data.token.id)
+                break;
+            tbl[i] = tbl[i-1];
+        }
+
+        tbl[i] = node;
+    }
+
+    prnt->ntoken++;
+
+    return 0;
+}
+
+
+static void del_token_child(node_t *prnt, node_t *node)
+{
+    node_t   **tbl = prnt->tokens, **slot;
+    uint32_t   mask, i, j, k;
+
+    if ((slot = lookup_slot(prnt, node->data.token.id)) == NULL)
+        return;
+
+    prnt->ntoken--;
+
+    if (prnt->size <= TRIE_SORTED_MAX) {
+        i = slot - tbl;
+        memmove(tbl + i, tbl + i + 1, (prnt->ntoken - i) * sizeof(tbl[0]));
+        tbl[prnt->ntoken] = NULL;
+        return;
+    }
+
+    /*
+     * Delete by shifting back any later entries of the probe sequence
+     * that would become unreachable, so we never need tombstones.
+     */
+
+    mask = prnt->size - 1;
+    i    = slot - tbl;
+    j    = i;
+    tbl[i] = NULL;
+
+    for (;;) {
+        j = (j + 1) & mask;
+
+        if (tbl[j] == NULL)
+            break;
+
+        k = hash_slot(tbl[j]->data.token.id, prnt->size);
+
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            tbl[i] = tbl[j];
+            tbl[j] = NULL;
+            i = j;
+        }
+    }
+
+    if (prnt->ntoken <= TRIE_SORTED_MAX / 2)
+        resize_children(prnt, TRIE_SORTED_MAX);
+}
+
+
+node_t *trie_token_node(trie_t *trie, node_t *prnt, srs_token_id_t id,
+                        int insert)
+{
+    node_t **slot, *node;
+
+    if (id == trie->wildcard) {
+        if (prnt->any != NULL)
+            return prnt->any;
+    }
+    else if ((slot = lookup_slot(prnt, id)) != NULL)
+        return *slot;
+
+    /*
+     * wildcard node matches all tokens but only for pure lookups
+     */
+
+    if (!insert) {
+        if (prnt->any != NULL)
+            return prnt->any;
+
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (prnt->dict != NULL || prnt->clients != NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /*
+     * a wildcard node must be the only child of its parent
+     */
+
+    if (prnt->any != NULL || (prnt->ntoken > 0 && id == trie->wildcard)) {
+        mrp_log_error("Wildcard/non-wildcard token conflict.");
+        errno = EILSEQ;
+        return NULL;
+    }
+
+    if ((node = alloc_node(trie, prnt, NODE_TYPE_TOKEN)) == NULL)
+        return NULL;
+
+    node->data.token.id  = id;
+    node->data.token.str = srs_token_string(id);
+
+    if (id == trie->wildcard)
+        prnt->any = node;
+    else if (add_token_child(prnt, node) < 0) {
+        free_node(trie, node);
+        return NULL;
+    }
+
+    mrp_debug("added token node %s", node->data.token.str);
+
+    return node;
+}
+
+
+node_t *trie_dict_node(trie_t *trie, node_t *prnt, srs_dict_op_t op,
+                       const char *dict, int insert)
+{
+    node_t *node;
+
+    if (prnt->type != NODE_TYPE_TOKEN) {
+        errno = ECHILD;
+        return NULL;
+    }
+
+    if ((node = prnt->dict) != NULL) {
+        if (dict == NULL ||
+            (node->data.dict.op == op && !strcmp(node->data.dict.dict, dict)))
+            return node;
+
+        errno = EILSEQ;
+        return NULL;
+    }
+
+    if (!insert || dict == NULL) {
+        errno = insert ? EINVAL : ENOENT;
+        return NULL;
+    }
+
+    if (prnt->ntoken > 0 || prnt->any != NULL || prnt->clients != NULL) {
+        errno = EILSEQ;
+        return NULL;
+    }
+
+    if ((node = alloc_node(trie, prnt, NODE_TYPE_DICTIONARY)) == NULL)
+        return NULL;
+
+    node->data.dict.op   = op;
+    node->data.dict.dict = mrp_strdup(dict);
+
+    if (node->data.dict.dict == NULL) {
+        free_node(trie, node);
+        return NULL;
+    }
+
+    prnt->dict = node;
+
+    mrp_debug("added dictionary node 0x%x(%s)", op, dict);
+
+    return node;
+}
+
+
+static node_t *client_node(trie_t *trie, node_t *prnt, srs_client_t *client,
+                           shared_t *shared, int index, int insert)
+{
+    node_t *node, **tail;
+
+    for (tail = &prnt->clients; (node = *tail) != NULL; tail = &node->next)
+        if (node->data.client.client == client &&
+            node->data.client.shared == shared &&
+            node->data.client.index  == index)
+            return node;
+
+    if (!insert) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if ((node = alloc_node(trie, prnt, NODE_TYPE_CLIENT)) == NULL)
+        return NULL;
+
+    node->data.client.client = client;
+    node->data.client.shared = shared;
+    node->data.client.index  = index;
+
+    *tail = node;
+
+    return node;
+}
+
+
+node_t *trie_client_node(trie_t *trie, node_t *prnt, srs_client_t *client,
+                         int index, int insert)
+{
+    return client_node(trie, prnt, client, NULL, index, insert);
+}
+
+
+node_t *trie_shared_node(trie_t *trie, node_t *prnt, shared_t *shared,
+                         int index, int insert)
+{
+    return client_node(trie, prnt, NULL, shared, index, insert);
+}
+
+
+void trie_remove_node(trie_t *trie, node_t *node)
+{
+    node_t *prnt, **np;
+
+    while (node != NULL && (prnt = node->parent) != NULL) {
+        switch (node->type) {
+        case NODE_TYPE_CLIENT:
+            for (np = &prnt->clients; *np != NULL; np = &(*np)->next) {
+                if (*np == node) {
+                    *np = node->next;
+                    break;
+                }
+            }
+            break;
+
+        case NODE_TYPE_DICTIONARY:
+            mrp_debug("deleting dictionary node 0x%x(%s)",
+                      node->data.dict.op, node->data.dict.dict);
+            prnt->dict = NULL;
+            break;
+
+        case NODE_TYPE_TOKEN:
+            mrp_debug("deleting token node '%s'", node->data.token.str);
+            if (prnt->any == node)
+                prnt->any = NULL;
+            else
+                del_token_child(prnt, node);
+            break;
+
+        default:
+            break;
+        }
+
+        free_node(trie, node);
+
+        if (prnt->ntoken || prnt->any || prnt->dict || prnt->clients)
+            break;
+
+        node = prnt;
+    }
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
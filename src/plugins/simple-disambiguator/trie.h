@@ -0,0 +1,113 @@
+#ifndef __SRS_SIMPLE_DISAMBIGUATOR_TRIE_H__
+#define __SRS_SIMPLE_DISAMBIGUATOR_TRIE_H__
+
+#include "srs/daemon/client.h"
+#include "srs/daemon/cmdset.h"
+#include "srs/daemon/arena.h"
+#include "srs/daemon/token.h"
+
+#define TRIE_SORTED_MAX 8                /* max. children in a sorted array */
+
+typedef enum {
+    NODE_TYPE_UNKNOWN = 0,
+    NODE_TYPE_NONE    = 0,
+    NODE_TYPE_TOKEN,                     /* a command token node */
+    NODE_TYPE_DICTIONARY,                /* dictionary operation node */
+    NODE_TYPE_CLIENT,                    /* a client/command node */
+} node_type_t;
+
+/*
+ * a command set shared by several clients
+ *
+ * A shared set is registered in the tree only once, so each of its
+ * client command nodes stands for the same command of all the clients
+ * sharing the set.
+ */
+typedef struct {
+    mrp_list_hook_t  hook;               /* to list of shared sets */
+    srs_cmdset_t    *set;                /* shared command set */
+    srs_client_t   **clients;            /* clients sharing the set */
+    int              nclient;            /* number of clients */
+} shared_t;
+
+typedef union {
+    struct {                             /* for NODE_TYPE_TOKEN */
+        srs_token_id_t  id;              /*     interned token id */
+        const char     *str;             /*     interned token string */
+    } token;
+    struct {                             /* for NODE_TYPE_CLIENT */
+        srs_client_t *client;            /*     client, or */
+        shared_t     *shared;            /*     shared command set */
+        int           index;             /*     command index */
+    } client;
+    struct {                             /* for NODE_TYPE_DICTIONARY */
+        srs_dict_op_t  op;               /*     operation */
+        char          *dict;             /*     dictionary to switch or push */
+    } dict;
+} node_data_t;
+
+typedef struct node_s node_t;
+
+/*
+ * a node in the command token tree
+ *
+ * Token children are kept in a sorted array of at most TRIE_SORTED_MAX
+ * entries, or in an open-addressed hash table keyed by token id once
+ * there are more of them. A wildcard, a dictionary operation and the
+ * client commands ending at the node are kept separately.
+ */
+struct node_s {
+    node_type_t      type;               /* node type */
+    node_data_t      data;               /* type-specific node data */
+    node_t          *parent;             /* parent node */
+    node_t         **tokens;             /* token children */
+    uint32_t         ntoken;             /* number of token children */
+    uint32_t         size;               /* token child slots allocated */
+    node_t          *any;                /* wildcard child */
+    node_t          *dict;               /* dictionary child */
+    node_t          *clients;            /* client children */
+    node_t          *next;               /* next client sibling */
+};
+
+typedef struct {
+    node_t         *root;                /* root of the tree */
+    srs_arena_t    *arena;               /* node storage */
+    node_t         *free;                /* recycled nodes */
+    size_t          nnode;               /* number of nodes in use */
+    srs_token_id_t  wildcard;            /* interned wildcard token */
+} trie_t;
+
+/** Create an empty command tree. */
+trie_t *trie_create(void);
+
+/** Destroy the given command tree. */
+void trie_destroy(trie_t *trie);
+
+/** Look up (falling back to any wildcard), or insert a token child. */
+node_t *trie_token_node(trie_t *trie, node_t *prnt, srs_token_id_t id,
+                        int insert);
+
+/** Look up or insert a dictionary child, NULL dict looks up any. */
+node_t *trie_dict_node(trie_t *trie, node_t *prnt, srs_dict_op_t op,
+                       const char *dict, int insert);
+
+/** Look up or insert a client command child. */
+node_t *trie_client_node(trie_t *trie, node_t *prnt, srs_client_t *client,
+                         int index, int insert);
+
+/** Look up or insert a shared command set command child. */
+node_t *trie_shared_node(trie_t *trie, node_t *prnt, shared_t *shared,
+                         int index, int insert);
+
+/** Remove a node, pruning any ancestors left without children. */
+void trie_remove_node(trie_t *trie, node_t *node);
+
+#endif /* __SRS_SIMPLE_DISAMBIGUATOR_TRIE_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
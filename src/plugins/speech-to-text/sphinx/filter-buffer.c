@@ -21,10 +21,12 @@
 #include "options.h"
 #include "decoder-set.h"
 #include "utterance.h"
+#include "noise-gate.h"
 
 #define INJECTED_SILENCE 10     /* injected silence in frames */
 
 static int open_file_for_recording(const char *);
+static void reject_segment(context_t *);
 
 
 int filter_buffer_create(context_t *ctx)
@@ -157,6 +159,8 @@ void filter_buffer_purge(context_t *ctx, int32_t length)
             memset(filtbuf->buf, 0, sillen * sizeof(int16_t));
         }
     }
+
+    noise_gate_reset(ctx);
 }
 
 void filter_buffer_process_data(context_t *ctx)
@@ -165,12 +169,10 @@ void filter_buffer_process_data(context_t *ctx)
     decoder_t *dec;
     input_buf_t *inpbuf;
     filter_buf_t *filtbuf;
-    cont_ad_t *cont;
     int32_t l, max, len;
 
     if (!ctx || !(decset = ctx->decset) || !(dec = decset->curdec) ||
-        !(inpbuf = ctx->inpbuf) || !(cont = inpbuf->cont) ||
-        !(filtbuf = ctx->filtbuf))
+        !(inpbuf = ctx->inpbuf) || !(filtbuf = ctx->filtbuf))
         return;
 
     len = 0;
@@ -180,7 +182,7 @@ void filter_buffer_process_data(context_t *ctx)
         if (max <= 0)
             break;
 
-        l = cont_ad_read(cont, filtbuf->buf + filtbuf->len + len, max);
+        l = input_buffer_read(ctx, filtbuf->buf + filtbuf->len + len, max);
 
         if (l <= 0)
             break;
@@ -191,23 +193,41 @@ void filter_buffer_process_data(context_t *ctx)
 
     if (len > 0) {
         filtbuf->len += len;
-        filtbuf->ts = cont->read_ts;
+        filtbuf->ts = input_buffer_timestamp(ctx);
 
         if (ctx->verbose) {
             mrp_debug("got %u samples to filter buffer "
                       "(total size %u samples)", len, filtbuf->len);
         }
 
-        utterance_start(ctx);
+        switch (noise_gate_process(ctx)) {
+
+        case NOISE_GATE_PASS:
+            utterance_start(ctx);
+
+            if (filtbuf->len >= filtbuf->hwm)
+                filter_buffer_utter(ctx, false);
+            break;
+
+        case NOISE_GATE_PENDING:
+            if (filtbuf->len >= filtbuf->hwm)
+                reject_segment(ctx);
+            break;
 
-        if (filtbuf->len >= filtbuf->hwm)
-            filter_buffer_utter(ctx, false);
+        default:
+            break;
+        }
     }
     else {
-        if (dec->utter && (cont->read_ts - filtbuf->ts) > filtbuf->silen) {
-            filter_buffer_utter(ctx, true);
-            cont_ad_reset(cont);
-            utterance_end(ctx);
+        if ((input_buffer_timestamp(ctx) - filtbuf->ts) > filtbuf->silen) {
+            if (dec->utter) {
+                filter_buffer_utter(ctx, true);
+                input_buffer_reset(ctx);
+                utterance_end(ctx);
+                noise_gate_reset(ctx);
+            }
+            else if (!filter_buffer_is_empty(ctx))
+                reject_segment(ctx);
         }
     }
 }
@@ -282,6 +302,13 @@ int16_t *filter_buffer_dup(context_t *ctx,
 
 
 
+static void reject_segment(context_t *ctx)
+{
+    noise_gate_reject(ctx);
+    filter_buffer_purge(ctx, -1);
+    input_buffer_reset(ctx);
+}
+
 static int open_file_for_recording(const char *path)
 {
     int fd;
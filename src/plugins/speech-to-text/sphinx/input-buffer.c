@@ -17,14 +17,18 @@
 #include "filter-buffer.h"
 
 static int32 ad_buffer_read(ad_rec_t *ud, int16 *buf, int32 reqlen);
+static int32_t vad_buffer_read(input_buf_t *inpbuf, int16_t *buf, int32_t max);
 
 
 int input_buffer_create(context_t *ctx)
 {
     options_t *opts;
+    filter_buf_t *filtbuf;
     input_buf_t *inpbuf;
+    srs_vad_config_t vcfg;
+    size_t frsiz;
 
-    if (!ctx || !(opts = ctx->opts)) {
+    if (!ctx || !(opts = ctx->opts) || !(filtbuf = ctx->filtbuf)) {
         errno = EINVAL;
         return -1;
     }
@@ -35,7 +39,28 @@ int input_buffer_create(context_t *ctx)
     inpbuf->ad.sps = opts->rate;
     inpbuf->ad.bps = 1 * sizeof(int16_t); /* for MONO + PA_SAMPLE_S16LE */
 
-    if (!(inpbuf->cont = cont_ad_init((ad_rec_t *)inpbuf, ad_buffer_read))) {
+    if (opts->vad.builtin) {
+        vcfg.rate     = opts->rate;
+        vcfg.frame    = (filtbuf->frlen * 1000) / opts->rate;
+        vcfg.onset    = opts->vad.onset;
+        vcfg.offset   = opts->vad.offset;
+        vcfg.hangover = opts->vad.hangover;
+        vcfg.adaptive = true;
+
+        if (!(inpbuf->vad = srs_vad_create(&vcfg))) {
+            mrp_log_error("failed to create voice activity detector");
+            goto failed;
+        }
+
+        frsiz = srs_vad_frame_length(inpbuf->vad) * sizeof(int16_t);
+
+        inpbuf->preroll = opts->vad.preroll * (opts->rate / 1000) *
+            sizeof(int16_t);
+        inpbuf->preroll = (inpbuf->preroll + frsiz - 1) / frsiz * frsiz;
+        inpbuf->calibrated = true;
+    }
+    else if (!(inpbuf->cont = cont_ad_init((ad_rec_t *)inpbuf,
+                                           ad_buffer_read))) {
         mrp_log_error("cont_ad_init() failed");
         goto failed;
     }
@@ -58,7 +83,9 @@ void input_buffer_destroy(context_t *ctx)
     if (ctx && (inpbuf = ctx->inpbuf)) {
         ctx->inpbuf = NULL;
 
-        cont_ad_close(inpbuf->cont);
+        if (inpbuf->cont)
+            cont_ad_close(inpbuf->cont);
+        srs_vad_destroy(inpbuf->vad);
         mrp_free(inpbuf->buf);
 
         mrp_free(inpbuf);
@@ -96,6 +123,12 @@ void input_buffer_purge(context_t *ctx)
         return;
 
     inpbuf->len = 0;
+    inpbuf->vadoffs = 0;
+
+    if (inpbuf->vad) {
+        srs_vad_reset(inpbuf->vad);
+        inpbuf->speech = false;
+    }
 }
 
 void input_buffer_process_data(context_t *ctx, const void *buf, size_t len)
@@ -111,10 +144,11 @@ void input_buffer_process_data(context_t *ctx, const void *buf, size_t len)
     size_t extra;
 
     if (!ctx || !(decset = ctx->decset) || !(dec = decset->curdec) ||
-        !(inpbuf = ctx->inpbuf) || !(cont = inpbuf->cont) ||
-        !(filtbuf = ctx->filtbuf))
+        !(inpbuf = ctx->inpbuf) || !(filtbuf = ctx->filtbuf))
         return;
 
+    cont = inpbuf->cont;
+
     if (inpbuf->calibrated)
         minreq = inpbuf->minreq;
     else
@@ -135,6 +169,11 @@ void input_buffer_process_data(context_t *ctx, const void *buf, size_t len)
         else {
             inpbuf->len -= extra;
             memmove(inpbuf->buf, inpbuf->buf + extra, inpbuf->len);
+
+            if (inpbuf->vadoffs > extra)
+                inpbuf->vadoffs -= extra;
+            else
+                inpbuf->vadoffs = 0;
         }
     }
 
@@ -154,7 +193,7 @@ void input_buffer_process_data(context_t *ctx, const void *buf, size_t len)
         }
 
         inpbuf->calibrated = true;
-        filtbuf->ts = cont->read_ts;
+        filtbuf->ts = input_buffer_timestamp(ctx);
 
         if (ctx->verbose || 1)
             mrp_log_info("Successfully calibrated @ %u", filtbuf->ts);
@@ -165,6 +204,47 @@ void input_buffer_process_data(context_t *ctx, const void *buf, size_t len)
     filter_buffer_process_data(ctx);
 }
 
+int32_t input_buffer_read(context_t *ctx, int16_t *buf, int32_t max)
+{
+    input_buf_t *inpbuf;
+
+    if (!ctx || !(inpbuf = ctx->inpbuf) || !buf || max <= 0)
+        return 0;
+
+    if (inpbuf->vad)
+        return vad_buffer_read(inpbuf, buf, max);
+    else
+        return cont_ad_read(inpbuf->cont, buf, max);
+}
+
+int32_t input_buffer_timestamp(context_t *ctx)
+{
+    input_buf_t *inpbuf;
+
+    if (!ctx || !(inpbuf = ctx->inpbuf))
+        return 0;
+
+    if (inpbuf->vad)
+        return inpbuf->ts;
+    else
+        return inpbuf->cont->read_ts;
+}
+
+void input_buffer_reset(context_t *ctx)
+{
+    input_buf_t *inpbuf;
+
+    if (!ctx || !(inpbuf = ctx->inpbuf))
+        return;
+
+    if (inpbuf->vad) {
+        srs_vad_reset(inpbuf->vad);
+        inpbuf->speech = false;
+    }
+    else
+        cont_ad_reset(inpbuf->cont);
+}
+
 
 static int32 ad_buffer_read(ad_rec_t *ud, int16 *buf, int32 reqlen)
 {
@@ -192,6 +272,66 @@ static int32 ad_buffer_read(ad_rec_t *ud, int16 *buf, int32 reqlen)
     return (int32)(len / sizeof(int16));
 }
 
+static int32_t vad_buffer_read(input_buf_t *inpbuf, int16_t *buf, int32_t max)
+{
+    uint8_t *data = inpbuf->buf;
+    size_t frlen = srs_vad_frame_length(inpbuf->vad);
+    size_t frsiz = frlen * sizeof(int16_t);
+    size_t offs = inpbuf->vadoffs;
+    size_t start = 0;
+    int32_t cnt, n = 0;
+    srs_vad_frame_t frame;
+
+    /*
+     * Run the detector over every complete frame. While there is no
+     * speech we keep the last preroll bytes of analyzed audio around
+     * so that the onset of speech is not chopped off, and once speech
+     * is detected we hand out everything up to the analysis point.
+     */
+    for (;;) {
+        if (inpbuf->speech && offs > start) {
+            cnt = (offs - start) / sizeof(int16_t);
+
+            if (cnt > max - n)
+                cnt = max - n;
+
+            memcpy(buf + n, data + start, cnt * sizeof(int16_t));
+            n += cnt;
+            start += cnt * sizeof(int16_t);
+
+            if (offs > start)
+                break;
+        }
+
+        if (offs + frsiz > inpbuf->len)
+            break;
+
+        srs_vad_process(inpbuf->vad, (int16_t *)(data + offs), frlen,
+                        &frame, 1);
+
+        offs += frsiz;
+        inpbuf->ts += frlen;
+
+        if (!inpbuf->speech && frame.state == SRS_VAD_SPEECH)
+            plugin_speech_handler(inpbuf->ctx);
+
+        inpbuf->speech = (frame.state == SRS_VAD_SPEECH);
+
+        if (!inpbuf->speech && offs - start > inpbuf->preroll)
+            start = offs - inpbuf->preroll;
+    }
+
+    if (start > 0) {
+        inpbuf->len -= start;
+        memmove(data, data + start, inpbuf->len);
+        offs -= start;
+    }
+
+    inpbuf->vadoffs = offs;
+
+    return n;
+}
+
 
 
 /*
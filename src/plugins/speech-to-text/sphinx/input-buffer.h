@@ -4,15 +4,22 @@
 #include <sphinxbase/ad.h>
 #include <sphinxbase/cont_ad.h>
 
+#include "srs/daemon/vad.h"
+
 #include "sphinx-plugin.h"
 
 struct input_buf_s {
     ad_rec_t ad;
     cont_ad_t *cont;
+    srs_vad_t *vad;    /* builtin VAD, if used instead of cont_ad */
     void *buf;
     size_t max;
     size_t minreq;
     size_t len;
+    size_t vadoffs;    /* bytes already analyzed by the builtin VAD */
+    size_t preroll;    /* bytes kept before speech onset */
+    int32_t ts;        /* samples analyzed by the builtin VAD */
+    bool speech;       /* builtin VAD speech state */
     bool calibrated;
     context_t *ctx;
 };
@@ -27,6 +34,10 @@ void input_buffer_purge(context_t *ctx);
 
 void input_buffer_process_data(context_t *ctx, const void *buf, size_t len);
 
+int32_t input_buffer_read(context_t *ctx, int16_t *buf, int32_t max);
+int32_t input_buffer_timestamp(context_t *ctx);
+void input_buffer_reset(context_t *ctx);
+
 
 #endif /* __SRS_POCKET_SPHINX_INPUT_BUFFER_H__ */
 
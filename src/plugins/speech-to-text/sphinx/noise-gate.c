@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include "srs/daemon/vad.h"
+
+#include "noise-gate.h"
+#include "filter-buffer.h"
+#include "options.h"
+
+#define FLOOR_MIN      1.0      /* lowest noise floor we ever assume */
+#define FLOOR_RISE     0.002    /* noise floor upward tracking factor */
+
+static double frame_flatness(noise_gate_t *, const int16_t *);
+static void analyze_frame(noise_gate_t *, const int16_t *);
+
+
+int noise_gate_create(context_t *ctx)
+{
+    options_t *opts;
+    filter_buf_t *filtbuf;
+    noise_gate_t *gate;
+    int32_t frlen, i, k;
+    double rate, w, f;
+    float *c, *s;
+
+    if (!ctx || !(opts = ctx->opts) || !(filtbuf = ctx->filtbuf)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!(gate = mrp_allocz(sizeof(noise_gate_t))))
+        return -1;
+
+    rate  = opts->rate;
+    frlen = filtbuf->frlen;
+
+    gate->enabled   = opts->gate.enabled;
+    gate->frlen     = frlen;
+    gate->minframes = (opts->gate.minlen * rate) / frlen;
+    gate->maxflat   = opts->gate.flatness;
+    gate->minzcr    = opts->gate.minzcr;
+    gate->maxzcr    = opts->gate.maxzcr;
+    gate->dynamic   = pow(10.0, opts->gate.dynamic / 10.0);
+    gate->floor     = 0.0;
+
+    if (gate->minframes < 1)
+        gate->minframes = 1;
+
+    /*
+     * Precompute a Hann-windowed basis for NOISE_GATE_NBIN evenly spaced
+     * frequencies between DC and Nyquist. A handful of bins is plenty for
+     * telling flat (noise-like) and peaky (voiced) spectra apart and
+     * keeps the per-frame cost at a few hundred multiply-adds per bin.
+     */
+    if (gate->enabled) {
+        gate->basis = mrp_alloc(2 * NOISE_GATE_NBIN * frlen * sizeof(float));
+
+        if (!gate->basis) {
+            mrp_free(gate);
+            return -1;
+        }
+
+        for (k = 0;  k < NOISE_GATE_NBIN;  k++) {
+            c = gate->basis + (2 * k + 0) * frlen;
+            s = gate->basis + (2 * k + 1) * frlen;
+            f = M_PI * (k + 0.5) / NOISE_GATE_NBIN;
+
+            for (i = 0;  i < frlen;  i++) {
+                w = 0.5 - 0.5 * cos(2.0 * M_PI * i / (frlen - 1));
+                c[i] = w * cos(f * i);
+                s[i] = w * sin(f * i);
+            }
+        }
+    }
+
+    ctx->gate = gate;
+
+    noise_gate_reset(ctx);
+
+    if (ctx->verbose) {
+        mrp_debug("noise gate %s: min. %d frames, max. flatness %.2lf, "
+                  "ZCR %.3lf - %.3lf, dynamic %.1lf dB",
+                  gate->enabled ? "enabled" : "disabled", gate->minframes,
+                  gate->maxflat, gate->minzcr, gate->maxzcr,
+                  opts->gate.dynamic);
+    }
+
+    return 0;
+}
+
+void noise_gate_destroy(context_t *ctx)
+{
+    noise_gate_t *gate;
+    noise_gate_stats_t *st;
+
+    if (ctx && (gate = ctx->gate)) {
+        ctx->gate = NULL;
+
+        st = &gate->stats;
+
+        if (gate->enabled) {
+            mrp_log_info("noise gate: %u segments, %u passed, %u rejected "
+                         "(short %u, envelope %u, flatness %u, ZCR %u), "
+                         "%llu samples discarded", st->nsegment, st->npass,
+                         st->nreject, st->nshort, st->nenvelope, st->nflat,
+                         st->nzcr, (unsigned long long)st->nsample);
+        }
+
+        mrp_free(gate->basis);
+        mrp_free(gate);
+    }
+}
+
+void noise_gate_reset(context_t *ctx)
+{
+    noise_gate_t *gate;
+    filter_buf_t *filtbuf;
+
+    if (!ctx || !(gate = ctx->gate) || !(filtbuf = ctx->filtbuf))
+        return;
+
+    gate->offs = filtbuf->len;
+    gate->verdict = gate->enabled ? NOISE_GATE_PENDING : NOISE_GATE_PASS;
+    memset(&gate->seg, 0, sizeof(gate->seg));
+}
+
+noise_gate_verdict_t noise_gate_process(context_t *ctx)
+{
+    noise_gate_t *gate;
+    filter_buf_t *filtbuf;
+    int32_t frlen;
+
+    if (!ctx || !(gate = ctx->gate) || !(filtbuf = ctx->filtbuf))
+        return NOISE_GATE_PASS;
+
+    if (gate->verdict != NOISE_GATE_PENDING)
+        return gate->verdict;
+
+    if (gate->offs > filtbuf->len)
+        gate->offs = filtbuf->len;
+
+    frlen = gate->frlen;
+
+    while (gate->offs + frlen <= filtbuf->len) {
+        analyze_frame(gate, filtbuf->buf + gate->offs);
+        gate->offs += frlen;
+
+        if (gate->seg.nspeech >= (uint32_t)gate->minframes) {
+            gate->verdict = NOISE_GATE_PASS;
+            gate->stats.nsegment++;
+            gate->stats.npass++;
+
+            if (ctx->verbose) {
+                mrp_debug("noise gate: passing segment after %u frames "
+                          "(%u speech-like)", gate->seg.nframe,
+                          gate->seg.nspeech);
+            }
+            break;
+        }
+    }
+
+    return gate->verdict;
+}
+
+void noise_gate_reject(context_t *ctx)
+{
+    noise_gate_t *gate;
+    filter_buf_t *filtbuf;
+    noise_gate_stats_t *st;
+    const char *reason;
+    uint32_t min;
+
+    if (!ctx || !(gate = ctx->gate) || !(filtbuf = ctx->filtbuf))
+        return;
+
+    if (gate->verdict != NOISE_GATE_PENDING)
+        return;
+
+    st  = &gate->stats;
+    min = gate->minframes;
+
+    st->nsegment++;
+    st->nreject++;
+    st->nsample += filtbuf->len;
+
+    if (gate->seg.nframe < min) {
+        st->nshort++;
+        reason = "too short";
+    }
+    else if (gate->seg.nloud < min) {
+        st->nenvelope++;
+        reason = "weak energy envelope";
+    }
+    else if (gate->seg.nflat >= gate->seg.nzcr) {
+        st->nflat++;
+        reason = "flat spectrum";
+    }
+    else {
+        st->nzcr++;
+        reason = "zero-crossing rate";
+    }
+
+    gate->verdict = NOISE_GATE_REJECT;
+
+    mrp_debug("noise gate: rejected %d samples (%u frames, %u speech-like): "
+              "%s; %u of %u segments rejected so far", filtbuf->len,
+              gate->seg.nframe, gate->seg.nspeech, reason,
+              st->nreject, st->nsegment);
+}
+
+
+static void analyze_frame(noise_gate_t *gate, const int16_t *frame)
+{
+    int32_t frlen = gate->frlen;
+    double energy, zcr, flat;
+
+    energy = srs_vad_energy(frame, frlen);
+
+    if (gate->floor < FLOOR_MIN || energy < gate->floor)
+        gate->floor = (energy < FLOOR_MIN) ? FLOOR_MIN : energy;
+    else
+        gate->floor += (energy - gate->floor) * FLOOR_RISE;
+
+    gate->seg.nframe++;
+
+    if (energy < gate->floor * gate->dynamic)
+        return;
+
+    gate->seg.nloud++;
+
+    zcr  = (double)srs_vad_zero_crossings(frame, frlen) / (double)frlen;
+    flat = frame_flatness(gate, frame);
+
+    if (flat > gate->maxflat)
+        gate->seg.nflat++;
+    else if (zcr < gate->minzcr || zcr > gate->maxzcr)
+        gate->seg.nzcr++;
+    else
+        gate->seg.nspeech++;
+}
+
+
+static double frame_flatness(noise_gate_t *gate, const int16_t *buf)
+{
+    int32_t frlen = gate->frlen;
+    const float *c, *s;
+    float re, im, x;
+    double p, sum, logsum;
+    int32_t i, k;
+
+    sum = logsum = 0.0;
+
+    /*
+     * Spectral flatness is the ratio of the geometric and arithmetic
+     * means of the power spectrum: close to 1.0 for white noise and
+     * clicks, small for harmonic (voiced) signals.
+     */
+    for (k = 0;  k < NOISE_GATE_NBIN;  k++) {
+        c = gate->basis + (2 * k + 0) * frlen;
+        s = gate->basis + (2 * k + 1) * frlen;
+        re = im = 0.0;
+
+        for (i = 0;  i < frlen;  i++) {
+            x   = buf[i];
+            re += c[i] * x;
+            im += s[i] * x;
+        }
+
+        p = (double)re * re + (double)im * im + 1.0;
+
+        sum    += p;
+        logsum += log(p);
+    }
+
+    return exp(logsum / NOISE_GATE_NBIN) / (sum / NOISE_GATE_NBIN);
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
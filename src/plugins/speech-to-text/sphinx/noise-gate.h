@@ -0,0 +1,62 @@
+#ifndef __SRS_POCKET_SPHINX_NOISE_GATE_H__
+#define __SRS_POCKET_SPHINX_NOISE_GATE_H__
+
+#include "sphinx-plugin.h"
+
+#define NOISE_GATE_NBIN 16      /* spectral bins for flatness estimation */
+
+enum noise_gate_verdict_e {
+    NOISE_GATE_PENDING = 0,     /* not enough evidence yet */
+    NOISE_GATE_PASS,            /* looks like speech, feed the decoder */
+    NOISE_GATE_REJECT,          /* looks like noise, throw it away */
+};
+
+struct noise_gate_stats_s {
+    uint32_t nsegment;          /* segments seen */
+    uint32_t npass;             /* segments passed to the decoder */
+    uint32_t nreject;           /* segments rejected */
+    uint32_t nshort;            /* rejected for being too short */
+    uint32_t nenvelope;         /* rejected for weak energy envelope */
+    uint32_t nflat;             /* rejected for too flat a spectrum */
+    uint32_t nzcr;              /* rejected for zero-crossing rate */
+    uint64_t nsample;           /* total rejected samples */
+};
+
+struct noise_gate_s {
+    bool enabled;
+    int32_t frlen;              /* frame length in samples */
+    int32_t minframes;          /* minimum speech-like frames to pass */
+    double maxflat;             /* maximum spectral flatness (0.0 - 1.0) */
+    double minzcr;              /* minimum zero-crossings per sample */
+    double maxzcr;              /* maximum zero-crossings per sample */
+    double dynamic;             /* min. frame energy over noise floor */
+    float *basis;               /* windowed DFT basis (cos/sin per bin) */
+    double floor;               /* tracked noise floor (mean square) */
+    int32_t offs;               /* first unanalyzed sample in filter buf. */
+    noise_gate_verdict_t verdict;
+    struct {                    /* features of the current segment */
+        uint32_t nframe;        /* analyzed frames */
+        uint32_t nspeech;       /* speech-like frames */
+        uint32_t nloud;         /* frames above the noise floor */
+        uint32_t nflat;         /* loud frames failing the flatness test */
+        uint32_t nzcr;          /* loud frames failing the ZCR test */
+    } seg;
+    noise_gate_stats_t stats;
+};
+
+int  noise_gate_create(context_t *ctx);
+void noise_gate_destroy(context_t *ctx);
+
+void noise_gate_reset(context_t *ctx);
+noise_gate_verdict_t noise_gate_process(context_t *ctx);
+void noise_gate_reject(context_t *ctx);
+
+#endif /* __SRS_POCKET_SPHINX_NOISE_GATE_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
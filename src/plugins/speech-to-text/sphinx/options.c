@@ -11,6 +11,7 @@
 
 #include "logger.h"
 #include "options.h"
+#include "utterance.h"
 
 #define DEFAULT_HMM  "/usr/share/pocketsphinx/model/hmm/en_US/hub4wsj_sc_8k"
 #define DEFAULT_LM   "/usr/share/pocketsphinx/model/lm/en_US/wsj0vp.5000.DMP"
@@ -18,6 +19,10 @@
 
 static int add_decoder(int, srs_cfg_t *, const char *,
                        size_t *, options_decoder_t **pdecs);
+static int parse_gate_option(options_t *, const char *, const char *);
+static int parse_nbest_option(options_t *, const char *, const char *);
+static int parse_vad_option(options_t *, const char *, const char *);
+static int parse_aec_option(options_t *, const char *, const char *);
 static int print_decoders(size_t, options_decoder_t *, int, char *);
 
 
@@ -58,8 +63,24 @@ int options_create(context_t *ctx, int ncfg, srs_cfg_t *cfgs)
     opts->audio = NULL;
     opts->logfn = mrp_strdup("/dev/null");
     opts->topn = 12;
+    opts->nbest.depth = NBEST_DEPTH;
+    opts->nbest.ncand = CANDIDATE_MAX;
     opts->rate = 16000;
     opts->silen = 1.0;
+    opts->gate.enabled = true;
+    opts->gate.minlen = 0.2;
+    opts->gate.flatness = 0.5;
+    opts->gate.minzcr = 0.02;
+    opts->gate.maxzcr = 0.45;
+    opts->gate.dynamic = 6.0;
+    opts->vad.builtin = true;
+    opts->vad.onset = 9.0;
+    opts->vad.offset = 5.0;
+    opts->vad.hangover = 300;
+    opts->vad.preroll = 200;
+    opts->aec.enabled = true;
+    opts->aec.tail = 64;
+    opts->aec.margin = 8;
 
     verbose = false;
     sts = 0;
@@ -73,6 +94,15 @@ int options_create(context_t *ctx, int ncfg, srs_cfg_t *cfgs)
 
             switch (key[0]) {
 
+            case 'a':
+                if (!strncmp(key, "aec", 3)) {
+                    if (parse_aec_option(opts, key + 3, value) < 0) {
+                        mrp_log_error("invalid value %s for %s", value, key);
+                        sts = -1;
+                    }
+                }
+                break;
+
             case 'd':
                 if (!strcmp(key, "dict")) {
                     mrp_free((void *)decs->dict);
@@ -112,6 +142,21 @@ int options_create(context_t *ctx, int ncfg, srs_cfg_t *cfgs)
                 }
                 break;
 
+            case 'n':
+                if (!strncmp(key, "noisegate", 9)) {
+                    if (parse_gate_option(opts, key + 9, value) < 0) {
+                        mrp_log_error("invalid value %s for %s", value, key);
+                        sts = -1;
+                    }
+                }
+                else if (!strncmp(key, "nbest", 5)) {
+                    if (parse_nbest_option(opts, key + 5, value) < 0) {
+                        mrp_log_error("invalid value %s for %s", value, key);
+                        sts = -1;
+                    }
+                }
+                break;
+
             case 'p':
                 if (!strcmp(key, "pulsesrc")) {
                     mrp_free((void *)opts->srcnam);
@@ -151,7 +196,13 @@ int options_create(context_t *ctx, int ncfg, srs_cfg_t *cfgs)
                 break;
 
             case 'v':
-                if (!strcmp(key, "verbose")) {
+                if (!strncmp(key, "vad", 3)) {
+                    if (parse_vad_option(opts, key + 3, value) < 0) {
+                        mrp_log_error("invalid value %s for %s", value, key);
+                        sts = -1;
+                    }
+                }
+                else if (!strcmp(key, "verbose")) {
                     if (!strcmp(value, "true") ||
                         !strcmp(value, "on") ||
                         !strcmp(value, "yes"))
@@ -179,14 +230,22 @@ int options_create(context_t *ctx, int ncfg, srs_cfg_t *cfgs)
         print_decoders(opts->ndec, opts->decs, sizeof(buf), buf);
 
         mrp_log_info("topn: %u\n"
+                     "   N-best: %u candidates of %u hypotheses\n"
                      "   pulseaudio source name: %s\n"
                      "   sample rate: %.1lf KHz\n"
                      "   audio recording file: %s\n"
+                     "   noise gate: %s\n"
+                     "   voice activity detection: %s\n"
+                     "   echo cancellation: %s\n"
                      "%s",
                      opts->topn,
+                     opts->nbest.ncand, opts->nbest.depth,
                      opts->srcnam ? opts->srcnam : "<default-source>",
                      (double)opts->rate / 1000.0,
                      opts->audio,
+                     opts->gate.enabled ? "enabled" : "disabled",
+                     opts->vad.builtin ? "builtin" : "cont_ad",
+                     opts->aec.enabled ? "enabled" : "disabled",
                      buf);
     }
 
@@ -298,6 +357,153 @@ static int add_decoder(int ncfg,
     return -1;
 }
 
+static int parse_gate_option(options_t *opts, const char *key,
+                             const char *value)
+{
+    double *dptr;
+    double d;
+    char *e;
+
+    if (!key[0]) {
+        if (!strcmp(value, "true") ||
+            !strcmp(value, "on") ||
+            !strcmp(value, "yes"))
+            opts->gate.enabled = true;
+        else
+            opts->gate.enabled = false;
+
+        return 0;
+    }
+
+    if (key[0] != '.')
+        return 0;
+
+    key++;
+
+    if (!strcmp(key, "minlen"))
+        dptr = &opts->gate.minlen;
+    else if (!strcmp(key, "flatness"))
+        dptr = &opts->gate.flatness;
+    else if (!strcmp(key, "minzcr"))
+        dptr = &opts->gate.minzcr;
+    else if (!strcmp(key, "maxzcr"))
+        dptr = &opts->gate.maxzcr;
+    else if (!strcmp(key, "dynamic"))
+        dptr = &opts->gate.dynamic;
+    else
+        return 0;
+
+    d = strtod(value, &e);
+
+    if (e[0] || e == value || d < 0.0)
+        return -1;
+
+    *dptr = d;
+
+    return 0;
+}
+
+static int parse_nbest_option(options_t *opts, const char *key,
+                              const char *value)
+{
+    uint32_t n;
+    char *e;
+
+    n = strtoul(value, &e, 10);
+
+    if (e[0] || e == value || n < 1)
+        return -1;
+
+    if (!key[0] || !strcmp(key, ".depth")) {
+        if (n > 10000)
+            return -1;
+        opts->nbest.depth = n;
+    }
+    else if (!strcmp(key, ".candidates")) {
+        if (n > 100)
+            return -1;
+        opts->nbest.ncand = n;
+    }
+
+    return 0;
+}
+
+static int parse_vad_option(options_t *opts, const char *key,
+                            const char *value)
+{
+    double d;
+    char *e;
+
+    if (!key[0]) {
+        if (!strcmp(value, "builtin") || !strcmp(value, "srs"))
+            opts->vad.builtin = true;
+        else if (!strcmp(value, "cont_ad"))
+            opts->vad.builtin = false;
+        else
+            return -1;
+
+        return 0;
+    }
+
+    if (key[0] != '.')
+        return 0;
+
+    key++;
+
+    d = strtod(value, &e);
+
+    if (e[0] || e == value || d < 0.0)
+        return -1;
+
+    if (!strcmp(key, "onset"))
+        opts->vad.onset = d;
+    else if (!strcmp(key, "offset"))
+        opts->vad.offset = d;
+    else if (!strcmp(key, "hangover"))
+        opts->vad.hangover = (uint32_t)d;
+    else if (!strcmp(key, "preroll"))
+        opts->vad.preroll = (uint32_t)d;
+
+    return 0;
+}
+
+static int parse_aec_option(options_t *opts, const char *key,
+                            const char *value)
+{
+    double d;
+    char *e;
+
+    if (!key[0]) {
+        if (!strcmp(value, "true") || !strcmp(value, "on") ||
+            !strcmp(value, "yes"))
+            opts->aec.enabled = true;
+        else if (!strcmp(value, "false") || !strcmp(value, "off") ||
+                 !strcmp(value, "no"))
+            opts->aec.enabled = false;
+        else
+            return -1;
+
+        return 0;
+    }
+
+    if (key[0] != '.')
+        return 0;
+
+    key++;
+
+    d = strtod(value, &e);
+
+    if (e[0] || e == value || d < 1.0 || d > 1000.0)
+        return -1;
+
+    if (!strcmp(key, "tail"))
+        opts->aec.tail = (uint32_t)d;
+    else if (!strcmp(key, "margin"))
+        opts->aec.margin = (uint32_t)d;
+
+    return 0;
+}
+
 static int print_decoders(size_t ndec,
                           options_decoder_t *decs,
                           int len,
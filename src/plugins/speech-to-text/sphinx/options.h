@@ -15,7 +15,31 @@ struct options_s {
     const char *logfn;
     uint32_t rate;
     uint32_t topn;
+    struct {
+        uint32_t depth;     /* N-best hypotheses to examine */
+        uint32_t ncand;     /* candidates to pass on for disambiguation */
+    } nbest;
     double silen;
+    struct {
+        bool enabled;       /* whether to gate segments before decoding */
+        double minlen;      /* minimum speech length (in seconds) */
+        double flatness;    /* maximum spectral flatness of speech */
+        double minzcr;      /* minimum zero-crossing rate of speech */
+        double maxzcr;      /* maximum zero-crossing rate of speech */
+        double dynamic;     /* minimum speech level over noise (in dB) */
+    } gate;
+    struct {
+        bool builtin;       /* use the daemon VAD instead of cont_ad */
+        double onset;       /* speech onset level over noise (in dB) */
+        double offset;      /* speech offset level over noise (in dB) */
+        uint32_t hangover;  /* speech hangover (in msecs) */
+        uint32_t preroll;   /* audio kept before speech onset (in msecs) */
+    } vad;
+    struct {
+        bool enabled;       /* cancel echo of our own voice output */
+        uint32_t tail;      /* echo tail length (in msecs) */
+        uint32_t margin;    /* reference alignment margin (in msecs) */
+    } aec;
 };
 
 struct options_decoder_s {
@@ -6,6 +6,7 @@
 
 #include <pulse/pulseaudio.h>
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
 
 #include <sphinxbase/err.h>
 #include <sphinxbase/ad.h>
@@ -25,6 +26,8 @@
 
 static void connect_to_server(context_t *ctx);
 static int  stream_create(context_t *);
+static const void *cancel_echo(pulse_interface_t *, pa_stream *,
+                               const void *, size_t);
 
 static void state_callback(pa_stream *, void *);
 static void read_callback(pa_stream *, size_t, void *);
@@ -77,6 +80,8 @@ void pulse_interface_destroy(context_t *ctx)
             pa_context_unref(pulseif->pactx);
         }
 
+        srs_aec_destroy(pulseif->aec);
+        mrp_free(pulseif->aecbuf);
         mrp_free(pulseif);
     }
 }
@@ -139,6 +144,8 @@ static int stream_create(context_t *ctx)
     uint32_t tlength;
     pa_stream_flags_t flags;
     pa_proplist *pl;
+    srs_aec_config_t aeccfg;
+    srs_pulse_t *pulse;
     size_t bufsiz, calsiz, size, hwm, extra, silsiz, minsiz;
     int32_t silen;
 
@@ -164,7 +171,10 @@ static int stream_create(context_t *ctx)
         silen = pa_usec_to_bytes(dsilen*PA_USEC_PER_SEC, &spec)/sizeof(int16);
 
         bufsiz = pa_usec_to_bytes(filtmax * PA_USEC_PER_MSEC, &spec);
-        calsiz = cont_ad_calib_size(inpbuf->cont) * sizeof(int16);
+        if (inpbuf->cont)
+            calsiz = cont_ad_calib_size(inpbuf->cont) * sizeof(int16);
+        else
+            calsiz = 0;
         hwm = (bufsiz > calsiz) ? bufsiz : calsiz;
         silsiz = silen * sizeof(int16);
         extra = ((minsiz * 2 > silsiz) ? minsiz * 2 : silsiz) + minsiz;
@@ -200,6 +210,18 @@ static int stream_create(context_t *ctx)
 
         input_buffer_initialize(ctx, size, minsiz);
 
+        if (opts->aec.enabled && !pulseif->aec &&
+            (pulse = plugin_get_pulse(ctx->plugin)) != NULL)
+        {
+            aeccfg.rate   = opts->rate;
+            aeccfg.tail   = opts->aec.tail;
+            aeccfg.margin = opts->aec.margin;
+
+            if (!(pulseif->aec = srs_aec_create(pulse, &aeccfg)))
+                mrp_log_error("sphinx plugin: failed to create echo "
+                              "canceller, continuing without it");
+        }
+
         battr.maxlength = -1;       /* default (4MB) */
         battr.tlength   = tlength;
         battr.minreq    = minsiz;
@@ -208,6 +230,10 @@ static int stream_create(context_t *ctx)
 
         flags = PA_STREAM_ADJUST_LATENCY;
 
+        if (pulseif->aec)
+            flags |= PA_STREAM_INTERPOLATE_TIMING |
+                     PA_STREAM_AUTO_TIMING_UPDATE;
+
         pa_stream_set_state_callback(pulseif->stream, state_callback, ctx);
 #if 0
         pa_stream_set_underflow_callback(pulseif->stream, underflow_callback,
@@ -298,13 +324,50 @@ static void read_callback(pa_stream *stream, size_t bytes, void *userdata)
 
     pa_stream_peek(stream, &data, &size);
 
-    if (data && size && !pulseif->corked)
+    if (data && size && !pulseif->corked) {
+        if (pulseif->aec)
+            data = cancel_echo(pulseif, stream, data, size);
+
         input_buffer_process_data(ctx, data, size);
+    }
 
     if (size)
         pa_stream_drop(stream);
 }
 
+static const void *cancel_echo(pulse_interface_t *pulseif, pa_stream *stream,
+                               const void *data, size_t size)
+{
+    size_t nsample = size / sizeof(int16_t);
+    pa_usec_t when, latency;
+    int negative;
+
+    if (pulseif->aecsize < nsample) {
+        if (!mrp_reallocz(pulseif->aecbuf, pulseif->aecsize, nsample)) {
+            pulseif->aecsize = 0;
+            return data;
+        }
+        pulseif->aecsize = nsample;
+    }
+
+    /*
+     * Estimate when the first sample of this chunk hit the microphone
+     * so the canceller can line it up with what we were playing back.
+     */
+    if (pa_stream_get_latency(stream, &latency, &negative) < 0)
+        when = 0;
+    else {
+        when = pa_rtclock_now();
+        when = (negative || latency > when) ? when : when - latency;
+    }
+
+    if (srs_aec_process(pulseif->aec, data, pulseif->aecbuf, nsample,
+                        when) <= 0)
+        return data;
+
+    return pulseif->aecbuf;
+}
+
 static void context_callback(pa_context *pactx, void *userdata)
 {
     context_t *ctx = (context_t *)userdata;
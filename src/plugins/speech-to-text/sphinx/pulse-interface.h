@@ -4,6 +4,8 @@
 #include <pulse/pulseaudio.h>
 #include <pulse/mainloop.h>
 
+#include "srs/daemon/aec.h"
+
 #include "sphinx-plugin.h"
 
 struct pulse_interface_s {
@@ -12,6 +14,9 @@ struct pulse_interface_s {
     pa_stream *stream;
     bool conup;
     bool corked;
+    srs_aec_t *aec;             /* echo canceller, if enabled */
+    int16_t *aecbuf;            /* echo cancelled samples */
+    size_t aecsize;             /* size of aecbuf in samples */
 };
 
 int  pulse_interface_create(context_t *ctx, pa_mainloop_api *api);
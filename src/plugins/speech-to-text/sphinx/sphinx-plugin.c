@@ -37,6 +37,7 @@
 #include "decoder-set.h"
 #include "utterance.h"
 #include "filter-buffer.h"
+#include "noise-gate.h"
 #include "input-buffer.h"
 #include "pulse-interface.h"
 
@@ -60,6 +61,11 @@ mrp_mainloop_t *plugin_get_mainloop(plugin_t *plugin)
     return plugin->self->srs->ml;
 }
 
+srs_pulse_t *plugin_get_pulse(plugin_t *plugin)
+{
+    return plugin->self->srs->pulse;
+}
+
 
 int32_t plugin_utterance_handler(context_t *ctx, srs_srec_utterance_t *utt)
 {
@@ -77,6 +83,14 @@ int32_t plugin_utterance_handler(context_t *ctx, srs_srec_utterance_t *utt)
     return length;
 }
 
+void plugin_speech_handler(context_t *ctx)
+{
+    plugin_t *pl;
+
+    if ((pl = ctx->plugin) != NULL)
+        srs_srec_speech_detected(pl->self->srs, SPHINX_NAME);
+}
+
 static int activate(void *user_data)
 {
     context_t *ctx = (context_t *)user_data;
@@ -258,6 +272,8 @@ static int config_sphinx(srs_plugin_t *plugin, srs_cfg_t *settings)
     if (options_create(ctx, n, cfg) < 0 ||
         decoder_set_create(ctx)     < 0 ||
         filter_buffer_create(ctx)   < 0 ||
+        noise_gate_create(ctx)      < 0 ||
+        utterance_create(ctx)       < 0 ||
         input_buffer_create(ctx)    < 0  )
     {
         mrp_log_error("Failed to configure CMU Sphinx plugin.");
@@ -308,6 +324,8 @@ static void destroy_sphinx(srs_plugin_t *plugin)
         mrp_free(ctx->plugin);
 
         input_buffer_destroy(ctx);
+        utterance_destroy(ctx);
+        noise_gate_destroy(ctx);
         filter_buffer_destroy(ctx);
         decoder_set_destroy(ctx);
         options_destroy(ctx);
@@ -8,6 +8,7 @@
 #include "srs/daemon/recognizer.h"
 
 typedef enum utterance_processor_e  utterance_processor_t;
+typedef enum noise_gate_verdict_e   noise_gate_verdict_t;
 
 typedef struct context_s            context_t;
 typedef struct plugin_s             plugin_t;
@@ -22,6 +23,10 @@ typedef struct word_s               word_t;
 typedef struct filter_buf_s         filter_buf_t;
 typedef struct input_buf_s          input_buf_t;
 typedef struct pulse_interface_s    pulse_interface_t;
+typedef struct noise_gate_s         noise_gate_t;
+typedef struct noise_gate_stats_s   noise_gate_stats_t;
+typedef struct nbest_s              nbest_t;
+typedef struct nbest_cand_s         nbest_cand_t;
 
 enum utterance_processor_e {
     UTTERANCE_PROCESSOR_UNKNOWN = 0,
@@ -34,6 +39,8 @@ struct context_s {
     options_t *opts;
     decoder_set_t *decset;
     filter_buf_t *filtbuf;
+    noise_gate_t *gate;
+    nbest_t *nbest;
     input_buf_t *inpbuf;
     pulse_interface_t *pulseif;
     bool verbose;
@@ -41,7 +48,9 @@ struct context_s {
 
 
 int32_t plugin_utterance_handler(context_t *ctx, srs_srec_utterance_t *utt);
+void plugin_speech_handler(context_t *ctx);
 mrp_mainloop_t *plugin_get_mainloop(plugin_t *plugin);
+srs_pulse_t *plugin_get_pulse(plugin_t *plugin);
 
 #endif /* __SRS_POCKET_SPHINX_PLUGIN_H__ */
 
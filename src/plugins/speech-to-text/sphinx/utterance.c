@@ -14,24 +14,92 @@
 #include <murphy/common/log.h>
 
 #include "utterance.h"
+#include "options.h"
 #include "decoder-set.h"
 #include "filter-buffer.h"
 
 
 static void process_utterance(context_t *);
-static void acoustic_processor(context_t *, srs_srec_utterance_t *,
-                               srs_srec_candidate_t *,srs_srec_candidate_t **);
-static void fsg_processor(context_t *, srs_srec_utterance_t *,
-                          srs_srec_candidate_t *, srs_srec_candidate_t **);
+static void acoustic_processor(context_t *, srs_srec_utterance_t *);
+static void fsg_processor(context_t *, srs_srec_utterance_t *);
 static void print_utterance(context_t *, srs_srec_utterance_t *);
 
-static srs_srec_candidate_t *candidate_equal(srs_srec_candidate_t *,
-                                             srs_srec_candidate_t *);
-static double candidate_score(srs_srec_candidate_t *);
-static uint32_t candidate_sort(srs_srec_candidate_t *,srs_srec_candidate_t **);
+static void nbest_reset(nbest_t *);
+static srs_srec_candidate_t *nbest_spare(nbest_t *);
+static void nbest_add(nbest_t *);
+static uint32_t nbest_sort(nbest_t *);
 
-static bool tkneq(const char *, const char *);
-static const char *tknbase(const char *token);
+static srs_token_id_t tknbase(srs_srec_token_t *, const char *);
+
+
+int utterance_create(context_t *ctx)
+{
+    options_t *opts;
+    nbest_t *nbest;
+    uint32_t max, i;
+
+    if (!ctx || !(opts = ctx->opts)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (!(nbest = mrp_allocz(sizeof(nbest_t))))
+        return -1;
+
+    max = opts->nbest.ncand;
+
+    nbest->depth = opts->nbest.depth;
+    nbest->max = max;
+
+    for (nbest->nslot = 4;  nbest->nslot < 4 * (max + 1);  nbest->nslot *= 2)
+        ;
+
+    nbest->pool = mrp_allocz_array(nbest_cand_t, max + 1);
+    nbest->tokens = mrp_allocz_array(srs_srec_token_t,
+                                     (max + 1) * (CANDIDATE_TOKEN_MAX + 1));
+    nbest->heap = mrp_allocz_array(nbest_cand_t *, max);
+    nbest->table = mrp_allocz_array(nbest_cand_t *, nbest->nslot);
+    nbest->sorted = mrp_allocz_array(srs_srec_candidate_t *, max + 1);
+
+    ctx->nbest = nbest;
+
+    if (!nbest->pool || !nbest->tokens || !nbest->heap || !nbest->table ||
+        !nbest->sorted)
+    {
+        utterance_destroy(ctx);
+        return -1;
+    }
+
+    for (i = 0;  i <= max;  i++) {
+        nbest->pool[i].cand.tokens =
+            nbest->tokens + (i * (CANDIDATE_TOKEN_MAX + 1));
+    }
+
+    nbest_reset(nbest);
+
+    if (ctx->verbose) {
+        mrp_debug("N-best: examining %u hypotheses for %u candidates",
+                  nbest->depth, nbest->max);
+    }
+
+    return 0;
+}
+
+void utterance_destroy(context_t *ctx)
+{
+    nbest_t *nbest;
+
+    if (ctx && (nbest = ctx->nbest)) {
+        ctx->nbest = NULL;
+
+        mrp_free(nbest->pool);
+        mrp_free(nbest->tokens);
+        mrp_free(nbest->heap);
+        mrp_free(nbest->table);
+        mrp_free(nbest->sorted);
+        mrp_free(nbest);
+    }
+}
 
 
 void utterance_start(context_t *ctx)
@@ -43,7 +111,7 @@ void utterance_start(context_t *ctx)
     if (ctx && (decset = ctx->decset) && (dec = decset->curdec)) {
         if (!dec->utter) {
             snprintf(utid, sizeof(utid), "%07u-%s", dec->utid++, dec->name);
-            ps_start_utt(dec->ps, mrp_strdup(utid));
+            ps_start_utt(dec->ps, utid);
             dec->utter = true;
         }
     }
@@ -69,27 +137,20 @@ static void process_utterance(context_t *ctx)
     decoder_set_t *decset;
     decoder_t *dec;
     srs_srec_utterance_t utt;
-    srs_srec_token_t token_pool[CANDIDATE_MAX * (CANDIDATE_TOKEN_MAX + 1)];
-    srs_srec_candidate_t cands[CANDIDATE_MAX + 1];
-    srs_srec_candidate_t *sorted[CANDIDATE_MAX + 1];
     int32_t purgelen;
-    int i;
 
     if (!ctx || !(decset = ctx->decset) || !(dec = decset->curdec) ||
-        !(filtbuf = ctx->filtbuf))
+        !(filtbuf = ctx->filtbuf) || !ctx->nbest)
         return;
 
-    for (i = 0;  i < CANDIDATE_MAX;  i++)
-        cands[i].tokens = token_pool + (i * (CANDIDATE_TOKEN_MAX + 1));
-
     switch (dec->utproc) {
 
     case UTTERANCE_PROCESSOR_ACOUSTIC:
-        acoustic_processor(ctx, &utt, cands, sorted);
+        acoustic_processor(ctx, &utt);
         goto processed;
 
     case UTTERANCE_PROCESSOR_FSG:
-        fsg_processor(ctx, &utt, cands, sorted);
+        fsg_processor(ctx, &utt);
         goto processed;
 
     processed:
@@ -115,14 +176,12 @@ static void process_utterance(context_t *ctx)
     }
 }
 
-static void acoustic_processor(context_t *ctx,
-                               srs_srec_utterance_t *utt,
-                               srs_srec_candidate_t *cands,
-                               srs_srec_candidate_t **sorted)
+static void acoustic_processor(context_t *ctx, srs_srec_utterance_t *utt)
 {
     filter_buf_t *filtbuf;
     decoder_set_t *decset;
     decoder_t *dec;
+    nbest_t *nbest;
     logmath_t *lmath;
     const char *uttid;
     const char *hyp;
@@ -132,12 +191,12 @@ static void acoustic_processor(context_t *ctx,
     ps_seg_t *seg;
     int32_t frlen;
     int32 start, end;
-    size_t ncand;
-    srs_srec_candidate_t *cand = cands;
+    uint32_t nhyp;
+    bool complete;
+    srs_srec_candidate_t *cand;
     srs_srec_token_t *tkn;
-    int32_t length;
 
-    if (!ctx || !(filtbuf = ctx->filtbuf) ||
+    if (!ctx || !(filtbuf = ctx->filtbuf) || !(nbest = ctx->nbest) ||
         !(decset = ctx->decset) || !(dec = decset->curdec))
         return;
 
@@ -146,16 +205,23 @@ static void acoustic_processor(context_t *ctx,
     uttid = "<unknown>";
     /*hyp = */ps_get_hyp(dec->ps, &score, &uttid);
     prob = logmath_exp(lmath, score);
-    length = 0;
 
     if (prob < 0.00000001)
         prob = 0.00000001;
 
-    for (nb  = ps_nbest(dec->ps, 0,-1, NULL,NULL), ncand = 0;
+    nbest_reset(nbest);
+
+    /*
+     * Walk the N-best list up to the configured depth, keeping only the
+     * best scoring distinct candidates in a bounded heap. Hypotheses that
+     * only differ in silences or alternate pronunciations collapse to the
+     * same token id sequence and are merged keeping the better score.
+     */
+    for (nb  = ps_nbest(dec->ps, 0,-1, NULL,NULL), nhyp = 0;
          nb != NULL;
          nb  = ps_nbest_next(nb))
     {
-        if (ncand >= CANDIDATE_MAX-1) {
+        if (nhyp++ >= nbest->depth) {
             ps_nbest_free(nb);
             break;
         }
@@ -169,73 +235,56 @@ static void acoustic_processor(context_t *ctx,
 
             ps_seg_frames(seg, &start, &end);
 
-            cand = cands + ncand;
+            cand = nbest_spare(nbest);
 
             cand->score = logmath_exp(lmath, score) / prob;
             cand->ntoken = 0;
-
-            length = 0;
+            complete = false;
 
             while ((seg = ps_seg_next(seg))) {
                 if ((hyp = ps_seg_word(seg))) {
                     if (!strcmp(hyp, "</s>") ||
                         cand->ntoken >= CANDIDATE_TOKEN_MAX)
                     {
-                        ncand++;
-                        //memset(cand+1, 0, sizeof(srs_srec_candidate_t));
-                        ps_seg_frames(seg, &start, &end);
                         ps_seg_free(seg);
-                        //printf("hyp=</s> ncand=%d\n", ncand);
-                        length = (end + 1) * frlen;
+                        complete = true;
                         break;
                     }
                     else if (!strcmp(hyp, "<sil>")) {
                         ps_seg_frames(seg, &start, &end);
-                        //printf("hyp=<sil> skip it\n");
                     }
                     else {
                         tkn = cand->tokens + cand->ntoken++;
-                        tkn->token = tknbase(hyp);
+                        tknbase(tkn, hyp);
                         ps_seg_frames(seg, &start, &end);
                         tkn->start = start * frlen;
                         tkn->end = (end + 1) * frlen;
-                        //printf("hyp=%s (%d, %d) tkn count %d\n",
-                        //      tkn->token, tkn->start,tkn->end, cand->ntoken);
                     }
                 }
             } /* while seg */
 
-            if (!seg && cand->ntoken > 0) {
-                ncand++;
-                cand->score *= 0.9; /* some penalty */
-                //memset(cand+1, 0, sizeof(srs_srec_candidate_t));
-            }
+            if (cand->ntoken > 0) {
+                if (!complete)
+                    cand->score *= 0.9; /* some penalty */
 
-            if (!length) {
-                tkn = cand->tokens + (cand->ntoken - 1);
-                length = tkn->end;
+                nbest_add(nbest);
             }
         }
     } /* for nb */
 
-    memset(cand+1, 0, sizeof(srs_srec_candidate_t));
-
     utt->id = uttid;
     utt->score = prob;
-    //utt->length = length;
     utt->length = filtbuf->len;
-    utt->ncand = candidate_sort(cands, sorted);
-    utt->cands = sorted;
+    utt->ncand = nbest_sort(nbest);
+    utt->cands = nbest->sorted;
 }
 
-static void fsg_processor(context_t *ctx,
-                          srs_srec_utterance_t *utt,
-                          srs_srec_candidate_t *cands,
-                          srs_srec_candidate_t **sorted)
+static void fsg_processor(context_t *ctx, srs_srec_utterance_t *utt)
 {
     filter_buf_t *filtbuf;
     decoder_set_t *decset;
     decoder_t *dec;
+    nbest_t *nbest;
     logmath_t *lmath;
     const char *uttid;
     int32_t score;
@@ -246,11 +295,12 @@ static void fsg_processor(context_t *ctx,
     ps_latlink_t *lnk;
     ps_latnode_t *nod;
     const char *token;
+    srs_srec_token_t next;
     int32_t frlen;
     int32_t start, end;
     int16 fef, lef;
 
-    if (!ctx || !(filtbuf = ctx->filtbuf) ||
+    if (!ctx || !(filtbuf = ctx->filtbuf) || !(nbest = ctx->nbest) ||
         !(decset = ctx->decset) || !(dec = decset->curdec))
         return;
 
@@ -259,7 +309,9 @@ static void fsg_processor(context_t *ctx,
     ps_get_hyp(dec->ps, &score, &uttid);
     prob = logmath_exp(lmath, score);
 
-    cand = cands;
+    nbest_reset(nbest);
+
+    cand = nbest_spare(nbest);
     cand->score = 1.0;
     cand->ntoken = 0;
 
@@ -273,7 +325,7 @@ static void fsg_processor(context_t *ctx,
 
             if (nod && (token = ps_latnode_word(dag, nod)) && *token != '<') {
                 tkn = cand->tokens + cand->ntoken++;
-                tkn->token = tknbase(token);
+                tknbase(tkn, token);
                 tkn->start = ps_latnode_times(nod, &fef, &lef) * frlen;
                 tkn->end = ((fef + lef) / 2) * frlen;
             }
@@ -293,9 +345,12 @@ static void fsg_processor(context_t *ctx,
                     if (tkn && start < (int32_t)tkn->end)
                         break;  /* just take one candidate */
 
-                    if (!tkn || !tkneq(token, tkn->token)) {
+                    if (!tknbase(&next, token))
+                        continue;
+
+                    if (!tkn || next.id != tkn->id) {
                         tkn = cand->tokens + cand->ntoken++;
-                        tkn->token = tknbase(token);
+                        *tkn = next;
                         tkn->start = start;
                         tkn->end = end + frlen;
                     }
@@ -304,15 +359,14 @@ static void fsg_processor(context_t *ctx,
         }
     }
 
-    sorted[0] = cands;
-    sorted[1] = NULL;
+    nbest_add(nbest);
 
     utt->id = uttid;
     utt->score = prob < 0.00001 ? 0.00001 : prob;
     //utt->length = dag ? ps_lattice_n_frames(dag) * frlen : 0;
     utt->length = filtbuf->len;
-    utt->ncand = 1;
-    utt->cands = sorted;
+    utt->ncand = nbest_sort(nbest);
+    utt->cands = nbest->sorted;
 }
 
 
@@ -342,127 +396,237 @@ static void print_utterance(context_t *ctx, srs_srec_utterance_t *utt)
     }
 }
 
-static srs_srec_candidate_t *candidate_equal(srs_srec_candidate_t *a,
-                                             srs_srec_candidate_t *b)
+#define NBEST_DELETED ((nbest_cand_t *)-1)
+
+static uint32_t nbest_hash(srs_srec_candidate_t *cand)
 {
-    srs_srec_token_t *at,*bt;
-    size_t i,n;
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0;  i < cand->ntoken;  i++) {
+        h ^= cand->tokens[i].id;
+        h *= 16777619u;
+    }
 
-    if (!a || !b)
-        return NULL;
+    return h ^ (uint32_t)cand->ntoken;
+}
 
-    if ((n = a->ntoken) != b->ntoken)
+static bool nbest_equal(nbest_cand_t *a, nbest_cand_t *b)
+{
+    size_t i;
+
+    if (a->hash != b->hash || a->cand.ntoken != b->cand.ntoken)
         return false;
 
-    for (i = 0;  i < n;  i++) {
-        at = a->tokens + i;
-        bt = b->tokens + i;
+    for (i = 0;  i < a->cand.ntoken;  i++) {
+        if (a->cand.tokens[i].id != b->cand.tokens[i].id)
+            return false;
+    }
+
+    return true;
+}
+
+static nbest_cand_t *nbest_lookup(nbest_t *nbest, nbest_cand_t *c,
+                                  uint32_t *slotp)
+{
+    uint32_t mask = nbest->nslot - 1;
+    uint32_t i, free;
+    nbest_cand_t *e;
+
+    free = nbest->nslot;
 
-        if (!tkneq(at->token, bt->token))
-            return NULL;
+    for (i = c->hash & mask;  (e = nbest->table[i]);  i = (i + 1) & mask) {
+        if (e == NBEST_DELETED) {
+            if (free == nbest->nslot)
+                free = i;
+        }
+        else if (nbest_equal(e, c))
+            return e;
     }
 
-    return (a->score > b->score) ? a : b;
+    *slotp = (free < nbest->nslot) ? free : i;
+
+    return NULL;
 }
 
-static double candidate_score(srs_srec_candidate_t *cand)
+static void nbest_rehash(nbest_t *nbest)
 {
-    return cand ? cand->score : 0.0;
+    nbest_cand_t *c;
+    uint32_t i, slot;
+
+    memset(nbest->table, 0, nbest->nslot * sizeof(nbest->table[0]));
+    nbest->ntomb = 0;
+
+    for (i = 0;  i < nbest->ncand;  i++) {
+        c = nbest->heap[i];
+        nbest_lookup(nbest, c, &slot);
+        nbest->table[slot] = c;
+        c->slot = slot;
+    }
 }
 
+static void nbest_swap(nbest_t *nbest, uint32_t i, uint32_t j)
+{
+    nbest_cand_t *c = nbest->heap[i];
+
+    nbest->heap[i] = nbest->heap[j];
+    nbest->heap[j] = c;
+    nbest->heap[i]->heapidx = i;
+    nbest->heap[j]->heapidx = j;
+}
 
-static uint32_t candidate_sort(srs_srec_candidate_t *cands,
-                               srs_srec_candidate_t **sorted)
+static void nbest_sift_up(nbest_t *nbest, uint32_t i)
 {
-    srs_srec_candidate_t *c, **s;
-    srs_srec_candidate_t *better_score;
-    size_t i,j,n;
+    uint32_t parent;
 
-    memset(sorted, 0, sizeof(srs_srec_candidate_t *) * (CANDIDATE_MAX + 1));
+    while (i > 0) {
+        parent = (i - 1) / 2;
 
-    for (i = n = 0;  i < CANDIDATE_MAX;  i++) {
-        if (!(c = cands + i)->ntoken)
+        if (nbest->heap[parent]->cand.score <= nbest->heap[i]->cand.score)
             break;
 
-        for (j = 0;   j <= n;   j++) {
-            s = sorted + j;
+        nbest_swap(nbest, i, parent);
+        i = parent;
+    }
+}
 
-            if ((better_score = candidate_equal(c, *s))) {
-                *s = better_score;
-                break;
-            }
+static void nbest_sift_down(nbest_t *nbest, uint32_t i)
+{
+    uint32_t l, r, min;
 
-            if (candidate_score(c) > candidate_score(*s)) {
-                if (j < n) {
-                    memmove(sorted + j+1, sorted + j,
-                            sizeof(srs_srec_candidate_t *) * (n - j));
-                }
-                *s = c;
-                n++;
-                break;
-            }
-        }
+    for (;;) {
+        l = 2 * i + 1;
+        r = l + 1;
+        min = i;
+
+        if (l < nbest->ncand &&
+            nbest->heap[l]->cand.score < nbest->heap[min]->cand.score)
+            min = l;
+        if (r < nbest->ncand &&
+            nbest->heap[r]->cand.score < nbest->heap[min]->cand.score)
+            min = r;
+
+        if (min == i)
+            break;
+
+        nbest_swap(nbest, i, min);
+        i = min;
     }
+}
 
-    return n;
+static void nbest_reset(nbest_t *nbest)
+{
+    memset(nbest->table, 0, nbest->nslot * sizeof(nbest->table[0]));
+    nbest->ntomb = 0;
+    nbest->ncand = 0;
+    nbest->spare = nbest->pool;
 }
 
-static bool tkneq(const char *tkn1, const char *tkn2)
+static srs_srec_candidate_t *nbest_spare(nbest_t *nbest)
 {
-    const char *e1, *e2;
-    int l1, l2;
+    return &nbest->spare->cand;
+}
 
-    if (!tkn1 || !tkn2)
-        return false;
+static void nbest_add(nbest_t *nbest)
+{
+    nbest_cand_t *c, *old;
+    uint32_t slot;
+
+    c = nbest->spare;
+    c->hash = nbest_hash(&c->cand);
+
+    /*
+     * A duplicate replaces the earlier instance if it scores better,
+     * otherwise it is dropped. Either way the loser becomes the spare.
+     */
+    if ((old = nbest_lookup(nbest, c, &slot))) {
+        if (c->cand.score > old->cand.score) {
+            c->heapidx = old->heapidx;
+            c->slot = old->slot;
+            nbest->heap[c->heapidx] = c;
+            nbest->table[c->slot] = c;
+            nbest->spare = old;
+            nbest_sift_down(nbest, c->heapidx);
+        }
+        return;
+    }
 
-    if (!strcmp(tkn1, tkn2))
-        return true;
+    if (nbest->ncand < nbest->max) {
+        c->heapidx = nbest->ncand;
+        c->slot = slot;
+        nbest->heap[nbest->ncand++] = c;
+        nbest->table[slot] = c;
+        nbest->spare = nbest->pool + nbest->ncand;
+        nbest_sift_up(nbest, c->heapidx);
+        return;
+    }
 
-    if (*tkn1 == *tkn2) {
-        l1 = (e1 = strchr(tkn1, '(')) ? e1 - tkn1 : 0;
-        l2 = (e2 = strchr(tkn2, '(')) ? e2 - tkn2 : 0;
+    /* full: replace the worst kept candidate if we're better */
+    old = nbest->heap[0];
 
-        if (l1 || l2) {
-            if (l1 == l2 && !strncmp(tkn1, tkn2, l1))
-                return true;
-            if (l1 && !l2 && !strncmp(tkn1, tkn2, l1))
-                return true;
-            if (!l1 && l2 && !strncmp(tkn1, tkn2, l2))
-                return true;
-        }
-    }
+    if (c->cand.score <= old->cand.score)
+        return;
 
-    return false;
+    nbest->table[old->slot] = NBEST_DELETED;
+    nbest->ntomb++;
+
+    c->heapidx = 0;
+    nbest->heap[0] = c;
+    nbest->spare = old;
+    nbest_sift_down(nbest, 0);
+
+    if (nbest->ntomb > nbest->max)
+        nbest_rehash(nbest);
+    else {
+        nbest_lookup(nbest, c, &slot);
+        c->slot = slot;
+        nbest->table[slot] = c;
+    }
 }
 
-static const char *tknbase(const char *token)
+static int nbest_cmp(const void *a, const void *b)
 {
-    static char  pool[16384];
-    static char *ptr = pool;
-    static char *end = pool + (sizeof(pool) - 1);
+    const srs_srec_candidate_t *ca = *(srs_srec_candidate_t * const *)a;
+    const srs_srec_candidate_t *cb = *(srs_srec_candidate_t * const *)b;
+
+    if (ca->score > cb->score)
+        return -1;
+    if (ca->score < cb->score)
+        return 1;
+    return 0;
+}
 
-    char c, *p, *stripped;
-    const char *q;
-    int i;
+static uint32_t nbest_sort(nbest_t *nbest)
+{
+    uint32_t i, n = nbest->ncand;
 
-    for (i = 0; i < 2;  i++) {
-        for (stripped = p = ptr, q = token;  p < end;  p++) {
-            c = *q++;
+    for (i = 0;  i < n;  i++)
+        nbest->sorted[i] = &nbest->heap[i]->cand;
 
-            if (c == '\0')
-                return token;
+    qsort(nbest->sorted, n, sizeof(nbest->sorted[0]), nbest_cmp);
+    nbest->sorted[n] = NULL;
 
-            if (c == '(') {
-                *p++ = '\0';
-                ptr = p;
-                return stripped;
-            }
+    return n;
+}
 
-            *p++ = c;
-        }
-        ptr = pool;
-    }
-    return token;
+static srs_token_id_t tknbase(srs_srec_token_t *tkn, const char *token)
+{
+    const char *e;
+    size_t len;
+
+    /*
+     * Strip alternate pronunciation suffixes (eg. 'word(2)') and intern
+     * the result, so tokens can be compared by id and need no copying.
+     */
+    if ((e = strchr(token, '(')) != NULL)
+        len = e - token;
+    else
+        len = SRS_TOKEN_NUL;
+
+    tkn->id = srs_token_intern(token, len);
+    tkn->token = tkn->id ? srs_token_string(tkn->id) : token;
+
+    return tkn->id;
 }
 
 
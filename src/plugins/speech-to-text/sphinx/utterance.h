@@ -4,8 +4,33 @@
 #include "sphinx-plugin.h"
 
 #define CANDIDATE_TOKEN_MAX  50
-#define CANDIDATE_MAX        5
+#define CANDIDATE_MAX        5      /* default number of candidates */
+#define NBEST_DEPTH          16     /* default N-best hypotheses examined */
 
+struct nbest_cand_s {
+    srs_srec_candidate_t cand;      /* the candidate itself */
+    uint32_t hash;                  /* hash of the token id sequence */
+    uint32_t slot;                  /* slot in the duplicate hash table */
+    uint32_t heapidx;               /* index in the heap */
+};
+
+struct nbest_s {
+    uint32_t depth;                 /* max. hypotheses to examine */
+    uint32_t max;                   /* max. candidates to keep */
+    uint32_t ncand;                 /* candidates currently kept */
+    nbest_cand_t *pool;             /* max + 1 candidates */
+    srs_srec_token_t *tokens;       /* token storage for the pool */
+    nbest_cand_t **heap;            /* kept candidates, worst on top */
+    nbest_cand_t *spare;            /* candidate being filled in */
+    nbest_cand_t **table;           /* hash table for duplicate merging */
+    uint32_t nslot;                 /* hash table size, power of 2 */
+    uint32_t ntomb;                 /* deleted hash table entries */
+    srs_srec_candidate_t **sorted;  /* kept candidates, best first */
+};
+
+
+int  utterance_create(context_t *ctx);
+void utterance_destroy(context_t *ctx);
 
 void utterance_start(context_t *ctx);
 void utterance_end(context_t *ctx);
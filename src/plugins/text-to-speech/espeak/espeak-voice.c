@@ -55,10 +55,100 @@
 #define ESPEAK_CONTINUE 0
 #define ESPEAK_ABORT    1
 
+#define BUFFER_MSEC     50               /* synthesis callback interval */
+#define CHUNK_POOL_MAX  32               /* max. free chunks to keep */
+
+/*
+ * an ongoing rendering
+ *
+ * espeak keeps all of its state in globals, so we synthesize one message
+ * at a time, in a worker thread if we have one. Audio is passed back to
+ * the main loop in chunks as espeak produces it and appended to the
+ * playback stream of the rendering.
+ */
+
 typedef struct {
-    void *samples;
-    int   nsample;
-} synth_data_t;
+    mrp_list_hook_t  hook;               /* to list of renderings */
+    espeak_t        *e;                  /* plugin instance */
+    uint32_t         id;                 /* playback stream id */
+    uint32_t         job;                /* synthesis job id */
+    char           **segs;               /* message segments to render */
+    int              nseg;               /* number of segments */
+    int              actor;              /* voice to render with */
+    double           rate;               /* synthesis rate */
+    double           pitch;              /* synthesis pitch */
+    int              status;             /* synthesis status */
+    volatile int     cancelled;          /* whether cancelled */
+} render_t;
+
+/*
+ * a chunk of synthesized audio on its way to the main loop
+ *
+ * espeak calls us back with at most BUFFER_MSEC worth of audio at a
+ * time. Every callback block is copied to a fixed-size chunk taken from
+ * a free list and posted as such, so once the pool has warmed up audio
+ * flows to the playback stream without any further allocation.
+ */
+
+typedef struct chunk_s chunk_t;
+
+struct chunk_s {
+    chunk_t         *next;               /* next free chunk */
+    render_t        *r;                  /* rendering */
+    int              nsample;            /* number of samples */
+    double           input;              /* fraction of message done */
+    short            samples[];          /* synthesized samples */
+};
+
+
+static chunk_t *get_chunk(espeak_t *e)
+{
+    chunk_t *c;
+
+    pthread_mutex_lock(&e->chunks.lock);
+
+    if ((c = e->chunks.free) != NULL) {
+        e->chunks.free = c->next;
+        e->chunks.nfree--;
+    }
+
+    pthread_mutex_unlock(&e->chunks.lock);
+
+    if (c == NULL)
+        c = mrp_alloc(sizeof(*c) + e->chunks.size * sizeof(c->samples[0]));
+
+    return c;
+}
+
+
+static void put_chunk(espeak_t *e, chunk_t *c)
+{
+    pthread_mutex_lock(&e->chunks.lock);
+
+    if (e->chunks.nfree < CHUNK_POOL_MAX) {
+        c->next = e->chunks.free;
+        e->chunks.free = c;
+        e->chunks.nfree++;
+        c = NULL;
+    }
+
+    pthread_mutex_unlock(&e->chunks.lock);
+
+    mrp_free(c);
+}
+
+
+static void purge_chunks(espeak_t *e)
+{
+    chunk_t *c;
+
+    while ((c = e->chunks.free) != NULL) {
+        e->chunks.free = c->next;
+        mrp_free(c);
+    }
+
+    e->chunks.nfree = 0;
+}
 
 
 static void stream_event_cb(srs_pulse_t *p, srs_voice_event_t *event,
@@ -72,19 +162,72 @@ static void stream_event_cb(srs_pulse_t *p, srs_voice_event_t *event,
 }
 
 
+static void chunk_cb(uint32_t job, int status, void *data)
+{
+    chunk_t  *c = (chunk_t *)data;
+    render_t *r = c->r;
+
+    MRP_UNUSED(job);
+
+    if (status == 0 && !r->cancelled) {
+        if (c->nsample > 0)
+            srs_append_stream(r->e->srs->pulse, r->id, c->samples,
+                              c->nsample);
+        if (c->input > 0)
+            srs_estimate_stream(r->e->srs->pulse, r->id, c->input);
+    }
+
+    put_chunk(r->e, c);
+}
+
+
+static int pass_chunk(render_t *r, short *samples, int nsample, double input)
+{
+    espeak_t *e = r->e;
+    chunk_t  *c;
+    int       n;
+
+    do {
+        if ((c = get_chunk(e)) == NULL)
+            return -1;
+
+        n = nsample < e->chunks.size ? nsample : e->chunks.size;
+
+        c->r       = r;
+        c->nsample = n;
+        c->input   = n < nsample ? 0 : input;
+
+        if (n > 0) {
+            memcpy(c->samples, samples, n * sizeof(samples[0]));
+            samples += n;
+            nsample -= n;
+        }
+
+        if (e->jobs == NULL)
+            chunk_cb(SRS_JOB_INVALID, 0, c);
+        else if (srs_job_post(e->jobs, chunk_cb, c) < 0) {
+            put_chunk(e, c);
+            return -1;
+        }
+    } while (nsample > 0);
+
+    return 0;
+}
+
+
 static int espeak_synth_cb(short *samples, int nsample, espeak_EVENT *events)
 {
-    synth_data_t *data = events->user_data;
+    render_t *r = events->user_data;
+
+    if (r->cancelled)
+        return ESPEAK_ABORT;
 
-    if (samples == NULL)
+    if (samples == NULL || nsample <= 0)
         return ESPEAK_CONTINUE;
 
-    if (mrp_realloc(data->samples, 2 * (data->nsample + nsample)) == NULL)
+    if (pass_chunk(r, samples, nsample, 0) < 0)
         return ESPEAK_ABORT;
 
-    memcpy(data->samples + 2 * data->nsample, samples, 2 * nsample);
-    data->nsample += nsample;
-
     return ESPEAK_CONTINUE;
 }
 
@@ -135,30 +278,18 @@ static int espeak_setpitch(double dpitch)
 }
 
 
-static uint32_t espeak_render(const char *msg, char **tags, int actor,
-                              double rate, double pitch, int notify_events,
-                              void *api_data)
+static void synth_job(void *data)
 {
-    espeak_t     *e = (espeak_t *)api_data;
-    int           size, start, end, type, orate, opitch;
+    render_t     *r = (render_t *)data;
+    espeak_t     *e = r->e;
+    int           size, start, end, type, orate, opitch, total, done, i;
     unsigned int  flags, uid;
-    synth_data_t  data;
-    uint32_t      id;
-    int           r;
-
-    MRP_UNUSED(rate);
-    MRP_UNUSED(pitch);
-
-    if (0 <= actor && actor <= e->nactor) {
-        if (espeak_SetVoiceByName(e->actors[actor].name) != EE_OK) {
-            mrp_log_error("espeak: failed to activate espeak voice #%d ('%s').",
-                          actor, e->actors[actor].name);
-            return SRS_VOICE_INVALID;
-        }
-    }
-    else {
-        mrp_log_error("espeak: invalid espeak voice #%d requested.", actor);
-        return SRS_VOICE_INVALID;
+
+    if (espeak_SetVoiceByName(e->actors[r->actor].name) != EE_OK) {
+        mrp_log_error("espeak: failed to activate espeak voice #%d ('%s').",
+                      r->actor, e->actors[r->actor].name);
+        r->status = -1;
+        return;
     }
 
     size  = 0;
@@ -167,37 +298,146 @@ static uint32_t espeak_render(const char *msg, char **tags, int actor,
     end   = 0;
     flags = espeakCHARS_UTF8;
     uid   = 0;
-    data  = (synth_data_t) { NULL, 0 };
 
-    orate  = espeak_setrate(rate);
-    opitch = espeak_setpitch(pitch);
+    orate  = espeak_setrate(r->rate);
+    opitch = espeak_setpitch(r->pitch);
+
+    for (i = total = 0; i < r->nseg; i++)
+        total += strlen(r->segs[i]);
+
+    /* synthesize a segment at a time, letting playback catch up */
+    for (i = done = 0; i < r->nseg && !r->cancelled; i++) {
+        if (espeak_Synth(r->segs[i], size, start, type, end, flags, &uid,
+                         r) != EE_OK) {
+            if (!r->cancelled) {
+                mrp_log_error("espeak: failed to synthesize message.");
+                r->status = -1;
+            }
+            break;
+        }
+
+        done += strlen(r->segs[i]);
 
-    r = espeak_Synth(msg, size, start, type, end, flags, &uid, &data);
+        if (pass_chunk(r, NULL, 0, total ? 1.0 * done / total : 1.0) < 0) {
+            r->status = -1;
+            break;
+        }
+    }
 
     espeak_setrate(orate);
     espeak_setpitch(opitch);
+}
+
+
+static void free_render(render_t *r)
+{
+    mrp_list_delete(&r->hook);
+    mrp_free(r->segs);
+    mrp_free(r);
+}
+
+
+static void synth_done(uint32_t job, int status, void *data)
+{
+    render_t *r = (render_t *)data;
+    espeak_t *e = r->e;
+
+    MRP_UNUSED(job);
+
+    if (!r->cancelled) {
+        if (status != 0 || r->status != 0)
+            srs_stop_stream(e->srs->pulse, r->id, FALSE, TRUE);
+        else
+            srs_close_stream(e->srs->pulse, r->id);
+    }
+
+    free_render(r);
+}
+
+
+static uint32_t espeak_render(const char *msg, char **tags, int actor,
+                              double rate, double pitch, int notify_events,
+                              void *api_data)
+{
+    espeak_t *e = (espeak_t *)api_data;
+    render_t *r;
+    uint32_t  id;
+
+    if (actor < 0 || actor >= e->nactor) {
+        mrp_log_error("espeak: invalid espeak voice #%d requested.", actor);
+        return SRS_VOICE_INVALID;
+    }
+
+    if ((r = mrp_allocz(sizeof(*r))) == NULL)
+        return SRS_VOICE_INVALID;
+
+    mrp_list_init(&r->hook);
+    r->e     = e;
+    r->actor = actor;
+    r->rate  = rate;
+    r->pitch = pitch;
+    r->nseg  = srs_segment_voice(msg, &r->segs);
 
-    if (r != EE_OK || data.samples == NULL) {
-        mrp_log_error("espeak: failed to synthesize message with espeak.");
+    if (r->nseg < 0) {
+        mrp_free(r);
         return SRS_VOICE_INVALID;
     }
 
-    id = srs_play_stream(e->srs->pulse, data.samples, e->config.rate, 1,
-                         data.nsample, tags, notify_events,
-                         stream_event_cb, e);
+    r->id = srs_open_stream(e->srs->pulse, e->config.rate, 1, tags,
+                            notify_events, stream_event_cb, e);
+
+    if (r->id == SRS_VOICE_INVALID) {
+        free_render(r);
+        return SRS_VOICE_INVALID;
+    }
+
+    mrp_list_append(&e->renders, &r->hook);
+
+    if (e->jobs != NULL) {
+        r->job = srs_job_submit(e->jobs, synth_job, synth_done, r);
+
+        if (r->job != SRS_JOB_INVALID)
+            return r->id;
+    }
+    else {
+        /* no worker pool, synthesize it all right here */
+        synth_job(r);
 
-    if (id == SRS_VOICE_INVALID)
-        mrp_free(data.samples);
+        if (r->status == 0) {
+            id = r->id;
+            srs_close_stream(e->srs->pulse, id);
+            free_render(r);
 
-    return id;
+            return id;
+        }
+    }
+
+    srs_stop_stream(e->srs->pulse, r->id, FALSE, FALSE);
+    free_render(r);
+
+    return SRS_VOICE_INVALID;
 }
 
 
 static void espeak_cancel(uint32_t id, void *api_data)
 {
-    espeak_t *e = (espeak_t *)api_data;
+    espeak_t        *e = (espeak_t *)api_data;
+    mrp_list_hook_t *p, *n;
+    render_t        *r;
 
     srs_stop_stream(e->srs->pulse, id, FALSE, FALSE);
+
+    mrp_list_foreach(&e->renders, p, n) {
+        r = mrp_list_entry(p, typeof(*r), hook);
+
+        if (r->id == id) {
+            r->cancelled = TRUE;
+
+            if (e->jobs != NULL)
+                srs_job_cancel(e->jobs, r->job);
+            break;
+        }
+    }
 }
 
 
@@ -210,6 +450,8 @@ static int create_espeak(srs_plugin_t *plugin)
     e = mrp_allocz(sizeof(*e));
 
     if (e != NULL) {
+        mrp_list_init(&e->renders);
+        pthread_mutex_init(&e->chunks.lock, NULL);
         e->self = plugin;
         e->srs  = plugin->srs;
 
@@ -234,7 +476,7 @@ static int config_espeak(srs_plugin_t *plugin, srs_cfg_t *cfg)
 
     out  = AUDIO_OUTPUT_SYNCHRONOUS;
     path = e->config.voicedir;
-    blen = 1000;
+    blen = BUFFER_MSEC;
 
     rate = espeak_Initialize(out, blen, path, 0);
 
@@ -246,6 +488,7 @@ static int config_espeak(srs_plugin_t *plugin, srs_cfg_t *cfg)
     mrp_log_info("espeak: chose %d Hz for sample rate.", rate);
 
     e->config.rate = rate;
+    e->chunks.size = rate * BUFFER_MSEC / 1000;
 
     espeak_SetSynthCallback(espeak_synth_cb);
     /*espeak_SetParameter(espeakRATE, espeakRATE_NORMAL, 0);
@@ -368,6 +611,10 @@ static int start_espeak(srs_plugin_t *plugin)
         }
     }
 
+    /* espeak is not reentrant, synthesize one message at a time */
+    if ((e->jobs = srs_job_queue_create(e->srs, "espeak", 1)) == NULL)
+        mrp_log_info("espeak: no worker pool, synthesizing in mainloop.");
+
     if (srs_register_voice(e->self->srs, "espeak", &api, e,
                            e->actors, e->nactor,
                            &e->voice.notify, &e->voice.notify_data) == 0)
@@ -394,12 +641,23 @@ static void stop_espeak(srs_plugin_t *plugin)
 
 static void destroy_espeak(srs_plugin_t *plugin)
 {
-    espeak_t *e = (espeak_t *)plugin->plugin_data;
-    int       i;
+    espeak_t        *e = (espeak_t *)plugin->plugin_data;
+    mrp_list_hook_t *p, *n;
+    int              i;
 
     srs_unregister_voice(e->self->srs, "espeak");
+
+    srs_job_queue_destroy(e->jobs);
+    e->jobs = NULL;
+
+    mrp_list_foreach(&e->renders, p, n)
+        free_render(mrp_list_entry(p, render_t, hook));
+
     espeak_Terminate();
 
+    purge_chunks(e);
+    pthread_mutex_destroy(&e->chunks.lock);
+
     for (i = 0; i < e->nactor; i++) {
         mrp_free(e->actors[i].name);
         mrp_free(e->actors[i].lang);
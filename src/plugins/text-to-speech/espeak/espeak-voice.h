@@ -1,16 +1,28 @@
 #ifndef __SRS_ESPEAK_VOICE_H__
 #define __SRS_ESPEAK_VOICE_H__
 
+#include <pthread.h>
 #include <pulse/mainloop.h>
 
+#include <murphy/common/list.h>
+
 #include "srs/daemon/plugin.h"
 #include "srs/daemon/voice.h"
+#include "srs/daemon/worker.h"
 
 typedef struct {
     srs_plugin_t      *self;             /* our plugin instance */
     srs_context_t     *srs;              /* SRS context */
     srs_voice_actor_t *actors;           /* loaded voices */
     int                nactor;           /* number of voices */
+    srs_job_queue_t   *jobs;             /* synthesis job queue */
+    mrp_list_hook_t    renders;          /* ongoing renderings */
+    struct {
+        pthread_mutex_t  lock;           /* protects the free list */
+        void            *free;           /* free audio chunks */
+        int              nfree;          /* number of free chunks */
+        int              size;           /* chunk size in samples */
+    } chunks;
     struct {
         const char    *voicedir;         /* voice directory */
         int            rate;             /* sample rate */
@@ -27,6 +27,10 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
 #include <murphy/common/debug.h>
 #include <murphy/common/mainloop.h>
 
@@ -46,6 +50,37 @@
 #define AUTOLOAD       "auto"
 #define CONFIG_VOICES  "festival.voices"
 #define DEFVAL_VOICES  DEFVOICE
+#define CONFIG_PRELOAD "festival.preload"
+#define CONFIG_LIMIT   "festival.memory-limit"
+
+#define WARM_DELAY     1000              /* load next warm voice after this */
+
+/*
+ * an ongoing rendering
+ *
+ * The festival interpreter can only be run from the main thread. To get
+ * audio out early, we synthesize only the first segment of a message
+ * when asked to render it and the rest one segment per mainloop
+ * iteration. Within a segment festival passes us the audio of every
+ * utterance as soon as it is done and we append it straight to the
+ * playback stream, opening the stream with the first utterance.
+ */
+
+typedef struct {
+    mrp_list_hook_t  hook;               /* to list of renderings */
+    festival_t      *f;                  /* plugin instance */
+    uint32_t         id;                 /* playback stream id */
+    int              actor;              /* voice to render with */
+    char           **segs;               /* message segments */
+    int              nseg;               /* number of segments */
+    int              next;               /* next segment to synthesize */
+    int              total;              /* message length */
+    int              done;               /*     synthesized so far */
+    mrp_deferred_t  *d;                  /* for synthesizing the rest */
+    char           **tags;               /* stream tags, until opened */
+    int              notify_events;      /* stream events, until opened */
+    int              formatted;          /* whether stream format is set */
+} render_t;
 
 
 static void stream_event_cb(srs_pulse_t *pulse, srs_voice_event_t *event,
@@ -59,31 +94,219 @@ static void stream_event_cb(srs_pulse_t *pulse, srs_voice_event_t *event,
 }
 
 
+static void free_render(render_t *r)
+{
+    mrp_list_delete(&r->hook);
+    mrp_del_deferred(r->d);
+    mrp_free(r->segs);
+    mrp_free(r);
+}
+
+
+static size_t memory_usage(void)
+{
+    FILE          *fp;
+    unsigned long  size, resident;
+    int            n;
+
+    if ((fp = fopen("/proc/self/statm", "r")) == NULL)
+        return 0;
+
+    n = fscanf(fp, "%lu %lu", &size, &resident);
+    fclose(fp);
+
+    if (n != 2)
+        return 0;
+
+    return (size_t)resident * sysconf(_SC_PAGESIZE);
+}
+
+
+static int load_voice(festival_t *f, int actor)
+{
+    voice_t    *v    = f->voices + actor;
+    const char *name = f->actors[actor].name;
+    size_t      before, after;
+
+    if (v->loaded)
+        return 0;
+
+    /* voice data can't be freed, so refuse to go beyond the limit */
+    if (f->config.limit > 0 && f->loaded >= f->config.limit) {
+        mrp_log_error("festival: can't load voice '%s', loaded voices "
+                      "(%zu kB) are at the memory limit (%zu kB).", name,
+                      f->loaded / 1024, f->config.limit / 1024);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    before = memory_usage();
+
+    if (carnival_load_voice(name) != 0) {
+        mrp_log_error("festival: failed to load voice '%s'.", name);
+        return -1;
+    }
+
+    after = memory_usage();
+
+    v->loaded = TRUE;
+    v->size   = after > before ? after - before : 0;
+    f->loaded += v->size;
+
+    mrp_log_info("festival: loaded voice '%s' (%zu kB).", name,
+                 v->size / 1024);
+
+    if (f->config.limit > 0 && f->loaded > f->config.limit)
+        mrp_log_warning("festival: loaded voices (%zu kB) exceed the "
+                        "memory limit (%zu kB).", f->loaded / 1024,
+                        f->config.limit / 1024);
+
+    return 0;
+}
+
+
+static int utterance_cb(void *samples, int srate, int nchannel, int nsample,
+                        void *user_data)
+{
+    render_t   *r = (render_t *)user_data;
+    festival_t *f = r->f;
+
+    if (r->id == SRS_VOICE_INVALID) {
+        r->id = srs_open_stream(f->srs->pulse, srate, nchannel, r->tags,
+                                r->notify_events, stream_event_cb, f);
+
+        if (r->id == SRS_VOICE_INVALID)
+            return -1;
+
+        r->formatted = (srate > 0);
+    }
+
+    if (!r->formatted) {
+        if (srs_format_stream(f->srs->pulse, r->id, srate, nchannel) < 0)
+            return -1;
+
+        r->formatted = TRUE;
+    }
+
+    if (nsample <= 0)
+        return 0;
+
+    return srs_append_stream(f->srs->pulse, r->id, samples, nsample);
+}
+
+
+static int synthesize_next(render_t *r)
+{
+    festival_t *f = r->f;
+
+    /* another rendering might have switched voices in between */
+    if (carnival_select_voice(f->actors[r->actor].name) != 0 ||
+        carnival_synthesize_stream(r->segs[r->next], utterance_cb, r) != 0)
+        return -1;
+
+    /* nothing to say in this segment, format the stream once we know */
+    if (r->id == SRS_VOICE_INVALID) {
+        r->id = srs_open_stream(f->srs->pulse, 0, 0, r->tags,
+                                r->notify_events, stream_event_cb, f);
+
+        if (r->id == SRS_VOICE_INVALID)
+            return -1;
+    }
+
+    r->done += strlen(r->segs[r->next]);
+    r->next++;
+
+    srs_estimate_stream(f->srs->pulse, r->id, 1.0 * r->done / r->total);
+
+    return 0;
+}
+
+
+static void synthesize_cb(mrp_deferred_t *d, void *user_data)
+{
+    render_t   *r = (render_t *)user_data;
+    festival_t *f = r->f;
+
+    MRP_UNUSED(d);
+
+    if (synthesize_next(r) < 0) {
+        mrp_log_error("festival: failed to synthesize message segment.");
+        srs_stop_stream(f->srs->pulse, r->id, FALSE, TRUE);
+        free_render(r);
+    }
+    else if (r->next == r->nseg) {
+        srs_close_stream(f->srs->pulse, r->id);
+        free_render(r);
+    }
+}
+
+
 static uint32_t festival_render(const char *msg, char **tags, int actor,
                                 double rate, double pitch, int notify_events,
                                 void *api_data)
 {
     festival_t *f = (festival_t *)api_data;
-    void       *samples;
+    render_t   *r;
     uint32_t    id;
-    int         srate, nchannel, nsample;
+    int         i;
 
     MRP_UNUSED(rate);
     MRP_UNUSED(pitch);
 
-    if (0 <= actor && actor < f->nactor)
-        carnival_select_voice(f->actors[actor].name);
-    else
+    if (actor < 0 || actor >= f->nactor)
         return SRS_VOICE_INVALID;
 
-    if (carnival_synthesize(msg, &samples, &srate, &nchannel, &nsample) != 0)
+    if (load_voice(f, actor) < 0)
         return SRS_VOICE_INVALID;
-    else
-        id = srs_play_stream(f->srs->pulse, samples, srate, nchannel, nsample,
-                             tags, notify_events, stream_event_cb, f);
 
-    if (id == SRS_VOICE_INVALID)
-        mrp_free(samples);
+    if ((r = mrp_allocz(sizeof(*r))) == NULL)
+        return SRS_VOICE_INVALID;
+
+    mrp_list_init(&r->hook);
+    r->f     = f;
+    r->actor = actor;
+    r->nseg  = srs_segment_voice(msg, &r->segs);
+
+    if (r->nseg <= 0) {
+        mrp_free(r->segs);
+        mrp_free(r);
+        return SRS_VOICE_INVALID;
+    }
+
+    for (i = 0; i < r->nseg; i++)
+        r->total += strlen(r->segs[i]);
+
+    r->id            = SRS_VOICE_INVALID;
+    r->tags          = tags;
+    r->notify_events = notify_events;
+
+    if (synthesize_next(r) < 0) {
+        if (r->id != SRS_VOICE_INVALID)
+            srs_stop_stream(f->srs->pulse, r->id, FALSE, FALSE);
+        free_render(r);
+
+        return SRS_VOICE_INVALID;
+    }
+
+    id      = r->id;
+    r->tags = NULL;
+
+    if (r->next == r->nseg) {
+        srs_close_stream(f->srs->pulse, id);
+        free_render(r);
+    }
+    else {
+        r->d = mrp_add_deferred(f->srs->ml, synthesize_cb, r);
+
+        if (r->d == NULL) {
+            srs_stop_stream(f->srs->pulse, id, FALSE, FALSE);
+            free_render(r);
+
+            return SRS_VOICE_INVALID;
+        }
+
+        mrp_list_append(&f->renders, &r->hook);
+    }
 
     return id;
 }
@@ -91,9 +314,20 @@ static uint32_t festival_render(const char *msg, char **tags, int actor,
 
 static void festival_cancel(uint32_t id, void *api_data)
 {
-    festival_t *f = (festival_t *)api_data;
+    festival_t      *f = (festival_t *)api_data;
+    mrp_list_hook_t *p, *n;
+    render_t        *r;
 
     srs_stop_stream(f->srs->pulse, id, FALSE, FALSE);
+
+    mrp_list_foreach(&f->renders, p, n) {
+        r = mrp_list_entry(p, typeof(*r), hook);
+
+        if (r->id == id) {
+            free_render(r);
+            break;
+        }
+    }
 }
 
 
@@ -106,6 +340,7 @@ static int create_festival(srs_plugin_t *plugin)
     f = mrp_allocz(sizeof(*f));
 
     if (f != NULL) {
+        mrp_list_init(&f->renders);
         f->self = plugin;
         f->srs  = plugin->srs;
 
@@ -118,12 +353,50 @@ static int create_festival(srs_plugin_t *plugin)
 }
 
 
+static int parse_voices(const char *list, char ***voicesp)
+{
+    const char  *b, *e;
+    char       **voices;
+    int          nvoice, len;
+
+    voices = NULL;
+    nvoice = 0;
+
+    for (b = list; b != NULL && *b; b = e) {
+        while (*b == ',' || *b == ' ')
+            b++;
+
+        if ((e = strchr(b, ',')) != NULL)
+            len = e - b;
+        else
+            len = strlen(b);
+
+        while (len > 0 && b[len - 1] == ' ')
+            len--;
+
+        if (len == 0)
+            continue;
+
+        if (!mrp_reallocz(voices, nvoice, nvoice + 1) ||
+            (voices[nvoice] = mrp_datadup(b, len + 1)) == NULL) {
+            carnival_free_strings(voices, nvoice);
+            return -1;
+        }
+
+        voices[nvoice++][len] = '\0';
+    }
+
+    *voicesp = voices;
+
+    return nvoice;
+}
+
+
 static int config_festival(srs_plugin_t *plugin, srs_cfg_t *cfg)
 {
     festival_t  *f = (festival_t *)plugin->plugin_data;
-    const char  *b, *e;
-    char         voice[256], **voices;
-    int          nvoice, len, i;
+    char       **voices;
+    int          nvoice, limit, i;
 
     mrp_debug("configure festival voice plugin");
 
@@ -133,56 +406,34 @@ static int config_festival(srs_plugin_t *plugin, srs_cfg_t *cfg)
         return FALSE;
     }
 
-    f->config.voices = srs_config_get_string(cfg, CONFIG_VOICES, DEFVAL_VOICES);
+    f->config.voices  = srs_config_get_string(cfg, CONFIG_VOICES,
+                                              DEFVAL_VOICES);
+    f->config.preload = srs_config_get_string(cfg, CONFIG_PRELOAD, NULL);
+    limit             = srs_config_get_int32(cfg, CONFIG_LIMIT, 0);
+    f->config.limit   = limit > 0 ? (size_t)limit * 1024 : 0;
+
+    /*
+     * Only describe voices here, loading their data is deferred until
+     * they are first used or warmed up after startup.
+     */
 
     if (!strcmp(f->config.voices, AUTOLOAD)) {
-        if (carnival_available_voices(&voices, &nvoice) == 0) {
-            for (i = 0; i < nvoice; i++) {
-                if (carnival_load_voice(voices[i]) == 0)
-                    mrp_log_info("Loaded festival voice '%s'.", voices[i]);
-                else {
-                    mrp_log_info("Failed to load festival voice '%s'.",
-                                 voices[i]);
-                    return FALSE;
-                }
-            }
-        }
+        if (carnival_available_voices(&voices, &nvoice) != 0)
+            nvoice = 0;
     }
-    else if (f->config.voices[0]) {
-        b = f->config.voices;
-        while (b && *b) {
-            e = strchr(b, ',');
-
-            if (e != NULL) {
-                len = e - b;
-
-                if (len >= (int)sizeof(voice) - 1) {
-                toolong:
-                    mrp_log_error("Voice name '%*.*s' too long.", len, len, b);
-                    return FALSE;
-                }
-
-                strncpy(voice, b, len);
-                voice[len] = '\0';
-            }
-            else {
-                if ((len = strlen(b)) >= (int)sizeof(voice) - 1)
-                    goto toolong;
-
-                strcpy(voice, b);
-            }
+    else if ((nvoice = parse_voices(f->config.voices, &voices)) < 0)
+        return FALSE;
 
-            if (carnival_load_voice(voice) == 0)
-                mrp_log_info("Loaded festival voice '%s'.", voice);
-            else
-                mrp_log_error("Failed to load festival voice '%s'.", voice);
+    for (i = 0; i < nvoice; i++) {
+        if (carnival_describe_voice(voices[i]) != 0)
+            mrp_log_error("Failed to find festival voice '%s'.", voices[i]);
+    }
 
-            while (e != NULL && (*e == ',' || *e == ' '))
-                e++;
+    if (nvoice > 0)
+        carnival_free_strings(voices, nvoice);
 
-            b = e ? e : NULL;
-        }
-    }
+    if ((f->nwarm = parse_voices(f->config.preload, &f->warm)) < 0)
+        return FALSE;
 
     if (carnival_available_voices(&voices, &nvoice) == 0) {
         mrp_log_info("Available festival voices:");
@@ -193,11 +444,11 @@ static int config_festival(srs_plugin_t *plugin, srs_cfg_t *cfg)
         carnival_free_strings(voices, nvoice);
     }
 
-    if (carnival_loaded_voices(&voices, &nvoice) == 0) {
+    if (carnival_described_voices(&voices, &nvoice) == 0) {
         char *lang, *dial, *descr;
         int   female;
 
-        mrp_log_info("Loaded festival voices:");
+        mrp_log_info("Registered festival voices:");
 
         for (i = 0; i < nvoice; i++) {
             if (carnival_query_voice(voices[i],
@@ -223,6 +474,36 @@ static int config_festival(srs_plugin_t *plugin, srs_cfg_t *cfg)
 }
 
 
+static void warm_timer_cb(mrp_timer_t *t, void *user_data)
+{
+    festival_t *f = (festival_t *)user_data;
+    const char *name;
+    int         i;
+
+    MRP_UNUSED(t);
+
+    /* load one voice per round, not to stall the mainloop for too long */
+    if (f->nextwarm < f->nwarm) {
+        name = f->warm[f->nextwarm++];
+
+        for (i = 0; i < f->nactor; i++)
+            if (!strcmp(f->actors[i].name, name))
+                break;
+
+        if (i < f->nactor)
+            load_voice(f, i);
+        else
+            mrp_log_error("festival: can't preload unknown voice '%s'.",
+                          name);
+    }
+
+    if (f->nextwarm >= f->nwarm) {
+        mrp_del_timer(f->warm_timer);
+        f->warm_timer = NULL;
+    }
+}
+
+
 static int start_festival(srs_plugin_t *plugin)
 {
     static srs_voice_api_t api = {
@@ -239,13 +520,16 @@ static int start_festival(srs_plugin_t *plugin)
     if (f->srs->pulse == NULL)
         return FALSE;
 
-    if (carnival_loaded_voices(&voices, &nvoice) != 0)
+    if (carnival_described_voices(&voices, &nvoice) != 0)
         goto fail;
 
     if (nvoice == 0)
         return TRUE;
 
-    if ((f->actors = mrp_allocz_array(typeof(*f->actors), nvoice)) == NULL)
+    f->actors = mrp_allocz_array(typeof(*f->actors), nvoice);
+    f->voices = mrp_allocz_array(typeof(*f->voices), nvoice);
+
+    if (f->actors == NULL || f->voices == NULL)
         goto fail;
 
     for (i = 0; i < nvoice; i++) {
@@ -269,8 +553,12 @@ static int start_festival(srs_plugin_t *plugin)
 
     if (srs_register_voice(f->self->srs, "festival", &api, f,
                            f->actors, f->nactor,
-                           &f->voice.notify, &f->voice.notify_data) == 0)
+                           &f->voice.notify, &f->voice.notify_data) == 0) {
+        if (f->nwarm > 0)
+            f->warm_timer = mrp_add_timer(f->srs->ml, WARM_DELAY,
+                                          warm_timer_cb, f);
         return TRUE;
+    }
 
  fail:
     carnival_free_strings(voices, nvoice);
@@ -296,11 +584,18 @@ static void stop_festival(srs_plugin_t *plugin)
 
 static void destroy_festival(srs_plugin_t *plugin)
 {
-    festival_t *f = (festival_t *)plugin->plugin_data;
-    int         i;
+    festival_t      *f = (festival_t *)plugin->plugin_data;
+    mrp_list_hook_t *p, *n;
+    int              i;
 
     srs_unregister_voice(f->self->srs, "festival");
 
+    mrp_del_timer(f->warm_timer);
+    f->warm_timer = NULL;
+
+    mrp_list_foreach(&f->renders, p, n)
+        free_render(mrp_list_entry(p, render_t, hook));
+
     for (i = 0; i < f->nactor; i++) {
         mrp_free(f->actors[i].name);
         carnival_free_string(f->actors[i].lang);
@@ -308,6 +603,10 @@ static void destroy_festival(srs_plugin_t *plugin)
         carnival_free_string(f->actors[i].description);
     }
 
+    mrp_free(f->actors);
+    mrp_free(f->voices);
+    carnival_free_strings(f->warm, f->nwarm);
+
     carnival_exit();
 
     mrp_free(f);
@@ -3,20 +3,46 @@
 
 #include <pulse/mainloop.h>
 
+#include <murphy/common/list.h>
+#include <murphy/common/mainloop.h>
+
 #include "srs/daemon/plugin.h"
 #include "srs/daemon/voice.h"
 
+/*
+ * a festival voice
+ *
+ * All configured voices are registered up front but their data is only
+ * loaded when they are first needed. Festival cannot free voice data,
+ * so loaded voices stay loaded and no more voices are loaded once they
+ * take up the configured memory limit.
+ */
+
+typedef struct {
+    int                loaded;           /* whether voice data is loaded */
+    size_t             size;             /* memory taken by voice data */
+} voice_t;
+
 typedef struct {
     srs_plugin_t      *self;             /* our plugin instance */
     srs_context_t     *srs;              /* SRS context */
-    srs_voice_actor_t *actors;           /* loaded voices */
+    srs_voice_actor_t *actors;           /* registered voices */
+    voice_t           *voices;           /*     and their load state */
     int                nactor;           /* number of voices */
+    size_t             loaded;           /* memory taken by loaded voices */
+    char             **warm;             /* voices to load in advance */
+    int                nwarm;            /* number of voices to warm up */
+    int                nextwarm;         /* next voice to warm up */
+    mrp_timer_t       *warm_timer;       /* timer for warming up voices */
+    mrp_list_hook_t    renders;          /* ongoing renderings */
     struct {
         srs_voice_notify_t  notify;      /* voice notification callback */
         void               *notify_data; /* opaque notification data */
     } voice;
     struct {
         const char    *voices;           /* configured festival voices */
+        const char    *preload;          /* voices to load in advance */
+        size_t         limit;            /* memory limit for loaded voices */
     } config;
 } festival_t;
 
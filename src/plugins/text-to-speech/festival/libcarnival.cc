@@ -19,12 +19,19 @@ typedef struct {
     int              female;             /* whether a female speaker */
     char            *dialect;            /* spoken dialect if any */
     char            *description;        /* verbose voice description */
+    int              loaded;             /* whether voice data is loaded */
     mrp_list_hook_t  hook;
 } voice_t;
 
 static MRP_LIST_HOOK(ventries);          /* all known voices */
 static int           navail;             /* number of available voices */
-static int           nloaded;            /* number of loaded voices */
+static int           ndescribed;         /* number of described voices */
+
+static struct {                          /* ongoing streaming synthesis */
+    carnival_wave_cb_t  cb;              /* callback to pass audio to */
+    void               *user_data;       /* opaque callback data */
+    int                 status;          /* synthesis status */
+} stream;
 
 
 static voice_t *find_voice_entry(const char *name)
@@ -111,6 +118,9 @@ static void update_loaded_voices(void)
             continue;
         }
 
+        if (v->language != NULL)         /* already described */
+            continue;
+
         for (ldescr = car(cdr(lentry)); ldescr != NIL; ldescr = cdr(ldescr)) {
             lp = car(ldescr);
 
@@ -146,7 +156,7 @@ static void update_loaded_voices(void)
                                 v->name, get_c_string(lv));
         }
 
-        nloaded++;
+        ndescribed++;
     }
 
     END_CATCH_ERRORS();
@@ -156,10 +166,17 @@ static void update_loaded_voices(void)
 }
 
 
+static LISP stream_utterance(LISP lutt);
+
+
 int carnival_init(void)
 {
     festival_initialize(TRUE, FESTIVAL_HEAP_SIZE);
 
+    init_subr_1("carnival.utterance", stream_utterance,
+                "(carnival.utterance UTT)\n"
+                "  Synthesize UTT and pass its wave to the ongoing stream.");
+
     update_available_voices();
     update_loaded_voices();
 
@@ -187,8 +204,8 @@ void carnival_exit(void)
 
     festival_tidy_up();
 
-    navail  = 0;
-    nloaded = 0;
+    navail     = 0;
+    ndescribed = 0;
 }
 
 
@@ -231,7 +248,7 @@ int carnival_available_voices(char ***voicesp, int *nvoicep)
 }
 
 
-int carnival_loaded_voices(char ***voicesp, int *nvoicep)
+static int list_voices(char ***voicesp, int *nvoicep, int loaded)
 {
     voice_t          *v;
     mrp_list_hook_t  *p, *n;
@@ -247,7 +264,7 @@ int carnival_loaded_voices(char ***voicesp, int *nvoicep)
     mrp_list_foreach(&ventries, p, n) {
         v = mrp_list_entry(p, voice_t, hook);
 
-        if (!v->language)
+        if (!v->language || (loaded && !v->loaded))
             continue;
 
         if ((voices[nvoice] = mrp_strdup(v->name)) == NULL)
@@ -273,6 +290,18 @@ int carnival_loaded_voices(char ***voicesp, int *nvoicep)
 }
 
 
+int carnival_described_voices(char ***voicesp, int *nvoicep)
+{
+    return list_voices(voicesp, nvoicep, FALSE);
+}
+
+
+int carnival_loaded_voices(char ***voicesp, int *nvoicep)
+{
+    return list_voices(voicesp, nvoicep, TRUE);
+}
+
+
 void carnival_free_string(char *str)
 {
     mrp_free(str);
@@ -289,6 +318,57 @@ void carnival_free_strings(char **strings, int nstring)
 }
 
 
+int carnival_describe_voice(const char *name)
+{
+    voice_t    *v;
+    const char *dir;
+    char        path[1024];
+    LISP        lloc;
+    int         r;
+
+    if ((v = find_voice_entry(name)) == NULL) {
+        errno = ENOENT;
+
+        return -1;
+    }
+
+    if (v->language != NULL)
+        return 0;                        /* already described */
+
+    /*
+     * Loading the voice definition only defines the voice function and
+     * proclaims the voice. The voice data itself only gets loaded once
+     * the voice function is first called.
+     */
+
+    r = -1;
+    CATCH_ERRORS_QUIET()                 /* if (caught lisp errors) */
+        goto outerr;
+
+    lloc = siod_assoc_str(name, siod_get_lval("voice-locations", NULL));
+
+    if (lloc == NIL || (dir = get_c_string(cdr(lloc))) == NULL)
+        goto outerr;
+
+    if (snprintf(path, sizeof(path), "%s/festvox/%s.scm", dir, name) >=
+        (int)sizeof(path))
+        goto outerr;
+
+    vload(path, 0, 1);
+    update_loaded_voices();
+
+    r = (v->language != NULL ? 0 : -1);
+
+ outerr:
+    END_CATCH_ERRORS();
+
+    if (r < 0)
+        errno = ENOENT;
+
+    return r;
+}
+
+
 int carnival_load_voice(const char *name)
 {
     voice_t *v;
@@ -296,7 +376,7 @@ int carnival_load_voice(const char *name)
     LISP     lf, lr;
     int      r;
 
-    if ((v = find_voice_entry(name)) != NULL && v->language != NULL)
+    if ((v = find_voice_entry(name)) != NULL && v->loaded)
         return 0;                        /* already loaded, nothing to do */
 
     if (snprintf(loader, sizeof(loader), "voice_%s", name) >= (int)sizeof(loader)) {
@@ -323,6 +403,8 @@ int carnival_load_voice(const char *name)
 
     update_loaded_voices();
 
+    if (r == 0 && (v = find_voice_entry(name)) != NULL)
+        v->loaded = TRUE;
 
  outerr:
     END_CATCH_ERRORS();
@@ -372,7 +454,7 @@ int carnival_select_voice(const char *name)
     LISP     lf, lr;
     int      r;
 
-    if ((v = find_voice_entry(name)) == NULL || v->language == NULL) {
+    if ((v = find_voice_entry(name)) == NULL || !v->loaded) {
         errno = ENOENT;
 
         return -1;                       /* not loaded, cannot select */
@@ -406,13 +488,31 @@ int carnival_select_voice(const char *name)
 }
 
 
+static int copy_wave(EST_Wave &w, short **bufp)
+{
+    short  *buf;
+    size_t  size;
+
+    size = w.num_channels() * w.num_samples() * sizeof(short);
+
+    if ((buf = (short *)mrp_alloc(size)) == NULL)
+        return -1;
+
+    /* samples are stored interleaved, copy them in one go */
+    if (size > 0)
+        memcpy(buf, w.values().memory(), size);
+
+    *bufp = buf;
+
+    return 0;
+}
+
+
 int carnival_synthesize(const char *text, void **bufp, int *sratep,
                         int *nchannelp, int *nsamplep)
 {
     EST_Wave  w;
     short    *buf;
-    size_t    size;
-    int       nchannel, nsample, i;
 
     if (sratep == NULL || nchannelp == NULL || nsamplep == NULL) {
         errno = EFAULT;
@@ -423,22 +523,90 @@ int carnival_synthesize(const char *text, void **bufp, int *sratep,
     if (!festival_text_to_wave(text, w))
         return -1;
 
-    nchannel = w.num_channels();
-    nsample  = w.num_samples();
-    size     = nchannel * nsample * 2;
-
-    buf = (short *)mrp_allocz(size);
-
-    if (buf == NULL)
+    if (copy_wave(w, &buf) < 0)
         return -1;
 
-    for (i = 0; i < nsample; i++)
-        w.copy_sample(i, buf + i * nchannel);
-
     *sratep    = w.sample_rate();
-    *nchannelp = nchannel;
-    *nsamplep  = nsample;
+    *nchannelp = w.num_channels();
+    *nsamplep  = w.num_samples();
     *bufp      = (void *)buf;
 
     return 0;
 }
+
+
+static LISP stream_utterance(LISP lutt)
+{
+    EST_Wave *w;
+    LISP      lwave;
+
+    /* once the consumer has given up, skip the remaining utterances */
+    if (stream.cb == NULL || stream.status != 0)
+        return lutt;
+
+    lutt  = leval(cons(rintern("utt.synth"), cons(lutt, NIL)), NIL);
+    lwave = leval(cons(rintern("utt.wave"), cons(lutt, NIL)), NIL);
+    w     = wave(lwave);
+
+    if (w == NULL || w->num_samples() == 0)
+        return lutt;
+
+    if (stream.cb((void *)w->values().memory(), w->sample_rate(),
+                  w->num_channels(), w->num_samples(), stream.user_data) < 0)
+        stream.status = -1;
+
+    return lutt;
+}
+
+
+int carnival_synthesize_stream(const char *text, carnival_wave_cb_t cb,
+                               void *user_data)
+{
+    LISP hooks;
+    int  r;
+
+    if (cb == NULL) {
+        errno = EFAULT;
+
+        return -1;
+    }
+
+    if (stream.cb != NULL) {
+        errno = EBUSY;
+
+        return -1;
+    }
+
+    /*
+     * Let festival chunk the text into utterances and synthesize and
+     * pass on each of them from tts_hooks as soon as it gets done.
+     */
+
+    hooks = siod_get_lval("tts_hooks", NULL);
+    gc_protect(&hooks);
+
+    stream.cb        = cb;
+    stream.user_data = user_data;
+    stream.status    = 0;
+
+    r = -1;
+    CATCH_ERRORS_QUIET()                 /* if (caught lisp errors) */
+        goto outerr;
+
+    siod_set_lval("tts_hooks", cons(rintern("carnival.utterance"), NIL));
+    leval(cons(rintern("tts_text"), cons(strintern(text), cons(NIL, NIL))),
+          NIL);
+
+    r = stream.status;
+
+ outerr:
+    END_CATCH_ERRORS();
+
+    siod_set_lval("tts_hooks", hooks);
+    gc_unprotect(&hooks);
+
+    stream.cb        = NULL;
+    stream.user_data = NULL;
+
+    return r;
+}
@@ -22,6 +22,9 @@ void carnival_exit(void);
 /** List available voices. */
 int carnival_available_voices(char ***voices, int *nvoice);
 
+/** List described voices, the ones that can be queried. */
+int carnival_described_voices(char ***voices, int *nvoice);
+
 /** List loaded voices. */
 int carnival_loaded_voices(char ***voices, int *nvoice);
 
@@ -31,10 +34,13 @@ void carnival_free_string(char *str);
 /** Free an array of strings allocated by libcarnival. */
 void carnival_free_strings(char **strings, int nstring);
 
+/** Describe a given voice without loading its data. */
+int carnival_describe_voice(const char *name);
+
 /** Load a given voice. */
 int carnival_load_voice(const char *name);
 
-/** Query a (loaded) voice. */
+/** Query a (described) voice. */
 int carnival_query_voice(const char *name, char **language, int *female,
                          char **dialect, char **description);
 
@@ -45,6 +51,14 @@ int carnival_select_voice(const char *name);
 int carnival_synthesize(const char *text, void **bufp, int *sratep,
                         int *nchannelp, int *nsamplep);
 
+/** Callback to pass synthesized audio to, return < 0 to abort synthesis. */
+typedef int (*carnival_wave_cb_t)(void *samples, int srate, int nchannel,
+                                  int nsample, void *user_data);
+
+/** Synthesize a message one utterance at a time, passing on the audio. */
+int carnival_synthesize_stream(const char *text, carnival_wave_cb_t cb,
+                               void *user_data);
+
 MRP_CDECL_END
 
 
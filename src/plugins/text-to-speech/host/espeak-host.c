@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include <espeak/speak_lib.h>
+
+#include "srs/daemon/iso-6391.h"
+
+#include "host.h"
+
+#define CONFIG_VOICEDIR "espeak.voicedir"
+
+#define ESPEAK_CONTINUE 0
+#define ESPEAK_ABORT    1
+
+static int           rate;               /* sample rate */
+static host_voice_t *voices;             /* voices */
+static int           nvoice;             /* number of voices */
+static size_t        length;             /* length of message being rendered */
+
+
+static int synth_cb(short *samples, int nsample, espeak_EVENT *events)
+{
+    double input;
+
+    if (samples == NULL || nsample <= 0)
+        return host_cancelled() ? ESPEAK_ABORT : ESPEAK_CONTINUE;
+
+    if (events != NULL && length > 0 && events->text_position > 0)
+        input = (1.0 * events->text_position) / length;
+    else
+        input = 0.0;
+
+    if (host_write(samples, nsample, input < 1.0 ? input : 1.0) < 0)
+        return ESPEAK_ABORT;
+
+    return ESPEAK_CONTINUE;
+}
+
+
+static int espeak_init(void)
+{
+    const char *path = host_config(CONFIG_VOICEDIR, NULL);
+
+    /* we stream as we go, so keep the chunks short */
+    rate = espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 50, path, 0);
+
+    if (rate <= 0)
+        return -1;
+
+    espeak_SetSynthCallback(synth_cb);
+
+    return 0;
+}
+
+
+static const char *parse_dialect(const char *lang, const char **dialect)
+{
+    const char *l, *d;
+    char        code[8];
+    size_t      n;
+
+    *dialect = NULL;
+
+    if ((d = strchr(lang, '-')) != NULL && (n = d - lang) <= 3) {
+        strncpy(code, lang, n);
+        code[n] = '\0';
+        d++;
+    }
+    else {
+        snprintf(code, sizeof(code), "%s", lang);
+        d = NULL;
+    }
+
+    if ((l = srs_iso6391_language(code)) == NULL)
+        return lang;
+
+    if (d != NULL && strcmp(code, d))
+        *dialect = srs_iso6391_dialect(d);
+
+    return l;
+}
+
+
+static int espeak_voices(host_voice_t **voicesp)
+{
+    espeak_VOICE **ev, *v;
+    host_voice_t  *hv;
+    const char    *lang;
+    char           descr[256];
+    int            i;
+
+    if ((ev = (espeak_VOICE **)espeak_ListVoices(NULL)) == NULL)
+        return 0;
+
+    /* a voice for every language of every espeak voice */
+    for (i = 0; (v = ev[i]) != NULL; i++) {
+        for (lang = v->languages + 1; *lang; lang += strlen(lang) + 1) {
+            if (!mrp_reallocz(voices, nvoice, nvoice + 1))
+                return nvoice;
+
+            snprintf(descr, sizeof(descr), "espeak %s voice (%s).", lang,
+                     v->identifier ? v->identifier : "-");
+
+            hv = voices + nvoice;
+            hv->id          = nvoice;
+            hv->name        = v->name;
+            hv->lang        = parse_dialect(lang, &hv->dialect);
+            hv->gender      = v->gender == 2 ?
+                SRS_VOICE_GENDER_FEMALE : SRS_VOICE_GENDER_MALE;
+            hv->age         = v->age;
+            hv->description = mrp_strdup(descr);
+
+            nvoice++;
+        }
+    }
+
+    *voicesp = voices;
+
+    return nvoice;
+}
+
+
+static void set_rate(double drate)
+{
+    int r;
+
+    if (drate <= 0.0 || drate > 2.0)
+        drate = 1.0;
+
+    if (drate <= 1.0)
+        r = espeakRATE_MINIMUM +
+            drate * (espeakRATE_NORMAL - espeakRATE_MINIMUM);
+    else
+        r = espeakRATE_NORMAL +
+            (drate - 1.0) * (espeakRATE_MAXIMUM - espeakRATE_NORMAL);
+
+    espeak_SetParameter(espeakRATE, r, 0);
+}
+
+
+static void set_pitch(double dpitch)
+{
+    if (dpitch <= 0.0 || dpitch > 2.0)
+        dpitch = 1.0;
+
+    espeak_SetParameter(espeakPITCH, (int)(50 * dpitch), 0);
+}
+
+
+static int espeak_render(const char *msg, uint32_t voice, double drate,
+                         double dpitch)
+{
+    unsigned int uid = 0;
+
+    if (voice >= (uint32_t)nvoice)
+        return EINVAL;
+
+    if (espeak_SetVoiceByName(voices[voice].name) != EE_OK)
+        return ENOENT;
+
+    set_rate(drate);
+    set_pitch(dpitch);
+
+    if (host_format(rate, 1) < 0)
+        return errno;
+
+    length = strlen(msg);
+
+    if (espeak_Synth(msg, length + 1, 0, POS_CHARACTER, 0, espeakCHARS_UTF8,
+                     &uid, NULL) != EE_OK && !host_cancelled())
+        return EIO;
+
+    return 0;
+}
+
+
+static void espeak_exit(void)
+{
+    int i;
+
+    espeak_Terminate();
+
+    for (i = 0; i < nvoice; i++)
+        mrp_free((char *)voices[i].description);
+    mrp_free(voices);
+}
+
+
+host_engine_t host_engine = {
+    .name   = "espeak",
+    .init   = espeak_init,
+    .voices = espeak_voices,
+    .render = espeak_render,
+    .exit   = espeak_exit,
+};
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+
+#include <murphy/common/macros.h>
+#include <murphy/common/mm.h>
+#include <murphy/common/log.h>
+
+#include "srs/daemon/voice-host-protocol.h"
+
+#include "host.h"
+
+static int     hargc;                    /* configuration from the daemon */
+static char  **hargv;
+static char   *buf;                      /* shared sample buffer */
+static uint32_t busy;                    /* mask of slots in use */
+static uint32_t current;                 /* rendering in progress */
+static int     nchannel;                 /*     its number of channels */
+static int     cancelled;                /*     whether it was cancelled */
+
+
+const char *host_config(const char *key, const char *defval)
+{
+    size_t len = strlen(key);
+    int    i;
+
+    for (i = 0; i < hargc; i++)
+        if (!strncmp(hargv[i], key, len) && hargv[i][len] == '=')
+            return hargv[i] + len + 1;
+
+    return defval;
+}
+
+
+static int send_msg(srs_host_msg_t *msg, size_t size)
+{
+    if (send(SRS_HOST_SOCKET, msg, size, MSG_NOSIGNAL) != (ssize_t)size) {
+        mrp_log_error("%s host: failed to send message (%d: %s).",
+                      host_engine.name, errno, strerror(errno));
+        exit(1);
+    }
+
+    return 0;
+}
+
+
+static int recv_msg(srs_host_msg_t *msg, int block)
+{
+    ssize_t n;
+
+    while ((n = recv(SRS_HOST_SOCKET, msg, SRS_HOST_MSG_MAX,
+                     block ? 0 : MSG_DONTWAIT)) < 0) {
+        if (errno == EAGAIN)
+            return 0;
+        if (errno != EINTR)
+            break;
+    }
+
+    if (n <= 0)
+        return -1;
+
+    if (n < (ssize_t)sizeof(*msg))
+        return 0;
+
+    ((char *)msg)[n < SRS_HOST_MSG_MAX ? n : SRS_HOST_MSG_MAX - 1] = '\0';
+
+    return (int)n;
+}
+
+
+static void handle_msg(srs_host_msg_t *msg)
+{
+    switch (msg->type) {
+    case SRS_HOST_MSG_ACK:
+        if (msg->data.ack.slot < SRS_HOST_NSLOT)
+            busy &= ~(1 << msg->data.ack.slot);
+        break;
+
+    case SRS_HOST_MSG_CANCEL:
+        if (msg->id == current)
+            cancelled = TRUE;
+        break;
+
+    default:
+        mrp_log_error("%s host: unexpected message 0x%x.", host_engine.name,
+                      msg->type);
+    }
+}
+
+
+static void pump_msgs(int block)
+{
+    char            mbuf[SRS_HOST_MSG_MAX];
+    srs_host_msg_t *msg = (srs_host_msg_t *)mbuf;
+
+    int             n;
+
+    if (block && (n = recv_msg(msg, TRUE)) > 0)
+        handle_msg(msg);
+
+    while ((n = recv_msg(msg, FALSE)) > 0)
+        handle_msg(msg);
+
+    /* daemon gone, so are we */
+    if (n < 0)
+        exit(0);
+}
+
+
+int host_format(int sample_rate, int nch)
+{
+    srs_host_msg_t msg;
+
+    mrp_clear(&msg);
+    msg.type                 = SRS_HOST_MSG_FORMAT;
+    msg.id                   = current;
+    msg.data.format.rate     = sample_rate;
+    msg.data.format.nchannel = nch;
+
+    nchannel = nch;
+
+    return send_msg(&msg, sizeof(msg));
+}
+
+
+int host_write(void *samples, uint32_t nsample, double input)
+{
+    srs_host_msg_t  msg;
+    char           *p;
+    size_t          size, max, n;
+    int             slot;
+
+    if (nchannel <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    p    = samples;
+    size = 2 * (size_t)nsample * nchannel;
+    max  = SRS_HOST_SLOT_SIZE - SRS_HOST_SLOT_SIZE % (2 * nchannel);
+
+    while (size > 0) {
+        pump_msgs(FALSE);
+
+        if (cancelled) {
+            errno = ECANCELED;
+            return -1;
+        }
+
+        for (slot = 0; slot < SRS_HOST_NSLOT; slot++)
+            if (!(busy & (1 << slot)))
+                break;
+
+        /* wait for the daemon to catch up */
+        if (slot == SRS_HOST_NSLOT) {
+            pump_msgs(TRUE);
+            continue;
+        }
+
+        n = size < max ? size : max;
+        memcpy(buf + slot * SRS_HOST_SLOT_SIZE, p, n);
+        busy |= (1 << slot);
+
+        mrp_clear(&msg);
+        msg.type             = SRS_HOST_MSG_CHUNK;
+        msg.id               = current;
+        msg.data.chunk.slot  = slot;
+        msg.data.chunk.size  = n;
+        msg.data.chunk.input = input;
+
+        send_msg(&msg, sizeof(msg));
+
+        p    += n;
+        size -= n;
+    }
+
+    return 0;
+}
+
+
+int host_cancelled(void)
+{
+    pump_msgs(FALSE);
+
+    return cancelled;
+}
+
+
+static void announce_voices(void)
+{
+    char            mbuf[SRS_HOST_MSG_MAX];
+    srs_host_msg_t *msg = (srs_host_msg_t *)mbuf;
+    host_voice_t   *voices, *v;
+    char           *p;
+    int             nvoice, i, n;
+
+    nvoice = host_engine.voices(&voices);
+
+    for (i = 0, v = voices; i < nvoice; i++, v++) {
+        mrp_clear(msg);
+        msg->type              = SRS_HOST_MSG_VOICE;
+        msg->id                = v->id;
+        msg->data.voice.gender = v->gender;
+        msg->data.voice.age    = v->age;
+
+        p = SRS_HOST_MSG_PAYLOAD(msg);
+        n = snprintf(p, mbuf + sizeof(mbuf) - p, "%s%c%s%c%s%c%s",
+                     v->name, 0, v->lang, 0, v->dialect ? v->dialect : "", 0,
+                     v->description ? v->description : "");
+
+        if (n >= mbuf + sizeof(mbuf) - p)
+            continue;
+
+        send_msg(msg, sizeof(*msg) + n + 1);
+    }
+
+    mrp_clear(msg);
+    msg->type              = SRS_HOST_MSG_READY;
+    msg->data.ready.nvoice = nvoice > 0 ? nvoice : 0;
+
+    send_msg(msg, sizeof(*msg));
+}
+
+
+static void render(srs_host_msg_t *req)
+{
+    srs_host_msg_t msg;
+    int            status;
+
+    current   = req->id;
+    cancelled = FALSE;
+    nchannel  = 0;
+
+    status = host_engine.render(SRS_HOST_MSG_PAYLOAD(req),
+                                req->data.render.actor,
+                                req->data.render.rate,
+                                req->data.render.pitch);
+
+    if (cancelled)
+        status = ECANCELED;
+
+    mrp_clear(&msg);
+    msg.type             = SRS_HOST_MSG_DONE;
+    msg.id               = current;
+    msg.data.done.status = status;
+
+    send_msg(&msg, sizeof(msg));
+}
+
+
+int main(int argc, char *argv[])
+{
+    char            mbuf[SRS_HOST_MSG_MAX];
+    srs_host_msg_t *msg = (srs_host_msg_t *)mbuf;
+    int             n;
+
+    hargc = argc - 1;
+    hargv = argv + 1;
+
+    buf = mmap(NULL, SRS_HOST_NSLOT * SRS_HOST_SLOT_SIZE,
+               PROT_READ | PROT_WRITE, MAP_SHARED, SRS_HOST_BUFFER, 0);
+
+    if (buf == MAP_FAILED) {
+        mrp_log_error("%s host: failed to map sample buffer (%d: %s).",
+                      host_engine.name, errno, strerror(errno));
+        exit(1);
+    }
+
+    if (host_engine.init() < 0) {
+        mrp_log_error("%s host: failed to initialize engine.",
+                      host_engine.name);
+        exit(1);
+    }
+
+    announce_voices();
+
+    while ((n = recv_msg(msg, TRUE)) >= 0) {
+        if (n == 0)
+            continue;
+
+        if (msg->type == SRS_HOST_MSG_RENDER)
+            render(msg);
+        else
+            handle_msg(msg);
+    }
+
+    host_engine.exit();
+
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
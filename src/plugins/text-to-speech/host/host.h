@@ -0,0 +1,64 @@
+#ifndef __SRS_TTS_HOST_H__
+#define __SRS_TTS_HOST_H__
+
+#include <stdint.h>
+
+#include "srs/daemon/voice-api-types.h"
+
+/*
+ * synthesizer host
+ *
+ * The generic part of a synthesizer host process, which talks to the
+ * daemon (see srs/daemon/voice-host-protocol.h). A host is linked with
+ * exactly one engine, which provides the host_engine descriptor below.
+ * Engines are only ever called from the single thread of the host and
+ * render only one message at a time.
+ */
+
+typedef struct {
+    uint32_t            id;              /* engine voice id */
+    const char         *name;            /* engine voice name */
+    const char         *lang;            /* spoken language */
+    const char         *dialect;         /* language dialect, if any */
+    srs_voice_gender_t  gender;          /* voice gender */
+    int                 age;             /* voice age */
+    const char         *description;     /* human-readable description */
+} host_voice_t;
+
+typedef struct {
+    const char *name;                    /* engine name */
+    /** Initialize the engine. */
+    int  (*init)(void);
+    /** Get the voices of the engine. */
+    int  (*voices)(host_voice_t **voices);
+    /** Render a message, passing on samples with host_write. */
+    int  (*render)(const char *msg, uint32_t voice, double rate,
+                   double pitch);
+    /** Clean up the engine. */
+    void (*exit)(void);
+} host_engine_t;
+
+/** The engine of this host. */
+extern host_engine_t host_engine;
+
+/** Get a configuration value passed to us by the daemon. */
+const char *host_config(const char *key, const char *defval);
+
+/** Set the sample format of the current rendering. */
+int host_format(int sample_rate, int nchannel);
+
+/** Pass on samples of the current rendering, fails once cancelled. */
+int host_write(void *samples, uint32_t nsample, double input);
+
+/** Check whether the current rendering has been cancelled. */
+int host_cancelled(void);
+
+#endif /* __SRS_TTS_HOST_H__ */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */